@@ -0,0 +1,223 @@
+﻿#include "AppConfig.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    uint32_t ParseUInt(const std::string& option , const char* value)
+    {
+        if (value == nullptr)
+        {
+            throw std::runtime_error("缺少参数值: " + option);
+        }
+        try
+        {
+            return static_cast<uint32_t>(std::stoul(value));
+        }
+        catch (const std::exception&)
+        {
+            throw std::runtime_error("参数值不是整数: " + option + " " + value);
+        }
+    }
+}
+
+AppConfig AppConfig::FromCommandLine(int argc , char** argv)
+{
+    AppConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string option = argv[i];
+        const char* value  = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (option == "--frames-in-flight")
+        {
+            config.framesInFlight = ParseUInt(option, value);
+            i++;
+        }
+        else if (option == "--headless")
+        {
+            config.headless = true;
+        }
+        else if (option == "--pipeline-cache")
+        {
+            if (value == nullptr)
+            {
+                throw std::runtime_error("缺少参数值: " + option);
+            }
+            config.pipelineCachePath = value;
+            i++;
+        }
+        else if (option == "--no-pipeline-cache")
+        {
+            config.pipelineCachePath.clear();
+        }
+        else if (option == "--calibrate")
+        {
+            config.calibrateDevices = true;
+        }
+        else if (option == "--calibration-cache")
+        {
+            if (value == nullptr)
+            {
+                throw std::runtime_error("缺少参数值: " + option);
+            }
+            config.calibrationPath = value;
+            i++;
+        }
+        else if (option == "--shader-dir")
+        {
+            if (value == nullptr)
+            {
+                throw std::runtime_error("缺少参数值: " + option);
+            }
+            config.shaderDirectory = value;
+            i++;
+        }
+        else if (option == "--instances")
+        {
+            config.instanceCount = ParseUInt(option, value);
+            i++;
+        }
+        else if (option == "--present-policy")
+        {
+            if (value == nullptr)
+            {
+                throw std::runtime_error("缺少参数值: " + option);
+            }
+            config.presentPolicy = value;
+            i++;
+        }
+        else if (option == "--target-fps")
+        {
+            config.targetFps = ParseUInt(option, value);
+            i++;
+        }
+        else if (option == "--record-threads")
+        {
+            config.recordThreads = ParseUInt(option, value);
+            i++;
+        }
+        else if (option == "--gpu-culling")
+        {
+            config.gpuCulling = true;
+        }
+        else if (option == "--bindless-textures")
+        {
+            config.bindlessTextures = ParseUInt(option, value);
+            i++;
+        }
+        else if (option == "--textures")
+        {
+            if (value == nullptr)
+            {
+                throw std::runtime_error("缺少参数值: " + option);
+            }
+            config.textureDirectory = value;
+            i++;
+        }
+        else if (option == "--texture-upload-kb")
+        {
+            config.textureUploadKB = ParseUInt(option, value);
+            i++;
+        }
+        else if (option == "--texture-budget-mb")
+        {
+            config.textureBudgetMB = ParseUInt(option, value);
+            i++;
+        }
+        else if (option == "--compile-threads")
+        {
+            config.compileThreads = ParseUInt(option, value);
+            i++;
+        }
+        else if (option == "--shader-variant")
+        {
+            if (value == nullptr)
+            {
+                throw std::runtime_error("缺少参数值: " + option);
+            }
+            config.shaderVariant = value;
+            i++;
+        }
+        else if (option == "--validation-severity")
+        {
+            if (value == nullptr)
+            {
+                throw std::runtime_error("缺少参数值: " + option);
+            }
+            config.validationSeverity = value;
+            i++;
+        }
+        else if (option == "--validation-types")
+        {
+            if (value == nullptr)
+            {
+                throw std::runtime_error("缺少参数值: " + option);
+            }
+            config.validationTypes = value;
+            i++;
+        }
+        else if (option == "--validation-repeats")
+        {
+            config.validationRepeatLimit = ParseUInt(option, value);
+            i++;
+        }
+        else if (option == "--profile")
+        {
+            if (value == nullptr)
+            {
+                throw std::runtime_error("缺少参数值: " + option);
+            }
+            config.profilePath = value;
+            i++;
+        }
+        else if (option == "--bench")
+        {
+            if (value == nullptr)
+            {
+                throw std::runtime_error("缺少参数值: " + option);
+            }
+            config.benchmark = value;
+            i++;
+        }
+        else if (option == "--check")
+        {
+            if (value == nullptr)
+            {
+                throw std::runtime_error("缺少参数值: " + option);
+            }
+            config.check = value;
+            i++;
+        }
+        else if (option == "--bench-count")
+        {
+            config.benchCount = ParseUInt(option, value);
+            i++;
+        }
+        else if (option == "--bench-threads")
+        {
+            config.benchThreads = ParseUInt(option, value);
+            i++;
+        }
+        else if (option == "--frames")
+        {
+            config.frameCount = ParseUInt(option, value);
+            i++;
+        }
+        else
+        {
+            throw std::runtime_error("未知的命令行参数: " + option);
+        }
+    }
+
+    if (config.framesInFlight == 0)
+    {
+        throw std::runtime_error("--frames-in-flight 至少为1");
+    }
+    if (config.headless && config.frameCount == 0)
+    {
+        config.frameCount = DefaultHeadlessFrames;
+    }
+    return config;
+}
@@ -0,0 +1,81 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+
+//运行参数，由命令行解析得到，未指定的项使用默认值
+struct AppConfig
+{
+    //同时处于飞行状态(CPU已提交、GPU尚未完成)的最大帧数。
+    //为1时CPU每帧都要等待GPU完成上一帧；大于1时CPU可以在GPU执行第N帧时录制第N+1帧。
+    uint32_t framesInFlight = 2;
+
+    //无头模式：不创建窗口和交换链，渲染到离屏图像，用于没有显示器的机器(例如lavapipe上的CI)
+    bool headless = false;
+
+    //渲染指定帧数后退出，0表示一直运行到窗口关闭。无头模式下未指定时默认渲染DefaultHeadlessFrames帧
+    uint32_t frameCount = 0;
+
+    static constexpr uint32_t DefaultHeadlessFrames = 1000;
+
+    //管线缓存文件路径，为空时不读写磁盘
+    std::string pipelineCachePath = "pipeline_cache.bin";
+
+    //有多个可用的物理设备时，用短小的测试(复制带宽、计算、填充率)实测每个设备并选择分数最高的，见DeviceCalibration.h。
+    //结果按设备UUID和驱动版本缓存在calibrationPath中，为空时每次启动都重新测量
+    bool        calibrateDevices = false;
+    std::string calibrationPath  = "device_calibration.txt";
+
+    //不为空时从该目录读取<名称>.spv，覆盖构建时内嵌的着色器，用于不重新编译程序就调试着色器
+    std::string shaderDirectory;
+
+    //大于0时改用实例化绘制，每帧绘制这么多个三角形实例
+    uint32_t instanceCount = 0;
+
+    //呈现策略：latency(最低延迟)、vsync(垂直同步节奏)、power(省电，限制帧率)，见FramePacer.h
+    std::string presentPolicy = "latency";
+    //帧率上限，0表示使用策略的默认值(power为刷新率的一半，其它不限制)
+    uint32_t targetFps = 0;
+
+    //大于0时每个实例单独一次绘制调用，绘制列表由这么多个线程(包括主线程)并行录制进secondary命令缓冲。
+    //0表示单线程录制，实例化时一次绘制调用画出全部实例
+    uint32_t recordThreads = 0;
+
+    //GPU剔除：计算着色器按视锥体剔除实例并生成间接绘制命令，CPU每帧的开销与实例数量无关
+    bool gpuCulling = false;
+
+    //全局无绑定描述符堆中纹理的容量(按设备上限截断)，0表示不使用描述符堆。设备不支持描述符索引时自动关闭
+    uint32_t bindlessTextures = 65536;
+
+    //不为空时从该目录加载全部.ktx2和.dds纹理并在后台流送，见TextureStreamer.h。
+    //每帧最多上传textureUploadKB千字节，纹理占用的设备内存不超过textureBudgetMB兆字节
+    std::string textureDirectory;
+    uint32_t    textureUploadKB = 4096;
+    uint32_t    textureBudgetMB = 256;
+
+    //后台编译管线的线程数，0表示按CPU核心数自动选择
+    uint32_t compileThreads = 0;
+
+    //场景着色器的变体，例如"colorMode=2,posterize=6"，没有给出的选项取默认值，见PipelineVariants.h
+    std::string shaderVariant;
+
+    //校验层消息：记录的最低级别(verbose/info/warning/error)和类型(general/validation/performance，逗号分隔)
+    std::string validationSeverity = "warning";
+    std::string validationTypes    = "general,validation,performance";
+    //同一种消息(messageIdNumber和pMessageIdName都相同)最多输出的次数，之后只计数，0表示不限制
+    uint32_t validationRepeatLimit = 3;
+
+    //不为空时记录CPU区间和GPU时间戳，退出时以Chrome trace JSON格式写到这个路径
+    std::string profilePath;
+
+    //不为空时运行指定的基准测试而不进入帧循环
+    std::string benchmark;
+    uint32_t    benchCount   = 0; //每轮测试的工作量，含义由具体的测试决定，0表示使用测试的默认值
+    uint32_t    benchThreads = 0; //测试的最大线程数，0表示按CPU核心数自动选择
+
+    //不为空时运行指定的检查后退出，不创建窗口和设备；检查失败时抛出异常，程序返回非0。
+    //目前只有math：SIMD数学库的每一级实现和标量参考逐位比较，元素数量由benchCount指定
+    std::string check;
+
+    static AppConfig FromCommandLine(int argc , char** argv);
+};
@@ -0,0 +1,1600 @@
+﻿#include "MainLoop.h"
+#include "Vertex.h"
+#include "../Math/Batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+void HelloTriangleApplication::RunBenchmark()
+{
+    if (m_Config.benchmark == "pipelines")
+    {
+        BenchmarkPipelineCompilation();
+    }
+    else if (m_Config.benchmark == "instances")
+    {
+        BenchmarkInstancing();
+    }
+    else if (m_Config.benchmark == "resize")
+    {
+        BenchmarkResize();
+    }
+    else if (m_Config.benchmark == "present")
+    {
+        BenchmarkPresent();
+    }
+    else if (m_Config.benchmark == "recording")
+    {
+        BenchmarkRecording();
+    }
+    else if (m_Config.benchmark == "rendergraph")
+    {
+        BenchmarkRenderGraph();
+    }
+    else if (m_Config.benchmark == "bindless")
+    {
+        BenchmarkBindless();
+    }
+    else if (m_Config.benchmark == "culling")
+    {
+        BenchmarkCulling();
+    }
+    else if (m_Config.benchmark == "math")
+    {
+        BenchmarkMath();
+    }
+    else if (m_Config.benchmark == "variants")
+    {
+        BenchmarkPipelineVariants();
+    }
+    else if (m_Config.benchmark == "states")
+    {
+        BenchmarkPipelineStates();
+    }
+    else if (m_Config.benchmark == "textures")
+    {
+        BenchmarkTextures();
+    }
+    else
+    {
+        throw std::runtime_error("未知的基准测试: " + m_Config.benchmark);
+    }
+}
+
+/*
+ * 用1..K个线程分别编译同一组N条管线变体，比较墙钟时间。
+ * 每一轮都使用新建的空管线缓存，避免后一轮直接命中前一轮的编译结果。
+ * 注意驱动自己可能还有磁盘着色器缓存(例如Mesa的MESA_SHADER_CACHE_DISABLE)，测试前应当关掉它。
+ */
+void HelloTriangleApplication::BenchmarkPipelineCompilation()
+{
+    uint32_t variantCount = m_Config.benchCount != 0 ? m_Config.benchCount : 64;
+    uint32_t maxThreads   = m_Config.benchThreads != 0 ? m_Config.benchThreads : ThreadPool::DefaultThreadCount();
+
+    GraphicsPipelineDesc base = {};
+    base.vertexShader         = m_VertexShaderModule;
+    base.fragmentShader       = m_FragmentShaderModule;
+    base.layout               = m_PipelineLayout;
+    base.renderPass           = m_RenderGraph.RenderPass(m_ScenePass);
+    base.subpass              = m_RenderGraph.Subpass(m_ScenePass);
+    base.vertexInput          = Vertex::InputDesc();
+
+    //只改变不需要额外设备特性的状态，组合出互不相同的变体：3种图元 x 4种剔除 x 2种正面 x 2种混合 x 15种写掩码
+    const VkPrimitiveTopology topologies[] = {
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, VK_PRIMITIVE_TOPOLOGY_LINE_LIST
+    };
+    const VkCullModeFlags cullModes[] = {
+        VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_FRONT_AND_BACK
+    };
+
+    std::vector<GraphicsPipelineDesc> variants(variantCount, base);
+    for (uint32_t i = 0; i < variantCount; i++)
+    {
+        uint32_t key = i;
+        variants[i].topology       = topologies[key % 3];
+        key /= 3;
+        variants[i].cullMode       = cullModes[key % 4];
+        key /= 4;
+        variants[i].frontFace      = key % 2 == 0 ? VK_FRONT_FACE_CLOCKWISE : VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        key /= 2;
+        variants[i].blendEnable    = key % 2 == 1;
+        key /= 2;
+        variants[i].colorWriteMask = 0xF - key % 15;
+    }
+
+    std::cout << "pipeline compilation benchmark: " << variantCount << " variants\n";
+    std::cout << "threads |   wall ms | pipelines/s | speedup\n";
+
+    double singleThreadMs = 0.0;
+    for (uint32_t threads = 1; threads <= maxThreads; threads++)
+    {
+        VkPipelineCacheCreateInfo cacheInfo = {};
+        cacheInfo.sType                     = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        VkPipelineCache cache;
+        if (vkCreatePipelineCache(m_Device, &cacheInfo, nullptr, &cache) != VK_SUCCESS)
+        {
+            throw std::runtime_error("创建管线缓存失败");
+        }
+
+        std::vector<VkPipeline> pipelines;
+        pipelines.reserve(variantCount);
+
+        auto start = std::chrono::steady_clock::now();
+        {
+            PipelineCompiler compiler(m_Device, cache, threads);
+
+            std::vector<std::shared_future<VkPipeline>> futures;
+            futures.reserve(variantCount);
+            for (const auto& variant : variants)
+            {
+                futures.push_back(compiler.Compile(variant, CompilePriority::Background));
+            }
+            for (auto& future : futures)
+            {
+                pipelines.push_back(future.get());
+            }
+        }
+        double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (threads == 1)
+        {
+            singleThreadMs = wallMs;
+        }
+
+        char line[96];
+        std::snprintf(line, sizeof(line), "%7u | %9.2f | %11.1f | %6.2fx", threads, wallMs,
+                      variantCount * 1000.0 / wallMs, singleThreadMs / wallMs);
+        std::cout << line << '\n';
+
+        for (auto pipeline : pipelines)
+        {
+            vkDestroyPipeline(m_Device, pipeline, nullptr);
+        }
+        vkDestroyPipelineCache(m_Device, cache, nullptr);
+    }
+}
+
+/*
+ * 实例数从1K开始每次乘10，直到1M，每个规模渲染N帧(默认300)，统计：
+ *     CPU：每帧更新SoA数据、memcpy到实例缓冲、录制和提交命令的平均耗时
+ *     帧时间：连续渲染时相邻两帧之间的平均间隔，包括等待GPU的时间
+ * 窗口模式下帧时间会被垂直同步限制，测GPU吞吐时应当加--headless
+ */
+void HelloTriangleApplication::BenchmarkInstancing()
+{
+    uint32_t frames       = m_Config.benchCount != 0 ? m_Config.benchCount : 300;
+    uint32_t warmupFrames = m_Config.framesInFlight * 2 + 8;
+
+    std::cout << "instancing benchmark: " << frames << " frames per size"
+            << ( m_Config.headless ? "" : " (vsync may cap frame time, use --headless)" ) << '\n';
+    std::cout << "instances |  cpu ms | frame ms | Minstances/s\n";
+
+    for (uint32_t count = 1000; count <= 1000000; count *= 10)
+    {
+        vkDeviceWaitIdle(m_Device);
+        CreateInstances(count);
+
+        //预热：让每套帧资源都完整地跑过几轮，驱动和内存都进入稳定状态
+        for (uint32_t i = 0; i < warmupFrames; i++)
+        {
+            DrawFrame();
+        }
+
+        double cpuMs = 0.0;
+        auto   start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            if (m_Window != nullptr)
+            {
+                glfwPollEvents();
+            }
+            DrawFrame();
+            cpuMs += m_LastCpuFrameMs;
+        }
+        vkDeviceWaitIdle(m_Device);
+        double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() /
+                frames;
+
+        char line[96];
+        std::snprintf(line, sizeof(line), "%9u | %7.3f | %8.3f | %12.1f", count, cpuMs / frames, frameMs,
+                      count / frameMs / 1000.0);
+        std::cout << line << '\n';
+    }
+
+    //恢复命令行指定的实例数
+    vkDeviceWaitIdle(m_Device);
+    CreateInstances(m_Config.instanceCount);
+}
+
+/*
+ * 交换链重建压力测试：先正常渲染N帧作为基准，再渲染N帧，每一帧都改变窗口尺寸。
+ * 比较两个阶段的帧时间分布，重建引起的卡顿体现在p99和最大值上。
+ * 需要窗口，无头模式没有交换链
+ */
+void HelloTriangleApplication::BenchmarkResize()
+{
+    if (m_Window == nullptr)
+    {
+        throw std::runtime_error("resize基准测试需要窗口，不能在无头模式下运行");
+    }
+
+    uint32_t frames = m_Config.benchCount != 0 ? m_Config.benchCount : 600;
+
+    auto runPhase = [&](bool resize)
+    {
+        std::vector<double> frameMs;
+        frameMs.reserve(frames);
+        auto last = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            if (resize)
+            {
+                //宽高按不同的周期变化，尺寸几乎每帧都不同
+                int width  = static_cast<int>(Width * ( 0.75 + 0.25 * std::sin(i * 0.11) ));
+                int height = static_cast<int>(Height * ( 0.75 + 0.25 * std::sin(i * 0.07) ));
+                glfwSetWindowSize(m_Window, width, height);
+            }
+            glfwPollEvents();
+            DrawFrame();
+
+            auto now = std::chrono::steady_clock::now();
+            frameMs.push_back(std::chrono::duration<double, std::milli>(now - last).count());
+            last = now;
+        }
+        vkDeviceWaitIdle(m_Device);
+        std::sort(frameMs.begin(), frameMs.end());
+        return frameMs;
+    };
+
+    auto percentile = [](const std::vector<double>& sorted , double p)
+    {
+        return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+    };
+
+    std::cout << "swapchain resize benchmark: " << frames << " frames per phase\n";
+    std::cout << "phase    |  p50 ms |  p99 ms |  max ms | recreations\n";
+
+    for (bool resize : {false, true})
+    {
+        uint32_t recreateBefore = m_RecreateCount;
+        auto     frameMs        = runPhase(resize);
+
+        char line[96];
+        std::snprintf(line, sizeof(line), "%-8s | %7.3f | %7.3f | %7.3f | %u", resize ? "resizing" : "steady",
+                      percentile(frameMs, 0.5), percentile(frameMs, 0.99), frameMs.back(),
+                      m_RecreateCount - recreateBefore);
+        std::cout << line << '\n';
+    }
+
+    glfwSetWindowSize(m_Window, Width, Height);
+}
+
+/*
+ * 绘制数为10K、25K、50K、100K，每种用1..K个线程(包括主线程)并行录制，每个组合渲染N帧(默认100)。
+ * 统计主命令缓冲录制的平均耗时，其中包括各线程录制secondary命令缓冲和等待它们完成的时间。
+ * 切换线程数时要重建命令池，先等待设备空闲
+ */
+void HelloTriangleApplication::BenchmarkRecording()
+{
+    uint32_t frames       = m_Config.benchCount != 0 ? m_Config.benchCount : 100;
+    uint32_t maxThreads   = m_Config.benchThreads != 0 ? m_Config.benchThreads : ThreadPool::DefaultThreadCount() + 1;
+    uint32_t warmupFrames = m_Config.framesInFlight * 2 + 8;
+
+    std::cout << "command recording benchmark: " << frames << " frames per configuration"
+            << ( m_Config.headless ? "" : " (use --headless to avoid vsync)" ) << '\n';
+    std::cout << "  draws | threads | record ms | Mdraws/s | speedup\n";
+
+    for (uint32_t draws : {10000u, 25000u, 50000u, 100000u})
+    {
+        vkDeviceWaitIdle(m_Device);
+        CreateInstances(draws);
+
+        double singleThreadMs = 0.0;
+        for (uint32_t threads = 1; threads <= maxThreads; threads++)
+        {
+            vkDeviceWaitIdle(m_Device);
+            m_Recorder.Destroy();
+            m_Recorder.Create(m_Device, m_Queues.graphics.family, m_Config.framesInFlight, threads);
+
+            for (uint32_t i = 0; i < warmupFrames; i++)
+            {
+                DrawFrame();
+            }
+
+            double recordMs = 0.0;
+            for (uint32_t i = 0; i < frames; i++)
+            {
+                if (m_Window != nullptr)
+                {
+                    glfwPollEvents();
+                }
+                DrawFrame();
+                recordMs += m_LastRecordMs;
+            }
+            recordMs /= frames;
+            if (threads == 1)
+            {
+                singleThreadMs = recordMs;
+            }
+
+            char line[96];
+            std::snprintf(line, sizeof(line), "%7u | %7u | %9.3f | %8.2f | %6.2fx", draws, threads, recordMs,
+                          draws / recordMs / 1000.0, singleThreadMs / recordMs);
+            std::cout << line << '\n';
+        }
+    }
+
+    //恢复命令行指定的录制线程数和实例数
+    vkDeviceWaitIdle(m_Device);
+    m_Recorder.Destroy();
+    if (m_Config.recordThreads > 0)
+    {
+        m_Recorder.Create(m_Device, m_Queues.graphics.family, m_Config.framesInFlight, m_Config.recordThreads);
+    }
+    CreateInstances(m_Config.instanceCount);
+}
+
+/*
+ * 依次使用三种呈现策略，每种渲染N帧(默认600)，切换策略时重建交换链。
+ * 输出每种策略实际得到的呈现模式、帧率和延迟分位数，延迟的终点见FramePacer.h：
+ * 有present wait时是画面显示的时刻，没有时只到调用vkQueuePresentKHR为止
+ */
+void HelloTriangleApplication::BenchmarkPresent()
+{
+    if (m_Window == nullptr)
+    {
+        throw std::runtime_error("present基准测试需要窗口，不能在无头模式下运行");
+    }
+
+    uint32_t frames       = m_Config.benchCount != 0 ? m_Config.benchCount : 600;
+    uint32_t warmupFrames = m_Config.framesInFlight * 2 + 8;
+
+    std::cout << "present policy benchmark: " << frames << " frames per policy, refresh " << m_RefreshHz
+            << " Hz, latency measured to " << ( m_PresentWaitEnabled ? "display" : "present call" ) << '\n';
+    std::cout << "policy  | mode         |     fps |  p50 ms |  p90 ms |  p99 ms |  max ms\n";
+
+    PresentPolicy original = m_PresentPolicy;
+    for (PresentPolicy policy : {PresentPolicy::LowLatency, PresentPolicy::VSync, PresentPolicy::PowerSaving})
+    {
+        m_PresentPolicy = policy;
+        m_FramePacer.Configure(policy, m_RefreshHz, m_Config.targetFps, m_PresentWaitEnabled);
+        RecreateSwapChain();
+
+        //切换后的头几帧还在排空旧交换链的呈现队列，不计入统计
+        for (uint32_t i = 0; i < warmupFrames; i++)
+        {
+            glfwPollEvents();
+            DrawFrame();
+        }
+        m_FramePacer.ResetStats();
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            glfwPollEvents();
+            DrawFrame();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        char line[128];
+        std::snprintf(line, sizeof(line), "%-7s | %-12s | %7.1f | %7.3f | %7.3f | %7.3f | %7.3f",
+                      PresentPolicyName(policy), PresentModeName(m_PresentMode), frames / seconds,
+                      m_FramePacer.LatencyPercentile(0.5), m_FramePacer.LatencyPercentile(0.9),
+                      m_FramePacer.LatencyPercentile(0.99), m_FramePacer.LatencyPercentile(1.0));
+        std::cout << line << '\n';
+    }
+
+    //恢复命令行指定的策略
+    m_PresentPolicy = original;
+    m_FramePacer.Configure(original, m_RefreshHz, m_Config.targetFps, m_PresentWaitEnabled);
+    RecreateSwapChain();
+    m_FramePacer.ResetStats();
+}
+
+/*
+ * 用一个延迟着色风格的渲染图检查编译结果：GBuffer和光照合并为子流程，没有用到的调试过程被剔除，
+ * 泛光的模糊链中生命周期不重叠的附着共用内存。各过程不绘制任何东西，只执行清除、布局转换和依赖，
+ * 打开校验层(包括同步校验)时可以检查推导出的同步是否完整。输出编译耗时、编译结果和N帧(默认100)的平均GPU耗时
+ */
+void HelloTriangleApplication::BenchmarkRenderGraph()
+{
+    using Clock     = std::chrono::steady_clock;
+    uint32_t frames = m_Config.benchCount != 0 ? m_Config.benchCount : 100;
+    vkDeviceWaitIdle(m_Device);
+
+    //代替交换链图像的输出图像，交换链图像没有获取时不能渲染
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType         = VK_IMAGE_TYPE_2D;
+    imageInfo.format            = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent            = {m_SwapChainExtent.width, m_SwapChainExtent.height, 1};
+    imageInfo.mipLevels         = 1;
+    imageInfo.arrayLayers       = 1;
+    imageInfo.samples           = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling            = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage             = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    UniqueImage output;
+    if (output.Create(m_Device, vkCreateImage, imageInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建渲染图测试的输出图像失败");
+    }
+    Allocation outputMemory = m_Allocator.AllocateForImage(output, {});
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType                 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image                 = output;
+    viewInfo.viewType              = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format                = imageInfo.format;
+    viewInfo.subresourceRange      = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    UniqueImageView outputView;
+    if (outputView.Create(m_Device, vkCreateImageView, viewInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建渲染图测试的输出视图失败");
+    }
+
+    RenderGraph graph;
+    auto        noDraw = [](const RenderPassContext&) {};
+    auto        result = graph.ImportImage("Output", imageInfo.format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    auto        albedo = graph.CreateAttachment("Albedo", VK_FORMAT_R8G8B8A8_UNORM);
+    auto        normal = graph.CreateAttachment("Normal", VK_FORMAT_R16G16B16A16_SFLOAT);
+    auto        depth  = graph.CreateAttachment("Depth", VK_FORMAT_D16_UNORM);
+    auto        hdr    = graph.CreateAttachment("Hdr", VK_FORMAT_R16G16B16A16_SFLOAT);
+    auto        bright = graph.CreateAttachment("Bright", VK_FORMAT_R16G16B16A16_SFLOAT);
+    auto        blurH  = graph.CreateAttachment("BlurH", VK_FORMAT_R16G16B16A16_SFLOAT);
+    auto        blurV  = graph.CreateAttachment("BlurV", VK_FORMAT_R16G16B16A16_SFLOAT);
+    auto        debug  = graph.CreateAttachment("Debug", VK_FORMAT_R8G8B8A8_UNORM);
+
+    VkClearColorValue        black      = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    VkClearDepthStencilValue farDepth   = {1.0f, 0};
+    RenderPassId             gbuffer    = graph.AddPass("GBuffer", noDraw);
+    graph.WriteColor(gbuffer, albedo, &black);
+    graph.WriteColor(gbuffer, normal, &black);
+    graph.WriteDepth(gbuffer, depth, &farDepth);
+    RenderPassId lighting = graph.AddPass("Lighting", noDraw);
+    graph.ReadAttachment(lighting, albedo);
+    graph.ReadAttachment(lighting, normal);
+    graph.ReadAttachment(lighting, depth);
+    graph.WriteColor(lighting, hdr, &black);
+    RenderPassId debugView = graph.AddPass("DebugNormals", noDraw);
+    graph.ReadTexture(debugView, normal);
+    graph.WriteColor(debugView, debug, &black);
+    RenderPassId brightPass = graph.AddPass("BrightPass", noDraw);
+    graph.ReadTexture(brightPass, hdr);
+    graph.WriteColor(brightPass, bright);
+    RenderPassId blurHorizontal = graph.AddPass("BlurH", noDraw);
+    graph.ReadTexture(blurHorizontal, bright);
+    graph.WriteColor(blurHorizontal, blurH);
+    RenderPassId blurVertical = graph.AddPass("BlurV", noDraw);
+    graph.ReadTexture(blurVertical, blurH);
+    graph.WriteColor(blurVertical, blurV);
+    RenderPassId composite = graph.AddPass("Composite", noDraw);
+    graph.ReadTexture(composite, hdr);
+    graph.ReadTexture(composite, blurV);
+    graph.WriteColor(composite, result, &black);
+
+    auto compileStart = Clock::now();
+    graph.Compile(m_Device);
+    double compileMs = std::chrono::duration<double, std::milli>(Clock::now() - compileStart).count();
+    graph.SetImportedViews(result, {outputView});
+    graph.CreateTargets(m_Allocator, m_SwapChainExtent);
+    std::cout << "render graph benchmark: " << m_SwapChainExtent.width << "x" << m_SwapChainExtent.height
+            << ", compiled in " << compileMs << " ms\n" << graph.Report();
+
+    //同一个命令缓冲连续提交N次，最后等待一次，平均值就是每帧在GPU上的耗时
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex        = m_Queues.graphics.family;
+
+    UniqueCommandPool commandPool;
+    if (commandPool.Create(m_Device, vkCreateCommandPool, poolInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建渲染图测试的命令池失败");
+    }
+
+    VkCommandBufferAllocateInfo allocateInfo = {};
+    allocateInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool                 = commandPool;
+    allocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount          = 1;
+
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    if (vkAllocateCommandBuffers(m_Device, &allocateInfo, &commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("分配渲染图测试的命令缓冲失败");
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    graph.Execute(commandBuffer, 0);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("录制渲染图测试的命令缓冲失败");
+    }
+
+    VkSubmitInfo submitInfo       = {};
+    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = &commandBuffer;
+
+    auto submitStart = Clock::now();
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        if (vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            throw std::runtime_error("提交渲染图测试的命令缓冲失败");
+        }
+    }
+    vkQueueWaitIdle(m_GraphicsQueue);
+    double frameMs = std::chrono::duration<double, std::milli>(Clock::now() - submitStart).count() / frames;
+    std::cout << "  " << frames << " frames, " << frameMs << " ms per frame\n";
+
+    graph.Destroy();
+    outputView.Reset();
+    output.Reset();
+    m_Allocator.Free(outputMemory);
+}
+
+/*
+ * 描述符堆：
+ * 1. 用1个和K个线程把N个纹理(默认填满堆的剩余容量)注册进堆，再一次Flush写入，之后全部释放，测量注册、写入和释放的耗时；
+ * 2. N次绘制各自使用不同的纹理描述符，比较传统做法(每帧为每次绘制分配、更新一个描述符集，每次绘制绑定一次)
+ *    和描述符堆(每个命令缓冲只绑定一次，每次绘制推送索引)。两种做法用同一个片段着色器Textured.frag真正采样纹理，
+ *    画进一张离屏图像：输出CPU上更新和录制的耗时，以及把命令缓冲提交几次取平均的GPU耗时
+ */
+void HelloTriangleApplication::BenchmarkBindless()
+{
+    if (m_TexturedFragmentShaderModule == VK_NULL_HANDLE)
+    {
+        throw std::runtime_error("bindless基准测试需要设备支持VK_EXT_descriptor_indexing和"
+                                 "shaderSampledImageArrayNonUniformIndexing，且--bindless-textures不为0");
+    }
+
+    using Clock         = std::chrono::steady_clock;
+    uint32_t available  = m_DescriptorHeap.Capacity(DescriptorKind::SampledImage) -
+                          m_DescriptorHeap.UsedCount(DescriptorKind::SampledImage);
+    uint32_t count      = std::min(m_Config.benchCount != 0 ? m_Config.benchCount : available, available);
+    uint32_t maxThreads = m_Config.benchThreads != 0 ? m_Config.benchThreads : ThreadPool::DefaultThreadCount();
+    auto     elapsedMs  = [](Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    //默认纹理、索引缓冲和第0套帧资源的顶点缓冲随第一帧上传，先画一帧，之后所有槽位都指向默认纹理
+    DrawFrame();
+    vkDeviceWaitIdle(m_Device);
+    VkImageView textureView = m_DefaultTextureView;
+
+    std::cout << "descriptor heap benchmark: " << count << " textures (capacity "
+            << m_DescriptorHeap.Capacity(DescriptorKind::SampledImage) << ")\n";
+    std::cout << "  threads | add ms | flush ms | release ms | ns per descriptor\n";
+
+    std::vector<uint32_t> indices(count);
+    for (uint32_t threads : {1u, maxThreads})
+    {
+        //每个线程负责连续的一段，注册和释放同时在多个线程上进行，由堆内部的锁保证安全
+        auto forEachRange = [&](auto&& work)
+        {
+            ThreadPool                     pool(threads);
+            std::vector<std::future<void>> futures;
+            uint32_t                       chunk = ( count + threads - 1 ) / threads;
+            for (uint32_t begin = 0; begin < count; begin += chunk)
+            {
+                uint32_t end = std::min(begin + chunk, count);
+                futures.push_back(pool.Submit(0, [&work, begin, end]() { work(begin, end); }));
+            }
+            for (auto& future : futures)
+            {
+                future.get();
+            }
+        };
+
+        auto addStart = Clock::now();
+        forEachRange([&](uint32_t begin , uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                indices[i] = m_DescriptorHeap.AddImage(textureView);
+            }
+        });
+        double addMs = elapsedMs(addStart);
+
+        auto flushStart = Clock::now();
+        m_DescriptorHeap.Flush();
+        double flushMs = elapsedMs(flushStart);
+
+        //设备空闲，没有帧在使用这些槽位，可以立即释放
+        auto releaseStart = Clock::now();
+        forEachRange([&](uint32_t begin , uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                m_DescriptorHeap.Release(DescriptorKind::SampledImage, indices[i]);
+            }
+        });
+        double releaseMs = elapsedMs(releaseStart);
+
+        char line[96];
+        std::snprintf(line, sizeof(line), "%9u | %6.2f | %8.2f | %10.2f | %7.1f", threads, addMs, flushMs, releaseMs,
+                      ( addMs + flushMs + releaseMs ) * 1e6 / std::max(count, 1u));
+        std::cout << line << '\n';
+    }
+
+    //绘制使用的槽位：每次绘制推送其中一个，GPU真正按不同的索引访问描述符
+    for (uint32_t i = 0; i < count; i++)
+    {
+        indices[i] = m_DescriptorHeap.AddImage(textureView);
+    }
+    m_DescriptorHeap.Flush();
+
+    //绘制的目标：一个渲染过程写入一张离屏图像，交换链图像没有获取时不能渲染
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType         = VK_IMAGE_TYPE_2D;
+    imageInfo.format            = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent            = {m_SwapChainExtent.width, m_SwapChainExtent.height, 1};
+    imageInfo.mipLevels         = 1;
+    imageInfo.arrayLayers       = 1;
+    imageInfo.samples           = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling            = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage             = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    UniqueImage output;
+    if (output.Create(m_Device, vkCreateImage, imageInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建描述符堆测试的输出图像失败");
+    }
+    Allocation outputMemory = m_Allocator.AllocateForImage(output, {});
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType                 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image                 = output;
+    viewInfo.viewType              = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format                = imageInfo.format;
+    viewInfo.subresourceRange      = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    UniqueImageView outputView;
+    if (outputView.Create(m_Device, vkCreateImageView, viewInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建描述符堆测试的输出视图失败");
+    }
+
+    //渲染过程的内容由recordDraws决定，每种做法录制前替换它
+    std::function<void(VkCommandBuffer)> recordDraws;
+    RenderGraph                          graph;
+    VkClearColorValue                    black  = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    auto                                 result = graph.ImportImage("Output", imageInfo.format,
+                                                                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    RenderPassId drawPass = graph.AddPass("Draws", [&](const RenderPassContext& context)
+    {
+        recordDraws(context.commandBuffer);
+    });
+    graph.WriteColor(drawPass, result, &black);
+    graph.Compile(m_Device);
+    graph.SetImportedViews(result, {outputView});
+    graph.CreateTargets(m_Allocator, m_SwapChainExtent);
+
+    //传统做法的布局：每个描述符集只有一个纹理和一个采样器，绑定号和描述符堆相同，
+    //Textured.frag不需要修改，推送的索引都是0。纹理索引表的绑定0不查表(textureCount为0)，不写入描述符
+    VkDescriptorType             types[3]    = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+                                                VK_DESCRIPTOR_TYPE_SAMPLER};
+    VkDescriptorSetLayoutBinding bindings[3] = {};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bindings[i].binding         = i;
+        bindings[i].descriptorType  = types[i];
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags      = VK_SHADER_STAGE_ALL_GRAPHICS;
+    }
+    VkDescriptorBindingFlagsEXT bindingFlags[3] = {VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT, 0, 0};
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = {};
+    flagsInfo.sType                                          = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    flagsInfo.bindingCount                                   = 3;
+    flagsInfo.pBindingFlags                                  = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext                           = &flagsInfo;
+    layoutInfo.bindingCount                    = 3;
+    layoutInfo.pBindings                       = bindings;
+
+    UniqueDescriptorSetLayout perDrawSetLayout;
+    if (perDrawSetLayout.Create(m_Device, vkCreateDescriptorSetLayout, layoutInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建描述符堆测试的描述符集布局失败");
+    }
+
+    VkPushConstantRange pushConstantRange = {VK_SHADER_STAGE_ALL_GRAPHICS, 0, sizeof(DrawIndices)};
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount             = 1;
+    pipelineLayoutInfo.pSetLayouts                = perDrawSetLayout.Address();
+    pipelineLayoutInfo.pushConstantRangeCount     = 1;
+    pipelineLayoutInfo.pPushConstantRanges        = &pushConstantRange;
+
+    UniquePipelineLayout perDrawLayout;
+    if (perDrawLayout.Create(m_Device, vkCreatePipelineLayout, pipelineLayoutInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建描述符堆测试的管线布局失败");
+    }
+
+    //两条管线只有布局不同，着色器、顶点输入和固定功能状态都和场景相同
+    GraphicsPipelineDesc heapDesc = {};
+    heapDesc.vertexShader         = m_VertexShaderModule;
+    heapDesc.fragmentShader       = m_TexturedFragmentShaderModule;
+    heapDesc.layout               = m_PipelineLayout;
+    heapDesc.renderPass           = graph.RenderPass(drawPass);
+    heapDesc.subpass              = graph.Subpass(drawPass);
+    heapDesc.vertexInput          = Vertex::InputDesc();
+
+    GraphicsPipelineDesc perDrawDesc = heapDesc;
+    perDrawDesc.layout               = perDrawLayout;
+
+    UniquePipeline heapPipeline;
+    UniquePipeline perDrawPipeline;
+    heapPipeline.Reset(m_Device, PipelineFactory::CreateGraphicsPipeline(m_Device, VK_NULL_HANDLE, heapDesc));
+    perDrawPipeline.Reset(m_Device, PipelineFactory::CreateGraphicsPipeline(m_Device, VK_NULL_HANDLE, perDrawDesc));
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags                   = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex        = m_Queues.graphics.family;
+
+    UniqueCommandPool commandPool;
+    if (commandPool.Create(m_Device, vkCreateCommandPool, poolInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建描述符堆测试的命令池失败");
+    }
+
+    VkCommandBufferAllocateInfo allocateInfo = {};
+    allocateInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool                 = commandPool;
+    allocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount          = 1;
+
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    if (vkAllocateCommandBuffers(m_Device, &allocateInfo, &commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("分配描述符堆测试的命令缓冲失败");
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    VkSubmitInfo submitInfo       = {};
+    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = &commandBuffer;
+
+    //录制一次：设置视口、管线和顶点/索引缓冲，之后由draws录制全部绘制，返回录制的CPU耗时
+    auto record = [&](VkPipeline pipeline , const std::function<void(VkCommandBuffer)>& draws)
+    {
+        recordDraws = [&, pipeline](VkCommandBuffer drawCommands)
+        {
+            VkViewport viewport = {};
+            viewport.width      = static_cast<float>(m_SwapChainExtent.width);
+            viewport.height     = static_cast<float>(m_SwapChainExtent.height);
+            viewport.maxDepth   = 1.0f;
+            VkRect2D scissor    = {{0, 0}, m_SwapChainExtent};
+            vkCmdSetViewport(drawCommands, 0, 1, &viewport);
+            vkCmdSetScissor(drawCommands, 0, 1, &scissor);
+            vkCmdBindPipeline(drawCommands, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+            VkDeviceSize offsets[] = {0};
+            vkCmdBindVertexBuffers(drawCommands, 0, 1, &m_VertexBuffers[0].buffer, offsets);
+            vkCmdBindIndexBuffer(drawCommands, m_IndexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+            draws(drawCommands);
+        };
+
+        auto recordStart = Clock::now();
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        graph.Execute(commandBuffer, 0);
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("录制描述符堆测试的命令缓冲失败");
+        }
+        return elapsedMs(recordStart);
+    };
+
+    //同一个命令缓冲提交几次，每次等待完成，取平均作为GPU耗时
+    constexpr uint32_t submits = 10;
+    auto               submit  = [&]()
+    {
+        auto submitStart = Clock::now();
+        for (uint32_t i = 0; i < submits; i++)
+        {
+            if (vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+            {
+                throw std::runtime_error("提交描述符堆测试的命令缓冲失败");
+            }
+            vkQueueWaitIdle(m_GraphicsQueue);
+        }
+        return elapsedMs(submitStart) / submits;
+    };
+
+    uint32_t indexCount = static_cast<uint32_t>(m_IndexBuffer.size / sizeof(uint16_t));
+    std::cout << "  draws | per-draw sets: update ms, record ms, gpu ms | heap: record ms, gpu ms | binds"
+            << " | cpu speedup\n";
+    for (uint32_t draws : {1000u, 10000u, std::max(count, 1u)})
+    {
+        //传统做法：每帧为每次绘制分配并写入一个描述符集，录制时每次绘制绑定一次
+        VkDescriptorPoolSize poolSizes[] = {
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, draws},
+            {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, draws},
+            {VK_DESCRIPTOR_TYPE_SAMPLER, draws},
+        };
+
+        VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
+        descriptorPoolInfo.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolInfo.maxSets                    = draws;
+        descriptorPoolInfo.poolSizeCount              = 3;
+        descriptorPoolInfo.pPoolSizes                 = poolSizes;
+
+        UniqueDescriptorPool descriptorPool;
+        if (descriptorPool.Create(m_Device, vkCreateDescriptorPool, descriptorPoolInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("创建描述符堆测试的描述符池失败");
+        }
+
+        auto                               updateStart = Clock::now();
+        std::vector<VkDescriptorSetLayout> setLayouts(draws, perDrawSetLayout);
+        std::vector<VkDescriptorSet>       sets(draws);
+        VkDescriptorSetAllocateInfo        setInfo = {};
+        setInfo.sType                              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool                     = descriptorPool;
+        setInfo.descriptorSetCount                 = draws;
+        setInfo.pSetLayouts                        = setLayouts.data();
+        if (vkAllocateDescriptorSets(m_Device, &setInfo, sets.data()) != VK_SUCCESS)
+        {
+            throw std::runtime_error("分配描述符堆测试的描述符集失败");
+        }
+
+        VkDescriptorImageInfo             textureInfo = {VK_NULL_HANDLE, textureView,
+                                                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        VkDescriptorImageInfo             samplerInfo = {m_DefaultSampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED};
+        std::vector<VkWriteDescriptorSet> writes(draws * 2);
+        for (uint32_t i = 0; i < draws; i++)
+        {
+            VkWriteDescriptorSet& texture = writes[2 * i];
+            texture                       = {};
+            texture.sType                 = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            texture.dstSet                = sets[i];
+            texture.dstBinding            = bindings[1].binding;
+            texture.descriptorCount       = 1;
+            texture.descriptorType        = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            texture.pImageInfo            = &textureInfo;
+
+            VkWriteDescriptorSet& sampler = writes[2 * i + 1];
+            sampler                       = texture;
+            sampler.dstBinding            = bindings[2].binding;
+            sampler.descriptorType        = VK_DESCRIPTOR_TYPE_SAMPLER;
+            sampler.pImageInfo            = &samplerInfo;
+        }
+        vkUpdateDescriptorSets(m_Device, draws * 2, writes.data(), 0, nullptr);
+        double updateMs = elapsedMs(updateStart);
+
+        auto perDrawRecord = [&](VkCommandBuffer drawCommands)
+        {
+            DrawIndices drawIndices = {};
+            drawIndices.texture     = 0;
+            drawIndices.sampler     = 0;
+            for (uint32_t i = 0; i < draws; i++)
+            {
+                vkCmdBindDescriptorSets(drawCommands, VK_PIPELINE_BIND_POINT_GRAPHICS, perDrawLayout, 0, 1, &sets[i],
+                                        0, nullptr);
+                vkCmdPushConstants(drawCommands, perDrawLayout, VK_SHADER_STAGE_ALL_GRAPHICS, 0, sizeof(drawIndices),
+                                   &drawIndices);
+                vkCmdDrawIndexed(drawCommands, indexCount, 1, 0, 0, 0);
+            }
+        };
+        //描述符堆：绑定一次，每次绘制推送不同的纹理索引
+        auto heapRecord = [&](VkCommandBuffer drawCommands)
+        {
+            m_DescriptorHeap.Bind(drawCommands, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout);
+            DrawIndices drawIndices = {};
+            drawIndices.sampler     = m_DefaultSamplerIndex;
+            for (uint32_t i = 0; i < draws; i++)
+            {
+                drawIndices.texture = count > 0 ? indices[i % count] : m_DefaultTextureIndex;
+                vkCmdPushConstants(drawCommands, m_PipelineLayout, VK_SHADER_STAGE_ALL_GRAPHICS, 0,
+                                   sizeof(drawIndices), &drawIndices);
+                vkCmdDrawIndexed(drawCommands, indexCount, 1, 0, 0, 0);
+            }
+        };
+
+        double perDrawMs    = record(perDrawPipeline, perDrawRecord);
+        double perDrawGpuMs = submit();
+        double heapMs       = record(heapPipeline, heapRecord);
+        double heapGpuMs    = submit();
+
+        char line[160];
+        std::snprintf(line, sizeof(line), "%7u | %24.3f, %9.3f, %6.3f | %15.3f, %6.3f | %5u vs 1 | %10.2fx", draws,
+                      updateMs, perDrawMs, perDrawGpuMs, heapMs, heapGpuMs, draws,
+                      ( updateMs + perDrawMs ) / heapMs);
+        std::cout << line << '\n';
+    }
+
+    vkDeviceWaitIdle(m_Device);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        m_DescriptorHeap.Release(DescriptorKind::SampledImage, indices[i]);
+    }
+    commandPool.Reset();
+    heapPipeline.Reset();
+    perDrawPipeline.Reset();
+    graph.Destroy();
+    outputView.Reset();
+    output.Reset();
+    m_Allocator.Free(outputMemory);
+}
+
+/*
+ * GPU剔除和CPU剔除的对比：实例分布在两倍于视口的范围内，大约四分之一可见。
+ * CPU剔除逐个测试并为每个可见实例录制一次绘制，录制时间随实例数量增长；
+ * GPU剔除每帧只录制一次dispatch和一次间接绘制，录制时间基本不变，剔除本身的开销体现在帧时间中
+ */
+void HelloTriangleApplication::BenchmarkCulling()
+{
+    if (!m_GpuCuller.Enabled())
+    {
+        throw std::runtime_error("culling基准测试需要--gpu-culling");
+    }
+
+    uint32_t frames       = m_Config.benchCount != 0 ? m_Config.benchCount : 200;
+    uint32_t warmupFrames = m_Config.framesInFlight * 2 + 8;
+
+    std::cout << "culling benchmark: " << frames << " frames per configuration, "
+            << ( m_GpuCuller.UsesDrawCount() ? "draw indirect count" : "fixed-count indirect" )
+            << ( m_Config.headless ? "" : " (use --headless to avoid vsync)" ) << '\n';
+    std::cout << "  objects | mode | visible | record ms | cpu ms | frame ms\n";
+
+    for (uint32_t count = 1000; count <= 1000000; count *= 10)
+    {
+        vkDeviceWaitIdle(m_Device);
+        CreateInstances(count, 2.0f);
+
+        //两种模式看到的是同一个场景，可见数量取GPU剔除回读的结果
+        uint32_t visible = 0;
+        for (bool cpuCulling : {false, true})
+        {
+            vkDeviceWaitIdle(m_Device);
+            m_CpuCulling = cpuCulling;
+
+            for (uint32_t i = 0; i < warmupFrames; i++)
+            {
+                DrawFrame();
+            }
+
+            double recordMs = 0.0;
+            double cpuMs    = 0.0;
+            auto   start    = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < frames; i++)
+            {
+                if (m_Window != nullptr)
+                {
+                    glfwPollEvents();
+                }
+                DrawFrame();
+                recordMs += m_LastRecordMs;
+                cpuMs    += m_LastCpuFrameMs;
+            }
+            vkDeviceWaitIdle(m_Device);
+            double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                    / frames;
+            if (!cpuCulling)
+            {
+                m_GpuCuller.Collect(m_CurrentFrame);
+                visible = m_GpuCuller.LastVisibleCount();
+            }
+
+            char line[96];
+            std::snprintf(line, sizeof(line), "%9u | %4s | %7u | %9.3f | %6.3f | %8.3f", count,
+                          cpuCulling ? "cpu" : "gpu", visible, recordMs / frames, cpuMs / frames, frameMs);
+            std::cout << line << '\n';
+        }
+    }
+
+    //恢复正常的渲染路径和命令行指定的实例数
+    vkDeviceWaitIdle(m_Device);
+    m_CpuCulling = false;
+    CreateInstances(m_Config.instanceCount);
+}
+
+/*
+ * 批量数学函数(Math/Batch.h)的吞吐。每个函数对同一组随机数据依次运行编译进来、CPU也支持的每一级实现，
+ * 取5次中最快的一次，输出每个元素的耗时和相对标量参考的加速比。
+ * 结果是否和标量参考逐位一致由--check math单独检查，这里只计时
+ */
+void HelloTriangleApplication::BenchmarkMath()
+{
+    using Clock               = std::chrono::steady_clock;
+    constexpr int     Repeats = 5;
+
+    //默认数量不是8的倍数，SIMD循环之后的尾部也计入耗时
+    uint32_t        count       = m_Config.benchCount != 0 ? m_Config.benchCount : 1000003;
+    uint32_t        matrixCount = std::max(count / 4, 1u);
+    Math::SimdLevel detected    = Math::DetectSimdLevel();
+
+    std::vector<const Math::BatchKernels*> implementations;
+    for (Math::SimdLevel level : {Math::SimdLevel::Scalar, Math::SimdLevel::Simd4, Math::SimdLevel::Avx2})
+    {
+        const Math::BatchKernels* kernels = Math::GetBatchKernels(level);
+        if (level <= detected && kernels != nullptr)
+        {
+            implementations.push_back(kernels);
+        }
+    }
+
+    //相机前方的一个盒子里随机分布的点，大约一半在视锥体内
+    std::mt19937                          random(2024);
+    std::uniform_real_distribution<float> coordinate(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> size(0.1f, 2.0f);
+    std::uniform_real_distribution<float> element(-1.0f, 1.0f);
+
+    std::vector<float> x(count), y(count), z(count), radius(count), extentX(count), extentY(count), extentZ(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        x[i]       = coordinate(random);
+        y[i]       = coordinate(random);
+        z[i]       = coordinate(random) - 20.0f;
+        radius[i]  = size(random);
+        extentX[i] = size(random);
+        extentY[i] = size(random);
+        extentZ[i] = size(random);
+    }
+    std::vector<Math::Mat4> left(matrixCount), right(matrixCount);
+    for (uint32_t i = 0; i < matrixCount; i++)
+    {
+        for (int j = 0; j < 16; j++)
+        {
+            left[i].Data()[j]  = element(random);
+            right[i].Data()[j] = element(random);
+        }
+    }
+
+    Math::Quat orientation    = Math::Quat::FromAxisAngle(Math::Normalize(Math::Vec3{1.0f, 2.0f, 3.0f}), 0.3f);
+    Math::Mat4 view           = Math::Mat4::Rotation(orientation) * Math::Mat4::Translation({1.0f, -2.0f, 3.0f});
+    Math::Mat4 viewProjection = Math::Mat4::Perspective(1.0f, 16.0f / 9.0f, 0.1f, 100.0f) * view;
+    Frustum    frustum        = Frustum::FromMatrix(viewProjection.Data());
+
+    Math::PointStreams  points  = {x.data(), y.data(), z.data()};
+    Math::SphereStreams spheres = {x.data(), y.data(), z.data(), radius.data()};
+    Math::AabbStreams   boxes   = {x.data(), y.data(), z.data(), extentX.data(), extentY.data(), extentZ.data()};
+
+    std::vector<float>       resultX(count), resultY(count), resultZ(count);
+    std::vector<uint8_t>     visible(count);
+    std::vector<Math::Mat4>  matrices(matrixCount);
+    Math::PointOutputStreams output = {resultX.data(), resultY.data(), resultZ.data()};
+
+    std::cout << "math benchmark: " << count << " elements (" << matrixCount << " matrices), best of " << Repeats
+            << ", detected " << Math::GetBatchKernels(detected)->name << '\n';
+    std::cout << "  kernel            | impl   | ns/elem | speedup\n";
+
+    //第一级实现是标量参考，后面的实现相对它计算加速比
+    auto measure = [&](const char* kernel , size_t elements , auto&& run)
+    {
+        double referenceMs = 0.0;
+        for (const Math::BatchKernels* kernels : implementations)
+        {
+            double bestMs = 0.0;
+            for (int repeat = 0; repeat < Repeats; repeat++)
+            {
+                auto start = Clock::now();
+                run(*kernels);
+                double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                bestMs    = repeat == 0 ? ms : std::min(bestMs, ms);
+            }
+            if (kernels == implementations.front())
+            {
+                referenceMs = bestMs;
+            }
+
+            char line[128];
+            std::snprintf(line, sizeof(line), "  %-17s | %-6s | %7.3f | %6.2fx", kernel, kernels->name,
+                          bestMs * 1e6 / elements, referenceMs / bestMs);
+            std::cout << line << '\n';
+        }
+    };
+
+    measure("transform points", count, [&](const Math::BatchKernels& kernels)
+    {
+        kernels.transformPoints(viewProjection, points, output, count);
+    });
+    measure("multiply matrices", matrixCount, [&](const Math::BatchKernels& kernels)
+    {
+        kernels.multiplyMatrices(left.data(), right.data(), matrices.data(), matrixCount);
+    });
+    measure("cull spheres", count, [&](const Math::BatchKernels& kernels)
+    {
+        kernels.cullSpheres(frustum.planes, spheres, visible.data(), count);
+    });
+    measure("cull aabbs", count, [&](const Math::BatchKernels& kernels)
+    {
+        kernels.cullAabbs(frustum.planes, boxes, visible.data(), count);
+    });
+}
+
+/*
+ * 实例化管线的全部着色器变体：用一个空的管线缓存编译每一种特化常量的组合，输出变体数量、每个变体的编译耗时，
+ * 以及已编译的变体再次查询的开销。所有变体共用同一份SPIR-V，差别只在VkSpecializationInfo中。
+ * 和pipelines测试一样，驱动自己的磁盘着色器缓存会让结果偏低，测试前应当关掉它
+ */
+void HelloTriangleApplication::BenchmarkPipelineVariants()
+{
+    using Clock         = std::chrono::steady_clock;
+    uint32_t variants   = VariantKey::PermutationCount();
+    uint32_t threads    = m_Config.benchThreads != 0 ? m_Config.benchThreads : ThreadPool::DefaultThreadCount();
+    uint32_t lookups    = m_Config.benchCount != 0 ? m_Config.benchCount : 1000000;
+    auto     elapsedMs  = [](Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    std::cout << "pipeline variant benchmark: " << variants << " variants (" << VariantKey::TotalBits
+            << "-bit key), " << threads << " compile threads\n";
+
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType                     = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    VkPipelineCache cache;
+    if (vkCreatePipelineCache(m_Device, &cacheInfo, nullptr, &cache) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建管线缓存失败");
+    }
+
+    {
+        PipelineCompiler     compiler(m_Device, cache, threads);
+        PipelineStateCache   states;
+        PipelineVariantCache variantCache;
+        states.Create(m_Device, compiler, m_PipelineStates.Functions());
+        variantCache.Create(states, m_InstancedPipelines.Base());
+
+        std::vector<VariantKey> keys;
+        for (uint32_t i = 0; i < variants; i++)
+        {
+            keys.push_back(VariantKey::FromIndex(i));
+        }
+
+        //第一个变体单独编译，得到冷启动时一条管线的耗时
+        auto firstStart = Clock::now();
+        variantCache.Get(keys[0]);
+        double firstMs = elapsedMs(firstStart);
+
+        auto allStart = Clock::now();
+        for (uint32_t i = 1; i < variants; i++)
+        {
+            variantCache.Prefetch(keys[i]);
+        }
+        for (uint32_t i = 1; i < variants; i++)
+        {
+            variantCache.Get(keys[i]);
+        }
+        double allMs = elapsedMs(allStart);
+
+        //已编译的变体：无锁查表，和录制时绑定管线的路径相同
+        auto       lookupStart = Clock::now();
+        VkPipeline last        = VK_NULL_HANDLE;
+        for (uint32_t i = 0; i < lookups; i++)
+        {
+            last = variantCache.Get(keys[i % variants]);
+        }
+        double lookupMs = elapsedMs(lookupStart);
+
+        char line[160];
+        std::snprintf(line, sizeof(line), "  first variant %.2f ms, all %u variants %.1f ms wall, %.1f ms compiling "
+                      "(%.2f ms per variant)", firstMs, states.PipelineCount(), firstMs + allMs,
+                      states.CompileMilliseconds(), states.CompileMilliseconds() / variants);
+        std::cout << line << '\n';
+        std::snprintf(line, sizeof(line), "  memoized lookup %.1f ns (%s)", lookupMs * 1e6 / lookups,
+                      last != VK_NULL_HANDLE ? "hit" : "miss");
+        std::cout << line << '\n';
+
+        states.Destroy();
+    }
+    vkDestroyPipelineCache(m_Device, cache, nullptr);
+}
+
+/*
+ * 管线状态缓存：
+ * 1. 3种图元 x 4种剔除 x 2种正面 x 2种混合共48种状态，分别只用静态状态和用扩展动态状态规范化，
+ *    各自用一个空的管线缓存编译，比较需要的管线数量和编译耗时；
+ * 2. N次绘制按随机顺序和按状态排序两种顺序切换这些状态，比较每次绘制都绑定管线和PipelineBinder的调用次数与录制耗时；
+ * 3. 1..K个线程同时查找已编译的管线，测量无锁查找的吞吐量。
+ * 设备不支持VK_EXT_extended_dynamic_state时只测静态状态
+ */
+void HelloTriangleApplication::BenchmarkPipelineStates()
+{
+    using Clock         = std::chrono::steady_clock;
+    uint32_t draws      = m_Config.benchCount != 0 ? m_Config.benchCount : 100000;
+    uint32_t maxThreads = m_Config.benchThreads != 0 ? m_Config.benchThreads : ThreadPool::DefaultThreadCount();
+    bool     dynamic    = m_PipelineStates.DynamicState() != 0;
+    auto     elapsedMs  = [](Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    GraphicsPipelineDesc base = {};
+    base.vertexShader         = m_VertexShaderModule;
+    base.fragmentShader       = m_FragmentShaderModule;
+    base.layout               = m_PipelineLayout;
+    base.renderPass           = m_RenderGraph.RenderPass(m_ScenePass);
+    base.subpass              = m_RenderGraph.Subpass(m_ScenePass);
+    base.vertexInput          = Vertex::InputDesc();
+
+    const VkPrimitiveTopology topologies[] = {
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, VK_PRIMITIVE_TOPOLOGY_LINE_LIST
+    };
+    const VkCullModeFlags cullModes[] = {
+        VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_FRONT_AND_BACK
+    };
+
+    std::vector<GraphicsPipelineDesc> states;
+    for (uint32_t i = 0; i < 48; i++)
+    {
+        GraphicsPipelineDesc desc = base;
+        desc.topology             = topologies[i % 3];
+        desc.cullMode             = cullModes[i / 3 % 4];
+        desc.frontFace            = i / 12 % 2 == 0 ? VK_FRONT_FACE_CLOCKWISE : VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        desc.blendEnable          = i / 24 % 2 == 1;
+        states.push_back(desc);
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType                     = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    VkPipelineCache staticCache;
+    VkPipelineCache dynamicCache;
+    if (vkCreatePipelineCache(m_Device, &cacheInfo, nullptr, &staticCache) != VK_SUCCESS ||
+        vkCreatePipelineCache(m_Device, &cacheInfo, nullptr, &dynamicCache) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建管线缓存失败");
+    }
+
+    std::cout << "pipeline state benchmark: " << states.size() << " states, extended dynamic state "
+            << ( dynamic ? "enabled" : "unavailable" ) << '\n';
+    {
+        PipelineCompiler   staticCompiler(m_Device, staticCache, maxThreads);
+        PipelineCompiler   dynamicCompiler(m_Device, dynamicCache, maxThreads);
+        PipelineStateCache staticStates;
+        PipelineStateCache dynamicStates;
+        staticStates.Create(m_Device, staticCompiler);
+        dynamicStates.Create(m_Device, dynamicCompiler, m_PipelineStates.Functions());
+
+        //1. 编译：先全部提交再等待，墙钟时间包括多线程编译
+        auto compileAll = [&](PipelineStateCache& cache , const char* name)
+        {
+            auto start = Clock::now();
+            for (const auto& desc : states)
+            {
+                cache.Prefetch(desc, CompilePriority::Normal);
+            }
+            for (const auto& desc : states)
+            {
+                cache.Get(desc);
+            }
+            double wallMs = elapsedMs(start);
+
+            char line[128];
+            std::snprintf(line, sizeof(line), "  %-7s %3u pipelines, %8.1f ms wall, %8.1f ms compiling", name,
+                          cache.PipelineCount(), wallMs, cache.CompileMilliseconds());
+            std::cout << line << '\n';
+        };
+        compileAll(staticStates, "static");
+        if (dynamic)
+        {
+            compileAll(dynamicStates, "dynamic");
+        }
+
+        //2. 录制：只录制绑定和动态状态，不在渲染流程中，也不提交
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags                   = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex        = m_Queues.graphics.family;
+
+        UniqueCommandPool commandPool;
+        if (commandPool.Create(m_Device, vkCreateCommandPool, poolInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("创建管线状态测试的命令池失败");
+        }
+
+        VkCommandBufferAllocateInfo allocateInfo = {};
+        allocateInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.commandPool                 = commandPool;
+        allocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount          = 1;
+
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        if (vkAllocateCommandBuffers(m_Device, &allocateInfo, &commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("分配管线状态测试的命令缓冲失败");
+        }
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        std::mt19937                            random(42);
+        std::uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(states.size()) - 1);
+        std::vector<uint32_t>                   randomOrder(draws);
+        for (uint32_t& index : randomOrder)
+        {
+            index = pick(random);
+        }
+        std::vector<uint32_t> sortedOrder = randomOrder;
+        std::sort(sortedOrder.begin(), sortedOrder.end());
+
+        std::cout << "  order  | mode    | pipeline binds | state sets | skipped | record ms\n";
+        auto recordNaive = [&](const std::vector<uint32_t>& order , const char* orderName)
+        {
+            auto start = Clock::now();
+            vkBeginCommandBuffer(commandBuffer, &beginInfo);
+            for (uint32_t index : order)
+            {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, staticStates.Get(states[index]));
+            }
+            vkEndCommandBuffer(commandBuffer);
+            double recordMs = elapsedMs(start);
+
+            char line[128];
+            std::snprintf(line, sizeof(line), "  %-6s | naive   | %14u | %10u | %7u | %9.3f", orderName, draws, 0u, 0u,
+                          recordMs);
+            std::cout << line << '\n';
+        };
+        auto recordBinder = [&](PipelineStateCache& cache , const std::vector<uint32_t>& order ,
+                                const char* orderName , const char* mode)
+        {
+            auto start = Clock::now();
+            vkBeginCommandBuffer(commandBuffer, &beginInfo);
+            PipelineBinder binder(cache, commandBuffer);
+            for (uint32_t index : order)
+            {
+                binder.Bind(states[index]);
+            }
+            vkEndCommandBuffer(commandBuffer);
+            double recordMs = elapsedMs(start);
+
+            char line[128];
+            std::snprintf(line, sizeof(line), "  %-6s | %-7s | %14u | %10u | %7u | %9.3f", orderName, mode,
+                          binder.PipelineBinds(), binder.StateSets(), binder.SkippedCalls(), recordMs);
+            std::cout << line << '\n';
+        };
+        for (auto [order, orderName] : {std::pair{&randomOrder, "random"}, std::pair{&sortedOrder, "sorted"}})
+        {
+            recordNaive(*order, orderName);
+            recordBinder(staticStates, *order, orderName, "static");
+            if (dynamic)
+            {
+                recordBinder(dynamicStates, *order, orderName, "dynamic");
+            }
+        }
+        commandPool.Reset();
+
+        //3. 并发查找：每个线程各自轮流查找全部状态，查找路径不加锁，吞吐量应当随线程数增长
+        PipelineStateCache& lookupStates = dynamic ? dynamicStates : staticStates;
+        std::cout << "  threads | ns per lookup | Mlookups/s\n";
+        for (uint32_t threads = 1; threads <= maxThreads; threads++)
+        {
+            ThreadPool                     pool(threads);
+            std::vector<std::future<void>> futures;
+            uint32_t                       perThread = draws;
+            std::atomic<uint32_t>          misses    = 0;
+
+            auto start = Clock::now();
+            for (uint32_t t = 0; t < threads; t++)
+            {
+                futures.push_back(pool.Submit(0, [&, t]()
+                {
+                    uint32_t missed = 0;
+                    for (uint32_t i = 0; i < perThread; i++)
+                    {
+                        missed += lookupStates.Get(states[( i + t ) % states.size()]) == VK_NULL_HANDLE ? 1 : 0;
+                    }
+                    misses += missed;
+                }));
+            }
+            for (auto& future : futures)
+            {
+                future.get();
+            }
+            double wallMs = elapsedMs(start);
+            if (misses > 0)
+            {
+                throw std::runtime_error("管线状态缓存返回了空管线");
+            }
+
+            char line[96];
+            std::snprintf(line, sizeof(line), "%9u | %13.1f | %10.2f", threads, wallMs * 1e6 / perThread,
+                          static_cast<double>(perThread) * threads / ( wallMs * 1000.0 ));
+            std::cout << line << '\n';
+        }
+
+        staticStates.Destroy();
+        dynamicStates.Destroy();
+    }
+    vkDestroyPipelineCache(m_Device, staticCache, nullptr);
+    vkDestroyPipelineCache(m_Device, dynamicCache, nullptr);
+}
+
+namespace
+{
+    //基准测试用的合成纹理：width x width、带完整mip链的BC1(DDS)或BC3(KTX2)，块的内容按纹理编号变化。
+    //只写出TextureFile读取的字段，KTX2的数据格式描述符留空
+    void WriteSyntheticTexture(const std::filesystem::path& path , uint32_t index , uint32_t width , bool ktx2)
+    {
+        uint32_t              blockBytes = ktx2 ? 16 : 8;
+        uint32_t              levels     = std::bit_width(width);
+        std::vector<uint64_t> sizes(levels);
+        for (uint32_t level = 0; level < levels; level++)
+        {
+            uint32_t size = std::max(width >> level, 1u);
+            sizes[level]  = TextureFile::LevelBytes(size, size, blockBytes);
+        }
+
+        std::vector<std::byte> header(ktx2 ? 80 + 24 * levels : 128);
+        auto                   put32 = [&](size_t offset , uint32_t value) { std::memcpy(&header[offset], &value, 4); };
+        auto                   put64 = [&](size_t offset , uint64_t value) { std::memcpy(&header[offset], &value, 8); };
+        if (ktx2)
+        {
+            const uint8_t identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+            std::memcpy(header.data(), identifier, sizeof(identifier));
+            put32(12, VK_FORMAT_BC3_UNORM_BLOCK);
+            put32(16, 1); //typeSize
+            put32(20, width);
+            put32(24, width);
+            put32(36, 1); //faceCount
+            put32(40, levels);
+            //KTX2从最小的一级开始存放数据
+            uint64_t offset = header.size();
+            for (uint32_t level = levels; level-- > 0;)
+            {
+                put64(80 + 24 * level, offset);
+                put64(80 + 24 * level + 8, sizes[level]);
+                put64(80 + 24 * level + 16, sizes[level]);
+                offset += sizes[level];
+            }
+        }
+        else
+        {
+            std::memcpy(header.data(), "DDS ", 4);
+            put32(4, 124);
+            put32(8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000); //CAPS|HEIGHT|WIDTH|PIXELFORMAT|MIPMAPCOUNT|LINEARSIZE
+            put32(12, width);
+            put32(16, width);
+            put32(20, static_cast<uint32_t>(sizes[0]));
+            put32(28, levels);
+            put32(76, 32);  //像素格式的大小
+            put32(80, 0x4); //DDPF_FOURCC
+            std::memcpy(&header[84], "DXT1", 4);
+            put32(108, 0x1000 | 0x8 | 0x400000); //TEXTURE|COMPLEX|MIPMAP
+        }
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+        std::vector<char> data;
+        for (uint32_t i = 0; i < levels; i++)
+        {
+            uint32_t level = ktx2 ? levels - 1 - i : i;
+            data.resize(static_cast<size_t>(sizes[level]));
+            for (size_t b = 0; b < data.size(); b++)
+            {
+                data[b] = static_cast<char>(b * 31 + index * 17 + level);
+            }
+            file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        }
+        if (!file)
+        {
+            throw std::runtime_error("写入合成纹理失败: " + path.string());
+        }
+    }
+}
+
+/*
+ * 纹理流送：没有--textures时在临时目录生成N张(默认256)1024x1024的合成纹理，DDS(BC1)和KTX2(BC3)交替，
+ * 合计略超过默认的256MB内存预算。用m_TextureScreenOverride模拟镜头远近，分三个阶段，每个阶段渲染到全部纹理达到目标级别：
+ *     far：屏幕尺寸16像素，只需要mip尾部，同时统计从开始加载到全部尾部驻留的时间
+ *     near：屏幕尺寸4096像素，全部纹理都想要级别0，超出内存预算的部分按纹素密度降级
+ *     far：回到远处，多出的级别被换出
+ * 每个阶段统计帧数、耗时、CPU帧时间的平均值和最大值、单帧上传的峰值和驻留内存。
+ * 上传预算把每帧的memcpy和复制命令限制在固定的量，CPU帧时间的最大值不随纹理总量增长
+ */
+void HelloTriangleApplication::BenchmarkTextures()
+{
+    using Clock = std::chrono::steady_clock;
+    auto  start = Clock::now();
+    if (!m_TextureStreamer.Enabled())
+    {
+        uint32_t              count     = m_Config.benchCount != 0 ? m_Config.benchCount : 256;
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / "LearnVulkan-textures";
+        std::filesystem::create_directories(directory);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            bool ktx2 = i % 2 == 1;
+            char name[32];
+            std::snprintf(name, sizeof(name), "texture%04u.%s", i, ktx2 ? "ktx2" : "dds");
+            if (!std::filesystem::exists(directory / name))
+            {
+                WriteSyntheticTexture(directory / name, i, 1024, ktx2);
+            }
+        }
+        std::cout << "texture benchmark: synthetic textures ready in "
+                << std::chrono::duration<double, std::milli>(Clock::now() - start).count() << " ms\n";
+        m_Config.textureDirectory = directory.string();
+        start                     = Clock::now();
+        CreateTextureStreamer();
+    }
+
+    const TextureStreamer& streamer  = m_TextureStreamer;
+    uint32_t               textures  = streamer.TextureCount();
+    constexpr uint32_t     MaxFrames = 20000;
+    std::cout << "texture benchmark: " << textures << " textures, upload budget "
+            << ( streamer.Config().uploadBudget >> 10 ) << " KB/frame, memory budget "
+            << ( streamer.Config().memoryBudget >> 20 ) << " MB"
+            << ( m_Config.headless ? "" : " (vsync may cap frame rate, use --headless)" ) << '\n';
+    std::cout << "  phase | frames |       ms | cpu avg ms | cpu max ms | peak upload KB | resident MB\n";
+
+    const std::pair<const char*, float> phases[] = {{"far", 16.0f}, {"near", 4096.0f}, {"far", 16.0f}};
+    bool                                tailsReady = false;
+    for (auto [name, size] : phases)
+    {
+        m_TextureScreenOverride = size;
+        auto         phaseStart = Clock::now();
+        uint32_t     frames     = 0;
+        double       cpuTotal   = 0.0;
+        double       cpuMax     = 0.0;
+        VkDeviceSize peakUpload = 0;
+        bool         settled    = false;
+        while (!settled && frames < MaxFrames)
+        {
+            if (m_Window != nullptr)
+            {
+                glfwPollEvents();
+            }
+            DrawFrame();
+            frames++;
+            cpuTotal   += m_LastCpuFrameMs;
+            cpuMax      = std::max(cpuMax, m_LastCpuFrameMs);
+            peakUpload  = std::max(peakUpload, streamer.LastFrameUploadBytes());
+
+            if (!tailsReady && streamer.ResidentCount() + streamer.FailedCount() == textures)
+            {
+                tailsReady = true;
+                std::cout << "  all mip tails resident after " << frames << " frames, "
+                        << std::chrono::duration<double, std::milli>(Clock::now() - start).count() << " ms\n";
+            }
+            settled = streamer.BusyCount() == 0 && streamer.SettledCount() + streamer.FailedCount() == textures;
+        }
+        double phaseMs = std::chrono::duration<double, std::milli>(Clock::now() - phaseStart).count();
+
+        char line[128];
+        std::snprintf(line, sizeof(line), "  %-5s | %6u | %8.1f | %10.3f | %10.3f | %14.0f | %11.1f", name, frames,
+                      phaseMs, cpuTotal / frames, cpuMax, peakUpload / 1024.0, streamer.ResidentBytes() / 1048576.0);
+        std::cout << line << '\n';
+        if (!settled)
+        {
+            std::cout << "  (" << name << " did not settle within " << MaxFrames << " frames)\n";
+        }
+    }
+
+    m_TextureScreenOverride = 0.0f;
+    vkDeviceWaitIdle(m_Device);
+    std::cout << streamer.Report();
+}
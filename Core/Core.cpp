@@ -1,14 +1,32 @@
 ﻿#include <exception>
 #include <iostream>
 #include <ostream>
+#include <stdexcept>
 #include "MainLoop.h"
+#include "../Math/Batch.h"
 
-int main()
+int main(int argc , char** argv)
 {
+#ifdef _MSVC_LANG
     std::cout << _MSVC_LANG << std::endl; //202002
-    HelloTriangleApplication app;
+#endif
     try
     {
+        AppConfig config = AppConfig::FromCommandLine(argc, argv);
+        if (!config.check.empty())
+        {
+            //检查只用CPU，不需要窗口和Vulkan设备
+            if (config.check != "math")
+            {
+                throw std::runtime_error("未知的检查: " + config.check);
+            }
+            Math::CheckBatchKernels(config.benchCount != 0 ? config.benchCount : 100003);
+            std::cout << "math check passed: " << Math::GetBatchKernels(Math::DetectSimdLevel())->name
+                    << " matches the scalar reference bit for bit\n";
+            return EXIT_SUCCESS;
+        }
+
+        HelloTriangleApplication app(config);
         app.run();
     }
     catch (const std::exception& e)
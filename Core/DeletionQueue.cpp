@@ -0,0 +1,42 @@
+﻿#include "DeletionQueue.h"
+
+#include <stdexcept>
+
+void DeletionQueue::Push(uint64_t serial , std::function<void()> deleter)
+{
+    //序号回退说明调用者用错了序号，继续登记会让FIFO顺序失效，较早的对象被过早销毁
+    if (!m_Entries.empty() && serial < m_Entries.back().serial)
+    {
+        throw std::runtime_error("DeletionQueue: 帧序号必须单调不减");
+    }
+    m_Entries.push_back({serial, std::move(deleter)});
+}
+
+size_t DeletionQueue::Flush(uint64_t completedSerial)
+{
+    size_t destroyed = 0;
+    while (!m_Entries.empty() && m_Entries.front().serial <= completedSerial)
+    {
+        //先出队再执行，deleter再登记新的项也不会影响遍历
+        Entry entry = std::move(m_Entries.front());
+        m_Entries.pop_front();
+        entry.deleter();
+        destroyed++;
+    }
+    m_DestroyedCount += destroyed;
+    return destroyed;
+}
+
+size_t DeletionQueue::FlushAll()
+{
+    size_t destroyed = 0;
+    while (!m_Entries.empty())
+    {
+        Entry entry = std::move(m_Entries.front());
+        m_Entries.pop_front();
+        entry.deleter();
+        destroyed++;
+    }
+    m_DestroyedCount += destroyed;
+    return destroyed;
+}
@@ -0,0 +1,82 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/*
+ * 按帧序号延迟销毁的队列。
+ * 对象不再被新录制的命令引用后，可能还被已经提交、尚未完成的帧使用，不能立即销毁。
+ * 登记时带上最后一个可能使用它的帧序号(通常是当前已提交的最大序号)，
+ * 等这个序号之前的帧都确认完成(栅栏被等待过)后，由Flush分批销毁，整个过程不需要等待设备空闲。
+ *
+ * 帧序号单调递增，登记顺序就是完成顺序，队列是FIFO，Flush遇到第一个未完成的项就停止。
+ * 只在主线程使用，不加锁。
+ */
+class DeletionQueue
+{
+public:
+    DeletionQueue() = default;
+    ~DeletionQueue() { FlushAll(); }
+
+    DeletionQueue(const DeletionQueue&)            = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+    //登记一个销毁操作。deleter按值捕获要销毁的句柄或资源，serial完成后被调用一次
+    void Push(uint64_t serial , std::function<void()> deleter);
+
+    //把RAII句柄交给队列，句柄变为空。空句柄直接忽略
+    template <typename Handle>
+    void Retire(uint64_t serial , Handle&& handle)
+    {
+        auto parent = handle.GetParent();
+        auto raw    = handle.Release();
+        if (raw == VK_NULL_HANDLE) return;
+        Push(serial, [parent, raw]() { std::decay_t<Handle>::Destroy(parent, raw); });
+    }
+
+    //一组同类句柄合成一项登记，例如交换链的全部图像视图
+    template <typename Handle>
+    void Retire(uint64_t serial , std::vector<Handle>&& handles)
+    {
+        if (handles.empty()) return;
+        std::vector<typename Handle::HandleType> raws;
+        raws.reserve(handles.size());
+        auto parent = handles.front().GetParent();
+        for (auto& handle : handles)
+        {
+            raws.push_back(handle.Release());
+        }
+        handles.clear();
+        Push(serial, [parent, raws = std::move(raws)]()
+        {
+            for (auto raw : raws)
+            {
+                if (raw != VK_NULL_HANDLE) Handle::Destroy(parent, raw);
+            }
+        });
+    }
+
+    //销毁序号不大于completedSerial的项，返回销毁的项数
+    size_t Flush(uint64_t completedSerial);
+    //设备空闲后调用，销毁全部剩余的项
+    size_t FlushAll();
+
+    size_t Size() const { return m_Entries.size(); }
+    //累计销毁的项数
+    uint64_t DestroyedCount() const { return m_DestroyedCount; }
+
+private:
+    struct Entry
+    {
+        uint64_t              serial;
+        std::function<void()> deleter;
+    };
+
+    std::deque<Entry> m_Entries;
+    uint64_t          m_DestroyedCount = 0;
+};
@@ -0,0 +1,303 @@
+﻿#include "DescriptorHeap.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    constexpr VkDescriptorType DescriptorTypes[DescriptorHeap::KindCount] = {
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        VK_DESCRIPTOR_TYPE_SAMPLER,
+    };
+
+    constexpr const char* KindNames[DescriptorHeap::KindCount] = {"buffers", "images", "samplers"};
+
+    uint32_t KindIndex(DescriptorKind kind)
+    {
+        return static_cast<uint32_t>(kind);
+    }
+}
+
+DescriptorHeapCapacity DescriptorHeap::ClampCapacity(DescriptorHeapCapacity                                 desired ,
+                                                     const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& limits)
+{
+    DescriptorHeapCapacity capacity = {};
+    capacity.storageBuffers         = std::min({desired.storageBuffers,
+                                                limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                                limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+    capacity.sampledImages          = std::min({desired.sampledImages,
+                                                limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                                                limits.maxPerStageDescriptorUpdateAfterBindSampledImages});
+    capacity.samplers               = std::min({desired.samplers,
+                                                limits.maxDescriptorSetUpdateAfterBindSamplers,
+                                                limits.maxPerStageDescriptorUpdateAfterBindSamplers});
+
+    //每个阶段可访问的资源总数(不含采样器)也有上限，超出时先压缩纹理，缓冲通常少得多
+    uint32_t resources      = limits.maxPerStageUpdateAfterBindResources;
+    capacity.storageBuffers = std::min(capacity.storageBuffers, resources);
+    capacity.sampledImages  = std::min(capacity.sampledImages, resources - capacity.storageBuffers);
+
+    //所有池中update-after-bind描述符的总数，这里只有一个池
+    uint32_t total          = limits.maxUpdateAfterBindDescriptorsInAllPools;
+    capacity.samplers       = std::min(capacity.samplers, total);
+    capacity.storageBuffers = std::min(capacity.storageBuffers, total - capacity.samplers);
+    capacity.sampledImages  = std::min(capacity.sampledImages, total - capacity.samplers - capacity.storageBuffers);
+    return capacity;
+}
+
+void DescriptorHeap::Create(VkDevice device , DescriptorHeapCapacity capacity)
+{
+    m_Device                   = device;
+    uint32_t counts[KindCount] = {capacity.storageBuffers, capacity.sampledImages, capacity.samplers};
+
+    //数量为0的绑定不能声明为描述符数组，至少保留一个槽位
+    VkDescriptorSetLayoutBinding bindings[KindCount]     = {};
+    VkDescriptorBindingFlagsEXT  bindingFlags[KindCount] = {};
+    VkDescriptorPoolSize         poolSizes[KindCount]    = {};
+    for (uint32_t kind = 0; kind < KindCount; kind++)
+    {
+        counts[kind]                   = std::max(counts[kind], 1u);
+        bindings[kind].binding         = kind;
+        bindings[kind].descriptorType  = DescriptorTypes[kind];
+        bindings[kind].descriptorCount = counts[kind];
+        bindings[kind].stageFlags      = VK_SHADER_STAGE_ALL;
+        bindingFlags[kind]             = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                         VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                                         VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+
+        poolSizes[kind].type            = DescriptorTypes[kind];
+        poolSizes[kind].descriptorCount = counts[kind];
+
+        m_Slots[kind]          = {};
+        m_Slots[kind].capacity = counts[kind];
+        m_Slots[kind].live.assign(counts[kind], 0);
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = {};
+    flagsInfo.sType                                          = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    flagsInfo.bindingCount                                   = KindCount;
+    flagsInfo.pBindingFlags                                  = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext                           = &flagsInfo;
+    layoutInfo.flags                           = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    layoutInfo.bindingCount                    = KindCount;
+    layoutInfo.pBindings                       = bindings;
+    if (m_Layout.Create(m_Device, vkCreateDescriptorSetLayout, layoutInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建描述符堆的布局失败");
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags                      = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    poolInfo.maxSets                    = 1;
+    poolInfo.poolSizeCount              = KindCount;
+    poolInfo.pPoolSizes                 = poolSizes;
+    if (m_Pool.Create(m_Device, vkCreateDescriptorPool, poolInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建描述符堆的描述符池失败");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool              = m_Pool;
+    allocInfo.descriptorSetCount          = 1;
+    allocInfo.pSetLayouts                 = m_Layout.Address();
+    if (vkAllocateDescriptorSets(m_Device, &allocInfo, &m_Set) != VK_SUCCESS)
+    {
+        throw std::runtime_error("分配描述符堆的描述符集失败");
+    }
+}
+
+void DescriptorHeap::Destroy()
+{
+    //描述符集随描述符池一起释放
+    m_Set = VK_NULL_HANDLE;
+    m_Pool.Reset();
+    m_Layout.Reset();
+
+    std::lock_guard lock(m_Mutex);
+    for (auto& slots : m_Slots)
+    {
+        slots = {};
+    }
+    m_Pending.clear();
+}
+
+uint32_t DescriptorHeap::Allocate(DescriptorKind kind)
+{
+    SlotList& slots = m_Slots[KindIndex(kind)];
+    uint32_t  index;
+    if (!slots.freeList.empty())
+    {
+        index = slots.freeList.back();
+        slots.freeList.pop_back();
+    }
+    else if (slots.next < slots.capacity)
+    {
+        index = slots.next++;
+    }
+    else
+    {
+        throw std::runtime_error(std::string("描述符堆已满: ") + KindNames[KindIndex(kind)]);
+    }
+    slots.live[index] = 1;
+    slots.used++;
+    return index;
+}
+
+uint32_t DescriptorHeap::AddBuffer(VkBuffer buffer , VkDeviceSize offset , VkDeviceSize range)
+{
+    PendingWrite write  = {};
+    write.kind          = DescriptorKind::StorageBuffer;
+    write.buffer.buffer = buffer;
+    write.buffer.offset = offset;
+    write.buffer.range  = range;
+
+    std::lock_guard lock(m_Mutex);
+    write.index = Allocate(write.kind);
+    m_Pending.push_back(write);
+    return write.index;
+}
+
+uint32_t DescriptorHeap::AddImage(VkImageView view , VkImageLayout layout)
+{
+    PendingWrite write      = {};
+    write.kind              = DescriptorKind::SampledImage;
+    write.image.imageView   = view;
+    write.image.imageLayout = layout;
+
+    std::lock_guard lock(m_Mutex);
+    write.index = Allocate(write.kind);
+    m_Pending.push_back(write);
+    return write.index;
+}
+
+uint32_t DescriptorHeap::AddSampler(VkSampler sampler)
+{
+    PendingWrite write  = {};
+    write.kind          = DescriptorKind::Sampler;
+    write.image.sampler = sampler;
+
+    std::lock_guard lock(m_Mutex);
+    write.index = Allocate(write.kind);
+    m_Pending.push_back(write);
+    return write.index;
+}
+
+void DescriptorHeap::Release(DescriptorKind kind , uint32_t index)
+{
+    std::lock_guard lock(m_Mutex);
+    SlotList&       slots = m_Slots[KindIndex(kind)];
+    if (index >= slots.next || slots.live[index] == 0)
+    {
+        throw std::runtime_error(std::string("释放了无效的描述符槽位: ") + KindNames[KindIndex(kind)] + " " +
+                                 std::to_string(index));
+    }
+    //槽位里旧的描述符不必清除：PARTIALLY_BOUND下着色器不访问的槽位可以是任何内容
+    slots.live[index] = 0;
+    slots.used--;
+    slots.freeList.push_back(index);
+}
+
+uint32_t DescriptorHeap::Flush()
+{
+    {
+        std::lock_guard lock(m_Mutex);
+        if (m_Pending.empty()) return 0;
+        m_Flushing.swap(m_Pending);
+    }
+
+    //信息数组预留足够的容量，写入中保存的指针不会因为扩容失效
+    m_Writes.clear();
+    m_BufferInfos.clear();
+    m_ImageInfos.clear();
+    m_BufferInfos.reserve(m_Flushing.size());
+    m_ImageInfos.reserve(m_Flushing.size());
+
+    //按排队顺序写入，同一槽位写了两次时后一次生效。
+    //同一绑定上连续的索引(例如一次注册一批纹理)合并成一个descriptorCount更大的写入
+    for (const PendingWrite& pending : m_Flushing)
+    {
+        VkDescriptorType type     = DescriptorTypes[KindIndex(pending.kind)];
+        bool             isBuffer = pending.kind == DescriptorKind::StorageBuffer;
+        if (isBuffer)
+        {
+            m_BufferInfos.push_back(pending.buffer);
+        }
+        else
+        {
+            m_ImageInfos.push_back(pending.image);
+        }
+
+        if (!m_Writes.empty())
+        {
+            VkWriteDescriptorSet& last = m_Writes.back();
+            if (last.dstBinding == KindIndex(pending.kind) &&
+                last.dstArrayElement + last.descriptorCount == pending.index)
+            {
+                last.descriptorCount++;
+                continue;
+            }
+        }
+
+        VkWriteDescriptorSet write = {};
+        write.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet               = m_Set;
+        write.dstBinding           = KindIndex(pending.kind);
+        write.dstArrayElement      = pending.index;
+        write.descriptorCount      = 1;
+        write.descriptorType       = type;
+        write.pBufferInfo          = isBuffer ? &m_BufferInfos.back() : nullptr;
+        write.pImageInfo           = isBuffer ? nullptr : &m_ImageInfos.back();
+        m_Writes.push_back(write);
+    }
+
+    vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(m_Writes.size()), m_Writes.data(), 0, nullptr);
+
+    uint32_t count = static_cast<uint32_t>(m_Flushing.size());
+    m_WriteCount += count;
+    m_FlushCount++;
+    m_Flushing.clear();
+    return count;
+}
+
+void DescriptorHeap::Bind(VkCommandBuffer     commandBuffer ,
+                          VkPipelineBindPoint bindPoint ,
+                          VkPipelineLayout    layout ,
+                          uint32_t            set) const
+{
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, set, 1, &m_Set, 0, nullptr);
+}
+
+uint32_t DescriptorHeap::Capacity(DescriptorKind kind) const
+{
+    std::lock_guard lock(m_Mutex);
+    return m_Slots[KindIndex(kind)].capacity;
+}
+
+uint32_t DescriptorHeap::UsedCount(DescriptorKind kind) const
+{
+    std::lock_guard lock(m_Mutex);
+    return m_Slots[KindIndex(kind)].used;
+}
+
+std::string DescriptorHeap::Report() const
+{
+    std::ostringstream out;
+    out << "descriptor heap: ";
+    {
+        std::lock_guard lock(m_Mutex);
+        for (uint32_t kind = 0; kind < KindCount; kind++)
+        {
+            out << ( kind > 0 ? ", " : "" ) << KindNames[kind] << ' ' << m_Slots[kind].used << '/'
+                    << m_Slots[kind].capacity;
+        }
+    }
+    out << ", " << m_WriteCount << " writes in " << m_FlushCount << " flushes\n";
+    return out.str();
+}
@@ -0,0 +1,126 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "VulkanHandle.h"
+
+//堆中的三类描述符，各占一个绑定。绑定中的数组下标就是着色器里使用的索引
+enum class DescriptorKind : uint32_t
+{
+    StorageBuffer = 0,
+    SampledImage  = 1,
+    Sampler       = 2,
+};
+
+struct DescriptorHeapCapacity
+{
+    uint32_t storageBuffers = 0;
+    uint32_t sampledImages  = 0;
+    uint32_t samplers       = 0;
+};
+
+/*
+ * 全局无绑定描述符堆(VK_EXT_descriptor_indexing)：整个程序只有一个描述符集，
+ * 缓冲、纹理和采样器注册后得到一个稳定的索引，每次绘制通过push constant传入索引，着色器在数组中查找。
+ * 每个命令缓冲只绑定一次描述符集，绘制数量再多也不需要更多的绑定和更新。
+ *
+ * 三个绑定都是PARTIALLY_BOUND | UPDATE_AFTER_BIND | UPDATE_UNUSED_WHILE_PENDING：
+ * 没有写入的槽位不需要有效的描述符；描述符集被已提交的命令缓冲使用时，仍然可以写入这些命令缓冲没有访问的槽位。
+ *
+ * Add*和Release可以在任意线程调用，由一个互斥锁保护槽位的空闲链表和待写入队列。
+ * 写入先排队，由Flush(只在录制命令的线程、每帧一次)合成一次vkUpdateDescriptorSets。
+ * 已提交的帧可能还在读取一个槽位，Release要推迟到这些帧完成之后，通常交给删除队列调用。
+ */
+class DescriptorHeap
+{
+public:
+    static constexpr uint32_t InvalidIndex = UINT32_MAX;
+    static constexpr uint32_t KindCount    = 3;
+    //缓冲和采样器的默认容量，纹理的容量由--bindless-textures指定
+    static constexpr uint32_t DefaultBufferCapacity  = 16384;
+    static constexpr uint32_t DefaultSamplerCapacity = 1024;
+
+    //把期望的容量截断到设备update-after-bind描述符的上限之内
+    static DescriptorHeapCapacity ClampCapacity(DescriptorHeapCapacity                                 desired ,
+                                                const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& limits);
+
+    void Create(VkDevice device , DescriptorHeapCapacity capacity);
+    void Destroy();
+    bool Enabled() const { return m_Set != VK_NULL_HANDLE; }
+
+    //返回描述符在对应绑定中的索引，堆满时抛出异常
+    uint32_t AddBuffer(VkBuffer buffer , VkDeviceSize offset = 0 , VkDeviceSize range = VK_WHOLE_SIZE);
+    uint32_t AddImage(VkImageView view , VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t AddSampler(VkSampler sampler);
+    //槽位回到空闲链表，之后可能分配给新的资源
+    void Release(DescriptorKind kind , uint32_t index);
+
+    //写入排队的描述符，返回写入的数量
+    uint32_t Flush();
+    void     Bind(VkCommandBuffer commandBuffer , VkPipelineBindPoint bindPoint , VkPipelineLayout layout ,
+                  uint32_t        set = 0) const;
+
+    VkDescriptorSetLayout Layout() const { return m_Layout; }
+    VkDescriptorSet       Set() const { return m_Set; }
+    uint32_t              Capacity(DescriptorKind kind) const;
+    uint32_t              UsedCount(DescriptorKind kind) const;
+    //例如"descriptor heap: buffers 3/16384, images 0/65536, samplers 1/1024, 5 writes in 2 flushes"
+    std::string Report() const;
+
+private:
+    //一个绑定的槽位：next之前的槽位分配过，释放的槽位进入空闲链表，优先复用
+    struct SlotList
+    {
+        uint32_t              capacity = 0;
+        uint32_t              next     = 0;
+        uint32_t              used     = 0;
+        std::vector<uint32_t> freeList;
+        std::vector<uint8_t>  live; //检查重复释放
+    };
+
+    struct PendingWrite
+    {
+        DescriptorKind         kind   = DescriptorKind::StorageBuffer;
+        uint32_t               index  = 0;
+        VkDescriptorBufferInfo buffer = {};
+        VkDescriptorImageInfo  image  = {};
+    };
+
+    //调用者持有m_Mutex
+    uint32_t Allocate(DescriptorKind kind);
+
+    VkDevice                  m_Device = VK_NULL_HANDLE;
+    UniqueDescriptorSetLayout m_Layout;
+    UniqueDescriptorPool      m_Pool;
+    VkDescriptorSet           m_Set = VK_NULL_HANDLE;
+
+    SlotList                  m_Slots[KindCount];
+    std::vector<PendingWrite> m_Pending;
+    mutable std::mutex        m_Mutex;
+
+    //Flush只在一个线程调用，这几个数组跨帧复用，不再分配
+    std::vector<PendingWrite>           m_Flushing;
+    std::vector<VkWriteDescriptorSet>   m_Writes;
+    std::vector<VkDescriptorBufferInfo> m_BufferInfos;
+    std::vector<VkDescriptorImageInfo>  m_ImageInfos;
+
+    uint64_t m_WriteCount = 0;
+    uint64_t m_FlushCount = 0;
+};
+
+//每次绘制通过push constant传入的索引，着色器以它们在描述符堆中查找自己的资源。24字节，远小于规范保证的128字节
+struct DrawIndices
+{
+    uint32_t vertexBuffer   = DescriptorHeap::InvalidIndex;
+    uint32_t instanceBuffer = DescriptorHeap::InvalidIndex;
+    uint32_t texture        = DescriptorHeap::InvalidIndex;
+    uint32_t sampler        = DescriptorHeap::InvalidIndex;
+    //纹理索引表(存储缓冲)：实例i使用表中第i % textureCount项，textureCount为0时不查表，使用texture
+    uint32_t textureTable   = DescriptorHeap::InvalidIndex;
+    uint32_t textureCount   = 0;
+};
+static_assert(sizeof(DrawIndices) == 24, "和Textured.frag.glsl的push constant块、Culled.vert.glsl中流起始位置的偏移一致");
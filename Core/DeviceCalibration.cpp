@@ -0,0 +1,545 @@
+﻿#include "DeviceCalibration.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "DeviceMemoryAllocator.h"
+#include "EmbeddedShaders.h"
+#include "PipelineFactory.h"
+#include "RenderGraph.h"
+#include "ShaderModuleCache.h"
+#include "VulkanHandle.h"
+
+namespace
+{
+    //每项测试先预热一次(首次提交时驱动可能还在编译管线、映射内存)，再取Runs次中最快的一次
+    constexpr uint32_t Runs = 3;
+
+    constexpr VkDeviceSize CopyBytes  = 64ull * 1024 * 1024;
+    constexpr uint32_t     CopyPasses = 4;
+
+    //和Shader/Calibrate.comp.glsl一致：每次迭代两个vec4乘加，即8次FMA，每次FMA算2次浮点运算
+    constexpr uint32_t ComputeGroups          = 1024;
+    constexpr uint32_t ComputeGroupSize       = 256;
+    constexpr uint32_t ComputeIterations      = 256;
+    constexpr uint32_t ComputeFmaPerIteration = 8;
+
+    constexpr VkExtent2D FillExtent = {1024, 1024};
+    constexpr uint32_t   FillLayers = 32; //一次绘制的全屏三角形数量，每个覆盖整个附着
+    constexpr VkFormat   FillFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+    std::string ToHex(const uint8_t* bytes , size_t count)
+    {
+        std::string text;
+        char        digits[3];
+        for (size_t i = 0; i < count; ++i)
+        {
+            std::snprintf(digits, sizeof(digits), "%02x", bytes[i]);
+            text += digits;
+        }
+        return text;
+    }
+
+    /*
+     * 一次校准使用的临时设备：一个同时支持图形和计算的队列，一个命令缓冲，一个栅栏。
+     * 有时间戳时用GPU时间戳计时，只计算命令本身的执行时间；队列族不支持时间戳时退回CPU计时(包含提交和等待的开销)。
+     */
+    class CalibrationDevice
+    {
+    public:
+        explicit CalibrationDevice(VkPhysicalDevice physicalDevice)
+        {
+            uint32_t familyCount = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+            std::vector<VkQueueFamilyProperties> families(familyCount);
+            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+            constexpr VkQueueFlags required = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+            uint32_t               family   = familyCount;
+            for (uint32_t i = 0; i < familyCount; ++i)
+            {
+                if ((families[i].queueFlags & required) == required)
+                {
+                    family = i;
+                    break;
+                }
+            }
+            if (family == familyCount)
+            {
+                throw std::runtime_error("没有同时支持图形和计算的队列族");
+            }
+
+            float                   priority  = 1.0f;
+            VkDeviceQueueCreateInfo queueInfo = {};
+            queueInfo.sType                   = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            queueInfo.queueFamilyIndex        = family;
+            queueInfo.queueCount              = 1;
+            queueInfo.pQueuePriorities        = &priority;
+
+            VkDeviceCreateInfo deviceInfo   = {};
+            deviceInfo.sType                = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+            deviceInfo.queueCreateInfoCount = 1;
+            deviceInfo.pQueueCreateInfos    = &queueInfo;
+
+            VkDevice device = VK_NULL_HANDLE;
+            if (vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device) != VK_SUCCESS)
+            {
+                throw std::runtime_error("创建校准设备失败");
+            }
+            m_Device.Reset(device);
+            vkGetDeviceQueue(m_Device, family, 0, &m_Queue);
+
+            VkCommandPoolCreateInfo poolInfo = {};
+            poolInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.flags                   = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            poolInfo.queueFamilyIndex        = family;
+            m_CommandPool.Create(m_Device, vkCreateCommandPool, poolInfo);
+
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool                 = m_CommandPool;
+            allocInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount          = 1;
+            vkAllocateCommandBuffers(m_Device, &allocInfo, &m_CommandBuffer);
+
+            VkFenceCreateInfo fenceInfo = {};
+            fenceInfo.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            m_Fence.Create(m_Device, vkCreateFence, fenceInfo);
+
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+            uint32_t validBits = families[family].timestampValidBits;
+            if (validBits > 0)
+            {
+                VkQueryPoolCreateInfo queryInfo = {};
+                queryInfo.sType                 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                queryInfo.queryType             = VK_QUERY_TYPE_TIMESTAMP;
+                queryInfo.queryCount            = 2;
+                m_QueryPool.Create(m_Device, vkCreateQueryPool, queryInfo);
+                m_TimestampMask   = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+                m_TimestampPeriod = properties.limits.timestampPeriod;
+            }
+
+            m_Allocator.Create(physicalDevice, m_Device);
+            m_ShaderModules.Create(m_Device);
+        }
+
+        ~CalibrationDevice()
+        {
+            vkDeviceWaitIdle(m_Device);
+            m_ShaderModules.Destroy();
+            m_Allocator.Destroy();
+        }
+
+        VkDevice               Device() const { return m_Device; }
+        DeviceMemoryAllocator& Allocator() { return m_Allocator; }
+        ShaderModuleCache&     ShaderModules() { return m_ShaderModules; }
+
+        //录制并执行Runs + 1次，返回最快一次的毫秒数
+        double Time(const std::function<void(VkCommandBuffer)>& record)
+        {
+            double best = std::numeric_limits<double>::max();
+            for (uint32_t run = 0; run <= Runs; ++run)
+            {
+                double ms = Submit(record);
+                if (run > 0) best = std::min(best, ms);
+            }
+            return best;
+        }
+
+    private:
+        double Submit(const std::function<void(VkCommandBuffer)>& record)
+        {
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkBeginCommandBuffer(m_CommandBuffer, &beginInfo);
+            if (m_QueryPool != VK_NULL_HANDLE)
+            {
+                vkCmdResetQueryPool(m_CommandBuffer, m_QueryPool, 0, 2);
+                vkCmdWriteTimestamp(m_CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_QueryPool, 0);
+            }
+            record(m_CommandBuffer);
+            if (m_QueryPool != VK_NULL_HANDLE)
+            {
+                vkCmdWriteTimestamp(m_CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_QueryPool, 1);
+            }
+            vkEndCommandBuffer(m_CommandBuffer);
+
+            VkSubmitInfo submitInfo       = {};
+            submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers    = &m_CommandBuffer;
+
+            auto start = std::chrono::steady_clock::now();
+            if (vkQueueSubmit(m_Queue, 1, &submitInfo, m_Fence) != VK_SUCCESS ||
+                vkWaitForFences(m_Device, 1, m_Fence.Address(), VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+            {
+                throw std::runtime_error("校准命令执行失败");
+            }
+            auto end = std::chrono::steady_clock::now();
+            vkResetFences(m_Device, 1, m_Fence.Address());
+            vkResetCommandBuffer(m_CommandBuffer, 0);
+
+            if (m_QueryPool != VK_NULL_HANDLE)
+            {
+                uint64_t timestamps[2] = {};
+                if (vkGetQueryPoolResults(m_Device, m_QueryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) == VK_SUCCESS)
+                {
+                    uint64_t ticks = (timestamps[1] - timestamps[0]) & m_TimestampMask;
+                    return static_cast<double>(ticks) * m_TimestampPeriod * 1e-6;
+                }
+            }
+            return std::chrono::duration<double, std::milli>(end - start).count();
+        }
+
+        //成员按声明的逆序析构：设备最后销毁
+        UniqueDevice          m_Device;
+        VkQueue               m_Queue = VK_NULL_HANDLE;
+        UniqueCommandPool     m_CommandPool;
+        VkCommandBuffer       m_CommandBuffer = VK_NULL_HANDLE;
+        UniqueFence           m_Fence;
+        UniqueQueryPool       m_QueryPool;
+        uint64_t              m_TimestampMask   = 0;
+        float                 m_TimestampPeriod = 1.0f;
+        DeviceMemoryAllocator m_Allocator;
+        ShaderModuleCache     m_ShaderModules;
+    };
+
+    //两个设备本地缓冲之间来回复制，每次之间用屏障隔开，防止驱动把几次复制并行或合并
+    double MeasureCopy(CalibrationDevice& context)
+    {
+        DeviceMemoryAllocator& allocator = context.Allocator();
+        AllocationCreateInfo   allocInfo = {};
+        allocInfo.requiredFlags          = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        allocInfo.dedicated              = true;
+
+        constexpr VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+        GpuBuffer buffers[2] = {allocator.CreateBuffer(CopyBytes, usage, allocInfo),
+                                allocator.CreateBuffer(CopyBytes, usage, allocInfo)};
+
+        double ms = context.Time([&](VkCommandBuffer commandBuffer)
+        {
+            VkBufferCopy region = {0, 0, CopyBytes};
+            for (uint32_t pass = 0; pass < CopyPasses; ++pass)
+            {
+                if (pass > 0)
+                {
+                    VkMemoryBarrier barrier = {};
+                    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                    barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+                    barrier.dstAccessMask   = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+                    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+                }
+                vkCmdCopyBuffer(commandBuffer, buffers[pass % 2].buffer, buffers[(pass + 1) % 2].buffer, 1, &region);
+            }
+        });
+
+        allocator.DestroyBuffer(buffers[0]);
+        allocator.DestroyBuffer(buffers[1]);
+
+        //每次复制读写各CopyBytes字节
+        double bytes = 2.0 * static_cast<double>(CopyBytes) * CopyPasses;
+        return bytes / (ms * 1e-3) * 1e-9;
+    }
+
+    double MeasureCompute(CalibrationDevice& context)
+    {
+        auto code = FindEmbeddedShader("Calibrate.comp");
+        if (code.empty()) return 0.0;
+
+        VkDevice device = context.Device();
+
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.binding                      = 0;
+        binding.descriptorType               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        binding.descriptorCount              = 1;
+        binding.stageFlags                   = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+        setLayoutInfo.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutInfo.bindingCount                    = 1;
+        setLayoutInfo.pBindings                       = &binding;
+        UniqueDescriptorSetLayout setLayout;
+        setLayout.Create(device, vkCreateDescriptorSetLayout, setLayoutInfo);
+
+        VkPushConstantRange pushRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(float)};
+
+        VkPipelineLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount             = 1;
+        layoutInfo.pSetLayouts                = setLayout.Address();
+        layoutInfo.pushConstantRangeCount     = 1;
+        layoutInfo.pPushConstantRanges        = &pushRange;
+        UniquePipelineLayout layout;
+        layout.Create(device, vkCreatePipelineLayout, layoutInfo);
+
+        ComputePipelineDesc pipelineDesc = {};
+        pipelineDesc.shader              = context.ShaderModules().Get(code);
+        pipelineDesc.layout              = layout;
+        UniquePipeline pipeline(device, PipelineFactory::CreateComputePipeline(device, VK_NULL_HANDLE, pipelineDesc));
+
+        VkDescriptorPoolSize       poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1};
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets                    = 1;
+        poolInfo.poolSizeCount              = 1;
+        poolInfo.pPoolSizes                 = &poolSize;
+        UniqueDescriptorPool pool;
+        pool.Create(device, vkCreateDescriptorPool, poolInfo);
+
+        VkDescriptorSetAllocateInfo setInfo = {};
+        setInfo.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool              = pool;
+        setInfo.descriptorSetCount          = 1;
+        setInfo.pSetLayouts                 = setLayout.Address();
+        VkDescriptorSet set                 = VK_NULL_HANDLE;
+        vkAllocateDescriptorSets(device, &setInfo, &set);
+
+        constexpr uint32_t invocations = ComputeGroups * ComputeGroupSize;
+        AllocationCreateInfo allocInfo = {};
+        allocInfo.requiredFlags        = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        GpuBuffer output = context.Allocator().CreateBuffer(invocations * 4 * sizeof(float),
+                                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, allocInfo);
+
+        VkDescriptorBufferInfo bufferInfo = {output.buffer, 0, VK_WHOLE_SIZE};
+        VkWriteDescriptorSet   write      = {};
+        write.sType                       = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet                      = set;
+        write.descriptorCount             = 1;
+        write.descriptorType              = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo                 = &bufferInfo;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+        double ms = context.Time([&](VkCommandBuffer commandBuffer)
+        {
+            float seed = 0.999f;
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+            vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(seed), &seed);
+            vkCmdDispatch(commandBuffer, ComputeGroups, 1, 1);
+        });
+
+        context.Allocator().DestroyBuffer(output);
+
+        double flops = 2.0 * ComputeFmaPerIteration * ComputeIterations * static_cast<double>(invocations);
+        return flops / (ms * 1e-3) * 1e-9;
+    }
+
+    //用渲染图把一张图像作为唯一的颜色附着，FillLayers个全屏三角形叠加绘制
+    double MeasureFill(CalibrationDevice& context)
+    {
+        auto vertexCode   = FindEmbeddedShader("Fullscreen.vert");
+        auto fragmentCode = FindEmbeddedShader("Triangle.frag");
+        if (vertexCode.empty() || fragmentCode.empty()) return 0.0;
+
+        VkDevice               device    = context.Device();
+        DeviceMemoryAllocator& allocator = context.Allocator();
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType         = VK_IMAGE_TYPE_2D;
+        imageInfo.format            = FillFormat;
+        imageInfo.extent            = {FillExtent.width, FillExtent.height, 1};
+        imageInfo.mipLevels         = 1;
+        imageInfo.arrayLayers       = 1;
+        imageInfo.samples           = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling            = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage             = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        imageInfo.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+        UniqueImage image;
+        if (image.Create(device, vkCreateImage, imageInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("创建校准图像失败");
+        }
+        Allocation memory = allocator.AllocateForImage(image, {});
+
+        VkImageViewCreateInfo viewInfo           = {};
+        viewInfo.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image                           = image;
+        viewInfo.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format                          = FillFormat;
+        viewInfo.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.levelCount     = 1;
+        viewInfo.subresourceRange.layerCount     = 1;
+        UniqueImageView view;
+        view.Create(device, vkCreateImageView, viewInfo);
+
+        VkPipelineLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        UniquePipelineLayout layout;
+        layout.Create(device, vkCreatePipelineLayout, layoutInfo);
+
+        UniquePipeline pipeline;
+        RenderGraph    graph;
+        RenderResource target = graph.ImportImage("FillTarget", FillFormat, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        RenderPassId   pass   = graph.AddPass("Fill", [&](const RenderPassContext& passContext)
+        {
+            VkCommandBuffer commandBuffer = passContext.commandBuffer;
+            VkViewport      viewport      = {0.0f, 0.0f, static_cast<float>(passContext.extent.width),
+                                             static_cast<float>(passContext.extent.height), 0.0f, 1.0f};
+            VkRect2D        scissor       = {{0, 0}, passContext.extent};
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+            vkCmdDraw(commandBuffer, 3, FillLayers, 0, 0);
+        });
+        graph.WriteColor(pass, target);
+        graph.Compile(device);
+        graph.SetImportedViews(target, {view});
+        graph.CreateTargets(allocator, FillExtent);
+
+        GraphicsPipelineDesc desc = {};
+        desc.vertexShader         = context.ShaderModules().Get(vertexCode);
+        desc.fragmentShader       = context.ShaderModules().Get(fragmentCode);
+        desc.layout               = layout;
+        desc.renderPass           = graph.RenderPass(pass);
+        desc.subpass              = graph.Subpass(pass);
+        desc.cullMode             = VK_CULL_MODE_NONE;
+        pipeline.Reset(device, PipelineFactory::CreateGraphicsPipeline(device, VK_NULL_HANDLE, desc));
+
+        double ms = context.Time([&](VkCommandBuffer commandBuffer) { graph.Execute(commandBuffer, 0); });
+
+        graph.Destroy();
+        view.Reset();
+        image.Reset();
+        allocator.Free(memory);
+
+        double pixels = static_cast<double>(FillExtent.width) * FillExtent.height * FillLayers;
+        return pixels / (ms * 1e-3) * 1e-9;
+    }
+}
+
+double DeviceScore::Total() const
+{
+    double logSum = 0.0;
+    int    count  = 0;
+    for (double value : {copyGBps, computeGflops, fillGpixels})
+    {
+        if (value > 0.0)
+        {
+            logSum += std::log(value);
+            ++count;
+        }
+    }
+    return count == 0 ? 0.0 : std::exp(logSum / count);
+}
+
+void DeviceCalibration::Load(const std::string& path)
+{
+    m_Path = path;
+    m_Scores.clear();
+    if (m_Path.empty()) return;
+
+    std::ifstream file(m_Path);
+    std::string   line;
+    //文件格式变化后旧的结果全部作废，下次保存时覆盖
+    if (!std::getline(file, line) || line != FileHeader) return;
+
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string        key;
+        DeviceScore        score;
+        if (stream >> key >> score.copyGBps >> score.computeGflops >> score.fillGpixels)
+        {
+            m_Scores[key] = score;
+        }
+    }
+}
+
+void DeviceCalibration::Save() const
+{
+    if (!m_Dirty || m_Path.empty()) return;
+
+    //先写临时文件再替换，中途退出不会留下半个缓存文件
+    std::string tempPath = m_Path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::trunc);
+        file << FileHeader << '\n';
+        for (const auto& [key, score] : m_Scores)
+        {
+            file << key << ' ' << score.copyGBps << ' ' << score.computeGflops << ' ' << score.fillGpixels << '\n';
+        }
+        if (!file)
+        {
+            std::cerr << "device calibration: failed to write " << tempPath << '\n';
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, m_Path, error);
+    if (error)
+    {
+        std::cerr << "device calibration: failed to replace " << m_Path << ": " << error.message() << '\n';
+    }
+}
+
+std::string DeviceCalibration::DeviceKey(VkPhysicalDevice                      device ,
+                                         PFN_vkGetPhysicalDeviceProperties2KHR getProperties2)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+
+    std::string key;
+    if (getProperties2 != nullptr)
+    {
+        VkPhysicalDeviceIDPropertiesKHR idProperties = {};
+        idProperties.sType                           = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES_KHR;
+        VkPhysicalDeviceProperties2KHR properties2   = {};
+        properties2.sType                            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+        properties2.pNext                            = &idProperties;
+        getProperties2(device, &properties2);
+        key = "uuid:" + ToHex(idProperties.deviceUUID, VK_UUID_SIZE);
+    }
+    else
+    {
+        //同型号的两张显卡会得到相同的键，它们的分数本来也应该相同
+        char ids[32];
+        std::snprintf(ids, sizeof(ids), "pci:%04x:%04x", properties.vendorID, properties.deviceID);
+        key = std::string(ids) + ":" + ToHex(properties.pipelineCacheUUID, VK_UUID_SIZE);
+    }
+    return key + "/driver:" + std::to_string(properties.driverVersion);
+}
+
+DeviceScore DeviceCalibration::Score(VkPhysicalDevice device , const std::string& key , bool& measured)
+{
+    auto it = m_Scores.find(key);
+    if (it != m_Scores.end())
+    {
+        measured = false;
+        return it->second;
+    }
+
+    DeviceScore score = Measure(device);
+    m_Scores[key]     = score;
+    m_Dirty           = true;
+    measured          = true;
+    return score;
+}
+
+DeviceScore DeviceCalibration::Measure(VkPhysicalDevice device)
+{
+    CalibrationDevice context(device);
+
+    DeviceScore score;
+    score.copyGBps      = MeasureCopy(context);
+    score.computeGflops = MeasureCompute(context);
+    score.fillGpixels   = MeasureFill(context);
+    return score;
+}
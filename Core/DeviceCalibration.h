@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include <map>
+#include <string>
+#include <vulkan/vulkan.h>
+
+//一个物理设备的校准结果，三项都是越大越好，为0表示这项测试没有运行
+struct DeviceScore
+{
+    double copyGBps      = 0.0; //设备本地缓冲之间vkCmdCopyBuffer的带宽
+    double computeGflops = 0.0; //计算着色器的乘加吞吐
+    double fillGpixels   = 0.0; //全屏三角形的像素填充率
+
+    //各项的几何平均：与单位和量级无关，任何一项翻倍对总分的影响都相同
+    double Total() const;
+};
+
+/*
+ * 物理设备校准：在每个候选设备上创建一个临时的逻辑设备，运行三个很短的测试(复制带宽、计算吞吐、填充率)，
+ * 按实测的分数而不是设备类型和限制值选择设备。
+ *
+ * 结果缓存在一个文本文件中，键是设备UUID(没有时用厂商/设备ID和pipelineCacheUUID)加驱动版本，
+ * 更换显卡或升级驱动后键不同，会重新测量；之后的启动直接读取缓存，不再创建临时设备。
+ */
+class DeviceCalibration
+{
+public:
+    //path为空时不读写磁盘
+    void Load(const std::string& path);
+    //有新的测量结果时写回磁盘
+    void Save() const;
+
+    //getProperties2为空表示无法查询VkPhysicalDeviceIDProperties，改用设备属性中的ID
+    static std::string DeviceKey(VkPhysicalDevice device , PFN_vkGetPhysicalDeviceProperties2KHR getProperties2);
+
+    //返回缓存的分数；没有缓存时运行测试并记录，measured为true。测试失败时抛出异常
+    DeviceScore Score(VkPhysicalDevice device , const std::string& key , bool& measured);
+
+private:
+    static constexpr const char* FileHeader = "# LearnVulkan device calibration v1";
+
+    static DeviceScore Measure(VkPhysicalDevice device);
+
+    std::string                        m_Path;
+    std::map<std::string, DeviceScore> m_Scores;
+    bool                               m_Dirty = false;
+};
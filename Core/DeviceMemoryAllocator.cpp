@@ -0,0 +1,395 @@
+﻿#include "DeviceMemoryAllocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+void DeviceMemoryAllocator::Create(VkPhysicalDevice physicalDevice , VkDevice device)
+{
+    m_Device = device;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    m_BufferImageGranularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+    m_NonCoherentAtomSize    = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+    m_MaxAllocationCount     = properties.limits.maxMemoryAllocationCount;
+}
+
+void DeviceMemoryAllocator::Destroy()
+{
+    std::lock_guard lock(m_Mutex);
+    for (auto& block : m_Blocks)
+    {
+        vkFreeMemory(m_Device, block->memory, nullptr);
+    }
+    m_Blocks.clear();
+    m_DeviceAllocationCount = 0;
+}
+
+std::optional<uint32_t> DeviceMemoryAllocator::FindMemoryType(uint32_t              typeBits ,
+                                                              VkMemoryPropertyFlags requiredFlags ,
+                                                              VkMemoryPropertyFlags preferredFlags) const
+{
+    //typeBits的每一位对应一种内存类型，资源只能放在对应位为1的内存类型中。
+    //优先选择同时具备preferredFlags的类型，没有时退回只满足requiredFlags的类型
+    std::optional<uint32_t> fallback;
+    for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+    {
+        VkMemoryPropertyFlags flags = m_MemoryProperties.memoryTypes[i].propertyFlags;
+        if (!( typeBits & ( 1u << i ) ) || ( flags & requiredFlags ) != requiredFlags) continue;
+
+        if (( flags & preferredFlags ) == preferredFlags) return i;
+        if (!fallback) fallback = i;
+    }
+    return fallback;
+}
+
+VkDeviceSize DeviceMemoryAllocator::BlockSizeForType(uint32_t memoryType) const
+{
+    VkDeviceSize heapSize = m_MemoryProperties.memoryHeaps[m_MemoryProperties.memoryTypes[memoryType].heapIndex].size;
+    return heapSize <= SmallHeapThreshold ? heapSize / 8 : LargeHeapBlockSize;
+}
+
+VkDeviceMemory DeviceMemoryAllocator::AllocateBlock(VkDeviceSize size , uint32_t memoryType , void** mapped)
+{
+    std::lock_guard lock(m_Mutex);
+    VkDeviceMemory memory = AllocateDeviceMemory(size, memoryType, mapped);
+    if (memory != VK_NULL_HANDLE)
+    {
+        uint32_t heap = m_MemoryProperties.memoryTypes[memoryType].heapIndex;
+        m_RawBlockBytes[heap] += size;
+        m_RawBlockCount[heap]++;
+    }
+    return memory;
+}
+
+VkDeviceMemory DeviceMemoryAllocator::AllocateDeviceMemory(VkDeviceSize size , uint32_t memoryType , void** mapped)
+{
+    if (m_MaxAllocationCount != 0 && m_DeviceAllocationCount >= m_MaxAllocationCount)
+    {
+        throw std::runtime_error("设备内存分配数量达到maxMemoryAllocationCount上限");
+    }
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType                = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize       = size;
+    allocInfo.memoryTypeIndex      = memoryType;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(m_Device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    //主机可见的内存整块持久映射，之后的子分配直接用偏移量访问，不再反复调用vkMapMemory
+    *mapped = nullptr;
+    if (m_MemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        if (vkMapMemory(m_Device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS)
+        {
+            vkFreeMemory(m_Device, memory, nullptr);
+            throw std::runtime_error("映射设备内存失败");
+        }
+    }
+
+    m_DeviceAllocationCount++;
+    return memory;
+}
+
+void DeviceMemoryAllocator::FreeBlock(VkDeviceMemory memory , VkDeviceSize size , uint32_t memoryType)
+{
+    std::lock_guard lock(m_Mutex);
+    vkFreeMemory(m_Device, memory, nullptr);
+
+    uint32_t heap = m_MemoryProperties.memoryTypes[memoryType].heapIndex;
+    m_RawBlockBytes[heap] -= size;
+    m_RawBlockCount[heap]--;
+    m_DeviceAllocationCount--;
+}
+
+Allocation DeviceMemoryAllocator::Allocate(const VkMemoryRequirements& requirements ,
+                                           const AllocationCreateInfo& createInfo)
+{
+    //先按偏好尝试，某种内存类型的堆耗尽时换用其它满足requiredFlags的类型
+    uint32_t typeBits = requirements.memoryTypeBits;
+    while (auto memoryType = FindMemoryType(typeBits, createInfo.requiredFlags, createInfo.preferredFlags))
+    {
+        Allocation allocation;
+        if (TryAllocate(requirements, createInfo, *memoryType, allocation))
+        {
+            return allocation;
+        }
+        typeBits &= ~( 1u << *memoryType );
+    }
+    throw std::runtime_error("分配设备内存失败：没有合适的内存类型或内存已耗尽");
+}
+
+bool DeviceMemoryAllocator::TryAllocate(const VkMemoryRequirements& requirements ,
+                                        const AllocationCreateInfo& createInfo , uint32_t memoryType ,
+                                        Allocation&                 allocation)
+{
+    //粒度为1时两类资源可以放在同一块内存中
+    ResourceKind kind      = m_BufferImageGranularity > 1 ? createInfo.kind : ResourceKind::Linear;
+    VkDeviceSize blockSize = BlockSizeForType(memoryType);
+
+    auto fill = [&](MemoryBlock* block , VkDeviceSize offset , uint32_t node)
+    {
+        allocation.memory     = block->memory;
+        allocation.offset     = offset;
+        allocation.size       = requirements.size;
+        allocation.mapped     = block->mapped != nullptr ? block->mapped + offset : nullptr;
+        allocation.memoryType = memoryType;
+        allocation.block      = block;
+        allocation.node       = node;
+    };
+
+    std::lock_guard lock(m_Mutex);
+
+    //超过块大小一半的资源单独分配，避免一个大资源独占一整块后剩下的空间难以利用
+    bool dedicated = createInfo.dedicated || requirements.size > blockSize / 2;
+    if (!dedicated)
+    {
+        for (auto& block : m_Blocks)
+        {
+            if (block->dedicated || block->memoryType != memoryType || block->kind != kind) continue;
+            if (auto result = block->tlsf.Allocate(requirements.size, requirements.alignment))
+            {
+                fill(block.get(), result->offset, result->node);
+                return true;
+            }
+        }
+    }
+
+    //现有的块都放不下，向驱动申请新块
+    VkDeviceSize   size   = dedicated ? requirements.size : blockSize;
+    void*          mapped = nullptr;
+    VkDeviceMemory memory = AllocateDeviceMemory(size, memoryType, &mapped);
+    if (memory == VK_NULL_HANDLE) return false;
+
+    auto block        = std::make_unique<MemoryBlock>();
+    block->memory     = memory;
+    block->size       = size;
+    block->memoryType = memoryType;
+    block->kind       = kind;
+    block->dedicated  = dedicated;
+    block->mapped     = static_cast<std::byte*>(mapped);
+    block->tlsf       = TlsfAllocator(size);
+
+    auto result = block->tlsf.Allocate(requirements.size, requirements.alignment);
+    fill(block.get(), result->offset, result->node);
+    m_Blocks.push_back(std::move(block));
+    return true;
+}
+
+void DeviceMemoryAllocator::Free(Allocation& allocation)
+{
+    if (allocation.block == nullptr) return;
+
+    MemoryBlock* block = allocation.block;
+    uint32_t     node  = allocation.node;
+    allocation         = {};
+
+    std::lock_guard lock(m_Mutex);
+    block->tlsf.Free(node);
+    if (block->tlsf.Empty())
+    {
+        ReleaseBlock(block);
+    }
+}
+
+void DeviceMemoryAllocator::ReleaseBlock(MemoryBlock* block)
+{
+    //每种内存类型和资源类别保留一个空块，避免分配和释放在块边界上反复发生时频繁调用vkAllocateMemory
+    if (!block->dedicated)
+    {
+        bool otherEmpty = std::any_of(m_Blocks.begin(), m_Blocks.end(), [block](const auto& other)
+        {
+            return other.get() != block && !other->dedicated && other->memoryType == block->memoryType &&
+                   other->kind == block->kind && other->tlsf.Empty();
+        });
+        if (!otherEmpty) return;
+    }
+
+    vkFreeMemory(m_Device, block->memory, nullptr);
+    m_DeviceAllocationCount--;
+    m_Blocks.erase(std::find_if(m_Blocks.begin(), m_Blocks.end(),
+                                [block](const auto& other) { return other.get() == block; }));
+}
+
+Allocation DeviceMemoryAllocator::AllocateForBuffer(VkBuffer buffer , AllocationCreateInfo createInfo)
+{
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(m_Device, buffer, &requirements);
+
+    createInfo.kind       = ResourceKind::Linear;
+    Allocation allocation = Allocate(requirements, createInfo);
+    if (vkBindBufferMemory(m_Device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+    {
+        Free(allocation);
+        throw std::runtime_error("绑定缓冲内存失败");
+    }
+    return allocation;
+}
+
+Allocation DeviceMemoryAllocator::AllocateForImage(VkImage image , AllocationCreateInfo createInfo)
+{
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(m_Device, image, &requirements);
+
+    createInfo.kind       = ResourceKind::Optimal;
+    Allocation allocation = Allocate(requirements, createInfo);
+    if (vkBindImageMemory(m_Device, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+    {
+        Free(allocation);
+        throw std::runtime_error("绑定图像内存失败");
+    }
+    return allocation;
+}
+
+GpuBuffer DeviceMemoryAllocator::CreateBuffer(VkDeviceSize size , VkBufferUsageFlags usage ,
+                                              const AllocationCreateInfo& createInfo ,
+                                              std::span<const uint32_t>   queueFamilies)
+{
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size               = size;
+    bufferInfo.usage              = usage;
+    bufferInfo.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+    if (queueFamilies.size() > 1)
+    {
+        bufferInfo.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+        bufferInfo.pQueueFamilyIndices   = queueFamilies.data();
+    }
+
+    GpuBuffer buffer = {};
+    buffer.size      = size;
+    if (vkCreateBuffer(m_Device, &bufferInfo, nullptr, &buffer.buffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建缓冲失败");
+    }
+    try
+    {
+        buffer.allocation = AllocateForBuffer(buffer.buffer, createInfo);
+    }
+    catch (...)
+    {
+        vkDestroyBuffer(m_Device, buffer.buffer, nullptr);
+        throw;
+    }
+    return buffer;
+}
+
+void DeviceMemoryAllocator::DestroyBuffer(GpuBuffer& buffer)
+{
+    if (buffer.buffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(m_Device, buffer.buffer, nullptr);
+        Free(buffer.allocation);
+    }
+    buffer = {};
+}
+
+std::vector<HeapStatistics> DeviceMemoryAllocator::Statistics() const
+{
+    std::lock_guard lock(m_Mutex);
+
+    std::vector<HeapStatistics> heaps(m_MemoryProperties.memoryHeapCount);
+    std::vector<VkDeviceSize>   freeBytes(heaps.size());
+    std::vector<VkDeviceSize>   largestFree(heaps.size());
+    for (uint32_t i = 0; i < heaps.size(); i++)
+    {
+        heaps[i].heapIndex   = i;
+        heaps[i].heapSize    = m_MemoryProperties.memoryHeaps[i].size;
+        heaps[i].deviceLocal = m_MemoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+        //整块交给线性池的内存全部算作已使用
+        heaps[i].blockCount = m_RawBlockCount[i];
+        heaps[i].blockBytes = m_RawBlockBytes[i];
+        heaps[i].usedBytes  = m_RawBlockBytes[i];
+    }
+
+    for (const auto& block : m_Blocks)
+    {
+        uint32_t heap = m_MemoryProperties.memoryTypes[block->memoryType].heapIndex;
+        heaps[heap].blockCount++;
+        heaps[heap].allocationCount += block->tlsf.AllocationCount();
+        heaps[heap].blockBytes += block->size;
+        heaps[heap].usedBytes += block->tlsf.UsedBytes();
+        freeBytes[heap] += block->tlsf.FreeBytes();
+        largestFree[heap] = std::max(largestFree[heap], block->tlsf.LargestFreeRange());
+    }
+
+    for (uint32_t i = 0; i < heaps.size(); i++)
+    {
+        if (freeBytes[i] != 0)
+        {
+            heaps[i].fragmentation = 1.0 - static_cast<double>(largestFree[i]) / static_cast<double>(freeBytes[i]);
+        }
+    }
+    return heaps;
+}
+
+std::string DeviceMemoryAllocator::Report() const
+{
+    std::string report;
+    for (const auto& heap : Statistics())
+    {
+        if (heap.blockCount == 0) continue;
+
+        char line[160];
+        std::snprintf(line, sizeof(line),
+                      "heap %u (%s, %.0f MB): %u blocks, %u allocations, %.2f / %.2f MB in use, %.1f%% fragmentation\n",
+                      heap.heapIndex, heap.deviceLocal ? "device local" : "host", heap.heapSize / 1048576.0,
+                      heap.blockCount, heap.allocationCount, heap.usedBytes / 1048576.0, heap.blockBytes / 1048576.0,
+                      heap.fragmentation * 100.0);
+        report += line;
+    }
+    return report;
+}
+
+void LinearMemoryPool::Create(DeviceMemoryAllocator& allocator , const VkMemoryRequirements& requirements ,
+                              VkMemoryPropertyFlags  requiredFlags , VkMemoryPropertyFlags preferredFlags)
+{
+    m_Allocator = &allocator;
+
+    auto memoryType = allocator.FindMemoryType(requirements.memoryTypeBits, requiredFlags, preferredFlags);
+    if (!memoryType)
+    {
+        throw std::runtime_error("找不到线性内存池需要的内存类型");
+    }
+    m_MemoryType = *memoryType;
+
+    void* mapped = nullptr;
+    m_Memory     = allocator.AllocateBlock(requirements.size, m_MemoryType, &mapped);
+    if (m_Memory == VK_NULL_HANDLE)
+    {
+        throw std::runtime_error("分配线性内存池失败");
+    }
+    m_Mapped = static_cast<std::byte*>(mapped);
+    m_Ring   = RingAllocator(requirements.size);
+}
+
+void LinearMemoryPool::Destroy()
+{
+    if (m_Memory != VK_NULL_HANDLE)
+    {
+        m_Allocator->FreeBlock(m_Memory, m_Ring.Capacity(), m_MemoryType);
+        m_Memory = VK_NULL_HANDLE;
+        m_Mapped = nullptr;
+    }
+}
+
+std::optional<Allocation> LinearMemoryPool::Allocate(VkDeviceSize size , VkDeviceSize alignment)
+{
+    auto offset = m_Ring.Allocate(size, alignment);
+    if (!offset) return std::nullopt;
+
+    Allocation allocation = {};
+    allocation.memory     = m_Memory;
+    allocation.offset     = *offset;
+    allocation.size       = size;
+    allocation.mapped     = m_Mapped != nullptr ? m_Mapped + *offset : nullptr;
+    allocation.memoryType = m_MemoryType;
+    return allocation;
+}
@@ -0,0 +1,176 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "../Tool/RingAllocator.h"
+#include "../Tool/TlsfAllocator.h"
+
+/*
+ * 设备内存子分配器。
+ * vkAllocateMemory很慢，而且同时存在的分配数有maxMemoryAllocationCount的上限(常见为4096)，
+ * 所以向驱动申请大块VkDeviceMemory，再用TLSF把大块切分给各个缓冲和图像。
+ */
+
+//资源在内存中的排列方式。
+//线性资源(缓冲、线性图像)和非线性资源(最优排列的图像)在同一块内存中相邻时，必须相隔bufferImageGranularity，
+//这里在bufferImageGranularity大于1时让两类资源使用不同的内存块，完全避开这一限制
+enum class ResourceKind
+{
+    Linear,
+    Optimal
+};
+
+struct AllocationCreateInfo
+{
+    VkMemoryPropertyFlags requiredFlags  = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT; //必须具备的属性
+    VkMemoryPropertyFlags preferredFlags = 0;                                   //优先选择同时具备这些属性的内存类型
+    ResourceKind          kind           = ResourceKind::Linear;
+    //单独占用一个VkDeviceMemory，用于很大或需要单独释放的资源
+    bool dedicated = false;
+};
+
+struct MemoryBlock;
+
+struct Allocation
+{
+    VkDeviceMemory memory     = VK_NULL_HANDLE;
+    VkDeviceSize   offset     = 0;
+    VkDeviceSize   size       = 0;
+    void*          mapped     = nullptr; //主机可见的内存持久映射，这里已经加上了offset
+    uint32_t       memoryType = 0;
+
+    MemoryBlock* block = nullptr; //内部使用
+    uint32_t     node  = 0;
+};
+
+//缓冲和它的内存
+struct GpuBuffer
+{
+    VkBuffer     buffer = VK_NULL_HANDLE;
+    VkDeviceSize size   = 0;
+    Allocation   allocation;
+};
+
+//每个内存堆的统计信息
+struct HeapStatistics
+{
+    uint32_t     heapIndex       = 0;
+    VkDeviceSize heapSize        = 0;
+    bool         deviceLocal     = false;
+    uint32_t     blockCount      = 0; //向驱动申请的VkDeviceMemory数量
+    uint32_t     allocationCount = 0; //子分配数量
+    VkDeviceSize blockBytes      = 0; //向驱动申请的字节数
+    VkDeviceSize usedBytes       = 0; //子分配实际占用的字节数
+    //碎片率：1 - 最大连续空闲区间 / 全部空闲字节，空闲空间越零散越接近1
+    double fragmentation = 0.0;
+};
+
+//一块VkDeviceMemory，由TLSF切分
+struct MemoryBlock
+{
+    VkDeviceMemory memory;
+    VkDeviceSize   size;
+    uint32_t       memoryType;
+    ResourceKind   kind;
+    bool           dedicated;
+    std::byte*     mapped;
+    TlsfAllocator  tlsf;
+};
+
+class DeviceMemoryAllocator
+{
+public:
+    //普通堆上每次向驱动申请的块大小；小于1GB的堆使用堆大小的1/8
+    static constexpr VkDeviceSize LargeHeapBlockSize = 256ull << 20;
+    static constexpr VkDeviceSize SmallHeapThreshold = 1ull << 30;
+
+    void Create(VkPhysicalDevice physicalDevice , VkDevice device);
+    void Destroy();
+
+    Allocation Allocate(const VkMemoryRequirements& requirements , const AllocationCreateInfo& createInfo);
+    void       Free(Allocation& allocation);
+
+    //分配并绑定，缓冲总是线性资源，图像假定为最优排列(VK_IMAGE_TILING_OPTIMAL)
+    Allocation AllocateForBuffer(VkBuffer buffer , AllocationCreateInfo createInfo);
+    Allocation AllocateForImage(VkImage image , AllocationCreateInfo createInfo);
+
+    //queueFamilies多于一个时缓冲以VK_SHARING_MODE_CONCURRENT在这些队列族之间共享，不需要转移所有权
+    GpuBuffer CreateBuffer(VkDeviceSize size , VkBufferUsageFlags usage , const AllocationCreateInfo& createInfo ,
+                           std::span<const uint32_t> queueFamilies = {});
+    void      DestroyBuffer(GpuBuffer& buffer);
+
+    //找不到满足requiredFlags的内存类型时返回空
+    std::optional<uint32_t> FindMemoryType(uint32_t              typeBits , VkMemoryPropertyFlags requiredFlags ,
+                                           VkMemoryPropertyFlags preferredFlags = 0) const;
+
+    //直接向驱动申请/释放一整块内存，计入统计和分配数量上限。供LinearMemoryPool这类自己管理偏移量的使用者调用
+    VkDeviceMemory AllocateBlock(VkDeviceSize size , uint32_t memoryType , void** mapped);
+    void           FreeBlock(VkDeviceMemory memory , VkDeviceSize size , uint32_t memoryType);
+
+    const VkPhysicalDeviceMemoryProperties& MemoryProperties() const { return m_MemoryProperties; }
+    VkDeviceSize                            NonCoherentAtomSize() const { return m_NonCoherentAtomSize; }
+
+    std::vector<HeapStatistics> Statistics() const;
+    //每个有内存块的堆一行
+    std::string Report() const;
+
+private:
+    VkDeviceSize BlockSizeForType(uint32_t memoryType) const;
+    //调用者需要持有m_Mutex。内存不足时返回VK_NULL_HANDLE，超过分配数量上限时抛出异常
+    VkDeviceMemory AllocateDeviceMemory(VkDeviceSize size , uint32_t memoryType , void** mapped);
+    bool         TryAllocate(const VkMemoryRequirements& requirements , const AllocationCreateInfo& createInfo ,
+                             uint32_t                    memoryType , Allocation& allocation);
+    void ReleaseBlock(MemoryBlock* block);
+
+    VkDevice                         m_Device                 = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties m_MemoryProperties       = {};
+    VkDeviceSize                     m_BufferImageGranularity = 1;
+    VkDeviceSize                     m_NonCoherentAtomSize    = 1;
+    uint32_t                         m_MaxAllocationCount     = 0;
+    uint32_t                         m_DeviceAllocationCount  = 0;
+
+    std::vector<std::unique_ptr<MemoryBlock>> m_Blocks;
+    //直接分配出去的整块内存，按堆统计
+    VkDeviceSize m_RawBlockBytes[VK_MAX_MEMORY_HEAPS] = {};
+    uint32_t     m_RawBlockCount[VK_MAX_MEMORY_HEAPS] = {};
+
+    mutable std::mutex m_Mutex;
+};
+
+//线性/环形内存池：一整块内存，按RingAllocator的规则分配，适合每帧的上传数据这类生命周期先进先出的资源。
+//池中只能放同一种ResourceKind的资源
+class LinearMemoryPool
+{
+public:
+    //requirements.memoryTypeBits限定可用的内存类型，例如整块绑定到一个缓冲时使用该缓冲的内存需求
+    void Create(DeviceMemoryAllocator& allocator , const VkMemoryRequirements& requirements ,
+                VkMemoryPropertyFlags  requiredFlags , VkMemoryPropertyFlags preferredFlags = 0);
+    void Destroy();
+
+    //空间不足时返回空
+    std::optional<Allocation> Allocate(VkDeviceSize size , VkDeviceSize alignment);
+
+    uint64_t Head() const { return m_Ring.Head(); }
+    void     ReleaseUpTo(uint64_t marker) { m_Ring.ReleaseUpTo(marker); }
+    void     Reset() { m_Ring.Reset(); }
+
+    VkDeviceMemory Memory() const { return m_Memory; }
+    std::byte*     Mapped() const { return m_Mapped; }
+    VkDeviceSize   Size() const { return m_Ring.Capacity(); }
+    VkDeviceSize   UsedBytes() const { return m_Ring.UsedBytes(); }
+    uint32_t       MemoryType() const { return m_MemoryType; }
+
+private:
+    DeviceMemoryAllocator* m_Allocator  = nullptr;
+    VkDeviceMemory         m_Memory     = VK_NULL_HANDLE;
+    std::byte*             m_Mapped     = nullptr;
+    uint32_t               m_MemoryType = 0;
+    RingAllocator          m_Ring;
+};
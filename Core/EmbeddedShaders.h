@@ -0,0 +1,26 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+//构建时编译进程序的SPIR-V。
+//Shader/embed_spirv.py在预生成事件中编译并优化Shader/*.glsl，生成Shader/Generated/EmbeddedSpirv.h。
+//着色器按文件名去掉.glsl后的名称查找，例如Triangle.vert.glsl对应"Triangle.vert"。
+struct EmbeddedShader
+{
+    std::string_view          name;
+    std::span<const uint32_t> code;
+};
+
+#include "../Shader/Generated/EmbeddedSpirv.h"
+
+//找不到时返回空span
+constexpr std::span<const uint32_t> FindEmbeddedShader(std::string_view name)
+{
+    for (const auto& shader : EmbeddedSpirv::Table)
+    {
+        if (shader.name == name) return shader.code;
+    }
+    return {};
+}
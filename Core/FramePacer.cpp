@@ -0,0 +1,223 @@
+﻿#include "FramePacer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+
+PresentPolicy ParsePresentPolicy(const std::string& name)
+{
+    if (name == "latency") return PresentPolicy::LowLatency;
+    if (name == "vsync") return PresentPolicy::VSync;
+    if (name == "power") return PresentPolicy::PowerSaving;
+    throw std::runtime_error("未知的呈现策略: " + name + "，可选latency/vsync/power");
+}
+
+const char* PresentPolicyName(PresentPolicy policy)
+{
+    switch (policy)
+    {
+    case PresentPolicy::LowLatency:
+        return "latency";
+    case PresentPolicy::VSync:
+        return "vsync";
+    case PresentPolicy::PowerSaving:
+        return "power";
+    }
+    return "unknown";
+}
+
+const char* PresentModeName(VkPresentModeKHR mode)
+{
+    switch (mode)
+    {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "FIFO_RELAXED";
+    default:
+        return "OTHER";
+    }
+}
+
+VkPresentModeKHR ChoosePresentMode(PresentPolicy policy , const std::vector<VkPresentModeKHR>& availableModes)
+{
+    auto available = [&](VkPresentModeKHR mode)
+    {
+        return std::find(availableModes.begin(), availableModes.end(), mode) != availableModes.end();
+    };
+
+    //FIFO是唯一所有实现都必须支持的模式，其它策略找不到想要的模式时都退回它
+    if (policy == PresentPolicy::LowLatency)
+    {
+        //MAILBOX：新的一帧直接替换队列中还没显示的帧，不撕裂，延迟不超过一个刷新周期
+        //IMMEDIATE：不等垂直同步，延迟最低但会撕裂
+        if (available(VK_PRESENT_MODE_MAILBOX_KHR)) return VK_PRESENT_MODE_MAILBOX_KHR;
+        if (available(VK_PRESENT_MODE_IMMEDIATE_KHR)) return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    }
+    //VSync和PowerSaving都用FIFO：呈现引擎每次垂直同步取一帧，队列满时vkAcquireNextImageKHR阻塞，天然限制帧率
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+void FramePacer::Configure(PresentPolicy policy , double refreshHz , uint32_t targetFps , bool presentWait)
+{
+    m_Policy      = policy;
+    m_PresentWait = presentWait;
+    m_RefreshMs   = refreshHz > 0.0 ? 1000.0 / refreshHz : 0.0;
+
+    if (targetFps > 0)
+    {
+        m_IntervalMs = 1000.0 / targetFps;
+    }
+    else if (policy == PresentPolicy::PowerSaving)
+    {
+        //默认刷新率的一半；刷新率未知时按30fps
+        m_IntervalMs = m_RefreshMs > 0.0 ? m_RefreshMs * 2.0 : 1000.0 / 30.0;
+    }
+    else
+    {
+        m_IntervalMs = 0.0;
+    }
+    SwapChainChanged();
+}
+
+void FramePacer::SwapChainChanged()
+{
+    m_FirstSwapChainId = m_NextPresentId;
+    m_HasDisplayed     = false;
+}
+
+uint64_t FramePacer::PresentIdToWait() const
+{
+    if (!m_PresentWait) return 0;
+
+    //允许排队的呈现数：VSync留两帧缓冲吸收帧耗时的波动，其它策略只留一帧，输入到显示的延迟最短
+    uint64_t depth         = m_Policy == PresentPolicy::VSync ? 2 : 1;
+    uint64_t lastPresented = m_NextPresentId - 1;
+    if (lastPresented + 1 < m_FirstSwapChainId + depth) return 0;
+
+    uint64_t presentId = lastPresented + 1 - depth;
+    return presentId > m_LastDisplayedId ? presentId : 0;
+}
+
+void FramePacer::Displayed(uint64_t presentId)
+{
+    auto now          = Clock::now();
+    m_LastDisplayedId = presentId;
+    m_LastDisplayed   = now;
+    m_HasDisplayed    = true;
+
+    //太早的ID开始时刻已经被覆盖，不计入统计
+    if (presentId + HistorySize >= m_NextPresentId && presentId < m_NextPresentId)
+    {
+        auto start = m_StartById[presentId % HistorySize];
+        AddLatencySample(std::chrono::duration<double, std::milli>(now - start).count());
+    }
+}
+
+void FramePacer::WaitForFrameStart()
+{
+    auto now    = Clock::now();
+    auto target = now;
+    auto ms     = [](double value)
+    {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(value));
+    };
+
+    if (m_IntervalMs > 0.0 && m_HasLastFrame)
+    {
+        target = std::max(target, m_FrameStart + ms(m_IntervalMs));
+    }
+
+    //即时开始：上一帧在m_LastDisplayed显示，这一帧最早在depth个刷新周期之后显示，
+    //在那之前留出预测的帧耗时和安全余量开始，晚一点开始读到的输入就新一点
+    if (m_PresentWait && m_RefreshMs > 0.0 && m_HasDisplayed && m_Policy != PresentPolicy::PowerSaving)
+    {
+        double depth    = m_Policy == PresentPolicy::VSync ? 2.0 : 1.0;
+        auto   deadline = m_LastDisplayed + ms(m_RefreshMs * depth);
+        target          = std::max(target, deadline - ms(m_PredictedWorkMs + SafetyMarginMs));
+    }
+
+    if (target > now)
+    {
+        SleepUntil(target);
+    }
+
+    m_FrameStart   = Clock::now();
+    m_HasLastFrame = true;
+}
+
+uint64_t FramePacer::Presented()
+{
+    auto   now    = Clock::now();
+    double workMs = std::chrono::duration<double, std::milli>(now - m_FrameStart).count();
+
+    //指数平均，0.1的权重大约平均最近10帧，单帧的尖峰不会让下一帧提前太多
+    m_PredictedWorkMs = m_PredictedWorkMs == 0.0 ? workMs : m_PredictedWorkMs * 0.9 + workMs * 0.1;
+
+    uint64_t presentId                   = m_NextPresentId++;
+    m_StartById[presentId % HistorySize] = m_FrameStart;
+    if (!m_PresentWait)
+    {
+        AddLatencySample(workMs);
+    }
+    return presentId;
+}
+
+void FramePacer::ResetStats()
+{
+    m_LatencyMs.clear();
+    m_NextLatency  = 0;
+    m_SkippedWaits = 0;
+}
+
+void FramePacer::AddLatencySample(double ms)
+{
+    if (m_LatencyMs.size() < LatencyHistorySize)
+    {
+        m_LatencyMs.push_back(ms);
+        return;
+    }
+    m_LatencyMs[m_NextLatency] = ms;
+    m_NextLatency              = ( m_NextLatency + 1 ) % LatencyHistorySize;
+}
+
+double FramePacer::LatencyPercentile(double p) const
+{
+    if (m_LatencyMs.empty()) return 0.0;
+
+    std::vector<double> sorted = m_LatencyMs;
+    size_t              index  = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+std::string FramePacer::Report() const
+{
+    if (m_LatencyMs.empty()) return "latency: no samples";
+
+    char buffer[160];
+    std::snprintf(buffer, sizeof(buffer), "latency p50 %.2f / p90 %.2f / p99 %.2f / max %.2f ms (%s, %zu frames)",
+                  LatencyPercentile(0.5), LatencyPercentile(0.9), LatencyPercentile(0.99), LatencyPercentile(1.0),
+                  m_PresentWait ? "displayed" : "present call", m_LatencyMs.size());
+    return buffer;
+}
+
+void FramePacer::SleepUntil(Clock::time_point target)
+{
+    //系统睡眠的唤醒误差可达一两毫秒(Windows默认的时钟精度更差)，最后一段改为让出时间片的忙等
+    constexpr auto SpinThreshold = std::chrono::microseconds(1500);
+    auto           now           = Clock::now();
+    if (target - now > SpinThreshold)
+    {
+        std::this_thread::sleep_until(target - SpinThreshold);
+    }
+    while (Clock::now() < target)
+    {
+        std::this_thread::yield();
+    }
+}
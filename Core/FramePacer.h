@@ -0,0 +1,98 @@
+﻿#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+//呈现策略：决定交换链的呈现模式，以及CPU在每帧开始前是否、睡眠多久
+enum class PresentPolicy
+{
+    LowLatency,  //不撕裂的最低延迟：MAILBOX优先，其次IMMEDIATE；有present wait时按预测时刻开始每一帧
+    VSync,       //FIFO，帧率锁定在刷新率，允许两帧排队，换取稳定的帧间隔
+    PowerSaving, //FIFO并把帧率限制在刷新率的一半(或--target-fps)，CPU和GPU在帧之间休眠
+};
+
+PresentPolicy    ParsePresentPolicy(const std::string& name);
+const char*      PresentPolicyName(PresentPolicy policy);
+const char*      PresentModeName(VkPresentModeKHR mode);
+VkPresentModeKHR ChoosePresentMode(PresentPolicy policy , const std::vector<VkPresentModeKHR>& availableModes);
+
+/*
+ * 帧节奏控制和呈现延迟统计，只负责计时，不调用Vulkan。每帧的调用顺序：
+ *     PresentIdToWait -> (vkWaitForPresentKHR成功后)Displayed -> WaitForFrameStart -> 获取图像 ... 呈现 -> Presented
+ *
+ * 延迟指从帧开始(获取图像之前)到画面被显示的时间：
+ *     有present wait时终点是vkWaitForPresentKHR返回的时刻，只有在等待真正阻塞时才精确，否则偏大；
+ *     没有present wait时只能以调用vkQueuePresentKHR为终点，不包括呈现队列中的排队和扫描输出。
+ *
+ * 帧节奏：
+ *     间隔上限：PowerSaving或指定了--target-fps时，两帧开始的间隔不小于目标间隔；
+ *     即时开始：LowLatency和VSync在有present wait时，从上一帧显示的时刻推算下一次垂直同步，
+ *              减去预测的帧耗时(近期CPU耗时的指数平均加一个安全余量)，睡眠到这个时刻再开始，输入到显示的时间最短。
+ */
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    //refreshHz为0表示刷新率未知，这时不做即时开始；targetFps为0表示使用策略的默认值
+    void Configure(PresentPolicy policy , double refreshHz , uint32_t targetFps , bool presentWait);
+
+    //交换链重建后调用：呈现ID属于交换链，旧交换链上的ID不能再在新交换链上等待
+    void SwapChainChanged();
+
+    //开始新一帧之前要等待显示完成的呈现ID，0表示不需要等待
+    uint64_t PresentIdToWait() const;
+    //vkWaitForPresentKHR对presentId返回成功
+    void Displayed(uint64_t presentId);
+
+    //按策略睡眠到预测的帧开始时刻，并把返回的时刻记为这一帧的开始
+    void WaitForFrameStart();
+    //这一帧即将提交呈现，返回分配给它的呈现ID(从1开始递增)
+    uint64_t Presented();
+
+    PresentPolicy Policy() const { return m_Policy; }
+    bool          UsesPresentWait() const { return m_PresentWait; }
+
+    //清空延迟样本，例如切换策略后重新统计。只保留最近LatencyHistorySize帧的样本
+    void     ResetStats();
+    size_t   SampleCount() const { return m_LatencyMs.size(); }
+    double   LatencyPercentile(double p) const;
+    uint64_t SkippedWaits() const { return m_SkippedWaits; }
+    void     WaitSkipped() { m_SkippedWaits++; }
+    //例如"latency p50 8.1 / p90 9.0 / p99 12.4 / max 16.0 ms (displayed, 600 frames)"
+    std::string Report() const;
+
+private:
+    //每帧的开始时刻按呈现ID保存在一个小环中，等显示后查出来计算延迟
+    static constexpr uint32_t HistorySize = 16;
+    //延迟样本的环形缓冲容量，长时间运行时内存和百分位的计算量都不再增长
+    static constexpr size_t LatencyHistorySize = 4096;
+    //即时开始的安全余量，覆盖睡眠唤醒的误差和预测偏差
+    static constexpr double SafetyMarginMs = 1.0;
+
+    static void SleepUntil(Clock::time_point target);
+    void        AddLatencySample(double ms);
+
+    PresentPolicy m_Policy      = PresentPolicy::LowLatency;
+    bool          m_PresentWait = false;
+    double        m_RefreshMs   = 0.0;
+    double        m_IntervalMs  = 0.0; //两帧开始的最小间隔，0表示不限制
+
+    Clock::time_point m_FrameStart; //当前帧(WaitForFrameStart之前是上一帧)的开始时刻
+    Clock::time_point m_LastDisplayed;
+    bool              m_HasLastFrame = false;
+    bool              m_HasDisplayed = false;
+
+    uint64_t          m_NextPresentId    = 1;
+    uint64_t          m_FirstSwapChainId = 1; //当前交换链上第一个呈现ID
+    uint64_t          m_LastDisplayedId  = 0;
+    Clock::time_point m_StartById[HistorySize];
+
+    double              m_PredictedWorkMs = 0.0; //帧开始到提交呈现的CPU耗时的指数平均
+    std::vector<double> m_LatencyMs;        //最多LatencyHistorySize个，满了之后从m_NextLatency开始覆盖最旧的
+    size_t              m_NextLatency  = 0;
+    uint64_t            m_SkippedWaits = 0;
+};
@@ -0,0 +1,377 @@
+﻿#include "GpuCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+#include "DeletionQueue.h"
+#include "DescriptorHeap.h"
+#include "PipelineFactory.h"
+#include "QueueTopology.h"
+
+Frustum Frustum::FromMatrix(const float viewProjection[16])
+{
+    //列主序：第row行第column列是viewProjection[column * 4 + row]。
+    //裁剪空间中可见的点满足-w<=x<=w、-w<=y<=w、0<=z<=w，每个不等式对应一个平面：w±x、w±y、z、w-z
+    float planes[6][4];
+    for (int column = 0; column < 4; ++column)
+    {
+        float x = viewProjection[column * 4 + 0];
+        float y = viewProjection[column * 4 + 1];
+        float z = viewProjection[column * 4 + 2];
+        float w = viewProjection[column * 4 + 3];
+        planes[0][column] = w + x;
+        planes[1][column] = w - x;
+        planes[2][column] = w + y;
+        planes[3][column] = w - y;
+        planes[4][column] = z;
+        planes[5][column] = w - z;
+    }
+
+    Frustum frustum;
+    for (int i = 0; i < 6; ++i)
+    {
+        float length = std::sqrt(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] +
+                                 planes[i][2] * planes[i][2]);
+        float scale  = length > 0.0f ? 1.0f / length : 0.0f;
+        for (int j = 0; j < 4; ++j)
+        {
+            frustum.planes[i][j] = planes[i][j] * scale;
+        }
+    }
+    return frustum;
+}
+
+void GpuCuller::Create(VkDevice device , DeviceMemoryAllocator& allocator , VkShaderModule shader ,
+                       VkPipelineCache cache , uint32_t framesInFlight ,
+                       PFN_vkCmdDrawIndexedIndirectCountKHR drawIndirectCount , VkDescriptorSetLayout heapLayout)
+{
+    m_Device            = device;
+    m_Allocator         = &allocator;
+    m_DrawIndirectCount = drawIndirectCount;
+
+    //绑定0是实例缓冲，绑定1是间接绘制命令和可见列表。剔除写入，绘制时顶点着色器读取同一个描述符集
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        bindings[i].binding         = i;
+        bindings[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+    setLayoutInfo.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount                    = 2;
+    setLayoutInfo.pBindings                       = bindings;
+    if (m_SetLayout.Create(m_Device, vkCreateDescriptorSetLayout, setLayoutInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建剔除描述符集布局失败");
+    }
+
+    VkDescriptorPoolSize       poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * framesInFlight};
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets                    = framesInFlight;
+    poolInfo.poolSizeCount              = 1;
+    poolInfo.pPoolSizes                 = &poolSize;
+    if (m_DescriptorPool.Create(m_Device, vkCreateDescriptorPool, poolInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建剔除描述符池失败");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(framesInFlight, m_SetLayout);
+    VkDescriptorSetAllocateInfo        setInfo = {};
+    setInfo.sType                              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool                     = m_DescriptorPool;
+    setInfo.descriptorSetCount                 = framesInFlight;
+    setInfo.pSetLayouts                        = layouts.data();
+    m_Sets.resize(framesInFlight);
+    if (vkAllocateDescriptorSets(m_Device, &setInfo, m_Sets.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("分配剔除描述符集失败");
+    }
+
+    VkPushConstantRange pushRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants)};
+
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount             = 1;
+    layoutInfo.pSetLayouts                = m_SetLayout.Address();
+    layoutInfo.pushConstantRangeCount     = 1;
+    layoutInfo.pPushConstantRanges        = &pushRange;
+    if (m_PipelineLayout.Create(m_Device, vkCreatePipelineLayout, layoutInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建剔除管线布局失败");
+    }
+
+    ComputePipelineDesc desc = {};
+    desc.shader              = shader;
+    desc.layout              = m_PipelineLayout;
+    m_Pipeline.Reset(m_Device, PipelineFactory::CreateComputePipeline(m_Device, cache, desc));
+
+    //图形管线的布局：场景的片段着色器从描述符集0的描述符堆采样，剔除的描述符集移到集1。
+    //Vulkan 1.0的管线布局中不能跳过描述符集，没有描述符堆时用一个空的描述符集布局占位
+    if (heapLayout == VK_NULL_HANDLE)
+    {
+        VkDescriptorSetLayoutCreateInfo emptyInfo = {};
+        emptyInfo.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        if (m_EmptySetLayout.Create(m_Device, vkCreateDescriptorSetLayout, emptyInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("创建剔除绘制的空描述符集布局失败");
+        }
+        heapLayout = m_EmptySetLayout;
+    }
+    VkDescriptorSetLayout drawSetLayouts[] = {heapLayout, m_SetLayout};
+
+    //push constant开头是场景的DrawIndices，Culled.vert的流起始位置在它之后。两个阶段读取的范围不重叠，
+    //但放在同一个范围中，推送时阶段都是ALL_GRAPHICS，和场景的管线布局一致
+    VkPushConstantRange drawRange  = {VK_SHADER_STAGE_ALL_GRAPHICS, 0, sizeof(DrawIndices) + sizeof(DrawConstants)};
+    layoutInfo.setLayoutCount      = 2;
+    layoutInfo.pSetLayouts         = drawSetLayouts;
+    layoutInfo.pPushConstantRanges = &drawRange;
+    if (m_DrawLayout.Create(m_Device, vkCreatePipelineLayout, layoutInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建剔除绘制的管线布局失败");
+    }
+
+    //可见数量很小，放在主机可见的一致性内存中，栅栏之后直接读取
+    AllocationCreateInfo readbackInfo = {};
+    readbackInfo.requiredFlags        = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    m_Readback = m_Allocator->CreateBuffer(sizeof(uint32_t) * framesInFlight, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           readbackInfo);
+    if (m_Readback.allocation.mapped == nullptr)
+    {
+        throw std::runtime_error("剔除回读缓冲没有映射到主机地址");
+    }
+    m_Frames.assign(framesInFlight, {});
+    m_DrawBuffers.resize(framesInFlight);
+}
+
+void GpuCuller::Destroy()
+{
+    if (m_Allocator != nullptr)
+    {
+        for (auto& buffer : m_DrawBuffers)
+        {
+            m_Allocator->DestroyBuffer(buffer);
+        }
+        m_Allocator->DestroyBuffer(m_Readback);
+    }
+    m_DrawBuffers.clear();
+    m_Frames.clear();
+    m_Capacity = 0;
+
+    m_Pipeline.Reset();
+    m_PipelineLayout.Reset();
+    m_DrawLayout.Reset();
+    m_EmptySetLayout.Reset();
+    //描述符集随描述符池一起释放
+    m_Sets.clear();
+    m_DescriptorPool.Reset();
+    m_SetLayout.Reset();
+}
+
+void GpuCuller::Reserve(uint32_t capacity , DeletionQueue& deletionQueue , uint64_t serial)
+{
+    if (capacity == m_Capacity) return;
+
+    //飞行中的帧可能还在读取旧的命令，交给删除队列，不需要等待设备空闲
+    std::vector<GpuBuffer> retired;
+    for (auto& buffer : m_DrawBuffers)
+    {
+        if (buffer.buffer != VK_NULL_HANDLE)
+        {
+            retired.push_back(buffer);
+            buffer = {};
+        }
+    }
+    if (!retired.empty())
+    {
+        DeviceMemoryAllocator* allocator = m_Allocator;
+        deletionQueue.Push(serial, [allocator, retired]() mutable
+        {
+            for (auto& buffer : retired)
+            {
+                allocator->DestroyBuffer(buffer);
+            }
+        });
+    }
+
+    m_Capacity = capacity;
+    if (capacity == 0) return;
+
+    //计算着色器写入命令和可见列表，间接绘制和顶点着色器读取，重置命令和回读可见数量是传输操作
+    AllocationCreateInfo allocInfo = {};
+    allocInfo.requiredFlags        = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    VkDeviceSize       size  = VisibleBase + VkDeviceSize(capacity) * sizeof(uint32_t);
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    for (auto& buffer : m_DrawBuffers)
+    {
+        buffer = m_Allocator->CreateBuffer(size, usage, allocInfo);
+    }
+}
+
+void GpuCuller::Collect(uint32_t frameIndex)
+{
+    FrameState& frame = m_Frames[frameIndex];
+    if (!frame.pending) return;
+
+    m_LastVisible = static_cast<const uint32_t*>(m_Readback.allocation.mapped)[frameIndex];
+    m_VisibleSum  += m_LastVisible;
+    m_ObjectSum   += frame.objectCount;
+    m_CulledFrames++;
+    frame.pending = false;
+}
+
+void GpuCuller::RecordCull(VkCommandBuffer commandBuffer , uint32_t frameIndex , const CullInput& input ,
+                           const Frustum& frustum)
+{
+    FrameState& frame = m_Frames[frameIndex];
+    frame.objectCount = 0;
+    if (input.objectCount == 0) return;
+    if (input.objectCount > m_Capacity)
+    {
+        throw std::runtime_error("剔除的物体数量超出命令缓冲区的容量");
+    }
+
+    //实例缓冲和命令缓冲区都可能在两帧之间重新分配，每帧重写这套帧资源的描述符集。
+    //这个描述符集上一次被使用的命令已经完成(栅栏等待过)，可以直接更新
+    VkBuffer               drawBuffer     = m_DrawBuffers[frameIndex].buffer;
+    VkDescriptorBufferInfo bufferInfos[2] = {{input.instanceBuffer, 0, VK_WHOLE_SIZE}, {drawBuffer, 0, VK_WHOLE_SIZE}};
+    VkWriteDescriptorSet   writes[2]      = {};
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        writes[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet          = m_Sets[frameIndex];
+        writes[i].dstBinding      = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo     = &bufferInfos[i];
+    }
+    vkUpdateDescriptorSets(m_Device, 2, writes, 0, nullptr);
+
+    //Culled.vert以32位字为单位读取实例缓冲
+    frame.objectCount           = input.objectCount;
+    frame.streams.offsetBase    = static_cast<uint32_t>(input.offsetStream / sizeof(uint32_t));
+    frame.streams.transformBase = static_cast<uint32_t>(input.transformStream / sizeof(uint32_t));
+    frame.streams.colorBase     = static_cast<uint32_t>(input.colorStream / sizeof(uint32_t));
+    frame.pending               = true;
+
+    PushConstants constants = {};
+    std::copy(&frustum.planes[0][0], &frustum.planes[0][0] + 24, &constants.planes[0][0]);
+    constants.objectCount   = input.objectCount;
+    constants.offsetBase    = static_cast<uint32_t>(input.offsetStream / ( 2 * sizeof(float) ));
+    constants.transformBase = static_cast<uint32_t>(input.transformStream / ( 2 * sizeof(float) ));
+    constants.meshRadius    = input.meshRadius;
+
+    //绘制数量清零，命令的instanceCount从0开始由Cull.comp累加，其余字段对所有可见物体相同
+    DrawHeader header         = {};
+    header.command.indexCount = input.indexCount;
+    vkCmdUpdateBuffer(commandBuffer, drawBuffer, 0, sizeof(header), &header);
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, 1,
+                            &m_Sets[frameIndex], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+                       &constants);
+    vkCmdDispatch(commandBuffer, ( input.objectCount + GroupSize - 1 ) / GroupSize, 1, 1);
+
+    //instanceCount复制到回读缓冲。间接绘制和顶点着色器的读取由RecordRelease同步，
+    //计算队列不支持顶点着色阶段，这里的屏障不能包含它
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+
+    VkDeviceSize instanceCountOffset = CommandBase + offsetof(VkDrawIndexedIndirectCommand, instanceCount);
+    VkBufferCopy region              = {instanceCountOffset, sizeof(uint32_t) * frameIndex, sizeof(uint32_t)};
+    vkCmdCopyBuffer(commandBuffer, drawBuffer, m_Readback.buffer, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+}
+
+void GpuCuller::RecordRelease(VkCommandBuffer commandBuffer , uint32_t frameIndex , uint32_t computeFamily ,
+                              uint32_t        graphicsFamily) const
+{
+    if (m_Frames[frameIndex].objectCount == 0) return;
+
+    //命令和计数由间接绘制读取，可见列表由顶点着色器读取
+    if (computeFamily != graphicsFamily)
+    {
+        QueueOwnership::ReleaseBuffer(commandBuffer, m_DrawBuffers[frameIndex].buffer, 0, VK_WHOLE_SIZE,
+                                      computeFamily, graphicsFamily, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                      VK_ACCESS_SHADER_WRITE_BIT);
+        return;
+    }
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, AcquireStages, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+}
+
+void GpuCuller::RecordAcquire(VkCommandBuffer commandBuffer , uint32_t frameIndex , uint32_t computeFamily ,
+                              uint32_t        graphicsFamily) const
+{
+    if (m_Frames[frameIndex].objectCount == 0 || computeFamily == graphicsFamily) return;
+
+    //图形提交在同样的阶段等待剔除提交的信号量
+    QueueOwnership::AcquireBuffer(commandBuffer, m_DrawBuffers[frameIndex].buffer, 0, VK_WHOLE_SIZE, computeFamily,
+                                  graphicsFamily, AcquireStages,
+                                  VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+void GpuCuller::RecordDraw(VkCommandBuffer commandBuffer , uint32_t frameIndex) const
+{
+    const FrameState& frame = m_Frames[frameIndex];
+    if (frame.objectCount == 0) return;
+
+    //描述符集0的描述符堆由调用者绑定，这里只绑定集1，不会解除集0的绑定
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_DrawLayout, 1, 1, &m_Sets[frameIndex],
+                            0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_DrawLayout, VK_SHADER_STAGE_ALL_GRAPHICS, sizeof(DrawIndices),
+                       sizeof(frame.streams), &frame.streams);
+
+    //只有一个网格，也就只有一条命令
+    VkBuffer           drawBuffer = m_DrawBuffers[frameIndex].buffer;
+    constexpr uint32_t stride     = sizeof(VkDrawIndexedIndirectCommand);
+    if (m_DrawIndirectCount != nullptr)
+    {
+        //GPU写入的绘制数量在没有可见物体时为0，maxDrawCount是网格数量
+        m_DrawIndirectCount(commandBuffer, drawBuffer, CommandBase, drawBuffer, 0, 1, stride);
+        return;
+    }
+    //固定数量：没有可见物体时instanceCount为0，GPU跳过这条命令
+    vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, CommandBase, 1, stride);
+}
+
+std::string GpuCuller::Report() const
+{
+    std::ostringstream out;
+    out << "gpu culling: " << ( UsesDrawCount() ? "draw indirect count" : "fixed-count indirect" );
+    if (m_CulledFrames == 0)
+    {
+        out << ", no frames culled\n";
+        return out.str();
+    }
+    double objects = static_cast<double>(m_ObjectSum) / m_CulledFrames;
+    double visible = static_cast<double>(m_VisibleSum) / m_CulledFrames;
+    out << ", " << objects << " objects, " << visible << " visible on average ("
+            << ( objects > 0.0 ? 100.0 * visible / objects : 0.0 ) << "%) over " << m_CulledFrames << " frames\n";
+    return out.str();
+}
@@ -0,0 +1,170 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "DeviceMemoryAllocator.h"
+#include "VulkanHandle.h"
+
+class DeletionQueue;
+
+//剔除用的视锥体：6个平面(a, b, c, d)，点p在内侧当且仅当dot(abc, p) + d >= 0，法线已归一化
+struct Frustum
+{
+    float planes[6][4] = {};
+
+    //从列主序的投影(或视图投影)矩阵提取平面(Gribb/Hartmann)，深度范围是Vulkan的[0, 1]
+    static Frustum FromMatrix(const float viewProjection[16]);
+
+    //和Cull.comp相同的测试，用于CPU端的剔除
+    bool IntersectsSphere(float x , float y , float z , float radius) const
+    {
+        for (const auto& plane : planes)
+        {
+            if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < -radius) return false;
+        }
+        return true;
+    }
+};
+
+//要剔除的物体：实例缓冲中的位置流(vec2)、变换流(vec2，长度是缩放)和颜色流(RGBA8)，见InstanceData.h
+struct CullInput
+{
+    VkBuffer     instanceBuffer  = VK_NULL_HANDLE;
+    VkDeviceSize offsetStream    = 0; //字节偏移，必须是8的倍数
+    VkDeviceSize transformStream = 0;
+    VkDeviceSize colorStream     = 0; //必须是4的倍数
+    uint32_t     objectCount     = 0;
+    uint32_t     indexCount      = 0; //每个物体绘制的索引数
+    float        meshRadius      = 0.0f;
+};
+
+/*
+ * GPU驱动的提交：计算着色器(Cull.comp)用每个物体的包围球测试视锥体，可见物体的编号紧凑地写入可见列表，
+ * 并原子地增加网格唯一一条间接绘制命令的instanceCount。渲染流程内一次间接绘制画出全部可见物体，
+ * 顶点着色器(Culled.vert)用gl_InstanceIndex在可见列表中取得物体编号，再从实例缓冲读取它的数据。
+ * CPU每帧只录制一次命令重置、一次dispatch和一次间接绘制，与物体数量无关，物体从几千增加到几百万时CPU的开销不变；
+ * GPU也只处理一条命令，不可见的物体不产生任何绘制。
+ *
+ * 有VK_KHR_draw_indirect_count时绘制数量由GPU写入(没有可见物体时为0，vkCmdDrawIndexedIndirectCountKHR)；
+ * 否则固定一条命令调用vkCmdDrawIndexedIndirect，没有可见物体时instanceCount为0。
+ * 命令的firstInstance为0，不需要multiDrawIndirect和drawIndirectFirstInstance特性。
+ *
+ * 每套帧资源一个命令缓冲区：开头16字节是绘制数量，之后是命令，从VisibleBase开始是可见列表。
+ * 可见数量(命令的instanceCount)复制到主机可见的回读缓冲，等这套帧资源的栅栏之后读取。
+ *
+ * RecordCull只使用计算和传输阶段，可以录制在异步计算队列上。剔除的结果交给图形队列分两步：
+ * 剔除一侧RecordRelease，绘制一侧RecordAcquire。两个队列族不同时是一对所有权转移屏障，提交之间用信号量排序；
+ * 相同时RecordRelease录制一个普通的管线屏障，RecordAcquire什么也不做。
+ * 图形队列用完命令缓冲区后不需要把所有权还给计算队列：下一次剔除整段重写，不关心旧内容，
+ * 而写入之前这套帧资源的栅栏已经等待过。
+ */
+class GpuCuller
+{
+public:
+    //读取剔除结果的阶段：间接绘制读取命令，顶点着色器读取可见列表。异步剔除时图形提交在这些阶段等待信号量
+    static constexpr VkPipelineStageFlags AcquireStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+
+    //drawIndirectCount为空时使用固定数量的间接绘制。heapLayout是描述符堆的布局，不使用描述符堆时为VK_NULL_HANDLE
+    void Create(VkDevice device , DeviceMemoryAllocator& allocator , VkShaderModule shader , VkPipelineCache cache ,
+                uint32_t framesInFlight , PFN_vkCmdDrawIndexedIndirectCountKHR drawIndirectCount ,
+                VkDescriptorSetLayout heapLayout);
+    void Destroy();
+    bool Enabled() const { return m_Pipeline != VK_NULL_HANDLE; }
+    bool UsesDrawCount() const { return m_DrawIndirectCount != nullptr; }
+    //绘制可见物体的图形管线使用的布局，和场景的管线布局兼容：描述符集0是描述符堆(不使用时是空的描述符集)，
+    //描述符集1是实例缓冲和命令缓冲区；push constant的开头是DrawIndices，之后是实例各个流的起始位置
+    VkPipelineLayout DrawLayout() const { return m_DrawLayout; }
+
+    //物体数量变化后重新分配命令缓冲区，旧的交给删除队列
+    void Reserve(uint32_t capacity , DeletionQueue& deletionQueue , uint64_t serial);
+
+    //在等待过frameIndex的栅栏之后调用：累计这套帧资源上一次剔除的可见数量
+    void Collect(uint32_t frameIndex);
+
+    //在渲染流程之外录制：重置命令、剔除、把可见数量复制到回读缓冲。只用到计算和传输阶段
+    void RecordCull(VkCommandBuffer commandBuffer , uint32_t frameIndex , const CullInput& input ,
+                    const Frustum& frustum);
+    //接在RecordCull之后、录制在同一个命令缓冲中，把命令缓冲区交给graphicsFamily上的间接绘制和顶点着色器
+    void RecordRelease(VkCommandBuffer commandBuffer , uint32_t frameIndex , uint32_t computeFamily ,
+                       uint32_t        graphicsFamily) const;
+    //录制在图形命令缓冲中、渲染流程之前，参数和RecordRelease相同。同一个队列族时不录制任何命令
+    void RecordAcquire(VkCommandBuffer commandBuffer , uint32_t frameIndex , uint32_t computeFamily ,
+                       uint32_t        graphicsFamily) const;
+    //在渲染流程内录制，使用DrawLayout的管线、顶点/索引缓冲、描述符堆和DrawIndices由调用者设置，
+    //剔除的描述符集和流的起始位置由这里设置
+    void RecordDraw(VkCommandBuffer commandBuffer , uint32_t frameIndex) const;
+
+    uint32_t Capacity() const { return m_Capacity; }
+    uint32_t LastVisibleCount() const { return m_LastVisible; }
+    //例如"gpu culling: draw indirect count, 10000 objects, 2510.4 visible on average (25.1%) over 500 frames"
+    std::string Report() const;
+
+private:
+    static constexpr uint32_t     GroupSize   = 64; //和Cull.comp的local_size_x一致
+    static constexpr VkDeviceSize CommandBase = 16; //命令之前是绘制数量，和Cull.comp的Draws块一致
+    static constexpr VkDeviceSize VisibleBase = 48; //可见列表之前是计数、命令和填充，和Culled.vert的header一致
+
+    //命令缓冲区开头的VisibleBase字节，每帧剔除之前整段重写
+    struct DrawHeader
+    {
+        uint32_t                     drawCount  = 0;
+        uint32_t                     padding[3] = {};
+        VkDrawIndexedIndirectCommand command    = {};
+        uint32_t                     tail[3]    = {};
+    };
+    static_assert(offsetof(DrawHeader, command) == CommandBase && sizeof(DrawHeader) == VisibleBase);
+
+    //和Cull.comp的push constant块一致
+    struct PushConstants
+    {
+        float    planes[6][4];
+        uint32_t objectCount;
+        uint32_t offsetBase;
+        uint32_t transformBase;
+        float    meshRadius;
+    };
+
+    //和Culled.vert的push constant块一致，以32位字为单位，位于DrawIndices之后
+    struct DrawConstants
+    {
+        uint32_t offsetBase    = 0;
+        uint32_t transformBase = 0;
+        uint32_t colorBase     = 0;
+    };
+
+    VkDevice               m_Device    = VK_NULL_HANDLE;
+    DeviceMemoryAllocator* m_Allocator = nullptr;
+
+    UniqueDescriptorSetLayout    m_SetLayout;
+    UniqueDescriptorPool         m_DescriptorPool;
+    std::vector<VkDescriptorSet> m_Sets;
+    UniquePipelineLayout         m_PipelineLayout;
+    UniquePipeline               m_Pipeline;
+    UniquePipelineLayout         m_DrawLayout;
+    UniqueDescriptorSetLayout    m_EmptySetLayout; //没有描述符堆时占住描述符集0
+
+    PFN_vkCmdDrawIndexedIndirectCountKHR m_DrawIndirectCount = nullptr;
+
+    //一套帧资源最近一次剔除的状态
+    struct FrameState
+    {
+        uint32_t      objectCount = 0;
+        DrawConstants streams     = {};    //RecordDraw推送给Culled.vert
+        bool          pending     = false; //回读缓冲中有还没有累计的可见数量
+    };
+
+    uint32_t                m_Capacity = 0;
+    std::vector<GpuBuffer>  m_DrawBuffers; //每套帧资源一个
+    GpuBuffer               m_Readback;    //每套帧资源4字节
+    std::vector<FrameState> m_Frames;
+
+    uint32_t m_LastVisible  = 0;
+    uint64_t m_VisibleSum   = 0;
+    uint64_t m_ObjectSum    = 0;
+    uint64_t m_CulledFrames = 0;
+};
@@ -0,0 +1,148 @@
+﻿#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void GpuProfiler::Create(VkPhysicalDevice physicalDevice , VkDevice device , uint32_t queueFamily ,
+                         uint32_t         framesInFlight)
+{
+    m_Device = device;
+
+    //没有启用性能分析，或者队列不支持时间戳时，不创建查询池，所有调用都直接返回
+    if (!ENABLE_PROFILER || !Profiler::Enabled()) return;
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    uint32_t validBits = families[queueFamily].timestampValidBits;
+    if (validBits == 0) return;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    m_TimestampPeriod = properties.limits.timestampPeriod;
+    m_TimestampMask   = validBits >= 64 ? ~0ull : ( 1ull << validBits ) - 1;
+
+    VkQueryPoolCreateInfo poolInfo = {};
+    poolInfo.sType                 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType             = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount            = MaxScopesPerFrame * 2;
+
+    m_Frames.resize(framesInFlight);
+    for (auto& frame : m_Frames)
+    {
+        if (vkCreateQueryPool(m_Device, &poolInfo, nullptr, &frame.pool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("创建时间戳查询池失败");
+        }
+        frame.names.reserve(MaxScopesPerFrame);
+    }
+    m_Events.reserve(MaxEvents);
+}
+
+void GpuProfiler::Destroy()
+{
+    for (auto& frame : m_Frames)
+    {
+        vkDestroyQueryPool(m_Device, frame.pool, nullptr);
+    }
+    m_Frames.clear();
+    m_Current = nullptr;
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer , uint32_t frameIndex)
+{
+    if (m_Frames.empty()) return;
+
+    m_Current = &m_Frames[frameIndex];
+    Resolve(*m_Current);
+    vkCmdResetQueryPool(commandBuffer, m_Current->pool, 0, MaxScopesPerFrame * 2);
+}
+
+uint32_t GpuProfiler::BeginScope(VkCommandBuffer commandBuffer , const char* name)
+{
+    if (m_Current == nullptr || m_Current->names.size() == MaxScopesPerFrame) return UINT32_MAX;
+
+    auto scope = static_cast<uint32_t>(m_Current->names.size());
+    m_Current->names.push_back(name);
+    //TOP_OF_PIPE：之前的命令开始执行后就写入；和BOTTOM_OF_PIPE配合，区间覆盖其中命令的全部执行时间
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_Current->pool, scope * 2);
+    return scope;
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer , uint32_t scope)
+{
+    if (scope == UINT32_MAX) return;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_Current->pool, scope * 2 + 1);
+}
+
+void GpuProfiler::Submitted()
+{
+    if (m_Current == nullptr) return;
+    m_Current->submitNs  = Profiler::NowNs();
+    m_Current->submitted = true;
+}
+
+void GpuProfiler::ResolveAll()
+{
+    for (auto& frame : m_Frames)
+    {
+        Resolve(frame);
+    }
+}
+
+void GpuProfiler::Resolve(FrameQueries& frame)
+{
+    if (!frame.submitted || frame.names.empty())
+    {
+        frame.names.clear();
+        frame.submitted = false;
+        return;
+    }
+
+    uint64_t timestamps[MaxScopesPerFrame * 2];
+    auto     count  = static_cast<uint32_t>(frame.names.size() * 2);
+    VkResult result = vkGetQueryPoolResults(m_Device, frame.pool, 0, count, sizeof(timestamps), timestamps,
+                                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    //栅栏等待过后结果应当都可用；VK_NOT_READY时丢弃这一帧，绝不等待
+    if (result == VK_SUCCESS)
+    {
+        auto toNs = [this](uint64_t timestamp)
+        {
+            return static_cast<uint64_t>(static_cast<double>(timestamp & m_TimestampMask) * m_TimestampPeriod);
+        };
+
+        uint64_t firstNs = UINT64_MAX;
+        for (size_t i = 0; i < frame.names.size(); i++)
+        {
+            uint64_t startNs = toNs(timestamps[2 * i]);
+            uint64_t endNs   = std::max(startNs, toNs(timestamps[2 * i + 1]));
+            firstNs          = std::min(firstNs, startNs);
+
+            TraceEvent event = {frame.names[i], startNs, endNs - startNs, 0};
+            if (m_Events.size() < MaxEvents)
+            {
+                m_Events.push_back(event);
+            }
+            else
+            {
+                m_Events[m_NextEvent] = event;
+            }
+            m_NextEvent = ( m_NextEvent + 1 ) % MaxEvents;
+        }
+        m_OffsetNs = std::max(m_OffsetNs, static_cast<int64_t>(frame.submitNs) - static_cast<int64_t>(firstNs));
+    }
+
+    frame.names.clear();
+    frame.submitted = false;
+}
+
+std::vector<TraceEvent> GpuProfiler::Collect() const
+{
+    std::vector<TraceEvent> events = m_Events;
+    for (auto& event : events)
+    {
+        event.startNs = static_cast<uint64_t>(static_cast<int64_t>(event.startNs) + m_OffsetNs);
+    }
+    return events;
+}
@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "../Tool/Profiler.h"
+
+/*
+ * GPU时间戳性能分析。
+ * 每套帧资源一个查询池，命令缓冲中的区间前后各写一个时间戳。
+ * 读取结果放在同一套帧资源下一次录制的开头：这时它的栅栏已经等待过，结果一定可用，
+ * vkGetQueryPoolResults不带WAIT标志，不会让CPU等待GPU。
+ * GPU时间戳和CPU时钟没有共同的起点：每帧记录提交时的CPU时间，GPU开始执行一定晚于提交，
+ * 取所有帧中"提交时间 - 第一个时间戳"的最大值作为偏移，把GPU区间放到CPU时间线上。
+ */
+class GpuProfiler
+{
+public:
+    //每帧最多的GPU区间数
+    static constexpr uint32_t MaxScopesPerFrame = 64;
+    //保留最近的区间数，超过后覆盖最旧的
+    static constexpr size_t MaxEvents = 1u << 16;
+
+    void Create(VkPhysicalDevice physicalDevice , VkDevice device , uint32_t queueFamily , uint32_t framesInFlight);
+    void Destroy();
+
+    //在录制frameIndex这套帧资源的命令缓冲时，最先调用(渲染流程之外)：读取上一次的结果并重置查询
+    void BeginFrame(VkCommandBuffer commandBuffer , uint32_t frameIndex);
+    //返回区间编号，交给EndScope；未启用或本帧区间已满时返回UINT32_MAX
+    uint32_t BeginScope(VkCommandBuffer commandBuffer , const char* name);
+    void     EndScope(VkCommandBuffer commandBuffer , uint32_t scope);
+    //提交这一帧的命令缓冲后调用
+    void Submitted();
+
+    //设备空闲后调用，读取所有还没读取的结果
+    void ResolveAll();
+    //已读取的区间，时间已经换算到CPU时间线上
+    std::vector<TraceEvent> Collect() const;
+
+    bool Available() const { return !m_Frames.empty(); }
+
+private:
+    struct FrameQueries
+    {
+        VkQueryPool              pool = VK_NULL_HANDLE;
+        std::vector<const char*> names;
+        uint64_t                 submitNs  = 0;
+        bool                     submitted = false;
+    };
+
+    void Resolve(FrameQueries& frame);
+
+    VkDevice                  m_Device = VK_NULL_HANDLE;
+    double                    m_TimestampPeriod = 1.0; //一个时间戳单位对应的纳秒数
+    uint64_t                  m_TimestampMask   = ~0ull;
+    std::vector<FrameQueries> m_Frames;
+    FrameQueries*             m_Current = nullptr;
+
+    //已读取的区间，startNs是GPU时间，导出时加上m_OffsetNs
+    std::vector<TraceEvent> m_Events;
+    size_t                  m_NextEvent = 0;
+    int64_t                 m_OffsetNs  = INT64_MIN;
+};
+
+//GPU区间的作用域写法，区间的两个时间戳分别写在构造和析构时
+class GpuProfileScope
+{
+public:
+    GpuProfileScope(GpuProfiler& profiler , VkCommandBuffer commandBuffer , const char* name)
+        : m_Profiler(profiler) , m_CommandBuffer(commandBuffer) , m_Scope(profiler.BeginScope(commandBuffer, name))
+    {
+    }
+
+    ~GpuProfileScope() { m_Profiler.EndScope(m_CommandBuffer, m_Scope); }
+
+    GpuProfileScope(const GpuProfileScope&)            = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    GpuProfiler&    m_Profiler;
+    VkCommandBuffer m_CommandBuffer;
+    uint32_t        m_Scope;
+};
+
+#if ENABLE_PROFILER
+#define PROFILE_GPU_SCOPE(profiler , commandBuffer , name) \
+    GpuProfileScope PROFILER_CONCAT(gpuProfileScope, __LINE__)(profiler, commandBuffer, name)
+#else
+#define PROFILE_GPU_SCOPE(profiler , commandBuffer , name) ((void)0)
+#endif
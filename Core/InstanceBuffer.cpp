@@ -0,0 +1,72 @@
+﻿#include "InstanceBuffer.h"
+
+#include <cstring>
+#include <stdexcept>
+
+void InstanceBuffer::Create(DeviceMemoryAllocator&    allocator , uint32_t capacity , uint32_t framesInFlight ,
+                            std::span<const uint32_t> queueFamilies)
+{
+    m_Allocator = &allocator;
+    m_Capacity  = capacity;
+
+    //各个流按容量依次排列，每段都按16字节对齐
+    VkDeviceSize offset = 0;
+    for (uint32_t stream = 0; stream < InstanceData::StreamCount; stream++)
+    {
+        m_StreamOffsets[stream] = offset;
+        offset += ( VkDeviceSize(capacity) * InstanceData::StreamStride[stream] + 15 ) & ~VkDeviceSize(15);
+    }
+
+    AllocationCreateInfo allocInfo = {};
+    allocInfo.requiredFlags        = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    allocInfo.preferredFlags       = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    //同时作为存储缓冲，GPU剔除的计算着色器直接读取位置和变换
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+    m_Buffers.resize(framesInFlight);
+    for (auto& buffer : m_Buffers)
+    {
+        buffer = allocator.CreateBuffer(offset > 0 ? offset : 16, usage, allocInfo, queueFamilies);
+        if (buffer.allocation.mapped == nullptr)
+        {
+            throw std::runtime_error("实例缓冲没有映射到主机地址");
+        }
+    }
+}
+
+void InstanceBuffer::Destroy()
+{
+    for (auto& buffer : m_Buffers)
+    {
+        m_Allocator->DestroyBuffer(buffer);
+    }
+    m_Buffers.clear();
+    m_Capacity = 0;
+}
+
+void InstanceBuffer::Upload(uint32_t frameIndex , const InstanceData& instances)
+{
+    if (instances.Count() > m_Capacity)
+    {
+        throw std::runtime_error("实例数量超出实例缓冲的容量");
+    }
+
+    //SoA布局和GPU读取的布局相同，每个流一次memcpy
+    auto* mapped = static_cast<char*>(m_Buffers[frameIndex].allocation.mapped);
+    for (uint32_t stream = 0; stream < InstanceData::StreamCount; stream++)
+    {
+        auto kind = static_cast<InstanceData::Stream>(stream);
+        std::memcpy(mapped + m_StreamOffsets[stream], instances.StreamData(kind), instances.StreamBytes(kind));
+    }
+}
+
+void InstanceBuffer::Bind(VkCommandBuffer commandBuffer , uint32_t frameIndex , uint32_t firstBinding) const
+{
+    VkBuffer buffers[InstanceData::StreamCount];
+    for (auto& buffer : buffers)
+    {
+        buffer = m_Buffers[frameIndex].buffer;
+    }
+    vkCmdBindVertexBuffers(commandBuffer, firstBinding, InstanceData::StreamCount, buffers, m_StreamOffsets);
+}
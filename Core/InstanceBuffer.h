@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "DeviceMemoryAllocator.h"
+#include "InstanceData.h"
+
+/*
+ * GPU端的实例缓冲。每套帧资源一个缓冲，InstanceData的各个流在缓冲中首尾相接，
+ * 绑定时每个流用同一个VkBuffer加不同的偏移。
+ * 缓冲放在主机可见的一致性内存中(有设备本地且主机可见的内存时优先使用)，CPU直接memcpy写入，
+ * 不经过暂存缓冲：百万实例每帧约20MB，放进暂存环形缓冲再复制一遍只会多占一份带宽。
+ * 异步计算队列上的GPU剔除和图形队列都读取它，这时以并发共享模式创建：内容每帧由CPU重写，
+ * 两个队列都只读取，用所有权转移反而要在每帧的两次提交中各录制一次屏障。
+ */
+class InstanceBuffer
+{
+public:
+    //queueFamilies是读取实例缓冲的队列族，多于一个时以VK_SHARING_MODE_CONCURRENT创建
+    void Create(DeviceMemoryAllocator&    allocator , uint32_t capacity , uint32_t framesInFlight ,
+                std::span<const uint32_t> queueFamilies = {});
+    void Destroy();
+
+    //在等待过frameIndex这套帧资源的栅栏之后调用，GPU此时不再读取这个缓冲
+    void Upload(uint32_t frameIndex , const InstanceData& instances);
+    //绑定frameIndex的各个流，从firstBinding开始连续占用InstanceData::StreamCount个绑定
+    void Bind(VkCommandBuffer commandBuffer , uint32_t frameIndex , uint32_t firstBinding) const;
+
+    uint32_t Capacity() const { return m_Capacity; }
+    //GPU剔除以存储缓冲读取位置和变换流
+    VkBuffer     Buffer(uint32_t frameIndex) const { return m_Buffers[frameIndex].buffer; }
+    VkDeviceSize StreamOffset(InstanceData::Stream stream) const { return m_StreamOffsets[stream]; }
+
+private:
+    DeviceMemoryAllocator* m_Allocator = nullptr;
+    std::vector<GpuBuffer> m_Buffers;
+    uint32_t               m_Capacity  = 0;
+
+    //各个流在缓冲中的起始偏移
+    VkDeviceSize m_StreamOffsets[InstanceData::StreamCount] = {};
+};
@@ -0,0 +1,95 @@
+﻿#include "InstanceData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+void InstanceData::FillGrid(uint32_t count , float extent)
+{
+    m_Count = count;
+    m_Offsets.resize(size_t(count) * 2);
+    m_Transforms.resize(size_t(count) * 2);
+    m_Colors.resize(count);
+
+    //边长为ceil(sqrt(count))的网格，[-extent,extent]内每格宽2*extent/side。extent大于1时超出屏幕的实例可以被剔除
+    uint32_t side  = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count)))));
+    float    cell  = 2.0f * extent / static_cast<float>(side);
+    float    scale = cell * 0.5f;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t column = i % side;
+        uint32_t row    = i / side;
+        m_Offsets[2 * i]     = -extent + cell * ( static_cast<float>(column) + 0.5f );
+        m_Offsets[2 * i + 1] = -extent + cell * ( static_cast<float>(row) + 0.5f );
+
+        //每个实例起始角度不同，旋转起来不会整齐划一
+        float angle = static_cast<float>(i) * 0.618f;
+        m_Transforms[2 * i]     = std::cos(angle) * scale;
+        m_Transforms[2 * i + 1] = std::sin(angle) * scale;
+
+        //按网格位置渐变的颜色，alpha固定为255
+        uint32_t r  = column * 255 / side;
+        uint32_t g  = row * 255 / side;
+        uint32_t b  = 255 - ( r + g ) / 2;
+        m_Colors[i] = r | g << 8 | b << 16 | 0xFFu << 24;
+    }
+}
+
+void InstanceData::Rotate(float angle)
+{
+    //(c, s)看作复数，乘以(cos, sin)即旋转，缩放保持不变。循环体只有乘加，没有三角函数
+    float  c          = std::cos(angle);
+    float  s          = std::sin(angle);
+    float* transforms = m_Transforms.data();
+    for (size_t i = 0; i < m_Transforms.size(); i += 2)
+    {
+        float x           = transforms[i];
+        float y           = transforms[i + 1];
+        transforms[i]     = x * c - y * s;
+        transforms[i + 1] = x * s + y * c;
+    }
+}
+
+const void* InstanceData::StreamData(Stream stream) const
+{
+    switch (stream)
+    {
+    case Offset:
+        return m_Offsets.data();
+    case Transform:
+        return m_Transforms.data();
+    case Color:
+        return m_Colors.data();
+    default:
+        throw std::runtime_error("未知的实例数据流");
+    }
+}
+
+void InstanceData::AppendInputDesc(VertexInputDesc& desc , uint32_t firstBinding , uint32_t firstLocation)
+{
+    static constexpr VkFormat formats[StreamCount] = {
+        VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R8G8B8A8_UNORM
+    };
+
+    if (desc.bindingCount + StreamCount > VertexInputDesc::MaxBindings ||
+        desc.attributeCount + StreamCount > VertexInputDesc::MaxAttributes)
+    {
+        throw std::runtime_error("顶点输入绑定或属性数量超出上限");
+    }
+
+    for (uint32_t stream = 0; stream < StreamCount; stream++)
+    {
+        //inputRate为INSTANCE：每个实例前进一个stride，同一实例的所有顶点读到相同的值
+        VkVertexInputBindingDescription& binding = desc.bindings[desc.bindingCount++];
+        binding.binding                          = firstBinding + stream;
+        binding.stride                           = StreamStride[stream];
+        binding.inputRate                        = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+        //每个绑定只有一个属性，offset总是0
+        VkVertexInputAttributeDescription& attribute = desc.attributes[desc.attributeCount++];
+        attribute.binding                            = firstBinding + stream;
+        attribute.location                           = firstLocation + stream;
+        attribute.format                             = formats[stream];
+        attribute.offset                             = 0;
+    }
+}
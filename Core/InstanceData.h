@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "PipelineFactory.h"
+
+/*
+ * 逐实例数据，按结构数组(SoA)存放：每个属性一个连续数组(一个"流")，而不是每个实例一个结构体。
+ * 每个流对应实例缓冲中的一段和管线中的一个VK_VERTEX_INPUT_RATE_INSTANCE绑定，
+ * 内存布局和GPU读取的布局完全一致，上传时整段memcpy即可，不需要逐实例打包。
+ * CPU端逐属性更新(例如只改变旋转)时也只会访问这一个数组，缓存利用率高，循环也便于编译器向量化。
+ */
+class InstanceData
+{
+public:
+    enum Stream : uint32_t
+    {
+        Offset,    //屏幕上的位置，vec2
+        Transform, //旋转和缩放合成的二维向量(cos*scale, sin*scale)，vec2
+        Color,     //RGBA8，着色器中按unorm读取为vec4
+        StreamCount
+    };
+
+    //每个流中一个实例占用的字节数
+    static constexpr uint32_t StreamStride[StreamCount] = {2 * sizeof(float), 2 * sizeof(float), sizeof(uint32_t)};
+    //所有流加起来一个实例占用的字节数
+    static constexpr uint32_t InstanceBytes = StreamStride[Offset] + StreamStride[Transform] + StreamStride[Color];
+
+    //把count个实例排成铺满[-extent, extent]范围的网格，实例越多每个实例越小。extent为1时正好铺满屏幕
+    void FillGrid(uint32_t count , float extent = 1.0f);
+    //所有实例绕各自的中心旋转angle弧度
+    void Rotate(float angle);
+
+    uint32_t    Count() const { return m_Count; }
+    const void* StreamData(Stream stream) const;
+    size_t      StreamBytes(Stream stream) const { return size_t(m_Count) * StreamStride[stream]; }
+
+    //在desc后面追加实例属性：每个流占一个绑定(从firstBinding开始)，属性位置从firstLocation开始
+    static void AppendInputDesc(VertexInputDesc& desc , uint32_t firstBinding , uint32_t firstLocation);
+
+private:
+    uint32_t              m_Count = 0;
+    std::vector<float>    m_Offsets;    //x0 y0 x1 y1 ...
+    std::vector<float>    m_Transforms; //c0 s0 c1 s1 ...
+    std::vector<uint32_t> m_Colors;
+};
@@ -1,15 +1,55 @@
-#define GLFW_INCLUDE_VULKAN
+﻿#define GLFW_INCLUDE_VULKAN
 #include "MainLoop.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "DeviceCalibration.h"
+#include "EmbeddedShaders.h"
+#include "Vertex.h"
+#include "../Tool/Profiler.h"
+#include "../Tool/TaskGraph.h"
 #include "../Math/Math.h"
 
 
-constexpr uint32_t Width  = 800;
-constexpr uint32_t Height = 600;
+//三角形的顶点和索引，原先写死在顶点着色器中
+constexpr Vertex TriangleVertices[] = {
+    {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+    {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
+    {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
+};
+constexpr uint16_t TriangleIndices[] = {0, 1, 2};
+
+//实例直接以规范化设备坐标绘制，没有相机，视图投影矩阵是单位矩阵，剔除的视锥体就是裁剪空间的可见范围
+constexpr float SceneViewProjection[16] = {
+    1.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f,
+};
+
+//三角形绕原点旋转(UpdateGeometry)，包围球的半径是顶点到原点的最大距离
+static float TriangleRadius()
+{
+    float radius = 0.0f;
+    for (const Vertex& vertex : TriangleVertices)
+    {
+        radius = std::max(radius, std::hypot(vertex.position[0], vertex.position[1]));
+    }
+    return radius;
+}
+
+//无头模式下离屏图像的数量，和窗口模式下"minImageCount + 1"的三重缓冲保持一致
+constexpr uint32_t OffscreenImageCount = 3;
 
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
@@ -54,20 +94,59 @@ void DestroyDebugUtilsMessengerEXT(VkInstance                   instance ,
 }
 
 
+HelloTriangleApplication::HelloTriangleApplication(const AppConfig& config)
+    : m_Config(config)
+{
+    //尽早打开，InitVulkan的各个步骤也要计时
+    Profiler::SetEnabled(!m_Config.profilePath.empty());
+    Profiler::SetThreadName("Main");
+
+    //过滤条件在创建实例之前确定，格式错误的参数在这里就报错
+    m_ValidationLogger.SetFilter(ValidationLogger::ParseSeverity(m_Config.validationSeverity),
+                                 ValidationLogger::ParseTypes(m_Config.validationTypes));
+    m_ValidationLogger.SetRepeatLimit(m_Config.validationRepeatLimit);
+    m_PresentPolicy = ParsePresentPolicy(m_Config.presentPolicy);
+
+    //无头模式不创建交换链，也就不需要交换链扩展
+    if (!m_Config.headless)
+    {
+        m_DeviceExtensions = deviceExtensions;
+    }
+}
+
 void HelloTriangleApplication::run()
 {
-    InitWindow();
+    m_LaunchTime = std::chrono::steady_clock::now();
+    InitGlfw();
     InitVulkan();
-    MainLoop();
+    if (m_Config.benchmark.empty())
+    {
+        MainLoop();
+    }
+    else
+    {
+        RunBenchmark();
+    }
     CleanUp();
 }
 
 
-void HelloTriangleApplication::InitWindow()
+void HelloTriangleApplication::InitGlfw()
 {
+    //无头模式完全跳过GLFW，没有显示器的机器上glfwInit本身就会失败
+    if (m_Config.headless) return;
+
+    //glfwInit之后glfwGetRequiredInstanceExtensions才可用，所以它在任务图之外最先执行
     glfwInit();
+}
+
+void HelloTriangleApplication::InitWindow()
+{
+    PROFILE_SCOPE("InitWindow");
+    if (m_Config.headless) return;
+
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
     //glfwCreateWindow函数的前三个参数指定了要创建的窗口的宽度，高度和标题。
     //第四个参数用于指定在哪个显示器上打开窗口，最后一个参数与OpenGL相关，对我们没有意义。
@@ -76,55 +155,278 @@ void HelloTriangleApplication::InitWindow()
     {
         throw std::runtime_error("创建窗口失败");
     }
+
+    //帧节奏按主显示器的刷新率推算垂直同步的时刻，取不到时为0，不做即时开始
+    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+    if (monitor != nullptr)
+    {
+        const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+        m_RefreshHz             = mode != nullptr ? mode->refreshRate : 0.0;
+    }
+
+    //窗口尺寸改变时并不一定会收到VK_ERROR_OUT_OF_DATE_KHR，所以自己记录一下
+    glfwSetWindowUserPointer(m_Window, this);
+    glfwSetFramebufferSizeCallback(m_Window, FramebufferResizeCallback);
+}
+
+//新尺寸在重建交换链时由glfwGetFramebufferSize重新读取，这里只做标记
+void HelloTriangleApplication::FramebufferResizeCallback(GLFWwindow* window , int /*width*/ , int /*height*/)
+{
+    auto app                  = static_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+    app->m_FramebufferResized = true;
 }
 
 void HelloTriangleApplication::InitVulkan()
 {
-    CreateInstance();
-    CreateDebugMessenger();
-    CreateSurface();
-    ChoosePhysicalDevice();
-    CreateLogicalDevice();
-    CreateSwapChain();
-    CreateImageViews();
-    CreateRenderPass();
-    CreateGraphicsPipeline();
+    PROFILE_SCOPE("InitVulkan");
+
+    //启动步骤组成依赖图，互不依赖的步骤并发执行：读取SPIR-V、创建窗口与创建实例和设备同时进行，
+    //设备创建后分配器、着色器模块、管线缓存、交换链各自独立。GLFW的窗口函数只能在主线程调用，相应的步骤标记为主线程任务。
+    //步骤之间只通过依赖关系同步，同一成员不会被两个可能并发的步骤同时写入
+    TaskGraph graph;
+    auto      code      = graph.Add("LoadShaderCode", [this]() { LoadShaderCode(); });
+    auto      window    = graph.Add("InitWindow", [this]() { InitWindow(); }, {}, true);
+    auto      instance  = graph.Add("CreateInstance", [this]() { CreateInstance(); });
+    //创建调试信使要求外部同步实例，所以在它完成之前不创建表面
+    auto      messenger = graph.Add("CreateDebugMessenger", [this]() { CreateDebugMessenger(); }, {instance});
+    auto      surface   = graph.Add("CreateSurface", [this]() { CreateSurface(); }, {window, messenger}, true);
+    auto      physical  = graph.Add("ChoosePhysicalDevice", [this]() { ChoosePhysicalDevice(); }, {surface});
+    auto      device    = graph.Add("CreateLogicalDevice", [this]() { CreateLogicalDevice(); }, {physical});
+
+    auto allocator = graph.Add("CreateAllocator", [this]()
+    {
+        m_Allocator.Create(m_PhysicalDevice, m_Device);
+    }, {device});
+    graph.Add("CreateGpuProfiler", [this]()
+    {
+        m_GpuProfiler.Create(m_PhysicalDevice, m_Device, m_Queues.graphics.family, m_Config.framesInFlight);
+    }, {device});
+    auto modules = graph.Add("CreateShaderModules", [this]() { CreateShaderModules(); }, {device, code});
+    auto heap    = graph.Add("CreateDescriptorHeap", [this]() { CreateDescriptorHeap(); }, {device});
+    auto cache   = graph.Add("CreatePipelineCache", [this]()
+    {
+        m_PipelineCache.Create(m_PhysicalDevice, m_Device, m_Config.pipelineCachePath);
+        m_PipelineCompiler = std::make_unique<PipelineCompiler>(m_Device, m_PipelineCache.Get(),
+                                                                m_Config.compileThreads != 0
+                                                                    ? m_Config.compileThreads
+                                                                    : ThreadPool::DefaultThreadCount());
+    }, {device});
+
+    //交换链的尺寸取自glfwGetFramebufferSize，只能在主线程调用；无头模式下离屏图像由分配器分配
+    auto swapChain = graph.Add("CreateSwapChain", [this]()
+    {
+        CreateSwapChain();
+        m_FramePacer.Configure(m_PresentPolicy, m_RefreshHz, m_Config.targetFps, m_PresentWaitEnabled);
+    }, {device, allocator}, true);
+    auto imageViews = graph.Add("CreateImageViews", [this]() { CreateImageViews(); }, {swapChain});
+    auto renderPass = graph.Add("CreateRenderGraph", [this]() { CreateRenderGraph(); }, {swapChain});
+    //剔除管线和图形管线一样使用管线缓存；GPU剔除的图形管线使用剔除器的管线布局，其中包含描述符堆的布局
+    auto culler     = graph.Add("CreateGpuCuller", [this]() { CreateGpuCuller(); }, {allocator, modules, cache, heap});
+    auto pipelines  = graph.Add("CreateGraphicsPipeline", [this]() { CreateGraphicsPipeline(); },
+                                {renderPass, modules, cache, heap, culler});
+    graph.Add("CreateFramebuffers", [this]() { CreateFramebuffers(); }, {imageViews, renderPass, allocator});
+    graph.Add("CreateFrameResources", [this]()
+    {
+        CreateFrameResources();
+        if (m_Config.recordThreads > 0)
+        {
+            m_Recorder.Create(m_Device, m_Queues.graphics.family, m_Config.framesInFlight, m_Config.recordThreads);
+        }
+    }, {swapChain});
+    auto geometry = graph.Add("CreateGeometryBuffers", [this]() { CreateGeometryBuffers(); }, {allocator, heap});
+    //默认纹理只在场景使用Textured.frag时创建，经暂存环形缓冲上传；同时运行的步骤都不写暂存环形缓冲
+    graph.Add("CreateDefaultTexture", [this]() { CreateDefaultTexture(); }, {geometry, modules});
+    graph.Add("CreateTextureStreamer", [this]() { CreateTextureStreamer(); }, {geometry});
+    graph.Add("CreateInstances", [this]() { CreateInstances(m_Config.instanceCount); }, {allocator, culler});
+
+    //同一时刻最多只有四五个步骤可以并发，线程池只在启动期间存在
+    ThreadPool startupPool(std::min(ThreadPool::DefaultThreadCount(), 4u));
+    graph.Run(startupPool);
+    m_StartupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_LaunchTime).count();
+
+    //冷启动(没有可用的缓存)和热启动的管线创建耗时对比，就是管线缓存节省的时间
+    std::cout << graph.Report();
+    std::cout << "startup: " << m_StartupMs << " ms, pipelines: " << graph.DurationMs(pipelines) << " ms ("
+            << ( m_PipelineCache.IsWarm() ? "warm" : "cold" ) << " pipeline cache)\n";
 }
 
 void HelloTriangleApplication::MainLoop()
 {
-    while (!glfwWindowShouldClose(m_Window))
+    uint64_t renderedFrames = 0;
+    while (!ShouldClose(renderedFrames))
+    {
+        if (m_Window != nullptr)
+        {
+            glfwPollEvents();
+
+            //最小化时帧缓冲尺寸为0，无法创建交换链，等待窗口恢复
+            int width  = 0;
+            int height = 0;
+            glfwGetFramebufferSize(m_Window, &width, &height);
+            if (width == 0 || height == 0)
+            {
+                glfwWaitEvents();
+                continue;
+            }
+        }
+        DrawFrame();
+        renderedFrames++;
+        if (renderedFrames == 1)
+        {
+            //从run()开始到第一帧提交呈现，包括GLFW初始化和整个启动任务图
+            double firstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                             m_LaunchTime).count();
+            std::cout << "time to first frame: " << firstFrameMs << " ms (startup " << m_StartupMs << " ms)\n";
+        }
+
+        m_FrameTimer.Tick();
+        if (m_FrameTimer.HasReport())
+        {
+            std::string report = "Vulkan | " + std::to_string(m_Config.framesInFlight) + " frames in flight | " +
+                    m_FrameTimer.Report();
+            if (m_Window != nullptr)
+            {
+                glfwSetWindowTitle(m_Window, report.c_str());
+            }
+            std::cout << report << '\n';
+        }
+    }
+
+    //退出循环时GPU可能还在执行最后几帧，必须等它们完成后才能开始清理
+    vkDeviceWaitIdle(m_Device);
+    std::cout << "Summary: " << m_FrameTimer.Summary() << '\n';
+}
+
+bool HelloTriangleApplication::ShouldClose(uint64_t renderedFrames)
+{
+    if (m_Config.frameCount != 0 && renderedFrames >= m_Config.frameCount)
     {
-        glfwPollEvents();
+        return true;
     }
+    return m_Window != nullptr && glfwWindowShouldClose(m_Window);
 }
 
 void HelloTriangleApplication::CleanUp()
 {
-    vkDestroyPipeline(m_Device, m_GraphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(m_Device, m_PipelineLayout, nullptr);
-    vkDestroyRenderPass(m_Device, m_RenderPass, nullptr);
+    //最后几帧的时间戳还没有读取，设备空闲后一次读完
+    if (!m_Config.profilePath.empty())
+    {
+        m_GpuProfiler.ResolveAll();
+        if (Profiler::WriteChromeTrace(m_Config.profilePath, m_GpuProfiler.Collect()))
+        {
+            std::cout << "profile: trace written to " << m_Config.profilePath << '\n';
+        }
+        else
+        {
+            std::cerr << "profile: failed to write " << m_Config.profilePath << '\n';
+        }
+    }
+    m_GpuProfiler.Destroy();
+
+    //设备已经空闲，延迟销毁的对象全部可以销毁了
+    size_t deferred = m_DeletionQueue.FlushAll();
+    std::cout << "deletion queue: " << m_DeletionQueue.DestroyedCount() << " deferred destructions, " << deferred
+            << " flushed at shutdown\n";
 
-    for (auto imageView : m_ImageViews)
+    //销毁命令池时会一并释放从中分配的命令缓冲
+    m_Recorder.Destroy();
+    m_Frames.clear();
+    m_ImagesInFlight.clear();
+    m_RenderFinished.clear();
+
+    if (!m_Config.headless)
+    {
+        std::cout << "present: " << PresentPolicyName(m_PresentPolicy) << " (" << PresentModeName(m_PresentMode)
+                << "), " << m_FramePacer.Report() << '\n';
+    }
+    if (m_RecreateCount > 0)
     {
-        vkDestroyImageView(m_Device, imageView, nullptr);
+        std::cout << "swapchain: recreated " << m_RecreateCount << " times, " << m_RecreateMs / m_RecreateCount
+                << " ms on average\n";
     }
 
-    if (enableValidationLayers)
+    //先等后台编译任务全部结束，它们还在使用着色器模块和管线缓存
+    m_PipelineCompiler.reset();
+
+    //把本次运行编译过的管线写回磁盘，下次启动直接复用
+    m_PipelineCache.Save();
+    m_PipelineCache.Destroy();
+
+    uint32_t variantGroups = m_GpuCuller.Enabled() ? 3 : 2;
+    std::cout << "pipeline variants: " << m_SceneVariant.Name() << ", "
+            << variantGroups * VariantKey::PermutationCount() << " possible\n" << m_PipelineStates.Report();
+    m_PipelineStates.Destroy();
+    //流送的纹理要在描述符堆、暂存环形缓冲和分配器之前销毁
+    if (m_TextureStreamer.Enabled())
+    {
+        std::cout << m_TextureStreamer.Report();
+    }
+    m_TextureStreamer.Destroy();
+    if (m_GpuCuller.Enabled())
+    {
+        std::cout << m_GpuCuller.Report();
+    }
+    m_GpuCuller.Destroy();
+    m_ShaderModules.Destroy();
+    m_PipelineLayout.Reset();
+    if (m_DescriptorHeap.Enabled())
+    {
+        std::cout << m_DescriptorHeap.Report();
+    }
+    m_DescriptorHeap.Destroy();
+    m_DefaultSampler.Reset();
+    m_DefaultTextureView.Reset();
+    m_DefaultTexture.Reset();
+    m_Allocator.Free(m_DefaultTextureMemory);
+    for (auto& table : m_TextureTables)
+    {
+        m_Allocator.DestroyBuffer(table);
+    }
+    m_TextureTables.clear();
+    m_RenderGraph.Destroy();
+    m_ImageViews.clear();
+
+    //离屏图像由我们自己创建，交换链图像则由交换链负责销毁
+    m_OffscreenImages.clear();
+    for (auto& memory : m_OffscreenMemory)
+    {
+        m_Allocator.Free(memory);
+    }
+    m_OffscreenMemory.clear();
+    m_SwapChainImages.clear();
+
+    m_InstanceBuffer.Destroy();
+    m_Allocator.DestroyBuffer(m_IndexBuffer);
+    for (auto& vertexBuffer : m_VertexBuffers)
     {
-        DestroyDebugUtilsMessengerEXT(m_Instance, m_Messenger, nullptr);
+        m_Allocator.DestroyBuffer(vertexBuffer);
+    }
+    std::cout << "staging ring: " << m_StagingRing.UploadedBytes() / 1048576.0 << " MB in "
+            << m_StagingRing.UploadCount() << " uploads, " << m_StagingRing.RejectedCount() << " rejected\n";
+    m_StagingRing.Destroy();
+
+    std::cout << m_Allocator.Report();
+    m_Allocator.Destroy();
+
+    //设备级对象全部销毁之后才能销毁设备；交换链要在表面之前销毁，表面和校验层回调要在实例之前销毁
+    m_SwapChain.Reset();
+    m_Device.Reset();
+    m_Surface.Reset();
+    m_Messenger.Reset();
+    m_Instance.Reset();
+    if (m_Window != nullptr)
+    {
+        glfwDestroyWindow(m_Window);
+        glfwTerminate();
     }
 
-    vkDestroySwapchainKHR(m_Device, m_SwapChain, nullptr);
-    vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
-    vkDestroyInstance(m_Instance, nullptr);
-    vkDestroyDevice(m_Device, nullptr);
-    glfwDestroyWindow(m_Window);
-    glfwTerminate();
+    //实例销毁之后不会再有校验消息，输出剩余的消息和汇总
+    m_ValidationLogger.Stop();
 }
 
 void HelloTriangleApplication::CreateInstance()
 {
+    PROFILE_SCOPE("CreateInstance");
     if (enableValidationLayers && !CheckValidationLayerSupport())
     {
         throw std::runtime_error("使用了不被支持的校验层");
@@ -138,11 +440,20 @@ void HelloTriangleApplication::CreateInstance()
     //创建信息
     //这个结构体是创建一个Vulkan实例时必须填写的信息。
     //它告诉Vulkan的驱动程序需要使用的全局扩展和校验层。全局是指这里的设置对于整个应用程序都有效，而不仅仅对一个设备有效。
-    VkInstanceCreateInfo createInfo = {};
-    HandleCreateInfo(appInfo, createInfo);
+    //扩展列表和校验层回调的创建信息被createInfo引用，要活到vkCreateInstance返回
+    std::vector<const char*>           extensions      = GetRequiredExtensions();
+    VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo = {};
+    VkInstanceCreateInfo               createInfo      = {};
+    HandleCreateInfo(appInfo, extensions, debugCreateInfo, createInfo);
+
+    //实例创建和销毁期间的校验消息也经过m_ValidationLogger，后台线程要在这之前启动
+    if (enableValidationLayers)
+    {
+        m_ValidationLogger.Start();
+    }
 
     //创建实例
-    VkResult result = vkCreateInstance(&createInfo, nullptr, &m_Instance);
+    VkResult result = m_Instance.Create(vkCreateInstance, createInfo);
     if (result != VK_SUCCESS)
     {
         throw std::runtime_error("创建实例失败");
@@ -159,18 +470,19 @@ void HelloTriangleApplication::HandleAppInfo(VkApplicationInfo& appInfo)
     appInfo.apiVersion         = VK_API_VERSION_1_0;
 }
 
-void HelloTriangleApplication::HandleCreateInfo(const VkApplicationInfo& appInfo , VkInstanceCreateInfo& createInfo)
+void HelloTriangleApplication::HandleCreateInfo(const VkApplicationInfo&          appInfo ,
+                                                const std::vector<const char*>&     extensions ,
+                                                VkDebugUtilsMessengerCreateInfoEXT& debugCreateInfo ,
+                                                VkInstanceCreateInfo&               createInfo)
 {
     createInfo.sType            = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     createInfo.pApplicationInfo = &appInfo;
 
-    //将所需的拓展封装进getRequiredExtensions
-    auto glfwExtensions                = GetRequiredExtensions();
-    createInfo.enabledExtensionCount   = static_cast<uint32_t>(glfwExtensions.size());
-    createInfo.ppEnabledExtensionNames = glfwExtensions.data();
+    //所需的拓展由GetRequiredExtensions给出
+    createInfo.enabledExtensionCount   = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     //校验层信息
-    VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
     if (enableValidationLayers)
     {
         createInfo.enabledLayerCount   = static_cast<uint32_t>(validationLayers.size());
@@ -238,12 +550,16 @@ std::vector<const char*> HelloTriangleApplication::GetRequiredExtensions()
 {
     //Vulkan是平台无关的API，所以需要一个和窗口系统交互的扩展。
     //我们通过GLFW库里的glfwGetRequiredInstanceExtensions返回Vulkan所需的扩展。
-    uint32_t     glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    //无头模式不和窗口系统交互，不需要这些扩展
+    std::vector<const char*> extensions;
+    if (!m_Config.headless)
+    {
+        uint32_t     glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-    std::vector<const char*> extensions(glfwExtensions,
-                                        glfwExtensions + glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     //启用校验层所需的拓展
     if (enableValidationLayers)
@@ -252,30 +568,58 @@ std::vector<const char*> HelloTriangleApplication::GetRequiredExtensions()
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
     }
 
+    //实例版本是1.0，查询present wait、描述符索引的设备特性需要vkGetPhysicalDeviceFeatures2KHR，
+    //设备校准的缓存键(deviceUUID)还需要VK_KHR_external_memory_capabilities定义的VkPhysicalDeviceIDProperties。
+    //这两个扩展都是可选的，无头模式同样需要
+    uint32_t extensionCount = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> available(extensionCount);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, available.data());
+    bool hasExternalMemoryCapabilities = false;
+    for (const auto& extension : available)
+    {
+        if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+        {
+            m_HasPhysicalDeviceProperties2 = true;
+        }
+        else if (strcmp(extension.extensionName, VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME) == 0)
+        {
+            hasExternalMemoryCapabilities = true;
+        }
+    }
+    if (m_HasPhysicalDeviceProperties2)
+    {
+        extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        if (hasExternalMemoryCapabilities)
+        {
+            extensions.push_back(VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME);
+            m_HasDeviceIdProperties = true;
+        }
+    }
+
     return extensions;
 }
 
 void HelloTriangleApplication::HandleCreateInfo_DebugMessager(VkDebugUtilsMessengerCreateInfoEXT& createInfo)
 {
+    //只订阅启动时配置的级别和类型：没订阅的消息校验层根本不会格式化。
+    //运行时还可以通过m_ValidationLogger.SetFilter进一步收窄
     createInfo.sType           = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-    createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
-            VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
-            VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-    createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
-            VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
-            VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    createInfo.messageSeverity = m_ValidationLogger.Severities();
+    createInfo.messageType     = m_ValidationLogger.Types();
     createInfo.pfnUserCallback = DebugCallback;
-    createInfo.pUserData       = nullptr;
+    createInfo.pUserData       = &m_ValidationLogger;
 }
 
 void HelloTriangleApplication::CreateDebugMessenger()
 {
+    PROFILE_SCOPE("CreateDebugMessenger");
     if (!enableValidationLayers) return;
 
     VkDebugUtilsMessengerCreateInfoEXT createInfo = {};
     HandleCreateInfo_DebugMessager(createInfo);
 
-    CreateDebugUtilsMessengerEXT(m_Instance, &createInfo, nullptr, &m_Messenger);
+    m_Messenger.Create(m_Instance, CreateDebugUtilsMessengerEXT, createInfo);
 }
 
 /*
@@ -328,20 +672,28 @@ VKAPI_ATTR VkBool32 VKAPI_CALL HelloTriangleApplication::DebugCallback
     void*                                       pUserData
 )
 {
-    std::cerr << "validation layer: " << pCallbackData->pMessage << '\n';
+    //回调运行在调用Vulkan函数的线程上，这里只过滤、计数和入队，输出由后台线程完成
+    static_cast<ValidationLogger*>(pUserData)->Push(messageSeverity, messageType, pCallbackData);
     return VK_FALSE;
 }
 
 void HelloTriangleApplication::CreateSurface()
 {
-    if (glfwCreateWindowSurface(m_Instance, m_Window, nullptr, &m_Surface) != VK_SUCCESS)
+    PROFILE_SCOPE("CreateSurface");
+    //无头模式没有窗口表面，m_Surface保持为VK_NULL_HANDLE
+    if (m_Config.headless) return;
+
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    if (glfwCreateWindowSurface(m_Instance, m_Window, nullptr, &surface) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create window surface!");
     }
+    m_Surface.Reset(m_Instance, surface);
 }
 
 void HelloTriangleApplication::ChoosePhysicalDevice()
 {
+    PROFILE_SCOPE("ChoosePhysicalDevice");
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(m_Instance, &deviceCount, nullptr);
     if (deviceCount == 0)
@@ -363,13 +715,24 @@ void HelloTriangleApplication::ChoosePhysicalDevice()
 
 void HelloTriangleApplication::ChooseBestDevice(std::vector<VkPhysicalDevice> devices)
 {
-    //可以通过计算每张显卡的分数来选择最适合的显卡
-    int maxScore = 0;
+    std::vector<VkPhysicalDevice> candidates;
     for (auto device : devices)
     {
-        if (!CheckPhysicsDevice(device))
-            continue;
+        if (CheckPhysicsDevice(device))
+            candidates.push_back(device);
+    }
+
+    //只有一个候选设备时不需要校准
+    if (m_Config.calibrateDevices && candidates.size() > 1)
+    {
+        ChooseCalibratedDevice(candidates);
+        if (m_PhysicalDevice != VK_NULL_HANDLE) return;
+    }
 
+    //可以通过计算每张显卡的分数来选择最适合的显卡
+    int maxScore = 0;
+    for (auto device : candidates)
+    {
         int score = CalculateScore(device);
         if (score > maxScore)
         {
@@ -379,6 +742,51 @@ void HelloTriangleApplication::ChooseBestDevice(std::vector<VkPhysicalDevice> de
     }
 }
 
+//按实测的分数选择设备。全部设备的测试都失败时m_PhysicalDevice保持为空，由调用者退回CalculateScore
+void HelloTriangleApplication::ChooseCalibratedDevice(const std::vector<VkPhysicalDevice>& candidates)
+{
+    PROFILE_SCOPE("CalibrateDevices");
+    DeviceCalibration calibration;
+    calibration.Load(m_Config.calibrationPath);
+
+    PFN_vkGetPhysicalDeviceProperties2KHR getProperties2 = nullptr;
+    if (m_HasDeviceIdProperties)
+    {
+        getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(
+            m_Instance, "vkGetPhysicalDeviceProperties2KHR");
+    }
+
+    double bestScore = 0.0;
+    for (auto device : candidates)
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+
+        DeviceScore score;
+        bool        measured = false;
+        try
+        {
+            score = calibration.Score(device, DeviceCalibration::DeviceKey(device, getProperties2), measured);
+        }
+        catch (const std::exception& error)
+        {
+            std::cout << "device calibration: " << properties.deviceName << " failed (" << error.what() << ")\n";
+            continue;
+        }
+
+        std::cout << "device calibration: " << properties.deviceName << ": copy " << score.copyGBps
+                << " GB/s, compute " << score.computeGflops << " GFLOPS, fill " << score.fillGpixels
+                << " Gpixel/s, score " << score.Total() << (measured ? " (measured)" : " (cached)") << '\n';
+        if (score.Total() > bestScore)
+        {
+            bestScore        = score.Total();
+            m_PhysicalDevice = device;
+        }
+    }
+
+    calibration.Save();
+}
+
 int HelloTriangleApplication::CalculateScore(VkPhysicalDevice device)
 {
     //详细的设备信息：名称，类型和支持的Vulkan版本等
@@ -417,38 +825,13 @@ bool HelloTriangleApplication::CheckPhysicsDevice(VkPhysicalDevice device)
 {
     return CheckQueueFamilies(device) &&
             CheckDeviceExtensionSupport(device) &&
-            CheckSwapChainSupport(device);
-}
-
-int HelloTriangleApplication::GetQueueFamiliesIndex(VkPhysicalDevice device , VkQueueFlagBits queueFlags)
-{
-    uint32_t queueFamilyCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-
-    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
-
-    int i = 0;
-    for (const auto& queueFamily : queueFamilies)
-    {
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface, &presentSupport);
-        //既有图像能力，又有呈现支持
-        if (queueFamily.queueCount > 0 && ( queueFamily.queueFlags & queueFlags ) && presentSupport)
-        {
-            return i;
-        }
-        i++;
-    }
-    return -1;
+            ( m_Config.headless || CheckSwapChainSupport(device) );
 }
 
-
-//检查设备有没有所需的队列族
+//检查设备有没有所需的队列族：至少要有图形队列族和呈现队列族(可以是同一个)
 bool HelloTriangleApplication::CheckQueueFamilies(VkPhysicalDevice device)
 {
-    int index = GetQueueFamiliesIndex(device, VK_QUEUE_GRAPHICS_BIT);
-    return index != -1;
+    return QueueTopology::Discover(device, m_Surface).IsComplete();
 }
 
 //检查设备有没有所需的拓展
@@ -460,7 +843,7 @@ bool HelloTriangleApplication::CheckDeviceExtensionSupport(VkPhysicalDevice devi
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> tempSet = {deviceExtensions.begin(), deviceExtensions.end()};
+    std::set<std::string> tempSet = {m_DeviceExtensions.begin(), m_DeviceExtensions.end()};
     for (const auto& extension : availableExtensions)
     {
         tempSet.erase(extension.extensionName);
@@ -469,6 +852,129 @@ bool HelloTriangleApplication::CheckDeviceExtensionSupport(VkPhysicalDevice devi
     return tempSet.empty();
 }
 
+//选中的物理设备是否支持全部的可选扩展
+bool HelloTriangleApplication::HasDeviceExtensions(std::set<std::string> required)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions)
+    {
+        required.erase(extension.extensionName);
+    }
+    return required.empty();
+}
+
+//检查所选设备是否支持present id和present wait：两个设备扩展，以及对应的两个设备特性
+bool HelloTriangleApplication::CheckPresentWaitSupport()
+{
+    if (m_Config.headless || !m_HasPhysicalDeviceProperties2) return false;
+    if (!HasDeviceExtensions({VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME})) return false;
+
+    auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+        m_Instance, "vkGetPhysicalDeviceFeatures2KHR");
+    if (getFeatures2 == nullptr) return false;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+    presentWaitFeatures.sType                                  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+    presentIdFeatures.sType                                = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    presentIdFeatures.pNext                                = &presentWaitFeatures;
+
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType                     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext                     = &presentIdFeatures;
+    getFeatures2(m_PhysicalDevice, &features);
+
+    return presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE;
+}
+
+//无绑定描述符堆需要的描述符索引特性，支持时记录要启用的特性和按设备上限截断的堆容量
+bool HelloTriangleApplication::CheckDescriptorIndexingSupport()
+{
+    if (m_Config.bindlessTextures == 0 || !m_HasPhysicalDeviceProperties2) return false;
+    //VK_EXT_descriptor_indexing依赖VK_KHR_maintenance3
+    if (!HasDeviceExtensions({VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, VK_KHR_MAINTENANCE_3_EXTENSION_NAME}))
+    {
+        return false;
+    }
+
+    auto getFeatures2   = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+        m_Instance, "vkGetPhysicalDeviceFeatures2KHR");
+    auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(
+        m_Instance, "vkGetPhysicalDeviceProperties2KHR");
+    if (getFeatures2 == nullptr || getProperties2 == nullptr) return false;
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {};
+    supported.sType                                         = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType                     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext                     = &supported;
+    getFeatures2(m_PhysicalDevice, &features);
+
+    //描述符数组、部分绑定、缓冲和纹理的update-after-bind是必需的
+    if (supported.runtimeDescriptorArray != VK_TRUE || supported.descriptorBindingPartiallyBound != VK_TRUE ||
+        supported.descriptorBindingUpdateUnusedWhilePending != VK_TRUE ||
+        supported.descriptorBindingSampledImageUpdateAfterBind != VK_TRUE ||
+        supported.descriptorBindingStorageBufferUpdateAfterBind != VK_TRUE)
+    {
+        return false;
+    }
+
+    //同一次绘制中不同像素使用不同纹理时需要非一致索引(nonuniformEXT)，支持就启用
+    auto& enabled                                         = m_IndexingFeatures;
+    enabled                                               = {};
+    enabled.sType                                         = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    enabled.runtimeDescriptorArray                        = VK_TRUE;
+    enabled.descriptorBindingPartiallyBound               = VK_TRUE;
+    enabled.descriptorBindingUpdateUnusedWhilePending     = VK_TRUE;
+    enabled.descriptorBindingSampledImageUpdateAfterBind  = VK_TRUE;
+    enabled.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    enabled.shaderSampledImageArrayNonUniformIndexing     = supported.shaderSampledImageArrayNonUniformIndexing;
+    enabled.shaderStorageBufferArrayNonUniformIndexing    = supported.shaderStorageBufferArrayNonUniformIndexing;
+
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT limits = {};
+    limits.sType                                           = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+    VkPhysicalDeviceProperties2KHR properties = {};
+    properties.sType                          = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+    properties.pNext                          = &limits;
+    getProperties2(m_PhysicalDevice, &properties);
+
+    DescriptorHeapCapacity desired = {};
+    desired.storageBuffers         = DescriptorHeap::DefaultBufferCapacity;
+    desired.sampledImages          = m_Config.bindlessTextures;
+    desired.samplers               = DescriptorHeap::DefaultSamplerCapacity;
+    m_BindlessCapacity             = DescriptorHeap::ClampCapacity(desired, limits);
+    return m_BindlessCapacity.sampledImages > 0 && m_BindlessCapacity.storageBuffers > 0 &&
+           m_BindlessCapacity.samplers > 0;
+}
+
+//扩展动态状态：设备扩展VK_EXT_extended_dynamic_state和同名的设备特性
+bool HelloTriangleApplication::CheckExtendedDynamicStateSupport()
+{
+    if (!m_HasPhysicalDeviceProperties2) return false;
+    if (!HasDeviceExtensions({VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME})) return false;
+
+    auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+        m_Instance, "vkGetPhysicalDeviceFeatures2KHR");
+    if (getFeatures2 == nullptr) return false;
+
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures = {};
+    dynamicStateFeatures.sType                                           = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType                     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext                     = &dynamicStateFeatures;
+    getFeatures2(m_PhysicalDevice, &features);
+
+    return dynamicStateFeatures.extendedDynamicState == VK_TRUE;
+}
+
 SwapChainSupportDetails HelloTriangleApplication::GetSwapChainDetails(VkPhysicalDevice device)
 {
     SwapChainSupportDetails details = {};
@@ -528,25 +1034,9 @@ VkSurfaceFormatKHR HelloTriangleApplication::ChooseSwapSurfaceFormat(
 VkPresentModeKHR HelloTriangleApplication::ChooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> availablePresentModes)
 {
-    VkPresentModeKHR bestMode = VK_PRESENT_MODE_FIFO_KHR;
-
-    for (const auto& availablePresentMode : availablePresentModes)
-    {
-        // VK_PRESENT_MODE_MAILBOX_KHR三重缓冲，是最好的
-        // > VK_PRESENT_MODE_IMMEDIATE_KHR立即显示 
-        // > VK_PRESENT_MODE_FIFO_KHR类似垂直同步（许多驱动程序对VK_PRESENT_MODE_FIFO_KHR呈现模式的支持不够好）
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
-        {
-            bestMode = availablePresentMode;
-            break;
-        }
-        if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR && bestMode != VK_PRESENT_MODE_MAILBOX_KHR)
-        {
-            bestMode = availablePresentMode;
-        }
-    }
-
-    return bestMode;
+    //原先固定按MAILBOX > IMMEDIATE > FIFO选择，现在由呈现策略决定，见ChoosePresentMode
+    m_PresentMode = ChoosePresentMode(m_PresentPolicy, availablePresentModes);
+    return m_PresentMode;
 }
 
 VkExtent2D HelloTriangleApplication::ChooseSwapResolution(const VkSurfaceCapabilitiesKHR& capabilities)
@@ -557,58 +1047,165 @@ VkExtent2D HelloTriangleApplication::ChooseSwapResolution(const VkSurfaceCapabil
     {
         return capabilities.currentExtent;
     }
+    //窗口可以改变尺寸，以帧缓冲当前的像素尺寸为准(高DPI屏幕上和窗口坐标的尺寸不同)
+    int width  = 0;
+    int height = 0;
+    glfwGetFramebufferSize(m_Window, &width, &height);
+
     VkExtent2D actualExtent;
 
     //关于我只在这个文件里使用std::clamp会出现识别不到的情况，花了一个小时无法解决，所以不得不自己大无语手写Clamp函数这件事😅
-    actualExtent.width  = Math::Clamp(Width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
-    actualExtent.height = Math::Clamp(Height, capabilities.minImageExtent.height,
+    actualExtent.width = Math::Clamp(static_cast<uint32_t>(width), capabilities.minImageExtent.width,
+                                     capabilities.maxImageExtent.width);
+    actualExtent.height = Math::Clamp(static_cast<uint32_t>(height), capabilities.minImageExtent.height,
                                       capabilities.maxImageExtent.height);
     return actualExtent;
 }
 
 void HelloTriangleApplication::CreateLogicalDevice()
 {
-    //创建逻辑设备需要先创建队列
-    VkDeviceQueueCreateInfo queueCreateInfo  = {};
-    float                   queuePriority    = 1.0f;
-    int                     queueFamilyIndex = GetQueueFamiliesIndex(m_PhysicalDevice, VK_QUEUE_GRAPHICS_BIT);
-    HandleCreateInfo_DeviceQueue(queueCreateInfo, queuePriority, queueFamilyIndex);
+    PROFILE_SCOPE("CreateLogicalDevice");
+    //创建逻辑设备需要先创建队列：图形、呈现、计算、传输各用哪个队列族由QueueTopology决定
+    m_Queues                                              = QueueTopology::Discover(m_PhysicalDevice, m_Surface);
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos = m_Queues.QueueCreateInfos();
+    std::cout << m_Queues.Describe() << '\n';
 
     //设备特性
     VkPhysicalDeviceFeatures deviceFeatures = {};
 
-    //创建逻辑设备
+    //BC压缩纹理：桌面GPU基本都支持，不支持时流送的纹理因格式不可用而被跳过
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &supportedFeatures);
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+    //present wait是可选的：两个扩展和对应的特性都支持时才启用，否则帧节奏只靠CPU计时
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+    presentWaitFeatures.sType                                  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    presentWaitFeatures.presentWait                            = VK_TRUE;
+
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+    presentIdFeatures.sType                                = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    presentIdFeatures.pNext                                = &presentWaitFeatures;
+    presentIdFeatures.presentId                            = VK_TRUE;
+
+    m_PresentWaitEnabled = CheckPresentWaitSupport();
+    if (m_PresentWaitEnabled)
+    {
+        m_DeviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        m_DeviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    }
+
+    //GPU剔除只有一条firstInstance为0的间接绘制命令，不需要额外的设备特性；
+    //VK_KHR_draw_indirect_count是可选的，没有时退回固定数量的间接绘制
+    m_GpuCullingEnabled           = m_Config.gpuCulling;
+    bool drawIndirectCountEnabled = false;
+    if (m_GpuCullingEnabled)
+    {
+        if (HasDeviceExtensions({VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME}))
+        {
+            m_DeviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            drawIndirectCountEnabled = true;
+        }
+    }
+
+    //描述符索引也是可选的，不支持时不创建描述符堆
+    m_DescriptorIndexingEnabled = CheckDescriptorIndexingSupport();
+    if (m_DescriptorIndexingEnabled)
+    {
+        m_DeviceExtensions.push_back(VK_KHR_MAINTENANCE_3_EXTENSION_NAME);
+        m_DeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+        //Textured.frag用推送的索引访问纹理索引表和纹理数组，需要两种数组的动态索引，
+        //表中查出的纹理索引随实例变化，还需要纹理数组的非一致索引
+        deviceFeatures.shaderSampledImageArrayDynamicIndexing  = supportedFeatures.shaderSampledImageArrayDynamicIndexing;
+        deviceFeatures.shaderStorageBufferArrayDynamicIndexing = supportedFeatures.shaderStorageBufferArrayDynamicIndexing;
+        m_HeapSamplingEnabled = deviceFeatures.shaderSampledImageArrayDynamicIndexing == VK_TRUE &&
+                                deviceFeatures.shaderStorageBufferArrayDynamicIndexing == VK_TRUE &&
+                                m_IndexingFeatures.shaderSampledImageArrayNonUniformIndexing == VK_TRUE;
+    }
+
+    //扩展动态状态是可选的，不支持时剔除模式、正面朝向和图元类型仍然编进管线
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures = {};
+    dynamicStateFeatures.sType                                           = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    dynamicStateFeatures.extendedDynamicState                            = VK_TRUE;
+
+    bool extendedDynamicStateEnabled = CheckExtendedDynamicStateSupport();
+    if (extendedDynamicStateEnabled)
+    {
+        m_DeviceExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    }
+
+    //创建逻辑设备，可选特性的结构体串在pNext链上
     VkDeviceCreateInfo createInfo = {};
-    HandleCreateInfo_Device(queueCreateInfo, deviceFeatures, createInfo);
+    HandleCreateInfo_Device(queueCreateInfos, deviceFeatures, createInfo);
+    void* features = nullptr;
+    if (m_DescriptorIndexingEnabled)
+    {
+        m_IndexingFeatures.pNext = features;
+        features                 = &m_IndexingFeatures;
+    }
+    if (m_PresentWaitEnabled)
+    {
+        presentWaitFeatures.pNext = features;
+        features                  = &presentIdFeatures;
+    }
+    if (extendedDynamicStateEnabled)
+    {
+        dynamicStateFeatures.pNext = features;
+        features                   = &dynamicStateFeatures;
+    }
+    createInfo.pNext = features;
 
-    if (vkCreateDevice(m_PhysicalDevice, &createInfo, nullptr, &m_Device) != VK_SUCCESS)
+    VkDevice device = VK_NULL_HANDLE;
+    if (vkCreateDevice(m_PhysicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create logical device!");
     }
-    //两个指针指向同一个队列，因为它既支持图形又支持呈现
-    vkGetDeviceQueue(m_Device, queueFamilyIndex, 0, &m_GraphicsQueue);
-    vkGetDeviceQueue(m_Device, queueFamilyIndex, 0, &m_PresentQueue);
-}
-
-void HelloTriangleApplication::HandleCreateInfo_DeviceQueue(VkDeviceQueueCreateInfo& queueCreateInfo ,
-                                                            const float& queuePriority , int queueFamilyIndex)
-{
-    queueCreateInfo.sType            = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
-    queueCreateInfo.queueCount       = 1;
-    queueCreateInfo.pQueuePriorities = &queuePriority;
+    m_Device.Reset(device);
+    if (m_PresentWaitEnabled)
+    {
+        m_WaitForPresent     = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(m_Device, "vkWaitForPresentKHR");
+        m_PresentWaitEnabled = m_WaitForPresent != nullptr;
+    }
+    std::cout << "present: policy " << PresentPolicyName(m_PresentPolicy) << ", present wait "
+            << ( m_PresentWaitEnabled ? "enabled" : "unavailable" ) << ", refresh " << m_RefreshHz << " Hz\n";
+    if (!m_DescriptorIndexingEnabled)
+    {
+        std::cout << "descriptor heap: " << ( m_Config.bindlessTextures == 0 ? "disabled" : "unavailable" ) << '\n';
+    }
+    if (drawIndirectCountEnabled)
+    {
+        m_DrawIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+            m_Device, "vkCmdDrawIndexedIndirectCountKHR");
+    }
+    if (extendedDynamicStateEnabled)
+    {
+        m_ExtendedDynamicState.setCullMode          = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(
+            m_Device, "vkCmdSetCullModeEXT");
+        m_ExtendedDynamicState.setFrontFace         = (PFN_vkCmdSetFrontFaceEXT)vkGetDeviceProcAddr(
+            m_Device, "vkCmdSetFrontFaceEXT");
+        m_ExtendedDynamicState.setPrimitiveTopology = (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(
+            m_Device, "vkCmdSetPrimitiveTopologyEXT");
+    }
+    std::cout << "pipeline state: extended dynamic state "
+            << ( m_ExtendedDynamicState.Available() ? "enabled" : "unavailable" ) << '\n';
+    //没有专用队列族时，几个角色拿到的是同一个队列
+    vkGetDeviceQueue(m_Device, m_Queues.graphics.family, m_Queues.graphics.index, &m_GraphicsQueue);
+    vkGetDeviceQueue(m_Device, m_Queues.present.family, m_Queues.present.index, &m_PresentQueue);
+    vkGetDeviceQueue(m_Device, m_Queues.compute.family, m_Queues.compute.index, &m_ComputeQueue);
+    vkGetDeviceQueue(m_Device, m_Queues.transfer.family, m_Queues.transfer.index, &m_TransferQueue);
 }
 
-void HelloTriangleApplication::HandleCreateInfo_Device(VkDeviceQueueCreateInfo   queueCreateInfo ,
-                                                       VkPhysicalDeviceFeatures& deviceFeatures ,
-                                                       VkDeviceCreateInfo&       createInfo)
+void HelloTriangleApplication::HandleCreateInfo_Device(const std::vector<VkDeviceQueueCreateInfo>& queueCreateInfos ,
+                                                       VkPhysicalDeviceFeatures&                   deviceFeatures ,
+                                                       VkDeviceCreateInfo&                         createInfo)
 {
     createInfo.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    createInfo.pQueueCreateInfos       = &queueCreateInfo;
-    createInfo.queueCreateInfoCount    = 1;
+    createInfo.pQueueCreateInfos       = queueCreateInfos.data();
+    createInfo.queueCreateInfoCount    = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pEnabledFeatures        = &deviceFeatures;
-    createInfo.enabledExtensionCount   = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount   = static_cast<uint32_t>(m_DeviceExtensions.size());
+    createInfo.ppEnabledExtensionNames = m_DeviceExtensions.data();
     //让设备和实例使用相同的校验层
     if (enableValidationLayers)
     {
@@ -623,35 +1220,145 @@ void HelloTriangleApplication::HandleCreateInfo_Device(VkDeviceQueueCreateInfo
 
 void HelloTriangleApplication::CreateSwapChain()
 {
+    PROFILE_SCOPE("CreateSwapChain");
+    if (m_Config.headless)
+    {
+        CreateOffscreenTargets();
+        return;
+    }
+
     VkSwapchainCreateInfoKHR createInfo = HandleCreateInfo_SwapChain();
 
-    if (vkCreateSwapchainKHR(m_Device, &createInfo, nullptr, &m_SwapChain) != VK_SUCCESS)
+    //VK_SHARING_MODE_CONCURRENT：图像可以在多个队列族间使用，不需要显式地改变图像所有权。
+    //协同模式需要我们使用queueFamilyIndexCount和pQueueFamilyIndices来指定共享所有权的队列族。
+    //如果图形队列族和呈现队列族是同一个队列族(大部分情况下都是这样)，我们就不能使用协同模式，协同模式需要我们指定至少两个不同的队列族。
+    uint32_t queueFamilyIndices[] = {m_Queues.graphics.family, m_Queues.present.family};
+    if (m_Queues.HasSeparatePresent())
+    {
+        createInfo.imageSharingMode      = VK_SHARING_MODE_CONCURRENT;
+        createInfo.queueFamilyIndexCount = 2;
+        createInfo.pQueueFamilyIndices   = queueFamilyIndices;
+    }
+
+    //createInfo.oldSwapchain引用着旧交换链，新交换链创建成功之后才能让出旧句柄
+    UniqueSwapchain swapChain;
+    if (swapChain.Create(m_Device, vkCreateSwapchainKHR, createInfo) != VK_SUCCESS)
     {
         throw std::runtime_error("创建交换链失败！");
     }
+    RetireSwapChain();
+    m_SwapChain = std::move(swapChain);
+    m_FramePacer.SwapChainChanged();
 
     vkGetSwapchainImagesKHR(m_Device, m_SwapChain, &createInfo.minImageCount, nullptr);
     m_SwapChainImages.resize(createInfo.minImageCount);
     vkGetSwapchainImagesKHR(m_Device, m_SwapChain, &createInfo.minImageCount, m_SwapChainImages.data());
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    m_RenderFinished.resize(m_SwapChainImages.size());
+    for (auto& semaphore : m_RenderFinished)
+    {
+        if (semaphore.Create(m_Device, vkCreateSemaphore, semaphoreInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("创建同步对象失败");
+        }
+    }
 }
 
-VkSwapchainCreateInfoKHR HelloTriangleApplication::HandleCreateInfo_SwapChain()
+/*
+ * 旧交换链已经排队的呈现还没有完成时不能销毁它，但核心Vulkan没有办法直接等待一次呈现：
+ * 帧序号完成只说明渲染提交执行完了，呈现可能还在等renderFinished，或者还在呈现队列里
+ * (呈现栅栏要VK_EXT_swapchain_maintenance1才有)。
+ * 所以销毁操作仍按当前已提交的最大帧序号登记，序号完成后先等呈现队列空闲，再销毁旧交换链和它的renderFinished信号量。
+ * 此时旧交换链的呈现所等待的渲染都已完成，这次等待通常很短，而且只在重建后发生一次。
+ * 呈现队列和删除队列都只在主线程使用，满足vkQueueWaitIdle对队列的外部同步要求。
+ */
+void HelloTriangleApplication::RetireSwapChain()
 {
-    SwapChainSupportDetails swapChainDetails = GetSwapChainDetails(m_PhysicalDevice);
+    VkDevice                 device       = m_SwapChain.GetParent();
+    VkQueue                  presentQueue = m_PresentQueue;
+    VkSwapchainKHR           oldSwapChain = m_SwapChain.Release();
+    std::vector<VkSemaphore> oldSemaphores;
+    oldSemaphores.reserve(m_RenderFinished.size());
+    for (auto& semaphore : m_RenderFinished)
+    {
+        oldSemaphores.push_back(semaphore.Release());
+    }
+    m_RenderFinished.clear();
+    if (oldSwapChain == VK_NULL_HANDLE) return;
 
-    VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainDetails.formats);
-    VkPresentModeKHR   presentMode   = ChooseSwapPresentMode(swapChainDetails.presentModes);
-    VkExtent2D         extent        = ChooseSwapResolution(swapChainDetails.capabilities);
+    m_DeletionQueue.Push(m_SubmittedSerial,
+                         [device, presentQueue, oldSwapChain, oldSemaphores = std::move(oldSemaphores)]()
+    {
+        vkQueueWaitIdle(presentQueue);
+        for (auto semaphore : oldSemaphores)
+        {
+            UniqueSemaphore::Destroy(device, semaphore);
+        }
+        UniqueSwapchain::Destroy(device, oldSwapChain);
+    });
+}
 
-    m_SwapChainImageFormat = surfaceFormat.format;
-    m_SwapChainExtent      = extent;
+/*
+ * 重建交换链，不等待设备空闲。
+ * 新交换链以旧交换链为oldSwapchain创建，旧交换链进入退役状态：不能再获取图像，但已经提交的呈现仍会完成。
+ * 旧的图像视图和帧缓冲可能还被飞行中的帧使用，交给m_DeletionQueue，
+ * 登记的序号是当前已提交的最大帧序号，这一帧完成(栅栏被等待过)后，DrawFrame开头的Flush销毁它们。
+ * 旧交换链还要等它的呈现结束，见RetireSwapChain。
+ * 渲染流程和管线只依赖图像格式，视口和裁剪矩形是动态状态，都不需要重建。
+ */
+void HelloTriangleApplication::RecreateSwapChain()
+{
+    PROFILE_SCOPE("RecreateSwapChain");
+    auto start = std::chrono::steady_clock::now();
 
+    //最小化时不重建，等窗口恢复后由下一次获取或呈现的结果再触发
+    int width  = 0;
+    int height = 0;
+    glfwGetFramebufferSize(m_Window, &width, &height);
+    if (width == 0 || height == 0) return;
+    m_FramebufferResized = false;
 
-    VkSwapchainCreateInfoKHR createInfo = {};
-    createInfo.sType                    = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    createInfo.surface                  = m_Surface;
+    VkFormat oldFormat = m_SwapChainImageFormat;
 
-    //imageCount：能够支持的缓冲区的个数
+    //帧缓冲引用图像视图，图像视图引用交换链图像，按这个顺序登记，销毁时也按这个顺序。
+    //渲染图的临时附着跟随交换链的尺寸，一起交给删除队列
+    m_RenderGraph.RetireTargets(m_DeletionQueue, m_SubmittedSerial);
+    m_DeletionQueue.Retire(m_SubmittedSerial, std::move(m_ImageViews));
+
+    CreateSwapChain();
+    if (m_SwapChainImageFormat != oldFormat)
+    {
+        throw std::runtime_error("重建后交换链图像格式发生了变化");
+    }
+    CreateImageViews();
+    CreateFramebuffers();
+
+    //新交换链的图像还没有被任何帧使用
+    m_ImagesInFlight.assign(m_SwapChainImages.size(), VK_NULL_HANDLE);
+
+    m_RecreateCount++;
+    m_RecreateMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+VkSwapchainCreateInfoKHR HelloTriangleApplication::HandleCreateInfo_SwapChain()
+{
+    SwapChainSupportDetails swapChainDetails = GetSwapChainDetails(m_PhysicalDevice);
+
+    VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainDetails.formats);
+    VkPresentModeKHR   presentMode   = ChooseSwapPresentMode(swapChainDetails.presentModes);
+    VkExtent2D         extent        = ChooseSwapResolution(swapChainDetails.capabilities);
+
+    m_SwapChainImageFormat = surfaceFormat.format;
+    m_SwapChainExtent      = extent;
+
+
+    VkSwapchainCreateInfoKHR createInfo = {};
+    createInfo.sType                    = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    createInfo.surface                  = m_Surface;
+
+    //imageCount：能够支持的缓冲区的个数
     //使用minImageCount + 1来支持三倍缓冲
     uint32_t imageCount = swapChainDetails.capabilities.minImageCount + 1;
     //maxImageCount的值为0表明，可以使用任意数量的缓冲区。所以只有maxImageCount的值大于0的时候需要检查。
@@ -672,22 +1379,10 @@ VkSwapchainCreateInfoKHR HelloTriangleApplication::HandleCreateInfo_SwapChain()
     //如果读者需要对图像进行后期处理之类的操作，可以使用VK_IMAGE_USAGE_TRANSFER_DST_BIT作为imageUsage成员变量的值，让交换链图像可以作为传输的目的图像。
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-    int index = GetQueueFamiliesIndex(m_PhysicalDevice, VK_QUEUE_GRAPHICS_BIT);
-
-
     //VK_SHARING_MODE_EXCLUSIVE：一张图像同一时间只能被一个队列族所拥有，在另一队列族使用它之前，必须显式地改变图像所有权。
     //这一模式下性能表现最佳。
+    //图形和呈现不是同一个队列族时，CreateSwapChain会改为VK_SHARING_MODE_CONCURRENT
     createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    /*
-     * 如果不要求队列族必须支持两个功能：
-     *     //VK_SHARING_MODE_CONCURRENT：图像可以在多个队列族间使用，不需要显式地改变图像所有权。
-     *     //协同模式需要我们使用queueFamilyIndexCount和pQueueFamilyIndices来指定共享所有权的队列族。
-     *     //如果图形队列族和呈现队列族是同一个队列族(大部分情况下都是这样)，我们就不能使用协同模式，协同模式需要我们指定至少两个不同的队列族。
-     *     createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-     *     //VK_SHARING_MODE_EXCLUSIVE模式没必要设置这两个
-     *     createInfo.queueFamilyIndexCount = 2;
-     *     createInfo.pQueueFamilyIndices = {index1 , index2};
-     */
 
     //我们可以为交换链中的图像指定一个固定的变换操作(需要交换链具有supportedTransforms特性)，比如顺时针旋转90度或是水平翻转。
     //如果不需要进行任何变换操作，指定使用currentTransform变换即可。
@@ -701,13 +1396,15 @@ VkSwapchainCreateInfoKHR HelloTriangleApplication::HandleCreateInfo_SwapChain()
     createInfo.presentMode = presentMode;
     createInfo.clipped     = VK_TRUE;
 
-    //最后是oldSwapchain成员变量，需要指定它，是因为应用程序在运行过程中交换链可能会失效。比如，改变窗口大小后，交换链需要重建，重建时需要之前的交换链
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    //最后是oldSwapchain成员变量，需要指定它，是因为应用程序在运行过程中交换链可能会失效。比如，改变窗口大小后，交换链需要重建，重建时需要之前的交换链。
+    //传入旧交换链后，驱动可以复用它的资源，旧交换链中已经提交的呈现也能正常完成，新旧交换链之间不会出现空白帧
+    createInfo.oldSwapchain = m_SwapChain;
     return createInfo;
 }
 
 void HelloTriangleApplication::CreateImageViews()
 {
+    PROFILE_SCOPE("CreateImageViews");
     m_ImageViews.resize(m_SwapChainImages.size());
     for (size_t i = 0; i < m_SwapChainImages.size(); i++)
     {
@@ -728,254 +1425,1035 @@ void HelloTriangleApplication::CreateImageViews()
         createInfo.subresourceRange.levelCount     = 1; // 只操作第 0 层 mipmap
         createInfo.subresourceRange.baseArrayLayer = 0; // 从第 0 层数组开始（Vulkan 支持数组纹理，图像可以包含多个层，每层代表一个 2D 图像）
         createInfo.subresourceRange.layerCount     = 1; // 只操作第 0 层数组
+
+        if (m_ImageViews[i].Create(m_Device, vkCreateImageView, createInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("创建图像视图失败");
+        }
     }
 }
 
-void HelloTriangleApplication::CreateRenderPass()
+void HelloTriangleApplication::CreateRenderGraph()
 {
-    //只使用一个代表交换链图像的颜色缓冲附着
-    VkAttachmentDescription colorAttachment = {};
-    colorAttachment.format                  = m_SwapChainImageFormat;
-    colorAttachment.samples                 = VK_SAMPLE_COUNT_1_BIT;
-
-    //loadOp和storeOp成员变量用于指定在渲染之前和渲染之后对附着中的数据进行的操作
-    colorAttachment.loadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-
-    //loadOp和storeOp成员变量的设置会对颜色和深度缓冲起效。
-    //stencilLoadOp成员变量和stencilStoreOp成员变量会对模板缓冲起效
-    colorAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    PROFILE_SCOPE("CreateRenderGraph");
+    //交换链图像作为导入的图像：每帧开始时内容无效，渲染结束后转换到呈现布局。
+    //无头模式不呈现图像，渲染结束后转换为传输源布局，方便回读做回归比对
+    m_BackBuffer = m_RenderGraph.ImportImage("BackBuffer", m_SwapChainImageFormat,
+                                             m_Config.headless
+                                                 ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                                 : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+    //场景过程清除交换链图像后绘制全部实例。附着描述、布局转换和子流程依赖都由渲染图推导：
+    //第一次写入交换链图像前等待上一次对它的颜色输出，和提交时等待imageAvailable信号量的阶段对齐
+    m_ScenePass = m_RenderGraph.AddPass("Scene", [this](const RenderPassContext& context)
+    {
+        RecordScene(context);
+    });
+    VkClearColorValue clearColor = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    m_RenderGraph.WriteColor(m_ScenePass, m_BackBuffer, &clearColor);
 
-    //图像布局方式与这个图像的使用目的相关
-    //initialLayout渲染流程开始前的图像布局方式。finalLayout渲染流程结束后的图像布局方式.
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout   = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    m_RenderGraph.Compile(m_Device);
+}
 
-    //一个渲染流程可以包含多个子流程。子流程依赖于上一流程处理后的帧缓冲内容。
-    //比如，许多叠加的后期处理效果就是在上一次的处理结果上进行的。
-    VkAttachmentReference colorAttachmentRef = {};
-    colorAttachmentRef.attachment            = 0;
-    //Vulkan会在子流程开始时自动将引用的附着转换到layout成员变量指定的图像布局。
-    //我们推荐将layout成员变量设置为VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL，一般而言，它的性能表现最佳。
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+void HelloTriangleApplication::LoadShaderCode()
+{
+    PROFILE_SCOPE("LoadShaderCode");
+    //只需要SPIR-V的字节，不需要设备，所以在启动的第一时刻就和创建实例并行执行。
+    //指定了--shader-dir时以内存映射方式读取文件，否则直接使用编译进程序的SPIR-V，启动时没有任何文件读取
+    for (const char* name : {"Triangle.vert", "Instanced.vert", "Culled.vert", "Triangle.frag", "Textured.frag",
+                             "Cull.comp"})
+    {
+        if (m_Config.shaderDirectory.empty())
+        {
+            auto code = FindEmbeddedShader(name);
+            if (code.empty())
+            {
+                throw std::runtime_error(std::string("没有内嵌的着色器: ") + name);
+            }
+            m_ShaderCode[name] = code;
+            continue;
+        }
 
-    //子流程的定义，刚才是子流程的附着
-    VkSubpassDescription subpass = {};
-    subpass.pipelineBindPoint    = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    //这里设置的颜色附着在数组中的索引会被片段着色器使用，对应我们在片段着色器中使用的 layout(location = 0) out vec4 outColor
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments    = &colorAttachmentRef;
+        MappedFile file  = Loader::MapFile(m_Config.shaderDirectory + "/" + name + ".spv");
+        auto       words = file.Words();
+        //映射的页面在第一次访问时才调入，逐页读一遍，让磁盘读取发生在这里而不是创建模块时
+        volatile uint32_t touch = 0;
+        for (size_t i = 0; i < words.size(); i += 1024)
+        {
+            touch = touch + words[i];
+        }
+        m_ShaderCode[name] = words;
+        //移动MappedFile不改变映射地址，words仍然有效
+        m_ShaderFiles.push_back(std::move(file));
+    }
+}
 
-    VkRenderPassCreateInfo renderPassInfo = {};
-    renderPassInfo.sType                  = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount        = 1;
-    renderPassInfo.pAttachments           = &colorAttachment;
-    renderPassInfo.subpassCount           = 1;
-    renderPassInfo.pSubpasses             = &subpass;
+void HelloTriangleApplication::CreateShaderModules()
+{
+    PROFILE_SCOPE("CreateShaderModules");
+    m_ShaderModules.Create(m_Device);
+    //变体管线可能在后台继续编译，着色器模块由m_ShaderModules保留到CleanUp
+    m_VertexShaderModule          = LoadShader("Triangle.vert");
+    m_InstancedVertexShaderModule = LoadShader("Instanced.vert");
+    m_CulledVertexShaderModule    = LoadShader("Culled.vert");
+    m_FragmentShaderModule        = LoadShader("Triangle.frag");
+    m_CullShaderModule            = LoadShader("Cull.comp");
+
+    //Textured.frag需要描述符堆和按索引访问它的设备特性(见CreateLogicalDevice)，缺少时场景退回不采样纹理的Triangle.frag
+    if (m_HeapSamplingEnabled)
+    {
+        m_TexturedFragmentShaderModule = LoadShader("Textured.frag");
+        m_FragmentShaderModule         = m_TexturedFragmentShaderModule;
+    }
+}
 
-    if (vkCreateRenderPass(m_Device, &renderPassInfo, nullptr, &m_RenderPass) != VK_SUCCESS)
+void HelloTriangleApplication::CreateDescriptorHeap()
+{
+    PROFILE_SCOPE("CreateDescriptorHeap");
+    if (!m_DescriptorIndexingEnabled) return;
+
+    m_DescriptorHeap.Create(m_Device, m_BindlessCapacity);
+
+    //所有纹理共用的默认采样器，和纹理分开注册，着色器中组合成sampler2D
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType               = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter           = VK_FILTER_LINEAR;
+    samplerInfo.minFilter           = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode          = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU        = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV        = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW        = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.maxLod              = 1000.0f;
+    if (m_DefaultSampler.Create(m_Device, vkCreateSampler, samplerInfo) != VK_SUCCESS)
     {
-        throw std::runtime_error("failed to create render pass!");
+        throw std::runtime_error("创建默认采样器失败");
     }
+    m_DefaultSamplerIndex = m_DescriptorHeap.AddSampler(m_DefaultSampler);
+
+    std::cout << "descriptor heap: " << m_BindlessCapacity.storageBuffers << " buffers, "
+            << m_BindlessCapacity.sampledImages << " images, " << m_BindlessCapacity.samplers << " samplers\n";
 }
 
-void HelloTriangleApplication::CreateGraphicsPipeline()
+void HelloTriangleApplication::CreateGpuCuller()
 {
-    auto VertexShaderCode   = Loader::ReadFile("../Shaders/vert.spv");
-    auto FragmentShaderCode = Loader::ReadFile("../Shaders/frag.spv");
+    PROFILE_SCOPE("CreateGpuCuller");
+    if (!m_GpuCullingEnabled) return;
 
-    auto VertexShaderModule   = CreateShaderModule(VertexShaderCode);
-    auto FragmentShaderModule = CreateShaderModule(FragmentShaderCode);
+    m_GpuCuller.Create(m_Device, m_Allocator, m_CullShaderModule, m_PipelineCache.Get(), m_Config.framesInFlight,
+                       m_DrawIndirectCount, m_DescriptorHeap.Layout());
 
-    vkDestroyShaderModule(m_Device, FragmentShaderModule, nullptr);
-    vkDestroyShaderModule(m_Device, VertexShaderModule, nullptr);
+    std::cout << "gpu culling: " << ( m_DrawIndirectCount != nullptr
+                                          ? "draw indirect count"
+                                          : "fixed-count indirect (VK_KHR_draw_indirect_count unavailable)" ) << '\n';
+}
 
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-    vertShaderStageInfo.sType                           = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertShaderStageInfo.stage                           = VK_SHADER_STAGE_VERTEX_BIT; //指明用于哪个阶段
-    vertShaderStageInfo.module                          = VertexShaderModule;
-    vertShaderStageInfo.pName                           = "main"; //指明使用shader文件里的哪个函数。可以在一个文件里写多个着色器，通过不同的pName调用他们
-    vertShaderStageInfo.pSpecializationInfo             = nullptr;
-    /*
-    *VkPipelineShaderStageCreateInfo还有一个可选的成员变量pSpecializationInfo
-    *在这里，我们没有使用它，但这一成员变量非常值得我们在这里对它进行说明
-    *我们可以通过这一成员变量指定着色器用到的常量
-    *我们可以对同一个着色器模块对象指定不同的着色器常量用于管线创
-    *这使得编译器可以根据指定的着色器常量来消除一些条件分支，这比在渲染时，使用变量配置着色器带来的效率要高得多。
-    *如果不使用着色器常量，可以将pSpecializationInfo成员变量设置为nullptr。
-    */
+void HelloTriangleApplication::CreateGraphicsPipeline()
+{
+    PROFILE_SCOPE("CreateGraphicsPipeline");
+    //场景管线共用一个布局：描述符集0是全局描述符堆(支持时)，push constant是每次绘制的资源索引。
+    //每个命令缓冲绑定一次描述符堆，每次绘制推送索引，Textured.frag按索引采样纹理
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags          = VK_SHADER_STAGE_ALL_GRAPHICS;
+    pushConstantRange.offset              = 0;
+    pushConstantRange.size                = sizeof(DrawIndices);
+
+    VkDescriptorSetLayout setLayout = m_DescriptorHeap.Layout();
 
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-    fragShaderStageInfo.sType                           = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageInfo.stage                           = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module                          = FragmentShaderModule;
-    fragShaderStageInfo.pName                           = "main";
-
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-
-    //描述传递给顶点着色器的顶点数据格式
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-    vertexInputInfo.sType                                = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount        = 0;
-    vertexInputInfo.pVertexBindingDescriptions           = nullptr; //绑定：数据之间的间距和数据是按逐顶点的方式还是按逐实例的方式进行组织
-    vertexInputInfo.vertexAttributeDescriptionCount      = 0;
-    vertexInputInfo.pVertexAttributeDescriptions         = nullptr; //属性描述：传递给顶点着色器的属性类型，用于将属性绑定到顶点着色器中的变量
-
-    //描述图元装配模式(topology) 和 是否启用几何图元重启
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-    inputAssembly.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology                               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssembly.primitiveRestartEnable                 = VK_FALSE;
-
-    //描述视口和裁剪矩形
-    VkViewport viewport                             = {};
-    viewport.x                                      = 0.0f;
-    viewport.y                                      = 0.0f;
-    viewport.width                                  = static_cast<float>(m_SwapChainExtent.width);
-    viewport.height                                 = static_cast<float>(m_SwapChainExtent.height);
-    viewport.minDepth                               = 0.0f;
-    viewport.maxDepth                               = 1.0f;
-    VkRect2D scissor                                = {};
-    scissor.offset                                  = {0, 0};
-    scissor.extent                                  = m_SwapChainExtent;
-    VkPipelineViewportStateCreateInfo viewportState = {};
-    viewportState.sType                             = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount                     = 1;
-    viewportState.pViewports                        = &viewport;
-    viewportState.scissorCount                      = 1;
-    viewportState.pScissors                         = &scissor;
-
-    //描述光栅化方式
-    VkPipelineRasterizationStateCreateInfo rasterizer = {};
-    rasterizer.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer.depthClampEnable                       = VK_FALSE;
-    //depthClampEnable成员变量设置为VK_TRUE表示在近平面和远平面外的片段会被截断为在近平面和远平面上，而不是直接丢弃这些片段。这对于阴影贴图的生成很有用。使用这一设置需要开启相应的GPU特性。
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    //rasterizerDiscardEnable成员变量设置为VK_TRUE表示所有几何图元都不能通过光栅化阶段。这一设置会禁止一切片段输出到帧缓冲。
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    //polygonMode成员变量用于指定多边形的填充模式。可以设置为VK_POLYGON_MODE_FILL填充模式，VK_POLYGON_MODE_LINE线框模式，VK_POLYGON_MODE_POINT点模式。
-    rasterizer.lineWidth = 1.0f; //lineWidth成员变量用于指定光栅化后的线段宽度。线宽的最大值依赖于硬件，如果线宽度大于1.0f，需要开启相应的GPU特性。
-    rasterizer.cullMode  = VK_CULL_MODE_BACK_BIT;
-    //cullMode成员变量用于指定剔除模式。可以设置为VK_CULL_MODE_NONE不剔除任何图元，VK_CULL_MODE_FRONT_BIT剔除正面图元，VK_CULL_MODE_BACK_BIT剔除背面图元，VK_CULL_MODE_FRONT_AND_BACK剔除所有图元。
-    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    //frontFace成员变量用于指定多边形的正面是顺时针还是逆时针。可以设置为VK_FRONT_FACE_CLOCKWISE顺时针，VK_FRONT_FACE_COUNTER_CLOCKWISE逆时针。
-    rasterizer.depthBiasEnable = VK_FALSE;
-    //depthBiasEnable成员变量用于指定是否开启深度偏移。光栅化程序可以添加一个常量值或是一个基于片段所处线段的斜率得到的变量值到深度值上。这对于阴影贴图会很有用
-
-    //多重采样技术 用于反走样，这里暂时禁用。
-    VkPipelineMultisampleStateCreateInfo multisampling = {};
-    multisampling.sType                                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.sampleShadingEnable                  = VK_FALSE;
-    multisampling.rasterizationSamples                 = VK_SAMPLE_COUNT_1_BIT;
-    multisampling.minSampleShading                     = 1.0f;     // Optional
-    multisampling.pSampleMask                          = nullptr;  // Optional
-    multisampling.alphaToCoverageEnable                = VK_FALSE; // Optional
-    multisampling.alphaToOneEnable                     = VK_FALSE; // Optional
-
-    //颜色混合：有两个用于配置颜色混合的结构体。第一个是VkPipelineColorBlendAttachmentState结构体，可以用它来对每个绑定的帧缓冲进行单独的颜色混合配置。
-    //第二个是VkPipelineColorBlendStateCreateInfo结构体，可以用它来进行全局的颜色混合配置。
-    VkPipelineColorBlendAttachmentState colorBlendAttachment = {}; //不配置
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
-            | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable         = VK_FALSE;
-    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;  // Optional
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-    colorBlendAttachment.colorBlendOp        = VK_BLEND_OP_ADD;      // Optional
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;  // Optional
-    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-    colorBlendAttachment.alphaBlendOp        = VK_BLEND_OP_ADD;      // Optional
-    /* 上方设置的作用
-    if (blendEnable)
-    {
-        finalColor.rgb = (srcColorBlendFactor * newColor.rgb) <colorBlendOp> (dstColorBlendFactor * oldColor.rgb);
-        finalColor.a = (srcAlphaBlendFactor * newColor.a) <alphaBlendOp> (dstAlphaBlendFactor * oldColor.a);
-    }
-    else {
-        finalColor = newColor;
-    }
-    finalColor = finalColor & colorWriteMask;
-    */
-    VkPipelineColorBlendStateCreateInfo colorBlending = {};
-    colorBlending.sType                               = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlending.logicOpEnable                       = VK_FALSE;
-    colorBlending.logicOp                             = VK_LOGIC_OP_COPY; // Optional
-    colorBlending.attachmentCount                     = 1;
-    colorBlending.pAttachments                        = &colorBlendAttachment;
-    colorBlending.blendConstants[0]                   = 0.0f; // Optional
-    colorBlending.blendConstants[1]                   = 0.0f; // Optional
-    colorBlending.blendConstants[2]                   = 0.0f; // Optional
-    colorBlending.blendConstants[3]                   = 0.0f; // Optional
-
-    VkDynamicState dynamicStates[] = {
-        VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_LINE_WIDTH
-    };
-
-    //声明可以动态配置的内容
-    VkPipelineDynamicStateCreateInfo dynamicState = {};
-    dynamicState.sType                            = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicState.dynamicStateCount                = 2;
-    dynamicState.pDynamicStates                   = dynamicStates;
-
-    //Uniform变量通过m_PipelineLayout在管线中提前定义
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
     pipelineLayoutInfo.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount             = 0;       // Optional
-    pipelineLayoutInfo.pSetLayouts                = nullptr; // Optional
-    pipelineLayoutInfo.pushConstantRangeCount     = 0;       // Optional
-    pipelineLayoutInfo.pPushConstantRanges        = nullptr; // Optional
+    pipelineLayoutInfo.setLayoutCount             = m_DescriptorHeap.Enabled() ? 1 : 0;
+    pipelineLayoutInfo.pSetLayouts                = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount     = 1;
+    pipelineLayoutInfo.pPushConstantRanges        = &pushConstantRange;
 
-    if (vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS)
+    if (m_PipelineLayout.Create(m_Device, vkCreatePipelineLayout, pipelineLayoutInfo) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create pipeline layout!");
     }
 
-    VkGraphicsPipelineCreateInfo pipelineInfo = {};
-    pipelineInfo.sType                        = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount                   = 2;
-    pipelineInfo.pStages                      = shaderStages;
-    pipelineInfo.pVertexInputState            = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState          = &inputAssembly;
-    pipelineInfo.pViewportState               = &viewportState;
-    pipelineInfo.pRasterizationState          = &rasterizer;
-    pipelineInfo.pMultisampleState            = &multisampling;
-    pipelineInfo.pDepthStencilState           = nullptr; // Optional
-    pipelineInfo.pColorBlendState             = &colorBlending;
-    pipelineInfo.pDynamicState                = nullptr; // Optional
+    //固定功能状态的具体设置见PipelineFactory::CreateGraphicsPipeline
+    GraphicsPipelineDesc desc = {};
+    desc.vertexShader         = m_VertexShaderModule;
+    desc.fragmentShader       = m_FragmentShaderModule;
+    desc.layout               = m_PipelineLayout;
+    desc.renderPass           = m_RenderGraph.RenderPass(m_ScenePass);
+    desc.subpass              = m_RenderGraph.Subpass(m_ScenePass);
+    desc.vertexInput          = Vertex::InputDesc();
+
+    //实例化管线在顶点绑定0之后追加三个逐实例绑定，片段着色器相同
+    GraphicsPipelineDesc instancedDesc = desc;
+    instancedDesc.vertexShader         = m_InstancedVertexShaderModule;
+    InstanceData::AppendInputDesc(instancedDesc.vertexInput, 1, 2);
+
+    //变体只在特化常量上不同，其余状态来自这两个描述；两组变体的管线都存放在同一个状态缓存中
+    m_PipelineStates.Create(m_Device, *m_PipelineCompiler, m_ExtendedDynamicState);
+    m_ScenePipelines.Create(m_PipelineStates, desc);
+    m_InstancedPipelines.Create(m_PipelineStates, instancedDesc);
+    m_SceneVariant = VariantKey::Parse(m_Config.shaderVariant);
+
+    //当前变体以最高优先级编译，第一帧需要它，所以在这里等待结果；其它变体第一次被请求时才编译
+    m_InstancedPipelines.Prefetch(m_SceneVariant, CompilePriority::Critical);
+    m_ScenePipelines.Get(m_SceneVariant);
+    m_InstancedPipelines.Get(m_SceneVariant);
+
+    //GPU剔除的管线只有顶点绑定0，逐实例数据由Culled.vert经可见列表从剔除的描述符集中读取
+    if (m_GpuCuller.Enabled())
+    {
+        GraphicsPipelineDesc culledDesc = desc;
+        culledDesc.vertexShader         = m_CulledVertexShaderModule;
+        culledDesc.layout               = m_GpuCuller.DrawLayout();
+        m_CulledPipelines.Create(m_PipelineStates, culledDesc);
+        m_CulledPipelines.Get(m_SceneVariant);
+    }
+}
+
+VkShaderModule HelloTriangleApplication::LoadShader(const std::string& name)
+{
+    //代码由LoadShaderCode预先读好，经过m_ShaderModules，内容相同的着色器只创建一个模块
+    auto it = m_ShaderCode.find(name);
+    if (it == m_ShaderCode.end())
+    {
+        throw std::runtime_error("着色器代码没有加载: " + name);
+    }
+    return m_ShaderModules.Get(it->second);
+}
 
-    pipelineInfo.layout     = m_PipelineLayout;
-    pipelineInfo.renderPass = m_RenderPass;
-    pipelineInfo.subpass    = 0;
+void HelloTriangleApplication::CreateFramebuffers()
+{
+    PROFILE_SCOPE("CreateFramebuffers");
+    //每张交换链图像对应一组帧缓冲，渲染图按图像序号找到本次要写入的图像视图；临时附着按交换链的尺寸创建
+    std::vector<VkImageView> views(m_ImageViews.begin(), m_ImageViews.end());
+    m_RenderGraph.SetImportedViews(m_BackBuffer, std::move(views));
+    m_RenderGraph.CreateTargets(m_Allocator, m_SwapChainExtent);
+}
 
-    /*
-    basePipelineHandle和basePipelineIndex成员变量用于以一个创建好的图形管线为基础创建一个新的图形管线。
-    当要创建一个和已有管线大量设置相同的管线时，使用它的代价要比直接创建小，并且，对于从同一个管线衍生出的两个管线，在它们之间进行管线切换操作的效率也要高很多。
-    我们可以使用basePipelineHandle来指定已经创建好的管线，或是使用basePipelineIndex来指定将要创建的管线作为基础管线，用于衍生新的管线。
-    目前，我们只使用一个管线，所以将这两个成员变量分别设置为VK_NULL_HANDLE和-1，不使用基础管线衍生新的管线。
-    这两个成员变量的设置只有在VkGraphicsPipelineCreateInfo结构体的flags成员变量使用了VK_PIPELINE_CREATE_DERIVATIVE_BIT标记的情况下才会起效。
-    */
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
-    pipelineInfo.basePipelineIndex  = -1;             // Optional
+void HelloTriangleApplication::CreateFrameResources()
+{
+    PROFILE_SCOPE("CreateFrameResources");
+    uint32_t queueFamilyIndex = m_Queues.graphics.family;
+
+    m_Frames.resize(m_Config.framesInFlight);
+    m_ImagesInFlight.assign(m_SwapChainImages.size(), VK_NULL_HANDLE);
+
+    for (auto& frame : m_Frames)
+    {
+        //TRANSIENT：命令缓冲每帧都会重新录制，驱动可以据此优化内存分配。
+        //每帧独占一个命令池，复用时直接重置整个命令池，比逐个重置命令缓冲开销更低。
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex        = queueFamilyIndex;
+        if (frame.commandPool.Create(m_Device, vkCreateCommandPool, poolInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("创建命令池失败");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool                 = frame.commandPool;
+        allocInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount          = 1;
+        if (vkAllocateCommandBuffers(m_Device, &allocInfo, &frame.commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("分配命令缓冲失败");
+        }
+
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        //栅栏初始为已发出信号的状态，否则第一次等待它时会永远阻塞
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags             = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        if (frame.imageAvailable.Create(m_Device, vkCreateSemaphore, semaphoreInfo) != VK_SUCCESS ||
+            frame.inFlight.Create(m_Device, vkCreateFence, fenceInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("创建同步对象失败");
+        }
+
+        //传输命令池建在传输队列族上，命令缓冲只能提交到创建它的命令池所属的队列族
+        if (m_Queues.HasDedicatedTransfer())
+        {
+            poolInfo.queueFamilyIndex = m_Queues.transfer.family;
+            if (frame.transferPool.Create(m_Device, vkCreateCommandPool, poolInfo) != VK_SUCCESS)
+            {
+                throw std::runtime_error("创建传输命令池失败");
+            }
+            allocInfo.commandPool = frame.transferPool;
+            if (vkAllocateCommandBuffers(m_Device, &allocInfo, &frame.transferCommands) != VK_SUCCESS ||
+                frame.uploadFinished.Create(m_Device, vkCreateSemaphore, semaphoreInfo) != VK_SUCCESS)
+            {
+                throw std::runtime_error("创建传输命令缓冲失败");
+            }
+        }
+
+        //GPU剔除的计算命令池建在计算队列族上，没有异步计算队列时剔除直接录制在图形命令缓冲中
+        if (m_GpuCullingEnabled && m_Queues.HasAsyncCompute())
+        {
+            poolInfo.queueFamilyIndex = m_Queues.compute.family;
+            if (frame.computePool.Create(m_Device, vkCreateCommandPool, poolInfo) != VK_SUCCESS)
+            {
+                throw std::runtime_error("创建计算命令池失败");
+            }
+            allocInfo.commandPool = frame.computePool;
+            if (vkAllocateCommandBuffers(m_Device, &allocInfo, &frame.computeCommands) != VK_SUCCESS ||
+                frame.cullFinished.Create(m_Device, vkCreateSemaphore, semaphoreInfo) != VK_SUCCESS)
+            {
+                throw std::runtime_error("创建计算命令缓冲失败");
+            }
+        }
+    }
+}
+
+void HelloTriangleApplication::SubmitUploads(FrameResources& frame)
+{
+    //没有专用传输队列时，复制直接录制在图形命令缓冲中
+    frame.uploadSubmitted = false;
+    if (!m_Queues.HasDedicatedTransfer() || !m_StagingRing.HasPending()) return;
+
+    //上一次提交的传输命令已经被这套帧资源的图形提交等待过，栅栏等待之后可以直接重置
+    vkResetCommandPool(m_Device, frame.transferPool, 0);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(frame.transferCommands, &beginInfo);
+    m_StagingRing.RecordTransfer(frame.transferCommands, m_Queues.transfer.family, m_Queues.graphics.family);
+    if (vkEndCommandBuffer(frame.transferCommands) != VK_SUCCESS)
+    {
+        throw std::runtime_error("结束录制传输命令失败");
+    }
+
+    //传输队列和图形队列并行执行：这一帧的复制可以和上一帧的渲染重叠
+    VkSubmitInfo submitInfo         = {};
+    submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount   = 1;
+    submitInfo.pCommandBuffers      = &frame.transferCommands;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores    = frame.uploadFinished.Address();
+    if (vkQueueSubmit(m_TransferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+    {
+        throw std::runtime_error("提交传输命令失败");
+    }
+    frame.uploadSubmitted = true;
+}
+
+/*
+ * 有异步计算队列时，GPU剔除单独提交到计算队列，和图形队列上的其它工作(例如上一帧的渲染)重叠执行。
+ * 剔除读取的实例缓冲由CPU写入、以并发共享模式创建；写入的命令缓冲区在末尾释放给图形队列族，
+ * 图形命令缓冲开头获取，图形提交在间接绘制和顶点着色阶段等待cullFinished
+ */
+void HelloTriangleApplication::SubmitCulling(FrameResources& frame)
+{
+    frame.cullSubmitted = false;
+    if (!m_Queues.HasAsyncCompute() || !UseGpuCulling()) return;
+    PROFILE_SCOPE("SubmitCulling");
+
+    //上一次提交的计算命令已经被这套帧资源的图形提交等待过，栅栏等待之后可以直接重置
+    vkResetCommandPool(m_Device, frame.computePool, 0);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(frame.computeCommands, &beginInfo);
+    RecordCulling(frame.computeCommands, m_Queues.compute.family);
+    if (vkEndCommandBuffer(frame.computeCommands) != VK_SUCCESS)
+    {
+        throw std::runtime_error("结束录制计算命令失败");
+    }
+
+    VkSubmitInfo submitInfo         = {};
+    submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount   = 1;
+    submitInfo.pCommandBuffers      = &frame.computeCommands;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores    = frame.cullFinished.Address();
+    if (vkQueueSubmit(m_ComputeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+    {
+        throw std::runtime_error("提交剔除命令失败");
+    }
+    frame.cullSubmitted = true;
+}
+
+/*
+ * 帧开始前的节奏控制：先等待呈现队列排到允许的深度(present wait)，再睡眠到预测的开始时刻。
+ * 无头模式没有呈现，不控制节奏
+ */
+void HelloTriangleApplication::PaceFrame()
+{
+    PROFILE_SCOPE("PaceFrame");
+    uint64_t presentId = m_FramePacer.PresentIdToWait();
+    if (presentId != 0)
+    {
+        //超时通常是窗口被遮挡或呈现被丢弃，不能一直阻塞帧循环，这次不计入统计
+        constexpr uint64_t TimeoutNs = 100'000'000;
+        VkResult           result    = m_WaitForPresent(m_Device, m_SwapChain, presentId, TimeoutNs);
+        if (result == VK_SUCCESS)
+        {
+            m_FramePacer.Displayed(presentId);
+        }
+        else
+        {
+            m_FramePacer.WaitSkipped();
+        }
+    }
+    m_FramePacer.WaitForFrameStart();
+}
+
+void HelloTriangleApplication::DrawFrame()
+{
+    PROFILE_SCOPE("DrawFrame");
+    if (!m_Config.headless)
+    {
+        PaceFrame();
+    }
+    FrameResources& frame = m_Frames[m_CurrentFrame];
+
+    //等待GPU执行完上一次使用这套资源的帧。飞行帧数为N时，这里等待的是N帧之前提交的工作
+    {
+        PROFILE_SCOPE("WaitForFrameFence");
+        vkWaitForFences(m_Device, 1, frame.inFlight.Address(), VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
+    m_CompletedSerial = std::max(m_CompletedSerial, frame.serial);
+    m_DeletionQueue.Flush(m_CompletedSerial);
+    if (m_GpuCuller.Enabled())
+    {
+        m_GpuCuller.Collect(m_CurrentFrame);
+    }
+
+    //先获取图像再更新数据：交换链过期时这一帧直接放弃，不能留下已经提交、却没有人等待的上传
+    uint32_t imageIndex;
+    if (m_Config.headless)
+    {
+        //离屏图像轮流使用，不需要向呈现引擎获取
+        imageIndex            = m_OffscreenImageIndex;
+        m_OffscreenImageIndex = ( m_OffscreenImageIndex + 1 ) % static_cast<uint32_t>(m_SwapChainImages.size());
+    }
+    else
+    {
+        PROFILE_SCOPE("AcquireNextImage");
+        VkResult result = vkAcquireNextImageKHR(m_Device, m_SwapChain, std::numeric_limits<uint64_t>::max(),
+                                                frame.imageAvailable, VK_NULL_HANDLE, &imageIndex);
+        //交换链已经和窗口不匹配：没有获取到图像，信号量也不会发出，重建后跳过这一帧。
+        //SUBOPTIMAL时图像仍然可用，照常绘制，呈现之后再重建
+        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            RecreateSwapChain();
+            return;
+        }
+        if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+        {
+            throw std::runtime_error("获取交换链图像失败");
+        }
+    }
+
+    //图像获取的顺序由呈现引擎决定，这张图像可能仍被另一帧使用
+    if (m_ImagesInFlight[imageIndex] != VK_NULL_HANDLE)
+    {
+        vkWaitForFences(m_Device, 1, &m_ImagesInFlight[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
+    m_ImagesInFlight[imageIndex] = frame.inFlight;
+
+    //栅栏等待过之后，这套帧资源上一次用过的暂存空间可以回收了
+    auto cpuStart = std::chrono::steady_clock::now();
+    m_StagingRing.BeginFrame(m_CurrentFrame);
+    UpdateGeometry();
+    UpdateInstances();
+    UpdateTextures();
+    SubmitUploads(frame);
+    SubmitCulling(frame);
+    //其它线程注册的描述符在录制之前一次写入描述符堆
+    m_DescriptorHeap.Flush();
+
+    vkResetFences(m_Device, 1, frame.inFlight.Address());
+    vkResetCommandPool(m_Device, frame.commandPool, 0);
+    auto recordStart = std::chrono::steady_clock::now();
+    RecordCommandBuffer(frame.commandBuffer, imageIndex);
+    m_LastRecordMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+
+    //在颜色附着输出阶段等待图像可用，顶点着色等更早的阶段可以提前执行；
+    //顶点数据由传输队列上传时，在顶点输入阶段等待上传完成；剔除在计算队列上时，在间接绘制和顶点着色阶段等待剔除完成
+    VkSemaphore          waitSemaphores[3];
+    VkPipelineStageFlags waitStages[3];
+    uint32_t             waitCount = 0;
+    if (!m_Config.headless)
+    {
+        waitSemaphores[waitCount] = frame.imageAvailable;
+        waitStages[waitCount++]   = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    }
+    if (frame.uploadSubmitted)
+    {
+        waitSemaphores[waitCount] = frame.uploadFinished;
+        waitStages[waitCount++]   = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    }
+    if (frame.cullSubmitted)
+    {
+        waitSemaphores[waitCount] = frame.cullFinished;
+        waitStages[waitCount++]   = GpuCuller::AcquireStages;
+    }
+
+    //无头模式既不获取也不呈现，不需要信号量
+    uint32_t semaphoreCount = m_Config.headless ? 0 : 1;
+
+    VkSubmitInfo submitInfo         = {};
+    submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount   = waitCount;
+    submitInfo.pWaitSemaphores      = waitSemaphores;
+    submitInfo.pWaitDstStageMask    = waitStages;
+    submitInfo.commandBufferCount   = 1;
+    submitInfo.pCommandBuffers      = &frame.commandBuffer;
+    submitInfo.signalSemaphoreCount = semaphoreCount;
+    submitInfo.pSignalSemaphores    = m_Config.headless ? nullptr : m_RenderFinished[imageIndex].Address();
+
+    {
+        PROFILE_SCOPE("QueueSubmit");
+        if (vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, frame.inFlight) != VK_SUCCESS)
+        {
+            throw std::runtime_error("提交绘制命令失败");
+        }
+    }
+    m_GpuProfiler.Submitted();
+    frame.serial     = ++m_SubmittedSerial;
+    m_LastCpuFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+
+    if (!m_Config.headless)
+    {
+        VkPresentInfoKHR presentInfo   = {};
+        presentInfo.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores    = m_RenderFinished[imageIndex].Address();
+        presentInfo.swapchainCount     = 1;
+        presentInfo.pSwapchains        = m_SwapChain.Address();
+        presentInfo.pImageIndices      = &imageIndex;
+
+        //呈现ID由帧节奏分配，present wait按这个ID等待显示完成
+        uint64_t       presentId     = m_FramePacer.Presented();
+        VkPresentIdKHR presentIdInfo = {};
+        presentIdInfo.sType          = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentIdInfo.swapchainCount = 1;
+        presentIdInfo.pPresentIds    = &presentId;
+        if (m_PresentWaitEnabled)
+        {
+            presentInfo.pNext = &presentIdInfo;
+        }
+
+        PROFILE_SCOPE("QueuePresent");
+        VkResult result = vkQueuePresentKHR(m_PresentQueue, &presentInfo);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_FramebufferResized)
+        {
+            RecreateSwapChain();
+        }
+        else if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error("呈现交换链图像失败");
+        }
+    }
+
+    m_CurrentFrame = ( m_CurrentFrame + 1 ) % m_Config.framesInFlight;
+}
+
+void HelloTriangleApplication::RecordCommandBuffer(VkCommandBuffer commandBuffer , uint32_t imageIndex)
+{
+    PROFILE_SCOPE("RecordCommandBuffer");
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("开始录制命令缓冲失败");
+    }
+    //读取这套帧资源上一次的时间戳并重置查询，必须在渲染流程之外
+    m_GpuProfiler.BeginFrame(commandBuffer, m_CurrentFrame);
+
+    //复制命令不能放在渲染流程内，先录制本帧的全部上传
+    {
+        PROFILE_GPU_SCOPE(m_GpuProfiler, commandBuffer, "Uploads");
+        m_StagingRing.Record(commandBuffer);
+    }
+
+    //剔除的dispatch不能放在渲染流程内，渲染流程内的间接绘制读取它生成的命令。
+    //已经提交到计算队列时，这里只获取命令缓冲区的所有权
+    if (m_Frames[m_CurrentFrame].cullSubmitted)
+    {
+        m_GpuCuller.RecordAcquire(commandBuffer, m_CurrentFrame, m_Queues.compute.family, m_Queues.graphics.family);
+    }
+    else if (UseGpuCulling())
+    {
+        PROFILE_GPU_SCOPE(m_GpuProfiler, commandBuffer, "Culling");
+        RecordCulling(commandBuffer, m_Queues.graphics.family);
+    }
+
+    //并行录制时，场景过程的内容全部来自secondary命令缓冲，主命令缓冲只负责执行它们
+    m_RenderGraph.SetSecondaryContents(m_ScenePass, UseParallelRecording());
+    {
+        PROFILE_GPU_SCOPE(m_GpuProfiler, commandBuffer, "RenderPass");
+        m_RenderGraph.Execute(commandBuffer, imageIndex);
+    }
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("结束录制命令缓冲失败");
+    }
+}
+
+bool HelloTriangleApplication::UseParallelRecording() const
+{
+    return m_Recorder.Enabled() && m_Instances.Count() > 0 && !UseGpuCulling() && !m_CpuCulling;
+}
+
+bool HelloTriangleApplication::UseGpuCulling() const
+{
+    return m_GpuCuller.Enabled() && m_Instances.Count() > 0 && !m_CpuCulling;
+}
+
+void HelloTriangleApplication::RecordScene(const RenderPassContext& context)
+{
+    if (UseParallelRecording())
+    {
+        VkCommandBufferInheritanceInfo inheritance = {};
+        inheritance.sType                          = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.renderPass                     = context.renderPass;
+        inheritance.subpass                        = context.subpass;
+        inheritance.framebuffer                    = context.framebuffer;
+
+        auto recordDraws = [this](VkCommandBuffer secondary , uint32_t first , uint32_t count)
+        {
+            RecordDraws(secondary, first, count);
+        };
+        const auto& secondaries = m_Recorder.Record(m_CurrentFrame, inheritance, m_Instances.Count(), recordDraws);
+        vkCmdExecuteCommands(context.commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+    }
+    else if (UseGpuCulling())
+    {
+        //可见实例的绘制命令由计算着色器生成，这里只录制一次间接绘制，与实例数量无关
+        RecordDrawState(context.commandBuffer);
+        PushDrawIndices(context.commandBuffer);
+        m_GpuCuller.RecordDraw(context.commandBuffer, m_CurrentFrame);
+    }
+    else if (m_CpuCulling && m_Instances.Count() > 0)
+    {
+        RecordCpuCulledDraws(context.commandBuffer);
+    }
+    else
+    {
+        //实例化时一次绘制调用画出全部实例，逐实例数据从绑定1~3读取
+        RecordDrawState(context.commandBuffer);
+        uint32_t indexCount    = static_cast<uint32_t>(std::size(TriangleIndices));
+        uint32_t instanceCount = std::max(m_Instances.Count(), 1u);
+        PushDrawIndices(context.commandBuffer);
+        vkCmdDrawIndexed(context.commandBuffer, indexCount, instanceCount, 0, 0, 0);
+    }
+}
+
+//绑定管线、描述符堆、顶点/索引缓冲并设置动态状态。secondary命令缓冲不继承主命令缓冲的这些状态，每个都要自己录制一遍
+void HelloTriangleApplication::RecordDrawState(VkCommandBuffer commandBuffer)
+{
+    //视口和裁剪矩形是动态状态，跟随当前交换链的尺寸
+    VkViewport viewport = {};
+    viewport.width      = static_cast<float>(m_SwapChainExtent.width);
+    viewport.height     = static_cast<float>(m_SwapChainExtent.height);
+    viewport.maxDepth   = 1.0f;
+    VkRect2D scissor    = {{0, 0}, m_SwapChainExtent};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    //变体在启动时已经编译好，这里只是无锁查表；扩展动态状态可用时绑定器还会设置剔除模式、正面朝向和图元类型
+    PipelineVariantCache& pipelines = UseGpuCulling()           ? m_CulledPipelines
+                                      : m_Instances.Count() > 0 ? m_InstancedPipelines
+                                                                : m_ScenePipelines;
+    PipelineBinder        binder(m_PipelineStates, commandBuffer);
+    binder.Bind(pipelines.Desc(m_SceneVariant));
+
+    //描述符堆每个命令缓冲只绑定一次，之后的绘制只推送索引。GPU剔除的管线布局在描述符集0也是描述符堆，
+    //但push constant范围和场景的布局不同，两者不兼容，要用当前管线自己的布局绑定
+    if (m_DescriptorHeap.Enabled())
+    {
+        VkPipelineLayout layout = UseGpuCulling() ? m_GpuCuller.DrawLayout() : m_PipelineLayout;
+        m_DescriptorHeap.Bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout);
+    }
+
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_VertexBuffers[m_CurrentFrame].buffer, offsets);
+    if (m_Instances.Count() > 0 && !UseGpuCulling())
+    {
+        m_InstanceBuffer.Bind(commandBuffer, m_CurrentFrame, 1);
+    }
+    vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+}
+
+//每次绘制推送自己使用的资源索引，Textured.frag用它们在描述符堆中查找纹理和采样器。
+//有流送纹理时实例经本帧的纹理索引表取得各自的纹理，否则都使用默认纹理；不使用描述符堆时片段着色器不读取它们
+void HelloTriangleApplication::PushDrawIndices(VkCommandBuffer commandBuffer)
+{
+    DrawIndices indices = {};
+    indices.texture     = m_DefaultTextureIndex;
+    indices.sampler     = m_DefaultSamplerIndex;
+    if (m_TextureTableCount > 0)
+    {
+        indices.textureTable = m_TextureTableIndices[m_CurrentFrame];
+        indices.textureCount = m_TextureTableCount;
+    }
+
+    VkPipelineLayout layout = UseGpuCulling() ? m_GpuCuller.DrawLayout() : m_PipelineLayout;
+    vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_ALL_GRAPHICS, 0, sizeof(indices), &indices);
+}
+
+/*
+ * 并行录制的一段绘制列表：每个实例单独一次绘制调用，用firstInstance选中它的逐实例数据。
+ * 真实场景中每次绘制的网格和材质各不相同，这里用逐实例的绘制代替，制造足够多的录制工作。
+ * 在多个线程上同时运行，只读取成员，不修改
+ */
+void HelloTriangleApplication::RecordDraws(VkCommandBuffer commandBuffer , uint32_t firstInstance , uint32_t count)
+{
+    RecordDrawState(commandBuffer);
+    uint32_t indexCount = static_cast<uint32_t>(std::size(TriangleIndices));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        PushDrawIndices(commandBuffer);
+        vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, firstInstance + i);
+    }
+}
+
+//cullFamily是commandBuffer所属的队列族，剔除结果最后交给图形队列族
+void HelloTriangleApplication::RecordCulling(VkCommandBuffer commandBuffer , uint32_t cullFamily)
+{
+    CullInput input       = {};
+    input.instanceBuffer  = m_InstanceBuffer.Buffer(m_CurrentFrame);
+    input.offsetStream    = m_InstanceBuffer.StreamOffset(InstanceData::Offset);
+    input.transformStream = m_InstanceBuffer.StreamOffset(InstanceData::Transform);
+    input.colorStream     = m_InstanceBuffer.StreamOffset(InstanceData::Color);
+    input.objectCount     = m_Instances.Count();
+    input.indexCount      = static_cast<uint32_t>(std::size(TriangleIndices));
+    input.meshRadius      = TriangleRadius();
+    m_GpuCuller.RecordCull(commandBuffer, m_CurrentFrame, input, Frustum::FromMatrix(SceneViewProjection));
+    //剔除和绘制在同一个图形命令缓冲中时，两个族参数相同，RecordRelease只录制一个管线屏障
+    m_GpuCuller.RecordRelease(commandBuffer, m_CurrentFrame, cullFamily, m_Queues.graphics.family);
+}
+
+//GPU剔除的对照组：CPU逐个测试实例，每个可见实例一次绘制调用，录制的开销随实例数量线性增长
+void HelloTriangleApplication::RecordCpuCulledDraws(VkCommandBuffer commandBuffer)
+{
+    RecordDrawState(commandBuffer);
+
+    Frustum      frustum    = Frustum::FromMatrix(SceneViewProjection);
+    float        meshRadius = TriangleRadius();
+    uint32_t     indexCount = static_cast<uint32_t>(std::size(TriangleIndices));
+    const float* offsets    = static_cast<const float*>(m_Instances.StreamData(InstanceData::Offset));
+    const float* transforms = static_cast<const float*>(m_Instances.StreamData(InstanceData::Transform));
+    for (uint32_t i = 0; i < m_Instances.Count(); i++)
+    {
+        float radius = meshRadius * std::hypot(transforms[2 * i], transforms[2 * i + 1]);
+        if (frustum.IntersectsSphere(offsets[2 * i], offsets[2 * i + 1], 0.0f, radius))
+        {
+            PushDrawIndices(commandBuffer);
+            vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, i);
+        }
+    }
+}
+
+void HelloTriangleApplication::CreateGeometryBuffers()
+{
+    PROFILE_SCOPE("CreateGeometryBuffers");
+    m_StagingRing.Create(m_Device, m_Allocator, StagingRing::DefaultCapacity, m_Config.framesInFlight);
+
+    //顶点和索引都放在设备本地内存中，GPU读取最快；CPU不能直接写，所以经暂存环形缓冲复制过去
+    AllocationCreateInfo allocInfo = {};
+    allocInfo.requiredFlags        = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    m_VertexBuffers.resize(m_Config.framesInFlight);
+    for (auto& vertexBuffer : m_VertexBuffers)
+    {
+        vertexBuffer = m_Allocator.CreateBuffer(sizeof(TriangleVertices),
+                                                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                allocInfo);
+    }
+    m_IndexBuffer = m_Allocator.CreateBuffer(sizeof(TriangleIndices),
+                                             VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                             allocInfo);
+
+    //索引不会变化，只上传一次，随第一帧的命令一起复制
+    m_StagingRing.Upload(m_IndexBuffer.buffer, 0, TriangleIndices, sizeof(TriangleIndices));
+}
+
+void HelloTriangleApplication::CreateDefaultTexture()
+{
+    PROFILE_SCOPE("CreateDefaultTexture");
+    if (m_TexturedFragmentShaderModule == VK_NULL_HANDLE) return;
+
+    //8x8像素一格的棋盘格，白格和灰格与顶点颜色相乘，纹理坐标的方向一眼就能看出来
+    constexpr uint32_t   Size = 64;
+    std::vector<uint8_t> pixels(Size * Size * 4);
+    for (uint32_t y = 0; y < Size; y++)
+    {
+        for (uint32_t x = 0; x < Size; x++)
+        {
+            uint8_t  value = ( ( x / 8 + y / 8 ) % 2 == 0 ) ? 255 : 128;
+            uint8_t* pixel = &pixels[( y * Size + x ) * 4];
+            pixel[0]       = value;
+            pixel[1]       = value;
+            pixel[2]       = value;
+            pixel[3]       = 255;
+        }
+    }
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType         = VK_IMAGE_TYPE_2D;
+    imageInfo.format            = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent            = {Size, Size, 1};
+    imageInfo.mipLevels         = 1;
+    imageInfo.arrayLayers       = 1;
+    imageInfo.samples           = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling            = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage             = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (m_DefaultTexture.Create(m_Device, vkCreateImage, imageInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建默认纹理失败");
+    }
+
+    AllocationCreateInfo allocInfo = {};
+    allocInfo.requiredFlags        = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    allocInfo.kind                 = ResourceKind::Optimal;
+    m_DefaultTextureMemory         = m_Allocator.AllocateForImage(m_DefaultTexture, allocInfo);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType                 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image                 = m_DefaultTexture;
+    viewInfo.viewType              = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format                = imageInfo.format;
+    viewInfo.subresourceRange      = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    if (m_DefaultTextureView.Create(m_Device, vkCreateImageView, viewInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建默认纹理的图像视图失败");
+    }
+
+    //整张图像一次复制，满足任何队列族的传输粒度；复制和到SHADER_READ_ONLY的转换随第一帧的命令录制，
+    //描述符也在第一帧开始时写入，之前没有绘制会读取它
+    VkBufferImageCopy region = {};
+    region.imageSubresource  = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent       = imageInfo.extent;
+    if (!m_StagingRing.UploadImage(m_DefaultTexture, region, pixels.data(), pixels.size(), true, true))
+    {
+        throw std::runtime_error("暂存环形缓冲放不下默认纹理");
+    }
+    m_DefaultTextureIndex = m_DescriptorHeap.AddImage(m_DefaultTextureView);
+}
 
-    if (vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_GraphicsPipeline) !=
-        VK_SUCCESS)
+void HelloTriangleApplication::UpdateGeometry()
+{
+    //动态几何：每帧在CPU上旋转顶点并重新上传。暂存区满时这一帧沿用上一帧的顶点，不等待GPU
+    float angle = static_cast<float>(m_FrameTimer.TotalFrames()) * 0.01f;
+    float c     = std::cos(angle);
+    float s     = std::sin(angle);
+
+    Vertex vertices[std::size(TriangleVertices)];
+    for (size_t i = 0; i < std::size(TriangleVertices); i++)
     {
-        throw std::runtime_error("failed to create graphics pipeline!");
+        vertices[i]             = TriangleVertices[i];
+        vertices[i].position[0] = TriangleVertices[i].position[0] * c - TriangleVertices[i].position[1] * s;
+        vertices[i].position[1] = TriangleVertices[i].position[0] * s + TriangleVertices[i].position[1] * c;
     }
+    m_StagingRing.Upload(m_VertexBuffers[m_CurrentFrame].buffer, 0, vertices, sizeof(vertices));
 }
 
-VkShaderModule HelloTriangleApplication::CreateShaderModule(const std::vector<char>& code)
+void HelloTriangleApplication::CreateInstances(uint32_t count , float extent)
 {
-    VkShaderModuleCreateInfo createInfo = {};
-    createInfo.sType                    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize                 = code.size();
-    createInfo.pCode                    = reinterpret_cast<const uint32_t*>(code.data());
+    PROFILE_SCOPE("CreateInstances");
+    //飞行中的帧可能还在读取旧的实例缓冲，交给删除队列，不需要等待设备空闲
+    if (m_InstanceBuffer.Capacity() > 0)
+    {
+        InstanceBuffer retired = std::move(m_InstanceBuffer);
+        m_InstanceBuffer       = {};
+        m_DeletionQueue.Push(m_SubmittedSerial, [retired]() mutable { retired.Destroy(); });
+    }
+    m_Instances.FillGrid(count, extent);
+    //纹理的屏幕尺寸估计在下一次UpdateTextures时按新的实例重新计算
+    m_TextureScaleCount = 0;
+    if (count > 0)
+    {
+        //异步计算队列上的剔除和图形队列都读取实例缓冲
+        uint32_t families[] = {m_Queues.graphics.family, m_Queues.compute.family};
+        bool     shared     = m_GpuCullingEnabled && m_Queues.HasAsyncCompute();
+        m_InstanceBuffer.Create(m_Allocator, count, m_Config.framesInFlight,
+                                std::span<const uint32_t>(families, shared ? 2 : 0));
+    }
+    if (m_GpuCuller.Enabled())
+    {
+        m_GpuCuller.Reserve(count, m_DeletionQueue, m_SubmittedSerial);
+    }
+}
+
+void HelloTriangleApplication::UpdateInstances()
+{
+    if (m_Instances.Count() == 0) return;
+
+    //三角形本身已经随UpdateGeometry旋转，这里再让每个实例绕自己的中心反向转动
+    m_Instances.Rotate(-0.02f);
+    m_InstanceBuffer.Upload(m_CurrentFrame, m_Instances);
+}
 
-    VkShaderModule shaderModule;
-    if (vkCreateShaderModule(m_Device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+void HelloTriangleApplication::CreateTextureStreamer()
+{
+    PROFILE_SCOPE("CreateTextureStreamer");
+    if (m_Config.textureDirectory.empty()) return;
+
+    TextureStreamerConfig config;
+    config.uploadBudget = VkDeviceSize(m_Config.textureUploadKB) << 10;
+    config.memoryBudget = VkDeviceSize(m_Config.textureBudgetMB) << 20;
+    //有专用传输队列时暂存复制录制在传输队列上，分块要满足它的传输粒度
+    uint32_t uploadFamily = m_Queues.HasDedicatedTransfer() ? m_Queues.transfer.family : m_Queues.graphics.family;
+    m_TextureStreamer.Create(m_PhysicalDevice, m_Device, m_Allocator, m_StagingRing, uploadFamily, &m_DescriptorHeap,
+                             config);
+
+    //文件名排序后依次加载，句柄的顺序在每次运行之间保持一致
+    std::vector<std::string> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(m_Config.textureDirectory))
+    {
+        std::string extension = entry.path().extension().string();
+        if (entry.is_regular_file() && ( extension == ".ktx2" || extension == ".dds" ))
+        {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    for (const std::string& path : paths)
     {
-        throw std::runtime_error("failed to create shader module!");
+        m_TextureStreamer.Load(path);
+    }
+    std::cout << "texture streaming: " << paths.size() << " textures in " << m_Config.textureDirectory << '\n';
+}
+
+void HelloTriangleApplication::UpdateTextures()
+{
+    if (!m_TextureStreamer.Enabled()) return;
+
+    //按屏幕尺寸决定每张纹理驻留到哪一级：实例i使用纹理i % 纹理数，边长取实例缩放后占帧缓冲高度的像素数；
+    //没有实例时全部纹理按整个三角形的大小估计。
+    //实例只旋转不缩放，每张纹理的最大缩放在实例重建或纹理数变化后算一次，之后每帧的开销只和纹理数有关。
+    //纹理数变化时实例到纹理的对应关系全部改变，即使分组数相同也要重新计算
+    uint32_t textureCount = m_TextureStreamer.TextureCount();
+    uint32_t groupCount   = std::min(textureCount, m_Instances.Count());
+    if (m_TextureScaleCount != textureCount)
+    {
+        m_TextureScaleCount = textureCount;
+        m_TextureScales.assign(groupCount, 0.0f);
+        const float* transforms = static_cast<const float*>(m_Instances.StreamData(InstanceData::Transform));
+        for (uint32_t i = 0; i < m_Instances.Count() && groupCount > 0; i++)
+        {
+            float  x     = transforms[2 * i];
+            float  y     = transforms[2 * i + 1];
+            float& scale = m_TextureScales[i % textureCount];
+            scale        = std::max(scale, std::sqrt(x * x + y * y));
+        }
+    }
+
+    float height = static_cast<float>(m_SwapChainExtent.height);
+    for (TextureHandle texture = 0; texture < textureCount; texture++)
+    {
+        float pixels = height * 0.5f;
+        if (m_TextureScreenOverride > 0.0f)
+        {
+            pixels = m_TextureScreenOverride;
+        }
+        else if (m_Instances.Count() > 0)
+        {
+            //实例比纹理少时，没有实例使用的纹理不报告，闲置后退回mip尾部
+            if (texture >= groupCount) continue;
+            pixels = m_TextureScales[texture] * height * 0.5f;
+        }
+        m_TextureStreamer.ReportScreenSize(texture, pixels);
+    }
+    m_TextureStreamer.Update(m_DeletionQueue, m_SubmittedSerial);
+    UpdateTextureTable();
+}
+
+/*
+ * 在Update之后把每张流送纹理当前的描述符索引写进本帧的纹理索引表，这一帧刚换上的图像同一帧就能采样到；
+ * 还没有驻留的纹理写默认纹理。表在这套帧资源的栅栏之后写入，GPU不会同时读取。
+ * 纹理数超过表的容量时换一组更大的表，旧表和它们的描述符槽位交给删除队列
+ */
+void HelloTriangleApplication::UpdateTextureTable()
+{
+    uint32_t textureCount = m_TextureStreamer.TextureCount();
+    if (!m_HeapSamplingEnabled || textureCount == 0) return;
+
+    if (textureCount > m_TextureTableCapacity)
+    {
+        for (size_t i = 0; i < m_TextureTables.size(); i++)
+        {
+            DescriptorHeap*        heap       = &m_DescriptorHeap;
+            DeviceMemoryAllocator* allocator  = &m_Allocator;
+            uint32_t               descriptor = m_TextureTableIndices[i];
+            m_DeletionQueue.Push(m_SubmittedSerial, [heap, allocator, descriptor, table = m_TextureTables[i]]() mutable
+            {
+                heap->Release(DescriptorKind::StorageBuffer, descriptor);
+                allocator->DestroyBuffer(table);
+            });
+        }
+
+        m_TextureTableCapacity = std::max(textureCount, m_TextureTableCapacity * 2);
+        AllocationCreateInfo tableInfo = {};
+        tableInfo.requiredFlags        = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        m_TextureTables.resize(m_Config.framesInFlight);
+        m_TextureTableIndices.resize(m_Config.framesInFlight);
+        for (uint32_t i = 0; i < m_Config.framesInFlight; i++)
+        {
+            m_TextureTables[i] = m_Allocator.CreateBuffer(sizeof(uint32_t) * m_TextureTableCapacity,
+                                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, tableInfo);
+            if (m_TextureTables[i].allocation.mapped == nullptr)
+            {
+                throw std::runtime_error("纹理索引表没有映射到主机地址");
+            }
+            m_TextureTableIndices[i] = m_DescriptorHeap.AddBuffer(m_TextureTables[i].buffer);
+        }
+    }
+
+    auto* table = static_cast<uint32_t*>(m_TextureTables[m_CurrentFrame].allocation.mapped);
+    for (TextureHandle texture = 0; texture < textureCount; texture++)
+    {
+        uint32_t descriptor = m_TextureStreamer.DescriptorIndex(texture);
+        table[texture]      = descriptor != DescriptorHeap::InvalidIndex ? descriptor : m_DefaultTextureIndex;
+    }
+    m_TextureTableCount = textureCount;
+}
+
+void HelloTriangleApplication::CreateOffscreenTargets()
+{
+    PROFILE_SCOPE("CreateOffscreenTargets");
+    //R8G8B8A8_UNORM作为颜色附着是所有实现都必须支持的格式
+    m_SwapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    m_SwapChainExtent      = {Width, Height};
+
+    m_SwapChainImages.resize(OffscreenImageCount);
+    m_OffscreenImages.resize(OffscreenImageCount);
+    m_OffscreenMemory.resize(OffscreenImageCount);
+    for (uint32_t i = 0; i < OffscreenImageCount; i++)
+    {
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType         = VK_IMAGE_TYPE_2D;
+        imageInfo.format            = m_SwapChainImageFormat;
+        imageInfo.extent            = {m_SwapChainExtent.width, m_SwapChainExtent.height, 1};
+        imageInfo.mipLevels         = 1;
+        imageInfo.arrayLayers       = 1;
+        imageInfo.samples           = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling            = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage             = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (m_OffscreenImages[i].Create(m_Device, vkCreateImage, imageInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("创建离屏图像失败");
+        }
+        m_SwapChainImages[i] = m_OffscreenImages[i];
+
+        //三张图像从同一块设备内存中子分配，而不是各自调用一次vkAllocateMemory
+        AllocationCreateInfo allocInfo = {};
+        allocInfo.requiredFlags        = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        m_OffscreenMemory[i]           = m_Allocator.AllocateForImage(m_SwapChainImages[i], allocInfo);
     }
-    return shaderModule;
 }
@@ -1,9 +1,49 @@
 ﻿#pragma once
 
+#include <chrono>
+#include <memory>
+#include <set>
+#include <span>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan.h>
+#include "AppConfig.h"
+#include "DeletionQueue.h"
+#include "DescriptorHeap.h"
+#include "DeviceMemoryAllocator.h"
+#include "FramePacer.h"
+#include "GpuCuller.h"
+#include "GpuProfiler.h"
+#include "InstanceBuffer.h"
+#include "InstanceData.h"
+#include "ParallelRecorder.h"
+#include "PipelineCache.h"
+#include "PipelineCompiler.h"
+#include "PipelineStateCache.h"
+#include "PipelineVariants.h"
+#include "QueueTopology.h"
+#include "RenderGraph.h"
+#include "ShaderModuleCache.h"
+#include "StagingRing.h"
+#include "TextureStreamer.h"
+#include "ValidationLogger.h"
+#include "VulkanHandle.h"
+#include "../Tool/FrameTimer.h"
 #include "../Tool/Loader.h"
+#include "../Tool/MappedFile.h"
+
+//校验层扩展函数的代理，销毁函数同时作为UniqueDebugMessenger的销毁函数
+VkResult CreateDebugUtilsMessengerEXT(VkInstance                                instance ,
+                                      const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo ,
+                                      const VkAllocationCallbacks*              pAllocator ,
+                                      VkDebugUtilsMessengerEXT*                 pDebugMessenger);
+void DestroyDebugUtilsMessengerEXT(VkInstance                   instance ,
+                                   VkDebugUtilsMessengerEXT     debugMessenger ,
+                                   const VkAllocationCallbacks* pAllocator);
+
+using UniqueDebugMessenger = ChildHandle<VkInstance, VkDebugUtilsMessengerEXT, DestroyDebugUtilsMessengerEXT>;
 
 struct SwapChainSupportDetails
 {
@@ -12,23 +52,78 @@ struct SwapChainSupportDetails
     std::vector<VkPresentModeKHR>   presentModes;
 };
 
+//每个飞行中的帧独占一套录制与同步对象，CPU录制第N+1帧时不会碰到GPU仍在使用的第N帧的资源
+//命令缓冲随命令池一起释放，不单独包装
+struct FrameResources
+{
+    UniqueCommandPool commandPool;
+    VkCommandBuffer   commandBuffer  = VK_NULL_HANDLE;
+    UniqueSemaphore   imageAvailable; //交换链图像可用后发出信号，提交等待它
+    UniqueFence       inFlight;       //GPU执行完这一帧后发出信号，CPU复用这套资源前等待它
+    uint64_t          serial = 0;     //这套资源最近一次提交的帧序号
+
+    //有专用传输队列时，本帧的上传在传输队列上单独提交，图形提交等待uploadFinished
+    UniqueCommandPool transferPool;
+    VkCommandBuffer   transferCommands = VK_NULL_HANDLE;
+    UniqueSemaphore   uploadFinished;
+    bool              uploadSubmitted  = false;
+
+    //有异步计算队列时，本帧的GPU剔除在计算队列上单独提交，图形提交等待cullFinished
+    UniqueCommandPool computePool;
+    VkCommandBuffer   computeCommands  = VK_NULL_HANDLE;
+    UniqueSemaphore   cullFinished;
+    bool              cullSubmitted    = false;
+};
+
 class HelloTriangleApplication
 {
 public:
-    HelloTriangleApplication() = default;
+    explicit HelloTriangleApplication(const AppConfig& config = {});
 
     void run();
 
 private:
+    //窗口的初始尺寸，也是无头模式下离屏图像的尺寸
+    static constexpr uint32_t Width  = 800;
+    static constexpr uint32_t Height = 600;
+
+    void InitGlfw();
     void InitWindow();
 
 
+    //启动步骤组成的依赖任务图，互不依赖的步骤并发执行，结束时输出每个步骤的耗时
     void InitVulkan();
 
     void MainLoop();
+    bool ShouldClose(uint64_t renderedFrames);
+    void DrawFrame();
+    void RecordCommandBuffer(VkCommandBuffer commandBuffer , uint32_t imageIndex);
+    bool UseParallelRecording() const;
+    bool UseGpuCulling() const;
+    void RecordScene(const RenderPassContext& context);
+    void RecordDrawState(VkCommandBuffer commandBuffer);
+    void PushDrawIndices(VkCommandBuffer commandBuffer);
+    void RecordDraws(VkCommandBuffer commandBuffer , uint32_t firstInstance , uint32_t count);
+    void RecordCulling(VkCommandBuffer commandBuffer , uint32_t cullFamily);
+    void RecordCpuCulledDraws(VkCommandBuffer commandBuffer);
 
     void CleanUp();
 
+    //基准测试，实现在Benchmark.cpp中
+    void RunBenchmark();
+    void BenchmarkPipelineCompilation();
+    void BenchmarkInstancing();
+    void BenchmarkResize();
+    void BenchmarkPresent();
+    void BenchmarkRecording();
+    void BenchmarkRenderGraph();
+    void BenchmarkBindless();
+    void BenchmarkCulling();
+    void BenchmarkMath();
+    void BenchmarkPipelineVariants();
+    void BenchmarkPipelineStates();
+    void BenchmarkTextures();
+
     void CreateInstance();
 
 
@@ -45,12 +140,16 @@ private:
     void CreateSurface();
     void ChoosePhysicalDevice();
     void ChooseBestDevice(std::vector<VkPhysicalDevice> devices);
+    void ChooseCalibratedDevice(const std::vector<VkPhysicalDevice>& candidates);
     int  CalculateScore(VkPhysicalDevice device);
 
     bool CheckPhysicsDevice(VkPhysicalDevice device);
     bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
-    int  GetQueueFamiliesIndex(VkPhysicalDevice device , VkQueueFlagBits queueFlags);
     bool CheckQueueFamilies(VkPhysicalDevice device);
+    bool HasDeviceExtensions(std::set<std::string> required);
+    bool CheckPresentWaitSupport();
+    bool CheckDescriptorIndexingSupport();
+    bool CheckExtendedDynamicStateSupport();
 
     SwapChainSupportDetails GetSwapChainDetails(VkPhysicalDevice device);
     bool                    CheckSwapChainSupport(VkPhysicalDevice device);
@@ -60,40 +159,193 @@ private:
 
 
     void           CreateSwapChain();
+    void           RecreateSwapChain();
+    void           RetireSwapChain();
+    static void    FramebufferResizeCallback(GLFWwindow* window , int width , int height);
     void           CreateLogicalDevice();
     void           CreateImageViews();
-    void           CreateRenderPass();
+    void           CreateRenderGraph();
+    void           LoadShaderCode();
+    void           CreateShaderModules();
+    void           CreateDescriptorHeap();
+    void           CreateGpuCuller();
     void           CreateGraphicsPipeline();
-    VkShaderModule CreateShaderModule(const std::vector<char>& code);
+    VkShaderModule LoadShader(const std::string& name);
+    void           CreateFramebuffers();
+    void           CreateFrameResources();
+    void           CreateOffscreenTargets();
+    void           CreateGeometryBuffers();
+    void           CreateDefaultTexture();
+    void           UpdateGeometry();
+    void           SubmitUploads(FrameResources& frame);
+    void           SubmitCulling(FrameResources& frame);
+    void           PaceFrame();
+    void           CreateInstances(uint32_t count , float extent = 1.0f);
+    void           UpdateInstances();
+    void           CreateTextureStreamer();
+    void           UpdateTextures();
+    void           UpdateTextureTable();
 
 
     void HandleAppInfo(VkApplicationInfo& appInfo);
-    void HandleCreateInfo(const VkApplicationInfo& appInfo , VkInstanceCreateInfo& createInfo);
+    void HandleCreateInfo(const VkApplicationInfo&          appInfo , const std::vector<const char*>& extensions ,
+                          VkDebugUtilsMessengerCreateInfoEXT& debugCreateInfo , VkInstanceCreateInfo& createInfo);
     void HandleCreateInfo_DebugMessager(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
-    void HandleCreateInfo_DeviceQueue(VkDeviceQueueCreateInfo& queueCreateInfo , const float& queuePriority ,
-                                      int                      queueFamilyIndex);
-    void HandleCreateInfo_Device(VkDeviceQueueCreateInfo queueCreateInfo , VkPhysicalDeviceFeatures& deviceFeatures ,
-                                 VkDeviceCreateInfo&     createInfo);
+    void HandleCreateInfo_Device(const std::vector<VkDeviceQueueCreateInfo>& queueCreateInfos ,
+                                 VkPhysicalDeviceFeatures&                   deviceFeatures ,
+                                 VkDeviceCreateInfo&                         createInfo);
     VkSwapchainCreateInfoKHR HandleCreateInfo_SwapChain();
 
+    AppConfig                m_Config;
+    std::vector<const char*> m_DeviceExtensions;
+
+    //启动计时：run()开始的时刻，以及到启动任务图完成为止的耗时
+    std::chrono::steady_clock::time_point m_LaunchTime;
+    double                                m_StartupMs = 0.0;
 
     //窗口相关
-    GLFWwindow* m_Window;
-    //Vulkan相关
-    VkInstance               m_Instance;
-    VkDebugUtilsMessengerEXT m_Messenger;
-    //这一对象可以在VkInstance进行清除操作时，自动清除自己，所以我们不需要再cleanup函数中对它进行清除。
-    VkSurfaceKHR             m_Surface;
-    VkPhysicalDevice         m_PhysicalDevice;
-    VkDevice                 m_Device;
-    VkQueue                  m_GraphicsQueue;
-    VkQueue                  m_PresentQueue;
-    VkSwapchainKHR           m_SwapChain;
-    std::vector<VkImage>     m_SwapChainImages;
-    VkFormat                 m_SwapChainImageFormat;
-    VkExtent2D               m_SwapChainExtent;
-    std::vector<VkImageView> m_ImageViews;
-    VkRenderPass             m_RenderPass;
-    VkPipelineLayout         m_PipelineLayout;
-    VkPipeline               m_GraphicsPipeline;
+    GLFWwindow* m_Window = nullptr;
+    //校验层回调只把消息交给它，由后台线程输出。实例销毁期间仍有消息，要比实例活得更久，所以声明在最前面
+    ValidationLogger m_ValidationLogger;
+
+    //Vulkan相关。RAII句柄按声明的逆序析构：先声明的父对象(实例、设备)最后销毁。
+    //CleanUp按同样的顺序显式释放，析构函数只在初始化中途抛出异常时兜底
+    UniqueInstance                 m_Instance;
+    UniqueDebugMessenger           m_Messenger;
+    UniqueSurface                  m_Surface;
+    VkPhysicalDevice               m_PhysicalDevice;
+    UniqueDevice                   m_Device;
+    QueueTopology                  m_Queues;
+    VkQueue                        m_GraphicsQueue;
+    VkQueue                        m_PresentQueue;
+    VkQueue                        m_ComputeQueue;
+    VkQueue                        m_TransferQueue;
+    UniqueSwapchain                m_SwapChain;
+    std::vector<VkImage>           m_SwapChainImages;
+    VkFormat                       m_SwapChainImageFormat;
+    VkExtent2D                     m_SwapChainExtent;
+    std::vector<UniqueImageView>   m_ImageViews;
+    UniquePipelineLayout           m_PipelineLayout;
+    DeviceMemoryAllocator          m_Allocator;
+    PipelineCache              m_PipelineCache;
+    ShaderModuleCache          m_ShaderModules;
+    GpuProfiler                m_GpuProfiler;
+    VkShaderModule             m_VertexShaderModule;
+    VkShaderModule             m_InstancedVertexShaderModule;
+    VkShaderModule             m_FragmentShaderModule;
+    //m_HeapSamplingEnabled时的场景片段着色器，此时m_FragmentShaderModule也是它
+    VkShaderModule             m_TexturedFragmentShaderModule = VK_NULL_HANDLE;
+    //启动时预先读取的SPIR-V，从文件读取时映射保留到程序结束，span指向映射的内容或内嵌的数组
+    std::vector<MappedFile>                                    m_ShaderFiles;
+    std::unordered_map<std::string, std::span<const uint32_t>> m_ShaderCode;
+
+    std::unique_ptr<PipelineCompiler> m_PipelineCompiler;
+
+    //全部图形管线按规范化的状态键存放在这里。设备支持VK_EXT_extended_dynamic_state时，
+    //剔除模式、正面朝向和图元类型是动态状态，只在这些状态上不同的绘制共用一条管线
+    PipelineStateCache            m_PipelineStates;
+    ExtendedDynamicStateFunctions m_ExtendedDynamicState;
+
+    //场景管线按特化常量分成变体，第一次用到时才编译。各组的着色器和顶点输入不同，变体的选项相同。
+    //m_CulledPipelines只在GPU剔除启用时创建，逐实例数据经可见列表从存储缓冲读取
+    PipelineVariantCache m_ScenePipelines;
+    PipelineVariantCache m_InstancedPipelines;
+    PipelineVariantCache m_CulledPipelines;
+    VariantKey           m_SceneVariant;
+
+    //渲染图：渲染流程、帧缓冲、附着的布局转换和依赖都由它推导，目前只有一个写入交换链图像的场景过程
+    RenderGraph    m_RenderGraph;
+    RenderResource m_BackBuffer = 0;
+    RenderPassId   m_ScenePass  = 0;
+
+    //无绑定描述符堆：全部缓冲、纹理和采样器在同一个描述符集中，每个命令缓冲只绑定一次，绘制通过push constant传入索引。
+    //需要设备扩展VK_EXT_descriptor_indexing，不支持时管线布局中没有描述符集
+    DescriptorHeap                                m_DescriptorHeap;
+    DescriptorHeapCapacity                        m_BindlessCapacity;
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT m_IndexingFeatures          = {}; //创建设备时启用的特性
+    bool                                          m_DescriptorIndexingEnabled = false;
+    bool                                          m_HeapSamplingEnabled       = false; //着色器可以按索引采样堆中的纹理
+    UniqueSampler                                 m_DefaultSampler;
+    uint32_t                                      m_DefaultSamplerIndex = DescriptorHeap::InvalidIndex;
+    //默认纹理：64x64的棋盘格，场景的每次绘制都用它，随第一帧上传
+    UniqueImage                                   m_DefaultTexture;
+    UniqueImageView                               m_DefaultTextureView;
+    Allocation                                    m_DefaultTextureMemory;
+    uint32_t                                      m_DefaultTextureIndex = DescriptorHeap::InvalidIndex;
+
+    //呈现策略和帧节奏。present wait需要实例扩展VK_KHR_get_physical_device_properties2查询设备特性
+    PresentPolicy           m_PresentPolicy                = PresentPolicy::LowLatency;
+    VkPresentModeKHR        m_PresentMode                  = VK_PRESENT_MODE_FIFO_KHR;
+    double                  m_RefreshHz                    = 0.0;
+    bool                    m_HasPhysicalDeviceProperties2 = false;
+    bool                    m_HasDeviceIdProperties        = false; //VK_KHR_external_memory_capabilities，设备校准用deviceUUID作缓存键
+    bool                    m_PresentWaitEnabled           = false;
+    PFN_vkWaitForPresentKHR m_WaitForPresent               = nullptr;
+    FramePacer              m_FramePacer;
+
+    //交换链重建：窗口尺寸变化由回调标记，旧交换链经m_DeletionQueue在用到它的帧和它的呈现都完成之后才销毁，重建过程不等待设备空闲
+    bool     m_FramebufferResized = false;
+    uint32_t m_RecreateCount      = 0;
+    double   m_RecreateMs         = 0.0;
+
+    //无头模式下代替交换链图像的离屏图像，m_SwapChainImages中保存它们的原始句柄
+    std::vector<UniqueImage> m_OffscreenImages;
+    std::vector<Allocation>  m_OffscreenMemory;
+    uint32_t                 m_OffscreenImageIndex = 0;
+
+    //帧循环相关
+    std::vector<FrameResources> m_Frames;
+    //记录每张交换链图像正在被哪一帧的栅栏占用，飞行帧数大于交换链图像数时防止同一图像被重复使用
+    std::vector<VkFence>        m_ImagesInFlight;
+    //每张交换链图像一个：渲染完成后发出信号，呈现等待它。
+    //呈现引擎何时结束等待无从得知，只有再次获取到同一张图像时才能确定上一次的等待已经完成，
+    //所以这个信号量只能按图像索引复用，按飞行帧复用会在呈现还没消耗信号时再次发出信号
+    std::vector<UniqueSemaphore> m_RenderFinished;
+    uint32_t                    m_CurrentFrame = 0;
+    //已提交的帧数和已确认完成的最大帧序号。同一队列上的提交按顺序完成，序号之前的帧也都完成了
+    uint64_t                    m_SubmittedSerial = 0;
+    uint64_t                    m_CompletedSerial = 0;
+    FrameTimer                  m_FrameTimer;
+    //上一帧CPU端更新数据、录制和提交命令的耗时，不包括等待栅栏和获取图像
+    double                      m_LastCpuFrameMs = 0.0;
+    //上一帧录制主命令缓冲(包括并行录制的secondary命令缓冲)的耗时
+    double                      m_LastRecordMs = 0.0;
+    //--record-threads大于0时，逐实例的绘制列表由它并行录制
+    ParallelRecorder            m_Recorder;
+
+    //几何数据：设备本地的顶点/索引缓冲，经暂存环形缓冲上传
+    //顶点每帧都会更新，每套帧资源各用一个顶点缓冲，上传时不必等待其它帧读完
+    StagingRing            m_StagingRing;
+    std::vector<GpuBuffer> m_VertexBuffers;
+    GpuBuffer              m_IndexBuffer;
+
+    //实例化绘制：CPU端的SoA实例数据，每帧memcpy到本帧的实例缓冲
+    InstanceData   m_Instances;
+    InstanceBuffer m_InstanceBuffer;
+
+    //纹理流送(--textures)：后台读取BC压缩纹理，每帧在上传预算内分块上传。
+    //m_TextureScreenOverride大于0时代替按实例估计的屏幕尺寸，基准测试用它模拟镜头拉近拉远
+    TextureStreamer    m_TextureStreamer;
+    float              m_TextureScreenOverride = 0.0f;
+    std::vector<float> m_TextureScales;         //使用每张纹理的实例中最大的缩放
+    uint32_t           m_TextureScaleCount = 0; //m_TextureScales按这个纹理数分组，和当前纹理数不同或实例重建时重新计算
+    //纹理索引表：每套帧资源一个主机可见的存储缓冲，注册在描述符堆中。第t项是纹理t当前的描述符索引，
+    //还没有驻留时是默认纹理；实例i的片段着色器使用第i % m_TextureTableCount项
+    std::vector<GpuBuffer> m_TextureTables;
+    std::vector<uint32_t>  m_TextureTableIndices;
+    uint32_t               m_TextureTableCapacity = 0;
+    uint32_t               m_TextureTableCount    = 0; //本帧的表中写入的项数
+
+    //GPU剔除(--gpu-culling)：计算着色器把可见实例压缩成列表并生成一条间接绘制命令。m_CpuCulling是基准测试的对照组：
+    //CPU逐个测试实例，每个可见实例录制一次绘制
+    bool                                 m_GpuCullingEnabled        = false;
+    PFN_vkCmdDrawIndexedIndirectCountKHR m_DrawIndirectCount        = nullptr;
+    VkShaderModule                       m_CullShaderModule         = VK_NULL_HANDLE;
+    VkShaderModule                       m_CulledVertexShaderModule = VK_NULL_HANDLE;
+    GpuCuller                            m_GpuCuller;
+    bool                                 m_CpuCulling               = false;
+
+    //GPU可能仍在使用的对象交给它，登记时的帧序号完成后再销毁。
+    //登记的销毁操作可能引用上面的分配器等成员，所以放在最后声明、最先析构
+    DeletionQueue m_DeletionQueue;
 };
@@ -0,0 +1,150 @@
+﻿#include "ParallelRecorder.h"
+
+#include <algorithm>
+#include <future>
+#include <stdexcept>
+
+#include "../Tool/Profiler.h"
+
+void ParallelRecorder::Create(VkDevice device , uint32_t queueFamily , uint32_t framesInFlight , uint32_t threadCount)
+{
+    m_Device      = device;
+    m_ThreadCount = std::max(threadCount, 1u);
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex        = queueFamily;
+
+    m_Slices.resize(framesInFlight);
+    for (auto& frame : m_Slices)
+    {
+        frame.resize(m_ThreadCount);
+        for (auto& slice : frame)
+        {
+            if (slice.pool.Create(m_Device, vkCreateCommandPool, poolInfo) != VK_SUCCESS)
+            {
+                throw std::runtime_error("创建录制线程的命令池失败");
+            }
+
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool                 = slice.pool;
+            allocInfo.level                       = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount          = 1;
+            if (vkAllocateCommandBuffers(m_Device, &allocInfo, &slice.commandBuffer) != VK_SUCCESS)
+            {
+                throw std::runtime_error("分配secondary命令缓冲失败");
+            }
+        }
+    }
+
+    if (m_ThreadCount > 1)
+    {
+        m_Pool = std::make_unique<ThreadPool>(m_ThreadCount - 1);
+    }
+}
+
+void ParallelRecorder::Destroy()
+{
+    //先停掉线程池，再销毁它可能还在使用的命令池
+    m_Pool.reset();
+    m_Slices.clear();
+    m_Recorded.clear();
+    m_ThreadCount = 0;
+}
+
+const std::vector<VkCommandBuffer>& ParallelRecorder::Record(uint32_t                              frameIndex ,
+                                                             const VkCommandBufferInheritanceInfo& inheritance ,
+                                                             uint32_t                              drawCount ,
+                                                             const RecordFunction&                 record)
+{
+    PROFILE_SCOPE("ParallelRecord");
+    auto& slices = m_Slices[frameIndex];
+
+    //区间数不超过绘制数，每段至少一个绘制；前drawCount % sliceCount段各多分一个
+    uint32_t sliceCount = std::max(std::min(m_ThreadCount, drawCount), 1u);
+    uint32_t base       = drawCount / sliceCount;
+    uint32_t remainder  = drawCount % sliceCount;
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(sliceCount);
+    m_Recorded.clear();
+
+    uint32_t first      = 0;
+    uint32_t firstCount = 0;
+    for (uint32_t i = 0; i < sliceCount; i++)
+    {
+        uint32_t count = base + ( i < remainder ? 1 : 0 );
+        if (i == 0)
+        {
+            firstCount = count;
+        }
+        else
+        {
+            //区间参数按值捕获，其余按引用：Record返回前会等待全部任务完成
+            futures.push_back(m_Pool->Submit(0, [this, &slices, &inheritance, &record, i, first, count]()
+            {
+                RecordSlice(slices[i], inheritance, first, count, record);
+            }));
+        }
+        m_Recorded.push_back(slices[i].commandBuffer);
+        first += count;
+    }
+
+    //主线程不闲着，录制第0段。
+    //无论哪一段抛出异常，都要先等所有任务结束，任务不能在Record返回后继续引用它的参数
+    std::exception_ptr error;
+    try
+    {
+        RecordSlice(slices[0], inheritance, 0, firstCount, record);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    for (auto& future : futures)
+    {
+        try
+        {
+            future.get();
+        }
+        catch (...)
+        {
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return m_Recorded;
+}
+
+void ParallelRecorder::RecordSlice(SliceResources&                       slice ,
+                                   const VkCommandBufferInheritanceInfo& inheritance ,
+                                   uint32_t                              first ,
+                                   uint32_t                              count ,
+                                   const RecordFunction&                 record)
+{
+    PROFILE_SCOPE("RecordSlice");
+    //调用者已经等待过这套帧资源的栅栏，上一次录制的命令不再被GPU使用
+    vkResetCommandPool(m_Device, slice.pool, 0);
+
+    //RENDER_PASS_CONTINUE：整个命令缓冲在主命令缓冲的渲染流程之内执行，渲染流程和帧缓冲从inheritance继承
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+            VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+
+    if (vkBeginCommandBuffer(slice.commandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("开始录制secondary命令缓冲失败");
+    }
+    record(slice.commandBuffer, first, count);
+    if (vkEndCommandBuffer(slice.commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("结束录制secondary命令缓冲失败");
+    }
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "VulkanHandle.h"
+#include "../Tool/ThreadPool.h"
+
+/*
+ * 多线程录制secondary命令缓冲。
+ * 绘制列表按线程数切成互不重叠的连续区间，每个区间由一个线程录制进自己的secondary命令缓冲，
+ * 主线程负责第0段，其余各段交给工作线程，全部完成后由调用者在主命令缓冲里用vkCmdExecuteCommands依次执行。
+ *
+ * 命令池是外部同步的对象，不能被两个线程同时使用：每套帧资源、每个区间各有一个命令池，
+ * 一个区间在一帧内只由一个线程录制，所以命令池之间不需要加锁。
+ * 命令池在这套帧资源的栅栏等待过之后整体重置，secondary命令缓冲在Create时分配一次，之后反复使用。
+ */
+class ParallelRecorder
+{
+public:
+    //在secondary命令缓冲中录制绘制列表[first, first + count)的回调，会在多个线程上同时调用
+    using RecordFunction = std::function<void(VkCommandBuffer commandBuffer , uint32_t first , uint32_t count)>;
+
+    //threadCount包括主线程，为1时全部在调用线程上录制
+    void Create(VkDevice device , uint32_t queueFamily , uint32_t framesInFlight , uint32_t threadCount);
+    void Destroy();
+
+    //在等待过frameIndex这套帧资源的栅栏之后、主命令缓冲的渲染流程(SECONDARY_COMMAND_BUFFERS)之内调用。
+    //返回录制好的secondary命令缓冲，按区间顺序排列，执行顺序和单线程录制时相同
+    const std::vector<VkCommandBuffer>& Record(uint32_t                              frameIndex ,
+                                               const VkCommandBufferInheritanceInfo& inheritance ,
+                                               uint32_t                              drawCount ,
+                                               const RecordFunction&                 record);
+
+    uint32_t ThreadCount() const { return m_ThreadCount; }
+    bool     Enabled() const { return m_ThreadCount > 0; }
+
+private:
+    struct SliceResources
+    {
+        UniqueCommandPool pool;
+        VkCommandBuffer   commandBuffer = VK_NULL_HANDLE;
+    };
+
+    void RecordSlice(SliceResources&                       slice ,
+                     const VkCommandBufferInheritanceInfo& inheritance ,
+                     uint32_t                              first ,
+                     uint32_t                              count ,
+                     const RecordFunction&                 record);
+
+    VkDevice m_Device      = VK_NULL_HANDLE;
+    uint32_t m_ThreadCount = 0;
+
+    //m_Slices[帧序号][区间序号]
+    std::vector<std::vector<SliceResources>> m_Slices;
+    std::vector<VkCommandBuffer>             m_Recorded;
+
+    //主线程之外的录制线程，线程数为1时为空
+    std::unique_ptr<ThreadPool> m_Pool;
+};
@@ -0,0 +1,191 @@
+﻿#include "PipelineCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "../Tool/Hash.h"
+
+void PipelineCache::Create(VkPhysicalDevice physicalDevice , VkDevice device , const std::string& path)
+{
+    m_Device = device;
+    m_Path   = path;
+    vkGetPhysicalDeviceProperties(physicalDevice, &m_Properties);
+
+    std::string blob;
+    if (!m_Path.empty())
+    {
+        std::string reason;
+        blob = LoadBlob(reason);
+        if (blob.empty())
+        {
+            std::cout << "pipeline cache: cold start (" << reason << ")\n";
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType                     = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize           = blob.size();
+    createInfo.pInitialData              = blob.empty() ? nullptr : blob.data();
+
+    //驱动仍然可能拒绝通过了我们校验的数据，这时退回空缓存，而不是让程序启动失败
+    if (vkCreatePipelineCache(m_Device, &createInfo, nullptr, &m_Cache) != VK_SUCCESS && !blob.empty())
+    {
+        std::cout << "pipeline cache: cold start (driver rejected cached data)\n";
+        blob.clear();
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData    = nullptr;
+        m_Cache                    = VK_NULL_HANDLE;
+        vkCreatePipelineCache(m_Device, &createInfo, nullptr, &m_Cache);
+    }
+    if (m_Cache == VK_NULL_HANDLE)
+    {
+        throw std::runtime_error("创建管线缓存失败");
+    }
+
+    m_Warm = !blob.empty();
+    if (m_Warm)
+    {
+        std::cout << "pipeline cache: warm start (" << blob.size() << " bytes from " << m_Path << ")\n";
+    }
+}
+
+std::string PipelineCache::LoadBlob(std::string& reason) const
+{
+    namespace fs = std::filesystem;
+    std::error_code error;
+    if (!fs::exists(m_Path, error))
+    {
+        reason = "no cache file";
+        return {};
+    }
+
+    uintmax_t fileSize = fs::file_size(m_Path, error);
+    if (error)
+    {
+        reason = "cannot read file size";
+        return {};
+    }
+
+    std::ifstream file(m_Path, std::ios::binary);
+    FileHeader    header = {};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        reason = "truncated header";
+        return {};
+    }
+
+    FileHeader expected;
+    MakeHeader(expected);
+    if (header.magic != Magic || header.version != Version)
+    {
+        reason = "unknown file format";
+        return {};
+    }
+    if (header.vendorID != expected.vendorID || header.deviceID != expected.deviceID ||
+        header.driverVersion != expected.driverVersion ||
+        std::memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        reason = "device or driver changed";
+        return {};
+    }
+
+    //dataSize来自文件，分配之前先和实际的文件大小比较，损坏的文件不能让分配失败而中断启动
+    if (header.dataSize != fileSize - sizeof(FileHeader))
+    {
+        reason = "data size mismatch";
+        return {};
+    }
+
+    std::string blob(header.dataSize, '\0');
+    if (!file.read(blob.data(), static_cast<std::streamsize>(blob.size())))
+    {
+        reason = "truncated data";
+        return {};
+    }
+    if (Hash::Fnv1a(blob.data(), blob.size()) != header.dataHash)
+    {
+        reason = "checksum mismatch";
+        return {};
+    }
+
+    //Vulkan自己的缓存头(VkPipelineCacheHeaderVersionOne)也要和当前设备一致
+    VkPipelineCacheHeaderVersionOne vkHeader = {};
+    if (blob.size() < sizeof(vkHeader))
+    {
+        reason = "data smaller than vulkan header";
+        return {};
+    }
+    std::memcpy(&vkHeader, blob.data(), sizeof(vkHeader));
+    if (vkHeader.headerSize < sizeof(vkHeader) || vkHeader.headerSize > blob.size() ||
+        vkHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        vkHeader.vendorID != m_Properties.vendorID || vkHeader.deviceID != m_Properties.deviceID ||
+        std::memcmp(vkHeader.pipelineCacheUUID, m_Properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        reason = "vulkan header mismatch";
+        return {};
+    }
+
+    return blob;
+}
+
+void PipelineCache::Save()
+{
+    if (m_Cache == VK_NULL_HANDLE || m_Path.empty()) return;
+
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(m_Device, m_Cache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) return;
+
+    std::string blob(dataSize, '\0');
+    if (vkGetPipelineCacheData(m_Device, m_Cache, &dataSize, blob.data()) != VK_SUCCESS) return;
+    blob.resize(dataSize);
+
+    FileHeader header;
+    MakeHeader(header);
+    header.dataSize = blob.size();
+    header.dataHash = Hash::Fnv1a(blob.data(), blob.size());
+
+    //先写临时文件再替换，中途退出不会留下半个缓存文件
+    std::string tempPath = m_Path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(blob.data(), static_cast<std::streamsize>(blob.size()));
+        if (!file)
+        {
+            std::cerr << "pipeline cache: failed to write " << tempPath << '\n';
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, m_Path, error);
+    if (error)
+    {
+        std::cerr << "pipeline cache: failed to replace " << m_Path << ": " << error.message() << '\n';
+    }
+}
+
+void PipelineCache::Destroy()
+{
+    if (m_Cache != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineCache(m_Device, m_Cache, nullptr);
+        m_Cache = VK_NULL_HANDLE;
+    }
+}
+
+void PipelineCache::MakeHeader(FileHeader& header) const
+{
+    //dataSize之前有4字节填充，整个结构体先清零，写到磁盘的文件头不带栈上的残留内容，相同的数据得到相同的文件。
+    //就地填写而不是按值返回：复制结构体时不保证复制填充字节
+    std::memset(&header, 0, sizeof(header));
+    header.magic         = Magic;
+    header.version       = Version;
+    header.vendorID      = m_Properties.vendorID;
+    header.deviceID      = m_Properties.deviceID;
+    header.driverVersion = m_Properties.driverVersion;
+    std::memcpy(header.pipelineCacheUUID, m_Properties.pipelineCacheUUID, VK_UUID_SIZE);
+}
@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include <string>
+#include <vulkan/vulkan.h>
+
+//持久化的管线缓存。
+//启动时从磁盘读取上一次运行保存的缓存数据，驱动可以直接复用其中已编译好的管线，退出时再把缓存写回磁盘。
+//缓存数据只对生成它的设备和驱动有效，所以文件头记录了设备的pipelineCacheUUID、厂商/设备ID和驱动版本，任何一项不匹配都会丢弃旧数据。
+class PipelineCache
+{
+public:
+    //path为空时不读写磁盘，只创建一个空的内存缓存
+    void Create(VkPhysicalDevice physicalDevice , VkDevice device , const std::string& path);
+    void Save();
+    void Destroy();
+
+    VkPipelineCache Get() const { return m_Cache; }
+    //是否成功复用了磁盘上的缓存数据
+    bool IsWarm() const { return m_Warm; }
+
+private:
+    //返回通过校验的Vulkan缓存数据，校验失败时返回空，并在reason中记录原因
+    std::string LoadBlob(std::string& reason) const;
+
+    //文件头，位于Vulkan缓存数据之前
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+
+    static constexpr uint32_t Magic   = 0x4350564C; //"LVPC"
+    static constexpr uint32_t Version = 1;
+
+    //填写当前设备的文件头，dataSize和dataHash为0
+    void MakeHeader(FileHeader& header) const;
+
+    VkDevice                   m_Device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties m_Properties = {};
+    VkPipelineCache            m_Cache = VK_NULL_HANDLE;
+    std::string                m_Path;
+    bool                       m_Warm = false;
+};
@@ -0,0 +1,34 @@
+﻿#include "PipelineCompiler.h"
+
+#include <chrono>
+
+#include "../Tool/Profiler.h"
+
+PipelineCompiler::PipelineCompiler(VkDevice device , VkPipelineCache cache , uint32_t threadCount)
+    : m_Device(device),
+      m_Cache(cache),
+      m_Pool(threadCount)
+{
+}
+
+std::shared_future<VkPipeline> PipelineCompiler::Compile(const GraphicsPipelineDesc& desc , CompilePriority priority ,
+                                                        std::atomic<uint64_t>*      compileMicroseconds)
+{
+    //描述按值捕获，调用方不需要保证它在编译完成前一直有效
+    return m_Pool.Submit(static_cast<int>(priority), [this, desc, compileMicroseconds]()
+    {
+        PROFILE_SCOPE("CompilePipeline");
+        auto start    = std::chrono::steady_clock::now();
+        auto pipeline = PipelineFactory::CreateGraphicsPipeline(m_Device, m_Cache, desc);
+        auto elapsed  = std::chrono::steady_clock::now() - start;
+
+        auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        m_CompiledCount++;
+        m_CompileMicroseconds += microseconds;
+        if (compileMicroseconds != nullptr)
+        {
+            *compileMicroseconds += microseconds;
+        }
+        return pipeline;
+    }).share();
+}
@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <atomic>
+#include <future>
+#include <vulkan/vulkan.h>
+#include "PipelineFactory.h"
+#include "../Tool/ThreadPool.h"
+
+//编译优先级：渲染第一帧必需的管线用Critical，可以晚一点就绪的变体用Background
+enum class CompilePriority : int
+{
+    Background = 0,
+    Normal     = 1,
+    Critical   = 2,
+};
+
+//后台管线编译服务。
+//在工作线程上并发调用vkCreateGraphicsPipelines，所有线程共享同一个管线缓存(驱动内部同步)，
+//调用方拿到shared_future，需要时再等待结果，渲染可以在低优先级变体编译完成前开始。
+//返回的管线归调用方所有，由调用方负责销毁。
+class PipelineCompiler
+{
+public:
+    PipelineCompiler(VkDevice device , VkPipelineCache cache , uint32_t threadCount);
+
+    //compileMicroseconds不为空时，这条管线的编译耗时还会累加到调用方的计数器上
+    std::shared_future<VkPipeline> Compile(const GraphicsPipelineDesc& desc ,
+                                           CompilePriority             priority            = CompilePriority::Normal ,
+                                           std::atomic<uint64_t>*      compileMicroseconds = nullptr);
+
+    //等待所有已提交的编译任务完成
+    void WaitIdle() { m_Pool.WaitIdle(); }
+
+    uint32_t ThreadCount() const { return m_Pool.ThreadCount(); }
+    uint32_t CompiledCount() const { return m_CompiledCount.load(); }
+    //所有编译任务耗时之和(各线程的时间累加，不是墙钟时间)
+    double CompileMilliseconds() const { return m_CompileMicroseconds.load() / 1000.0; }
+
+private:
+    VkDevice        m_Device;
+    VkPipelineCache m_Cache;
+
+    std::atomic<uint32_t> m_CompiledCount       = 0;
+    std::atomic<uint64_t> m_CompileMicroseconds = 0;
+
+    //线程池最后声明，析构时最先销毁：先等工作线程执行完剩余任务，再释放它们用到的成员
+    ThreadPool m_Pool;
+};
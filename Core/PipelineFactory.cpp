@@ -0,0 +1,202 @@
+﻿#include "PipelineFactory.h"
+
+#include <iterator>
+#include <stdexcept>
+
+VkPipeline PipelineFactory::CreateGraphicsPipeline(VkDevice device , VkPipelineCache cache ,
+                                                   const GraphicsPipelineDesc& desc)
+{
+    //第i个常量的值在values中的偏移是4*i
+    const SpecializationDesc& constants = desc.specialization;
+    VkSpecializationMapEntry  mapEntries[SpecializationDesc::MaxConstants];
+    for (uint32_t i = 0; i < constants.constantCount; i++)
+    {
+        mapEntries[i].constantID = constants.ids[i];
+        mapEntries[i].offset     = i * sizeof(uint32_t);
+        mapEntries[i].size       = sizeof(uint32_t);
+    }
+
+    VkSpecializationInfo specializationInfo = {};
+    specializationInfo.mapEntryCount        = constants.constantCount;
+    specializationInfo.pMapEntries          = mapEntries;
+    specializationInfo.dataSize             = constants.constantCount * sizeof(uint32_t);
+    specializationInfo.pData                = constants.values;
+
+    const VkSpecializationInfo* specialization = constants.constantCount > 0 ? &specializationInfo : nullptr;
+
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
+    vertShaderStageInfo.sType                           = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage                           = VK_SHADER_STAGE_VERTEX_BIT; //指明用于哪个阶段
+    vertShaderStageInfo.module                          = desc.vertexShader;
+    vertShaderStageInfo.pName                           = "main"; //指明使用shader文件里的哪个函数。可以在一个文件里写多个着色器，通过不同的pName调用他们
+    vertShaderStageInfo.pSpecializationInfo             = specialization;
+    /*
+    *VkPipelineShaderStageCreateInfo还有一个可选的成员变量pSpecializationInfo
+    *我们可以通过这一成员变量指定着色器用到的常量(特化常量，见PipelineVariants.h)
+    *我们可以对同一个着色器模块对象指定不同的着色器常量用于管线创
+    *这使得编译器可以根据指定的着色器常量来消除一些条件分支，这比在渲染时，使用变量配置着色器带来的效率要高得多。
+    *如果不使用着色器常量，可以将pSpecializationInfo成员变量设置为nullptr。
+    */
+
+    VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
+    fragShaderStageInfo.sType                           = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageInfo.stage                           = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageInfo.module                          = desc.fragmentShader;
+    fragShaderStageInfo.pName                           = "main";
+    fragShaderStageInfo.pSpecializationInfo             = specialization;
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+    //描述传递给顶点着色器的顶点数据格式
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+    vertexInputInfo.sType                                = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount        = desc.vertexInput.bindingCount;
+    vertexInputInfo.pVertexBindingDescriptions           = desc.vertexInput.bindings; //绑定：数据之间的间距和数据是按逐顶点的方式还是按逐实例的方式进行组织
+    vertexInputInfo.vertexAttributeDescriptionCount      = desc.vertexInput.attributeCount;
+    vertexInputInfo.pVertexAttributeDescriptions         = desc.vertexInput.attributes; //属性描述：传递给顶点着色器的属性类型，用于将属性绑定到顶点着色器中的变量
+
+    //描述图元装配模式(topology) 和 是否启用几何图元重启
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology                               = desc.topology;
+    inputAssembly.primitiveRestartEnable                 = VK_FALSE;
+
+    //描述视口和裁剪矩形：两者都是动态状态，这里只声明数量，具体的值在录制命令时设置
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType                             = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount                     = 1;
+    viewportState.pViewports                        = nullptr;
+    viewportState.scissorCount                      = 1;
+    viewportState.pScissors                         = nullptr;
+
+    //描述光栅化方式
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable                       = VK_FALSE;
+    //depthClampEnable成员变量设置为VK_TRUE表示在近平面和远平面外的片段会被截断为在近平面和远平面上，而不是直接丢弃这些片段。这对于阴影贴图的生成很有用。使用这一设置需要开启相应的GPU特性。
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    //rasterizerDiscardEnable成员变量设置为VK_TRUE表示所有几何图元都不能通过光栅化阶段。这一设置会禁止一切片段输出到帧缓冲。
+    rasterizer.polygonMode = desc.polygonMode;
+    //polygonMode成员变量用于指定多边形的填充模式。可以设置为VK_POLYGON_MODE_FILL填充模式，VK_POLYGON_MODE_LINE线框模式，VK_POLYGON_MODE_POINT点模式。
+    rasterizer.lineWidth = 1.0f; //lineWidth成员变量用于指定光栅化后的线段宽度。线宽的最大值依赖于硬件，如果线宽度大于1.0f，需要开启相应的GPU特性。
+    rasterizer.cullMode  = desc.cullMode;
+    //cullMode成员变量用于指定剔除模式。可以设置为VK_CULL_MODE_NONE不剔除任何图元，VK_CULL_MODE_FRONT_BIT剔除正面图元，VK_CULL_MODE_BACK_BIT剔除背面图元，VK_CULL_MODE_FRONT_AND_BACK剔除所有图元。
+    rasterizer.frontFace = desc.frontFace;
+    //frontFace成员变量用于指定多边形的正面是顺时针还是逆时针。可以设置为VK_FRONT_FACE_CLOCKWISE顺时针，VK_FRONT_FACE_COUNTER_CLOCKWISE逆时针。
+    rasterizer.depthBiasEnable = VK_FALSE;
+    //depthBiasEnable成员变量用于指定是否开启深度偏移。光栅化程序可以添加一个常量值或是一个基于片段所处线段的斜率得到的变量值到深度值上。这对于阴影贴图会很有用
+
+    //多重采样技术 用于反走样，这里暂时禁用。
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType                                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable                  = VK_FALSE;
+    multisampling.rasterizationSamples                 = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.minSampleShading                     = 1.0f;     // Optional
+    multisampling.pSampleMask                          = nullptr;  // Optional
+    multisampling.alphaToCoverageEnable                = VK_FALSE; // Optional
+    multisampling.alphaToOneEnable                     = VK_FALSE; // Optional
+
+    //颜色混合：有两个用于配置颜色混合的结构体。第一个是VkPipelineColorBlendAttachmentState结构体，可以用它来对每个绑定的帧缓冲进行单独的颜色混合配置。
+    //第二个是VkPipelineColorBlendStateCreateInfo结构体，可以用它来进行全局的颜色混合配置。
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {}; //不配置
+    colorBlendAttachment.colorWriteMask      = desc.colorWriteMask;
+    colorBlendAttachment.blendEnable         = desc.blendEnable ? VK_TRUE : VK_FALSE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;  // Optional
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
+    colorBlendAttachment.colorBlendOp        = VK_BLEND_OP_ADD;      // Optional
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;  // Optional
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
+    colorBlendAttachment.alphaBlendOp        = VK_BLEND_OP_ADD;      // Optional
+    /* 上方设置的作用
+    if (blendEnable)
+    {
+        finalColor.rgb = (srcColorBlendFactor * newColor.rgb) <colorBlendOp> (dstColorBlendFactor * oldColor.rgb);
+        finalColor.a = (srcAlphaBlendFactor * newColor.a) <alphaBlendOp> (dstAlphaBlendFactor * oldColor.a);
+    }
+    else {
+        finalColor = newColor;
+    }
+    finalColor = finalColor & colorWriteMask;
+    */
+    VkPipelineColorBlendStateCreateInfo colorBlending = {};
+    colorBlending.sType                               = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable                       = VK_FALSE;
+    colorBlending.logicOp                             = VK_LOGIC_OP_COPY; // Optional
+    colorBlending.attachmentCount                     = 1;
+    colorBlending.pAttachments                        = &colorBlendAttachment;
+    colorBlending.blendConstants[0]                   = 0.0f; // Optional
+    colorBlending.blendConstants[1]                   = 0.0f; // Optional
+    colorBlending.blendConstants[2]                   = 0.0f; // Optional
+    colorBlending.blendConstants[3]                   = 0.0f; // Optional
+
+    VkDynamicState dynamicStates[5] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+    uint32_t dynamicStateCount = 2;
+    //扩展动态状态：剔除模式、正面朝向和图元类型在录制时设置，只在这些状态上不同的绘制可以共用一条管线
+    if (desc.dynamicState & DynamicCullMode) dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_CULL_MODE_EXT;
+    if (desc.dynamicState & DynamicFrontFace) dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_FRONT_FACE_EXT;
+    if (desc.dynamicState & DynamicTopology) dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT;
+
+    //声明可以动态配置的内容：窗口尺寸改变时不需要为新的视口重新创建管线。
+    //线宽没有声明为动态：没有启用wideLines特性时线宽只能是1.0
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType                            = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount                = dynamicStateCount;
+    dynamicState.pDynamicStates                   = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType                        = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount                   = 2;
+    pipelineInfo.pStages                      = shaderStages;
+    pipelineInfo.pVertexInputState            = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState          = &inputAssembly;
+    pipelineInfo.pViewportState               = &viewportState;
+    pipelineInfo.pRasterizationState          = &rasterizer;
+    pipelineInfo.pMultisampleState            = &multisampling;
+    pipelineInfo.pDepthStencilState           = nullptr; // Optional
+    pipelineInfo.pColorBlendState             = &colorBlending;
+    pipelineInfo.pDynamicState                = &dynamicState;
+
+    pipelineInfo.layout     = desc.layout;
+    pipelineInfo.renderPass = desc.renderPass;
+    pipelineInfo.subpass    = desc.subpass;
+
+    /*
+    basePipelineHandle和basePipelineIndex成员变量用于以一个创建好的图形管线为基础创建一个新的图形管线。
+    当要创建一个和已有管线大量设置相同的管线时，使用它的代价要比直接创建小，并且，对于从同一个管线衍生出的两个管线，在它们之间进行管线切换操作的效率也要高很多。
+    我们可以使用basePipelineHandle来指定已经创建好的管线，或是使用basePipelineIndex来指定将要创建的管线作为基础管线，用于衍生新的管线。
+    目前，我们只使用一个管线，所以将这两个成员变量分别设置为VK_NULL_HANDLE和-1，不使用基础管线衍生新的管线。
+    这两个成员变量的设置只有在VkGraphicsPipelineCreateInfo结构体的flags成员变量使用了VK_PIPELINE_CREATE_DERIVATIVE_BIT标记的情况下才会起效。
+    */
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+    pipelineInfo.basePipelineIndex  = -1;             // Optional
+
+    //传入管线缓存，驱动命中缓存时可以跳过着色器编译
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+    return pipeline;
+}
+
+VkPipeline PipelineFactory::CreateComputePipeline(VkDevice device , VkPipelineCache cache ,
+                                                  const ComputePipelineDesc& desc)
+{
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType                       = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType                 = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage                 = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module                = desc.shader;
+    pipelineInfo.stage.pName                 = "main";
+    pipelineInfo.layout                      = desc.layout;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(device, cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+    return pipeline;
+}
@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include <vulkan/vulkan.h>
+
+//顶点输入布局。用定长数组而不是指针，这样整个描述可以按值复制到编译线程上
+struct VertexInputDesc
+{
+    static constexpr uint32_t MaxBindings   = 4;
+    static constexpr uint32_t MaxAttributes = 16;
+
+    uint32_t                          bindingCount                = 0;
+    VkVertexInputBindingDescription   bindings[MaxBindings]       = {};
+    uint32_t                          attributeCount              = 0;
+    VkVertexInputAttributeDescription attributes[MaxAttributes]   = {};
+};
+
+//特化常量：同一个SPIR-V模块按不同的常量值创建不同的管线，驱动编译时可以折叠分支、展开循环。
+//常量都是32位(bool也是VkBool32)，同一组值用于全部着色器阶段，着色器中没有声明的constant_id不起作用
+struct SpecializationDesc
+{
+    static constexpr uint32_t MaxConstants = 8;
+
+    uint32_t constantCount        = 0;
+    uint32_t ids[MaxConstants]    = {};
+    uint32_t values[MaxConstants] = {};
+};
+
+//视口和裁剪矩形之外还可以改为动态的状态，需要VK_EXT_extended_dynamic_state。
+//标记为动态的状态在创建管线时被忽略，录制命令时必须用vkCmdSet*EXT设置
+enum DynamicStateBits : uint32_t
+{
+    DynamicCullMode  = 1u << 0,
+    DynamicFrontFace = 1u << 1,
+    DynamicTopology  = 1u << 2, //只有同一类图元(点/线/三角形/面片)之间可以动态切换
+
+    DynamicExtendedAll = DynamicCullMode | DynamicFrontFace | DynamicTopology,
+};
+
+//描述一条图形管线所需的全部状态。只包含句柄和值类型，可以按值复制到其它线程上编译
+struct GraphicsPipelineDesc
+{
+    VkShaderModule   vertexShader   = VK_NULL_HANDLE;
+    VkShaderModule   fragmentShader = VK_NULL_HANDLE;
+    VkPipelineLayout layout         = VK_NULL_HANDLE;
+    VkRenderPass     renderPass     = VK_NULL_HANDLE;
+    uint32_t         subpass        = 0;
+
+    VertexInputDesc    vertexInput;
+    SpecializationDesc specialization;
+
+    //视口和裁剪矩形是动态状态，录制命令时用vkCmdSetViewport/vkCmdSetScissor设置，
+    //交换链重建后尺寸改变，管线不需要重新编译
+
+    VkPrimitiveTopology   topology       = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode         polygonMode    = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags       cullMode       = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace           frontFace      = VK_FRONT_FACE_CLOCKWISE; //Vulkan帧缓冲坐标y轴向下，三角形顶点按顺时针排列
+    bool                  blendEnable    = false;
+    VkColorComponentFlags colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    //DynamicStateBits的组合，由PipelineStateCache按设备支持情况设置
+    uint32_t dynamicState = 0;
+};
+
+//计算管线只有一个着色器阶段，没有固定功能状态
+struct ComputePipelineDesc
+{
+    VkShaderModule   shader = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+};
+
+class PipelineFactory
+{
+public:
+    //可以在任意线程调用：VkDevice上的创建函数是线程安全的，管线缓存由驱动内部同步
+    static VkPipeline CreateGraphicsPipeline(VkDevice device , VkPipelineCache cache , const GraphicsPipelineDesc& desc);
+    static VkPipeline CreateComputePipeline(VkDevice device , VkPipelineCache cache , const ComputePipelineDesc& desc);
+};
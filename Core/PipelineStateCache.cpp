@@ -0,0 +1,348 @@
+﻿#include "PipelineStateCache.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "../Tool/Hash.h"
+
+namespace
+{
+    //动态图元类型只能在同一类图元之间切换，规范化时换成这一类的第一个
+    VkPrimitiveTopology TopologyClass(VkPrimitiveTopology topology)
+    {
+        switch (topology)
+        {
+        case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+            return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+        case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+            return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+        case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+            return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+        default:
+            return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        }
+    }
+
+    //64位句柄占两个字
+    void PushHandle(PipelineStateKey& key , uint64_t handle)
+    {
+        key.words[key.wordCount++] = static_cast<uint32_t>(handle);
+        key.words[key.wordCount++] = static_cast<uint32_t>(handle >> 32);
+    }
+}
+
+PipelineStateKey PipelineStateKey::From(const GraphicsPipelineDesc& desc)
+{
+    //句柄的顺序和数量要和HandleCount、References一致
+    PipelineStateKey key;
+    PushHandle(key, HandleBits(desc.vertexShader));
+    PushHandle(key, HandleBits(desc.fragmentShader));
+    PushHandle(key, HandleBits(desc.layout));
+    PushHandle(key, HandleBits(desc.renderPass));
+    key.words[key.wordCount++] = desc.subpass;
+
+    //固定功能状态放在一个字里：图元类型4位，剔除2位，朝向1位，混合1位，写掩码4位，动态状态位从第12位开始
+    key.words[key.wordCount++] = static_cast<uint32_t>(desc.topology) | desc.cullMode << 4 | desc.frontFace << 6 |
+                                 ( desc.blendEnable ? 1u : 0u ) << 7 | desc.colorWriteMask << 8 |
+                                 desc.dynamicState << 12;
+    key.words[key.wordCount++] = static_cast<uint32_t>(desc.polygonMode);
+
+    const VertexInputDesc& input = desc.vertexInput;
+    key.words[key.wordCount++]   = input.bindingCount;
+    for (uint32_t i = 0; i < input.bindingCount; i++)
+    {
+        const VkVertexInputBindingDescription& binding = input.bindings[i];
+        key.words[key.wordCount++] = binding.binding | static_cast<uint32_t>(binding.inputRate) << 16;
+        key.words[key.wordCount++] = binding.stride;
+    }
+    key.words[key.wordCount++] = input.attributeCount;
+    for (uint32_t i = 0; i < input.attributeCount; i++)
+    {
+        const VkVertexInputAttributeDescription& attribute = input.attributes[i];
+        key.words[key.wordCount++] = attribute.location | attribute.binding << 16;
+        key.words[key.wordCount++] = static_cast<uint32_t>(attribute.format);
+        key.words[key.wordCount++] = attribute.offset;
+    }
+
+    const SpecializationDesc& specialization = desc.specialization;
+    key.words[key.wordCount++]               = specialization.constantCount;
+    for (uint32_t i = 0; i < specialization.constantCount; i++)
+    {
+        key.words[key.wordCount++] = specialization.ids[i];
+        key.words[key.wordCount++] = specialization.values[i];
+    }
+
+    key.hash = Hash::Fnv1a(key.words, key.wordCount * sizeof(uint32_t));
+    return key;
+}
+
+bool PipelineStateKey::References(uint64_t handle) const
+{
+    if (handle == 0) return false;
+    for (uint32_t i = 0; i < HandleCount; i++)
+    {
+        if (( words[2 * i] | uint64_t(words[2 * i + 1]) << 32 ) == handle) return true;
+    }
+    return false;
+}
+
+bool PipelineStateKey::operator==(const PipelineStateKey& other) const
+{
+    if (hash != other.hash || wordCount != other.wordCount) return false;
+    for (uint32_t i = 0; i < wordCount; i++)
+    {
+        if (words[i] != other.words[i]) return false;
+    }
+    return true;
+}
+
+void PipelineStateCache::Create(VkDevice device , PipelineCompiler& compiler ,
+                                const ExtendedDynamicStateFunctions& functions)
+{
+    m_Device       = device;
+    m_Compiler     = &compiler;
+    m_Functions    = functions;
+    m_DynamicState = functions.Available() ? static_cast<uint32_t>(DynamicExtendedAll) : 0u;
+
+    auto table      = std::make_unique<Table>();
+    table->capacity = 64;
+    table->slots    = std::make_unique<std::atomic<Entry*>[]>(table->capacity);
+    m_Table.store(table.get());
+    m_Tables.push_back(std::move(table));
+}
+
+void PipelineStateCache::Destroy()
+{
+    std::lock_guard<std::mutex> lock(m_WriteMutex);
+    for (auto* entries : {&m_Entries, &m_Evicted})
+    {
+        for (auto& entry : *entries)
+        {
+            vkDestroyPipeline(m_Device, entry->future.get(), nullptr);
+        }
+    }
+    m_Table.store(nullptr);
+    m_Entries.clear();
+    m_Evicted.clear();
+    m_Tables.clear();
+    m_Count               = 0;
+    m_CompileMicroseconds = 0;
+}
+
+GraphicsPipelineDesc PipelineStateCache::Normalize(const GraphicsPipelineDesc& desc) const
+{
+    GraphicsPipelineDesc normalized = desc;
+    normalized.dynamicState         = m_DynamicState;
+    if (m_DynamicState & DynamicCullMode) normalized.cullMode = VK_CULL_MODE_NONE;
+    if (m_DynamicState & DynamicFrontFace) normalized.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    if (m_DynamicState & DynamicTopology) normalized.topology = TopologyClass(desc.topology);
+    return normalized;
+}
+
+PipelineStateCache::Entry* PipelineStateCache::Find(const Table& table , const PipelineStateKey& key)
+{
+    uint32_t mask = table.capacity - 1;
+    for (uint32_t index = static_cast<uint32_t>(key.hash) & mask;; index = ( index + 1 ) & mask)
+    {
+        Entry* entry = table.slots[index].load(std::memory_order_acquire);
+        if (entry == nullptr || entry->key == key)
+        {
+            return entry;
+        }
+    }
+}
+
+void PipelineStateCache::Insert(Table& table , Entry* entry)
+{
+    uint32_t mask  = table.capacity - 1;
+    uint32_t index = static_cast<uint32_t>(entry->key.hash) & mask;
+    while (table.slots[index].load(std::memory_order_relaxed) != nullptr)
+    {
+        index = ( index + 1 ) & mask;
+    }
+    //release：读线程看到指针时，条目的内容已经写完
+    table.slots[index].store(entry, std::memory_order_release);
+}
+
+PipelineStateCache::Entry* PipelineStateCache::Request(const GraphicsPipelineDesc& desc , CompilePriority priority)
+{
+    GraphicsPipelineDesc normalized = Normalize(desc);
+    PipelineStateKey     key        = PipelineStateKey::From(normalized);
+
+    //快路径：不加锁
+    Table* table = m_Table.load(std::memory_order_acquire);
+    if (table == nullptr)
+    {
+        throw std::runtime_error("管线状态缓存还没有创建");
+    }
+    if (Entry* entry = Find(*table, key))
+    {
+        return entry;
+    }
+
+    //慢路径：其它线程可能刚刚插入了同一个状态，或者已经换了新表，持有写锁后重新查找
+    std::lock_guard<std::mutex> lock(m_WriteMutex);
+    table = m_Table.load(std::memory_order_relaxed);
+    if (Entry* entry = Find(*table, key))
+    {
+        return entry;
+    }
+
+    auto entry    = std::make_unique<Entry>();
+    entry->key    = key;
+    entry->future = m_Compiler->Compile(normalized, priority, &m_CompileMicroseconds);
+
+    //装载率保持在一半以下，线性探测的查找长度才短
+    if (( m_Entries.size() + 1 ) * 2 > table->capacity)
+    {
+        auto grown      = std::make_unique<Table>();
+        grown->capacity = table->capacity * 2;
+        grown->slots    = std::make_unique<std::atomic<Entry*>[]>(grown->capacity);
+        for (auto& existing : m_Entries)
+        {
+            Insert(*grown, existing.get());
+        }
+        table = grown.get();
+        m_Tables.push_back(std::move(grown));
+        m_Table.store(table, std::memory_order_release);
+    }
+    Insert(*table, entry.get());
+    m_Entries.push_back(std::move(entry));
+    m_Count++;
+    return m_Entries.back().get();
+}
+
+VkPipeline PipelineStateCache::Get(const GraphicsPipelineDesc& desc)
+{
+    Entry*     entry    = Request(desc, CompilePriority::Critical);
+    VkPipeline pipeline = entry->pipeline.load(std::memory_order_acquire);
+    if (pipeline == VK_NULL_HANDLE)
+    {
+        //多个线程可能同时走到这里，写入的是同一个值
+        pipeline = entry->future.get();
+        entry->pipeline.store(pipeline, std::memory_order_release);
+    }
+    return pipeline;
+}
+
+void PipelineStateCache::Prefetch(const GraphicsPipelineDesc& desc , CompilePriority priority)
+{
+    Request(desc, priority);
+}
+
+void PipelineStateCache::EvictHandle(uint64_t handle)
+{
+    std::lock_guard<std::mutex> lock(m_WriteMutex);
+    Table* current = m_Table.load(std::memory_order_relaxed);
+    if (current == nullptr) return;
+
+    //还在编译的管线正在使用这个对象，等它完成，调用者返回后才能销毁对象
+    auto evicted = std::stable_partition(m_Entries.begin(), m_Entries.end(),
+                                         [handle](const std::unique_ptr<Entry>& entry)
+                                         {
+                                             return !entry->key.References(handle);
+                                         });
+    if (evicted == m_Entries.end()) return;
+    for (auto it = evicted; it != m_Entries.end(); ++it)
+    {
+        ( *it )->future.wait();
+        m_Evicted.push_back(std::move(*it));
+    }
+    m_Entries.erase(evicted, m_Entries.end());
+
+    //开放寻址表不能直接删除条目(会打断探测序列)，用剩下的条目建一张同样大小的新表替换。
+    //旧表和增长时一样保留到Destroy，正在读它的线程不受影响
+    auto rebuilt      = std::make_unique<Table>();
+    rebuilt->capacity = current->capacity;
+    rebuilt->slots    = std::make_unique<std::atomic<Entry*>[]>(rebuilt->capacity);
+    for (auto& entry : m_Entries)
+    {
+        Insert(*rebuilt, entry.get());
+    }
+    m_Table.store(rebuilt.get(), std::memory_order_release);
+    m_Tables.push_back(std::move(rebuilt));
+    m_Count = static_cast<uint32_t>(m_Entries.size());
+}
+
+std::string PipelineStateCache::Report() const
+{
+    std::ostringstream report;
+    report << "pipeline states: " << PipelineCount() << " pipelines, extended dynamic state "
+            << ( m_DynamicState != 0 ? "enabled" : "unavailable" ) << ", " << CompileMilliseconds()
+            << " ms compile\n";
+    return report.str();
+}
+
+PipelineBinder::PipelineBinder(PipelineStateCache& cache , VkCommandBuffer commandBuffer)
+    : m_Cache(&cache), m_CommandBuffer(commandBuffer)
+{
+}
+
+void PipelineBinder::Bind(const GraphicsPipelineDesc& desc)
+{
+    VkPipeline pipeline = m_Cache->Get(desc);
+    if (pipeline != m_Pipeline)
+    {
+        vkCmdBindPipeline(m_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        m_Pipeline = pipeline;
+        m_PipelineBinds++;
+    }
+    else
+    {
+        m_SkippedCalls++;
+    }
+
+    //状态已经编进管线时没有动态状态要设置
+    uint32_t                             dynamicState = m_Cache->DynamicState();
+    const ExtendedDynamicStateFunctions& functions    = m_Cache->Functions();
+    if (dynamicState & DynamicCullMode)
+    {
+        if (!m_HasState || desc.cullMode != m_CullMode)
+        {
+            functions.setCullMode(m_CommandBuffer, desc.cullMode);
+            m_CullMode = desc.cullMode;
+            m_StateSets++;
+        }
+        else
+        {
+            m_SkippedCalls++;
+        }
+    }
+    if (dynamicState & DynamicFrontFace)
+    {
+        if (!m_HasState || desc.frontFace != m_FrontFace)
+        {
+            functions.setFrontFace(m_CommandBuffer, desc.frontFace);
+            m_FrontFace = desc.frontFace;
+            m_StateSets++;
+        }
+        else
+        {
+            m_SkippedCalls++;
+        }
+    }
+    if (dynamicState & DynamicTopology)
+    {
+        if (!m_HasState || desc.topology != m_Topology)
+        {
+            functions.setPrimitiveTopology(m_CommandBuffer, desc.topology);
+            m_Topology = desc.topology;
+            m_StateSets++;
+        }
+        else
+        {
+            m_SkippedCalls++;
+        }
+    }
+    m_HasState = true;
+}
+
+void PipelineBinder::Reset()
+{
+    m_Pipeline = VK_NULL_HANDLE;
+    m_HasState = false;
+}
@@ -0,0 +1,174 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "PipelineCompiler.h"
+#include "PipelineFactory.h"
+
+/*
+ * 管线状态键：把GraphicsPipelineDesc中影响管线对象的字段按固定顺序压成一串32位字，比较和哈希都只看这串字。
+ * 不直接哈希整个结构体：结构体中有填充字节，未使用的数组元素也不应该让两个相同的状态得到不同的键。
+ * 着色器模块、管线布局和渲染流程按句柄的值进入键，对象销毁后驱动可能把同一个值分给新对象，
+ * 所以销毁这些对象之前要先调用PipelineStateCache::Evict
+ */
+struct PipelineStateKey
+{
+    //开头是4个句柄，各占两个字
+    static constexpr uint32_t HandleCount = 4;
+    //句柄、子流程、两个固定功能字，加上顶点输入和特化常量在各自上限时占用的字数
+    static constexpr uint32_t MaxPackedWords = HandleCount * 2 + 3 + 1 + VertexInputDesc::MaxBindings * 2 + 1 +
+            VertexInputDesc::MaxAttributes * 3 + 1 + SpecializationDesc::MaxConstants * 2;
+    static constexpr uint32_t MaxWords = 96;
+    static_assert(MaxPackedWords <= MaxWords, "管线状态键放不下全部字段");
+
+    uint32_t wordCount       = 0;
+    uint32_t words[MaxWords] = {};
+    uint64_t hash            = 0;
+
+    //desc应当已经规范化，见PipelineStateCache::Normalize
+    static PipelineStateKey From(const GraphicsPipelineDesc& desc);
+
+    //句柄的位模式：非分发句柄在32位平台上是uint64_t，在64位平台上是指针
+    template <typename Handle>
+    static uint64_t HandleBits(Handle handle)
+    {
+        if constexpr (sizeof(Handle) == sizeof(uint64_t) && !std::is_pointer_v<Handle>)
+        {
+            return static_cast<uint64_t>(handle);
+        }
+        else
+        {
+            return reinterpret_cast<uintptr_t>(handle);
+        }
+    }
+    //键中的句柄是否有一个等于handle
+    bool References(uint64_t handle) const;
+
+    bool operator==(const PipelineStateKey& other) const;
+};
+
+//VK_EXT_extended_dynamic_state的录制函数，扩展不可用时全部为空
+struct ExtendedDynamicStateFunctions
+{
+    PFN_vkCmdSetCullModeEXT          setCullMode          = nullptr;
+    PFN_vkCmdSetFrontFaceEXT         setFrontFace         = nullptr;
+    PFN_vkCmdSetPrimitiveTopologyEXT setPrimitiveTopology = nullptr;
+
+    bool Available() const { return setCullMode != nullptr && setFrontFace != nullptr && setPrimitiveTopology != nullptr; }
+};
+
+/*
+ * 运行时的管线状态缓存：按规范化后的状态键查找管线，没有时提交给PipelineCompiler编译，同一个状态只编译一次。
+ * 设备支持扩展动态状态时，剔除模式、正面朝向和图元类型(同一类图元之内)在规范化时被抹掉，
+ * 只在这些状态上不同的描述共用一条管线，录制时由PipelineBinder用vkCmdSet*EXT设置。
+ *
+ * 查找不加锁：哈希表是开放寻址的原子指针数组，读线程只做原子读取。插入由一把写锁串行化，
+ * 表满一半时复制到两倍大小的新表再原子地替换，旧表和条目保留到Destroy，正在读旧表的线程不会访问到已释放的内存。
+ * 在旧表上没找到的读线程进入加锁的慢路径，在新表上重新查找
+ */
+class PipelineStateCache
+{
+public:
+    //functions可用时启用DynamicExtendedAll
+    void Create(VkDevice device , PipelineCompiler& compiler , const ExtendedDynamicStateFunctions& functions = {});
+    //等待编译完成并销毁全部管线
+    void Destroy();
+
+    //把动态状态的字段替换为固定的代表值，设置dynamicState，得到实际用来创建管线的描述
+    GraphicsPipelineDesc Normalize(const GraphicsPipelineDesc& desc) const;
+
+    //没有编译过时以最高优先级编译并等待
+    VkPipeline Get(const GraphicsPipelineDesc& desc);
+    //提交编译但不等待
+    void Prefetch(const GraphicsPipelineDesc& desc , CompilePriority priority = CompilePriority::Background);
+
+    //销毁一个着色器模块、管线布局或渲染流程之前调用：等待引用它的管线编译完，把它们移出查找表，
+    //之后句柄的值被新对象复用时不会查到旧管线。移出的管线可能还在飞行中的命令缓冲里，保留到Destroy再销毁
+    template <typename Handle>
+    void Evict(Handle handle) { EvictHandle(PipelineStateKey::HandleBits(handle)); }
+
+    uint32_t                             DynamicState() const { return m_DynamicState; }
+    const ExtendedDynamicStateFunctions& Functions() const { return m_Functions; }
+    uint32_t                             PipelineCount() const { return m_Count.load(); }
+    //已提交的管线编译耗时之和(各编译线程的时间累加)
+    double      CompileMilliseconds() const { return m_CompileMicroseconds.load() / 1000.0; }
+    std::string Report() const;
+
+private:
+    struct Entry
+    {
+        PipelineStateKey               key;
+        std::shared_future<VkPipeline> future;
+        //编译完成并被取过一次之后缓存在这里，之后的查找不再经过shared_future
+        std::atomic<VkPipeline> pipeline = VK_NULL_HANDLE;
+    };
+
+    struct Table
+    {
+        uint32_t                                capacity = 0; //2的幂
+        std::unique_ptr<std::atomic<Entry*>[]> slots;
+    };
+
+    static Entry* Find(const Table& table , const PipelineStateKey& key);
+    static void   Insert(Table& table , Entry* entry);
+    Entry*        Request(const GraphicsPipelineDesc& desc , CompilePriority priority);
+    void          EvictHandle(uint64_t handle);
+
+    VkDevice                      m_Device       = VK_NULL_HANDLE;
+    PipelineCompiler*             m_Compiler     = nullptr;
+    ExtendedDynamicStateFunctions m_Functions;
+    uint32_t                      m_DynamicState = 0;
+
+    std::atomic<Table*> m_Table = nullptr;
+
+    //以下只在持有写锁时修改
+    std::mutex                          m_WriteMutex;
+    std::vector<std::unique_ptr<Table>> m_Tables; //当前表和被替换下来的旧表
+    std::vector<std::unique_ptr<Entry>> m_Entries; //查找表中的条目
+    std::vector<std::unique_ptr<Entry>> m_Evicted; //被Evict移出的条目，管线在Destroy时销毁
+
+    std::atomic<uint32_t> m_Count               = 0;
+    std::atomic<uint64_t> m_CompileMicroseconds = 0;
+};
+
+/*
+ * 一个命令缓冲上的管线绑定器：记住当前绑定的管线和已设置的动态状态，跳过重复的vkCmdBindPipeline和vkCmdSet*EXT。
+ * 所有管线都来自同一个PipelineStateCache，动态状态的集合相同，换管线后已设置的动态状态仍然有效。
+ * 不是线程安全的，每个录制线程、每个命令缓冲用自己的绑定器；中间绕过它绑定过其它图形管线时要先调用Reset
+ */
+class PipelineBinder
+{
+public:
+    PipelineBinder(PipelineStateCache& cache , VkCommandBuffer commandBuffer);
+
+    void Bind(const GraphicsPipelineDesc& desc);
+    //忘记已绑定的管线和动态状态，下一次Bind全部重新设置
+    void Reset();
+
+    uint32_t PipelineBinds() const { return m_PipelineBinds; }
+    uint32_t StateSets() const { return m_StateSets; }
+    //因为和当前状态相同而省掉的调用数
+    uint32_t SkippedCalls() const { return m_SkippedCalls; }
+
+private:
+    PipelineStateCache* m_Cache;
+    VkCommandBuffer     m_CommandBuffer;
+
+    VkPipeline          m_Pipeline  = VK_NULL_HANDLE;
+    bool                m_HasState  = false;
+    VkCullModeFlags     m_CullMode  = VK_CULL_MODE_NONE;
+    VkFrontFace         m_FrontFace = VK_FRONT_FACE_CLOCKWISE;
+    VkPrimitiveTopology m_Topology  = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    uint32_t m_PipelineBinds = 0;
+    uint32_t m_StateSets     = 0;
+    uint32_t m_SkippedCalls  = 0;
+};
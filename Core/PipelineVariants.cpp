@@ -0,0 +1,79 @@
+﻿#include "PipelineVariants.h"
+
+#include <sstream>
+
+std::string VariantKey::Name() const
+{
+    std::ostringstream name;
+    for (uint32_t i = 0; i < OptionCount; i++)
+    {
+        name << ( i == 0 ? "" : " " ) << ShaderOptions[i].name << '='
+                << ShaderOptions[i].firstValue + Get(static_cast<ShaderOption>(i));
+    }
+    return name.str();
+}
+
+VariantKey VariantKey::Parse(const std::string& text)
+{
+    VariantKey key;
+
+    std::string normalized = text;
+    for (char& c : normalized)
+    {
+        c = c == ',' ? ' ' : c;
+    }
+
+    std::istringstream stream(normalized);
+    std::string        token;
+    while (stream >> token)
+    {
+        size_t separator = token.find('=');
+        if (separator == std::string::npos)
+        {
+            throw std::runtime_error("着色器变体的格式应当是name=value: " + token);
+        }
+        std::string name  = token.substr(0, separator);
+        std::string value = token.substr(separator + 1);
+
+        uint32_t option = 0;
+        while (option < OptionCount && name != ShaderOptions[option].name)
+        {
+            option++;
+        }
+        if (option == OptionCount)
+        {
+            throw std::runtime_error("未知的着色器选项: " + name);
+        }
+
+        const ShaderOptionInfo& info = ShaderOptions[option];
+        uint32_t                constant;
+        try
+        {
+            constant = static_cast<uint32_t>(std::stoul(value));
+        }
+        catch (const std::exception&)
+        {
+            throw std::runtime_error("着色器选项的值不是整数: " + token);
+        }
+        if (constant < info.firstValue || constant - info.firstValue >= info.valueCount)
+        {
+            throw std::runtime_error("着色器选项" + name + "的取值范围是" + std::to_string(info.firstValue) + "~" +
+                                     std::to_string(info.firstValue + info.valueCount - 1));
+        }
+        key = key.With(static_cast<ShaderOption>(option), constant - info.firstValue);
+    }
+    return key;
+}
+
+void PipelineVariantCache::Create(PipelineStateCache& states , const GraphicsPipelineDesc& base)
+{
+    m_States = &states;
+    m_Base   = base;
+}
+
+GraphicsPipelineDesc PipelineVariantCache::Desc(VariantKey key) const
+{
+    GraphicsPipelineDesc desc = m_Base;
+    desc.specialization       = key.Specialization();
+    return desc;
+}
@@ -0,0 +1,184 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vulkan/vulkan.h>
+
+#include "PipelineStateCache.h"
+
+//场景着色器的特性开关，每个选项对应着色器中的一个特化常量
+enum class ShaderOption : uint32_t
+{
+    Tint,            //Instanced.vert：颜色乘以逐实例的色调
+    Rotation,        //Instanced.vert：应用逐实例的旋转，关闭时只缩放
+    ColorMode,       //Triangle.frag：0原色，1灰度，2色调分离
+    PosterizeLevels, //Triangle.frag：色调分离的级数
+    Count,
+};
+
+struct ShaderOptionInfo
+{
+    const char* name;
+    uint32_t    constantId;   //着色器中的layout(constant_id = N)
+    uint32_t    valueCount;   //排列键中保存[0, valueCount)的取值
+    uint32_t    firstValue;   //传给着色器的常量是firstValue + 取值
+    uint32_t    defaultValue; //排列键中的取值，不是常量本身
+};
+
+//顺序和ShaderOption一致，constant_id和着色器中的声明一致
+constexpr ShaderOptionInfo ShaderOptions[] = {
+    {"tint", 0, 2, 0, 1},
+    {"rotation", 1, 2, 0, 1},
+    {"colorMode", 2, 3, 0, 0},
+    {"posterize", 3, 8, 2, 2}, //2~9级，默认4级
+};
+static_assert(std::size(ShaderOptions) == static_cast<size_t>(ShaderOption::Count));
+static_assert(std::size(ShaderOptions) <= SpecializationDesc::MaxConstants);
+
+//能容纳valueCount种取值的最少位数
+constexpr uint32_t ShaderOptionBits(uint32_t valueCount)
+{
+    uint32_t bits = 0;
+    while (( 1u << bits ) < valueCount)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+//第option个选项在排列键中的起始位
+constexpr uint32_t ShaderOptionShift(uint32_t option)
+{
+    uint32_t shift = 0;
+    for (uint32_t i = 0; i < option; i++)
+    {
+        shift += ShaderOptionBits(ShaderOptions[i].valueCount);
+    }
+    return shift;
+}
+
+/*
+ * 着色器变体的排列键：每个选项占用能容纳它的取值数量的最少位数，按ShaderOption的顺序排列在一个uint32_t中。
+ * 全部是constexpr，常用的变体可以在编译期写成常量：
+ *     constexpr VariantKey Grayscale = VariantKey().With(ShaderOption::ColorMode, 1);
+ */
+class VariantKey
+{
+public:
+    static constexpr uint32_t OptionCount = static_cast<uint32_t>(ShaderOption::Count);
+
+    //全部选项取默认值
+    constexpr VariantKey()
+    {
+        for (uint32_t i = 0; i < OptionCount; i++)
+        {
+            m_Bits |= ShaderOptions[i].defaultValue << Shift(i);
+        }
+    }
+
+    constexpr uint32_t Get(ShaderOption option) const
+    {
+        uint32_t index = static_cast<uint32_t>(option);
+        return ( m_Bits >> Shift(index) ) & ( ( 1u << BitWidth(ShaderOptions[index].valueCount) ) - 1 );
+    }
+
+    //在编译期求值时，超出范围的取值是编译错误
+    constexpr VariantKey With(ShaderOption option , uint32_t value) const
+    {
+        uint32_t index = static_cast<uint32_t>(option);
+        if (value >= ShaderOptions[index].valueCount)
+        {
+            throw std::runtime_error(std::string("着色器选项的取值超出范围: ") + ShaderOptions[index].name);
+        }
+        uint32_t   mask   = ( ( 1u << BitWidth(ShaderOptions[index].valueCount) ) - 1 ) << Shift(index);
+        VariantKey result = *this;
+        result.m_Bits     = ( m_Bits & ~mask ) | ( value << Shift(index) );
+        return result;
+    }
+
+    constexpr uint32_t Bits() const { return m_Bits; }
+    constexpr bool     operator==(const VariantKey& other) const = default;
+
+    //全部选项取值组合的数量
+    static constexpr uint32_t PermutationCount()
+    {
+        uint32_t count = 1;
+        for (const auto& option : ShaderOptions)
+        {
+            count *= option.valueCount;
+        }
+        return count;
+    }
+
+    //第index个组合，index在[0, PermutationCount())内，用于枚举全部变体。按混合进制展开，第一个选项变化最快
+    static constexpr VariantKey FromIndex(uint32_t index)
+    {
+        VariantKey key;
+        for (uint32_t i = 0; i < OptionCount; i++)
+        {
+            key    = key.With(static_cast<ShaderOption>(i), index % ShaderOptions[i].valueCount);
+            index /= ShaderOptions[i].valueCount;
+        }
+        return key;
+    }
+
+    constexpr SpecializationDesc Specialization() const
+    {
+        SpecializationDesc desc = {};
+        desc.constantCount      = OptionCount;
+        for (uint32_t i = 0; i < OptionCount; i++)
+        {
+            desc.ids[i]    = ShaderOptions[i].constantId;
+            desc.values[i] = ShaderOptions[i].firstValue + Get(static_cast<ShaderOption>(i));
+        }
+        return desc;
+    }
+
+    //例如"tint=1 rotation=1 colorMode=0 posterize=4"，值是传给着色器的常量
+    std::string Name() const;
+    //格式和Name相同，也可以用逗号分隔；没有给出的选项取默认值。格式错误时抛出异常
+    static VariantKey Parse(const std::string& text);
+
+    static constexpr uint32_t TotalBits = ShaderOptionShift(OptionCount);
+
+private:
+    static constexpr uint32_t Shift(uint32_t option) { return ShaderOptionShift(option); }
+    static constexpr uint32_t BitWidth(uint32_t valueCount) { return ShaderOptionBits(valueCount); }
+
+    uint32_t m_Bits = 0;
+};
+
+static_assert(VariantKey::TotalBits <= 32, "排列键放不进32位");
+static_assert(VariantKey().With(ShaderOption::ColorMode, 2).Get(ShaderOption::ColorMode) == 2);
+static_assert(VariantKey::FromIndex(VariantKey::PermutationCount() - 1).Get(ShaderOption::PosterizeLevels) == 7);
+
+/*
+ * 一组只有特化常量不同的管线。变体按完整的管线状态存放在PipelineStateCache中，第一次被请求时编译，之后直接查表。
+ * 磁盘上只有一份SPIR-V，变体数量不会让着色器文件成倍增加；驱动按常量值折叠分支，每个变体只保留自己用到的代码。
+ * 多个录制线程可以同时调用Get，同一个变体只编译一次
+ */
+class PipelineVariantCache
+{
+public:
+    //base是所有变体共用的状态，变体只替换其中的特化常量。管线归states所有，由它销毁
+    void Create(PipelineStateCache& states , const GraphicsPipelineDesc& base);
+
+    //变体对应的完整描述，可以交给PipelineBinder绑定
+    GraphicsPipelineDesc Desc(VariantKey key) const;
+
+    //没有编译过时以最高优先级编译并等待
+    VkPipeline Get(VariantKey key) { return m_States->Get(Desc(key)); }
+    //提交编译但不等待，用于提前准备即将用到的变体
+    void Prefetch(VariantKey key , CompilePriority priority = CompilePriority::Background)
+    {
+        m_States->Prefetch(Desc(key), priority);
+    }
+
+    const GraphicsPipelineDesc& Base() const { return m_Base; }
+
+private:
+    PipelineStateCache*  m_States = nullptr;
+    GraphicsPipelineDesc m_Base;
+};
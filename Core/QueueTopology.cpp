@@ -0,0 +1,194 @@
+﻿#include "QueueTopology.h"
+
+#include <algorithm>
+
+QueueTopology QueueTopology::Discover(VkPhysicalDevice device , VkSurfaceKHR surface)
+{
+    QueueTopology topology;
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, nullptr);
+    topology.m_Families.resize(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, topology.m_Families.data());
+
+    auto supportsPresent = [&](uint32_t family)
+    {
+        //无头模式没有表面，也就不需要呈现支持
+        VkBool32 presentSupport = surface == VK_NULL_HANDLE;
+        if (surface != VK_NULL_HANDLE)
+        {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, family, surface, &presentSupport);
+        }
+        return presentSupport == VK_TRUE;
+    };
+    auto has = [&](uint32_t family , VkQueueFlags flags)
+    {
+        return topology.m_Families[family].queueCount > 0 && ( topology.m_Families[family].queueFlags & flags ) == flags;
+    };
+    auto lacks = [&](uint32_t family , VkQueueFlags flags)
+    {
+        return ( topology.m_Families[family].queueFlags & flags ) == 0;
+    };
+
+    //图形：优先选同时支持呈现的队列族，这样图形和呈现可以共用一个队列
+    for (uint32_t i = 0; i < familyCount; i++)
+    {
+        if (!has(i, VK_QUEUE_GRAPHICS_BIT)) continue;
+        if (topology.graphics.family == UINT32_MAX) topology.graphics.family = i;
+        if (supportsPresent(i))
+        {
+            topology.graphics.family = i;
+            topology.present.family  = i;
+            break;
+        }
+    }
+    if (topology.graphics.family == UINT32_MAX) return topology;
+
+    //呈现：图形队列族不支持时，另找一个支持呈现的队列族
+    for (uint32_t i = 0; i < familyCount && topology.present.family == UINT32_MAX; i++)
+    {
+        if (topology.m_Families[i].queueCount > 0 && supportsPresent(i)) topology.present.family = i;
+    }
+
+    //异步计算：支持计算但不支持图形的队列族
+    topology.compute = topology.graphics;
+    for (uint32_t i = 0; i < familyCount; i++)
+    {
+        if (has(i, VK_QUEUE_COMPUTE_BIT) && lacks(i, VK_QUEUE_GRAPHICS_BIT))
+        {
+            topology.compute.family = i;
+            break;
+        }
+    }
+
+    //传输：优先选只支持传输的队列族，其次是非图形队列族(图形和计算队列族隐含传输能力)
+    topology.transfer = topology.graphics;
+    for (uint32_t i = 0; i < familyCount; i++)
+    {
+        if (has(i, VK_QUEUE_TRANSFER_BIT) && lacks(i, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+        {
+            topology.transfer.family = i;
+            break;
+        }
+    }
+    if (!topology.HasDedicatedTransfer() && topology.HasAsyncCompute())
+    {
+        //和异步计算共用队列族时，队列数足够就使用族内的另一个队列
+        topology.transfer.family = topology.compute.family;
+        topology.transfer.index  = topology.m_Families[topology.compute.family].queueCount > 1 ? 1 : 0;
+    }
+    return topology;
+}
+
+std::vector<VkDeviceQueueCreateInfo> QueueTopology::QueueCreateInfos() const
+{
+    //一个队列族最多请求两个队列(异步计算和传输共用队列族时)
+    static constexpr float priorities[] = {1.0f, 1.0f};
+
+    std::vector<VkDeviceQueueCreateInfo> createInfos;
+    for (const QueueSlot& slot : {graphics, present, compute, transfer})
+    {
+        auto it = std::find_if(createInfos.begin(), createInfos.end(), [&](const VkDeviceQueueCreateInfo& info)
+        {
+            return info.queueFamilyIndex == slot.family;
+        });
+        if (it == createInfos.end())
+        {
+            VkDeviceQueueCreateInfo queueCreateInfo = {};
+            queueCreateInfo.sType                   = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            queueCreateInfo.queueFamilyIndex        = slot.family;
+            queueCreateInfo.queueCount              = slot.index + 1;
+            queueCreateInfo.pQueuePriorities        = priorities;
+            createInfos.push_back(queueCreateInfo);
+        }
+        else
+        {
+            it->queueCount = std::max(it->queueCount, slot.index + 1);
+        }
+    }
+    return createInfos;
+}
+
+std::string QueueTopology::Describe() const
+{
+    auto name = [](const QueueSlot& slot)
+    {
+        return std::to_string(slot.family) + "." + std::to_string(slot.index);
+    };
+    return "queues: graphics " + name(graphics) + ", present " + name(present) + ", compute " + name(compute) +
+            ( HasAsyncCompute() ? " (async)" : "" ) + ", transfer " + name(transfer) +
+            ( HasDedicatedTransfer() ? " (dedicated)" : "" );
+}
+
+namespace QueueOwnership
+{
+    namespace
+    {
+        VkBufferMemoryBarrier BufferBarrier(VkBuffer buffer , VkDeviceSize offset , VkDeviceSize size ,
+                                            uint32_t srcFamily , uint32_t     dstFamily)
+        {
+            VkBufferMemoryBarrier barrier = {};
+            barrier.sType                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex   = srcFamily;
+            barrier.dstQueueFamilyIndex   = dstFamily;
+            barrier.buffer                = buffer;
+            barrier.offset                = offset;
+            barrier.size                  = size;
+            return barrier;
+        }
+
+        VkImageMemoryBarrier ImageBarrier(VkImage       image , const VkImageSubresourceRange& range ,
+                                          VkImageLayout oldLayout , VkImageLayout newLayout , uint32_t srcFamily ,
+                                          uint32_t      dstFamily)
+        {
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout            = oldLayout;
+            barrier.newLayout            = newLayout;
+            barrier.srcQueueFamilyIndex  = srcFamily;
+            barrier.dstQueueFamilyIndex  = dstFamily;
+            barrier.image                = image;
+            barrier.subresourceRange     = range;
+            return barrier;
+        }
+    }
+
+    void ReleaseBuffer(VkCommandBuffer      commandBuffer , VkBuffer buffer , VkDeviceSize offset , VkDeviceSize size ,
+                       uint32_t             srcFamily , uint32_t     dstFamily , VkPipelineStageFlags srcStage ,
+                       VkAccessFlags        srcAccess)
+    {
+        VkBufferMemoryBarrier barrier = BufferBarrier(buffer, offset, size, srcFamily, dstFamily);
+        barrier.srcAccessMask         = srcAccess;
+        vkCmdPipelineBarrier(commandBuffer, srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1,
+                             &barrier, 0, nullptr);
+    }
+
+    void AcquireBuffer(VkCommandBuffer      commandBuffer , VkBuffer buffer , VkDeviceSize offset , VkDeviceSize size ,
+                       uint32_t             srcFamily , uint32_t     dstFamily , VkPipelineStageFlags dstStage ,
+                       VkAccessFlags        dstAccess)
+    {
+        //源阶段和信号量等待的阶段相同，让获取屏障接在信号量等待之后
+        VkBufferMemoryBarrier barrier = BufferBarrier(buffer, offset, size, srcFamily, dstFamily);
+        barrier.dstAccessMask         = dstAccess;
+        vkCmdPipelineBarrier(commandBuffer, dstStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    void ReleaseImage(VkCommandBuffer commandBuffer , VkImage image , const VkImageSubresourceRange& range ,
+                      VkImageLayout   oldLayout , VkImageLayout newLayout , uint32_t srcFamily , uint32_t dstFamily ,
+                      VkPipelineStageFlags srcStage , VkAccessFlags srcAccess)
+    {
+        VkImageMemoryBarrier barrier = ImageBarrier(image, range, oldLayout, newLayout, srcFamily, dstFamily);
+        barrier.srcAccessMask        = srcAccess;
+        vkCmdPipelineBarrier(commandBuffer, srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0,
+                             nullptr, 1, &barrier);
+    }
+
+    void AcquireImage(VkCommandBuffer commandBuffer , VkImage image , const VkImageSubresourceRange& range ,
+                      VkImageLayout   oldLayout , VkImageLayout newLayout , uint32_t srcFamily , uint32_t dstFamily ,
+                      VkPipelineStageFlags dstStage , VkAccessFlags dstAccess)
+    {
+        VkImageMemoryBarrier barrier = ImageBarrier(image, range, oldLayout, newLayout, srcFamily, dstFamily);
+        barrier.dstAccessMask        = dstAccess;
+        vkCmdPipelineBarrier(commandBuffer, dstStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+}
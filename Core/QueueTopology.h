@@ -0,0 +1,72 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+//一个队列：所在的队列族和族内的序号
+struct QueueSlot
+{
+    uint32_t family = UINT32_MAX;
+    uint32_t index  = 0;
+
+    bool operator==(const QueueSlot&) const = default;
+};
+
+/*
+ * 设备的队列拓扑。
+ * 图形队列族一般同时支持计算和传输，但很多GPU还有：
+ *     只支持传输的队列族(DMA引擎)：上传数据可以和渲染并行
+ *     支持计算但不支持图形的队列族(异步计算)：计算任务可以填补图形管线的空闲
+ * 没有专用队列族时，对应的角色退回到图形队列。呈现优先使用图形队列族，不支持时才使用单独的呈现队列族。
+ */
+class QueueTopology
+{
+public:
+    //surface为空(无头模式)时不需要呈现支持
+    static QueueTopology Discover(VkPhysicalDevice device , VkSurfaceKHR surface);
+
+    bool IsComplete() const { return graphics.family != UINT32_MAX && present.family != UINT32_MAX; }
+
+    bool HasDedicatedTransfer() const { return transfer.family != graphics.family; }
+    bool HasAsyncCompute() const { return compute.family != graphics.family; }
+    bool HasSeparatePresent() const { return present.family != graphics.family; }
+
+    //每个用到的队列族一项，所有队列的优先级相同
+    std::vector<VkDeviceQueueCreateInfo> QueueCreateInfos() const;
+
+    std::string Describe() const;
+
+    QueueSlot graphics;
+    QueueSlot present;
+    QueueSlot compute;
+    QueueSlot transfer;
+
+private:
+    std::vector<VkQueueFamilyProperties> m_Families;
+};
+
+/*
+ * 队列族所有权转移。
+ * VK_SHARING_MODE_EXCLUSIVE的资源在另一个队列族上使用前需要转移所有权，否则内容是未定义的：
+ * 先在原队列上录制释放屏障，再在目标队列上录制参数相同的获取屏障，两次提交之间用信号量排序。
+ * 释放屏障的目标阶段和获取屏障的源阶段会被忽略，真正的同步由信号量完成。
+ */
+namespace QueueOwnership
+{
+    void ReleaseBuffer(VkCommandBuffer      commandBuffer , VkBuffer buffer , VkDeviceSize offset , VkDeviceSize size ,
+                       uint32_t             srcFamily , uint32_t     dstFamily , VkPipelineStageFlags srcStage ,
+                       VkAccessFlags        srcAccess);
+    void AcquireBuffer(VkCommandBuffer      commandBuffer , VkBuffer buffer , VkDeviceSize offset , VkDeviceSize size ,
+                       uint32_t             srcFamily , uint32_t     dstFamily , VkPipelineStageFlags dstStage ,
+                       VkAccessFlags        dstAccess);
+
+    //图像的所有权转移可以同时改变布局，释放和获取两侧的布局参数必须相同
+    void ReleaseImage(VkCommandBuffer commandBuffer , VkImage image , const VkImageSubresourceRange& range ,
+                      VkImageLayout   oldLayout , VkImageLayout newLayout , uint32_t srcFamily , uint32_t dstFamily ,
+                      VkPipelineStageFlags srcStage , VkAccessFlags srcAccess);
+    void AcquireImage(VkCommandBuffer commandBuffer , VkImage image , const VkImageSubresourceRange& range ,
+                      VkImageLayout   oldLayout , VkImageLayout newLayout , uint32_t srcFamily , uint32_t dstFamily ,
+                      VkPipelineStageFlags dstStage , VkAccessFlags dstAccess);
+}
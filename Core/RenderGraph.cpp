@@ -0,0 +1,912 @@
+﻿#include "RenderGraph.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include "DeletionQueue.h"
+
+namespace
+{
+    bool IsDepthFormat(VkFormat format)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool HasStencil(VkFormat format)
+    {
+        return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+                format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+    }
+}
+
+RenderResource RenderGraph::ImportImage(std::string name , VkFormat format , VkImageLayout finalLayout)
+{
+    Resource resource    = {};
+    resource.name        = std::move(name);
+    resource.format      = format;
+    resource.imported    = true;
+    resource.depth       = IsDepthFormat(format);
+    resource.finalLayout = finalLayout;
+    m_Resources.push_back(std::move(resource));
+    return static_cast<RenderResource>(m_Resources.size() - 1);
+}
+
+RenderResource RenderGraph::CreateAttachment(std::string name , VkFormat format)
+{
+    Resource resource = {};
+    resource.name     = std::move(name);
+    resource.format   = format;
+    resource.depth    = IsDepthFormat(format);
+    m_Resources.push_back(std::move(resource));
+    return static_cast<RenderResource>(m_Resources.size() - 1);
+}
+
+RenderPassId RenderGraph::AddPass(std::string name , ExecuteFunction execute)
+{
+    Pass pass    = {};
+    pass.name    = std::move(name);
+    pass.execute = std::move(execute);
+    m_Passes.push_back(std::move(pass));
+    return static_cast<RenderPassId>(m_Passes.size() - 1);
+}
+
+void RenderGraph::AddAccess(RenderPassId pass , RenderResource resource , AccessType type , const VkClearValue* clear)
+{
+    if (m_Compiled)
+    {
+        throw std::runtime_error("RenderGraph: 编译之后不能再修改过程的读写声明");
+    }
+    for (const Access& access : m_Passes[pass].accesses)
+    {
+        if (access.resource == resource)
+        {
+            throw std::runtime_error("RenderGraph: 过程" + m_Passes[pass].name + "重复使用了附着" +
+                                     m_Resources[resource].name);
+        }
+    }
+
+    Access access   = {};
+    access.resource = resource;
+    access.type     = type;
+    access.clear    = clear != nullptr;
+    if (clear != nullptr)
+    {
+        access.clearValue = *clear;
+    }
+    m_Passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::WriteColor(RenderPassId pass , RenderResource resource , const VkClearColorValue* clear)
+{
+    if (m_Resources[resource].depth)
+    {
+        throw std::runtime_error("RenderGraph: " + m_Resources[resource].name + "是深度格式，不能作为颜色附着");
+    }
+    VkClearValue value = {};
+    if (clear != nullptr)
+    {
+        value.color = *clear;
+    }
+    AddAccess(pass, resource, AccessType::ColorWrite, clear != nullptr ? &value : nullptr);
+}
+
+void RenderGraph::WriteDepth(RenderPassId pass , RenderResource resource , const VkClearDepthStencilValue* clear)
+{
+    if (!m_Resources[resource].depth)
+    {
+        throw std::runtime_error("RenderGraph: " + m_Resources[resource].name + "不是深度格式");
+    }
+    for (const Access& access : m_Passes[pass].accesses)
+    {
+        if (access.type == AccessType::DepthWrite)
+        {
+            throw std::runtime_error("RenderGraph: 过程" + m_Passes[pass].name + "只能写入一个深度附着");
+        }
+    }
+    VkClearValue value = {};
+    if (clear != nullptr)
+    {
+        value.depthStencil = *clear;
+    }
+    AddAccess(pass, resource, AccessType::DepthWrite, clear != nullptr ? &value : nullptr);
+}
+
+void RenderGraph::ReadAttachment(RenderPassId pass , RenderResource resource)
+{
+    AddAccess(pass, resource, AccessType::AttachmentRead, nullptr);
+}
+
+void RenderGraph::ReadTexture(RenderPassId pass , RenderResource resource)
+{
+    AddAccess(pass, resource, AccessType::TextureRead, nullptr);
+}
+
+RenderGraph::AccessInfo RenderGraph::Describe(const Access& access) const
+{
+    VkImageLayout readLayout = m_Resources[access.resource].depth
+                                   ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                   : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    AccessInfo info = {};
+    switch (access.type)
+    {
+    case AccessType::ColorWrite:
+        //保留原有内容时loadOp为LOAD，渲染流程开始时会读取附着
+        info.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        info.writes = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        info.access = info.writes | ( access.clear ? 0 : VK_ACCESS_COLOR_ATTACHMENT_READ_BIT );
+        info.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        break;
+    case AccessType::DepthWrite:
+        //深度测试既读又写，发生在片段着色器前后两个阶段
+        info.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        info.writes = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        info.access = info.writes | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+        info.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        break;
+    case AccessType::AttachmentRead:
+        info.stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        info.access = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        info.layout = readLayout;
+        break;
+    case AccessType::TextureRead:
+        info.stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        info.access = VK_ACCESS_SHADER_READ_BIT;
+        info.layout = readLayout;
+        break;
+    }
+    return info;
+}
+
+void RenderGraph::Compile(VkDevice device)
+{
+    m_Device = device;
+    CullPasses();
+
+    //存活的过程按执行顺序登记每个资源的使用，第一次使用必须是写入
+    for (RenderPassId id = 0; id < m_Passes.size(); id++)
+    {
+        Pass& pass = m_Passes[id];
+        if (pass.culled) continue;
+
+        bool writesAttachment = false;
+        for (uint32_t i = 0; i < pass.accesses.size(); i++)
+        {
+            const Access& access   = pass.accesses[i];
+            Resource&     resource = m_Resources[access.resource];
+            bool          write    = access.type == AccessType::ColorWrite || access.type == AccessType::DepthWrite;
+            if (resource.uses.empty() && !write)
+            {
+                throw std::runtime_error("RenderGraph: 过程" + pass.name + "读取了还没有写入的" + resource.name);
+            }
+            writesAttachment = writesAttachment || write;
+            resource.uses.push_back({id, i});
+
+            switch (access.type)
+            {
+            case AccessType::ColorWrite: resource.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+                break;
+            case AccessType::DepthWrite: resource.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+                break;
+            case AccessType::AttachmentRead: resource.usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+                break;
+            case AccessType::TextureRead: resource.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+                break;
+            }
+        }
+        if (!writesAttachment)
+        {
+            throw std::runtime_error("RenderGraph: 过程" + pass.name + "没有写入任何附着");
+        }
+    }
+
+    AssignGroups();
+    AssignMemorySlots();
+
+    //逐个VkRenderPass推导附着的布局，currentLayouts是每个资源在上一个VkRenderPass结束时的布局
+    std::vector<VkImageLayout> currentLayouts(m_Resources.size(), VK_IMAGE_LAYOUT_UNDEFINED);
+    for (uint32_t group = 0; group < m_Groups.size(); group++)
+    {
+        CreateRenderPass(group, currentLayouts);
+    }
+    m_Compiled = true;
+}
+
+void RenderGraph::CullPasses()
+{
+    //从后往前倒推：needed表示资源当前的内容之后还会被读取。
+    //过程的写入没有一个被需要时剔除；保留的过程清除写入的资源之前的内容不再需要，读取的资源则需要
+    std::vector<bool> needed(m_Resources.size());
+    for (RenderResource id = 0; id < m_Resources.size(); id++)
+    {
+        needed[id] = m_Resources[id].imported;
+    }
+
+    for (size_t i = m_Passes.size(); i-- > 0;)
+    {
+        Pass& pass  = m_Passes[i];
+        pass.culled = std::none_of(pass.accesses.begin(), pass.accesses.end(), [&](const Access& access)
+        {
+            bool write = access.type == AccessType::ColorWrite || access.type == AccessType::DepthWrite;
+            return write && needed[access.resource];
+        });
+        if (pass.culled)
+        {
+            m_CulledCount++;
+            continue;
+        }
+
+        for (const Access& access : pass.accesses)
+        {
+            if (access.clear)
+            {
+                needed[access.resource] = false;
+            }
+        }
+        for (const Access& access : pass.accesses)
+        {
+            if (access.type == AccessType::AttachmentRead || access.type == AccessType::TextureRead)
+            {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::AssignGroups()
+{
+    //相邻的过程合并为子流程，除非需要以纹理方式采样同组的附着，或者把同组采样过的资源当作附着：
+    //采样任意位置的数据必须等整个VkRenderPass结束，附着在子流程之间也不能处于采样要求的布局
+    std::vector<bool> attachmentInGroup(m_Resources.size());
+    std::vector<bool> sampledInGroup(m_Resources.size());
+    for (RenderPassId id = 0; id < m_Passes.size(); id++)
+    {
+        Pass& pass = m_Passes[id];
+        if (pass.culled) continue;
+
+        bool merge = !m_Groups.empty();
+        for (const Access& access : pass.accesses)
+        {
+            bool sampled = access.type == AccessType::TextureRead;
+            if (sampled ? attachmentInGroup[access.resource] : sampledInGroup[access.resource])
+            {
+                merge = false;
+            }
+        }
+        if (!merge)
+        {
+            m_Groups.emplace_back();
+            std::fill(attachmentInGroup.begin(), attachmentInGroup.end(), false);
+            std::fill(sampledInGroup.begin(), sampledInGroup.end(), false);
+        }
+
+        Group& group = m_Groups.back();
+        pass.group   = static_cast<uint32_t>(m_Groups.size() - 1);
+        pass.subpass = static_cast<uint32_t>(group.passes.size());
+        group.passes.push_back(id);
+        for (const Access& access : pass.accesses)
+        {
+            if (access.type == AccessType::TextureRead)
+            {
+                sampledInGroup[access.resource] = true;
+            }
+            else
+            {
+                attachmentInGroup[access.resource] = true;
+            }
+        }
+    }
+
+    for (Resource& resource : m_Resources)
+    {
+        if (resource.uses.empty()) continue;
+        resource.firstGroup = m_Passes[resource.uses.front().pass].group;
+        resource.lastGroup  = m_Passes[resource.uses.back().pass].group;
+        //只在一个VkRenderPass内使用的附着不需要写回内存，在分块渲染的GPU上可以完全留在片上
+        resource.lazy = !resource.imported && resource.firstGroup == resource.lastGroup &&
+                ( resource.usage & VK_IMAGE_USAGE_SAMPLED_BIT ) == 0;
+    }
+}
+
+void RenderGraph::AssignMemorySlots()
+{
+    //按第一次使用的先后贪心分配：生命周期结束在这个附着开始之前的槽位可以复用
+    std::vector<RenderResource> order;
+    for (RenderResource id = 0; id < m_Resources.size(); id++)
+    {
+        if (!m_Resources[id].imported && !m_Resources[id].uses.empty())
+        {
+            order.push_back(id);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](RenderResource a , RenderResource b)
+    {
+        return m_Resources[a].firstGroup < m_Resources[b].firstGroup;
+    });
+
+    std::vector<uint32_t> slotEnd; //每个槽位最后一个附着的lastGroup
+    for (RenderResource id : order)
+    {
+        Resource& resource = m_Resources[id];
+        uint32_t  slot     = NoSlot;
+        if (!resource.lazy)
+        {
+            for (uint32_t i = 0; i < m_Slots.size(); i++)
+            {
+                if (!m_Slots[i].lazy && slotEnd[i] < resource.firstGroup)
+                {
+                    slot = i;
+                    break;
+                }
+            }
+        }
+        if (slot == NoSlot)
+        {
+            slot = static_cast<uint32_t>(m_Slots.size());
+            m_Slots.emplace_back();
+            m_Slots.back().lazy = resource.lazy;
+            slotEnd.push_back(0);
+        }
+        m_Slots[slot].resources.push_back(id);
+        slotEnd[slot] = resource.lastGroup;
+        resource.slot = slot;
+    }
+}
+
+void RenderGraph::CreateRenderPass(uint32_t groupIndex , std::vector<VkImageLayout>& currentLayouts)
+{
+    Group& group = m_Groups[groupIndex];
+
+    std::vector<uint32_t> attachmentIndex(m_Resources.size(), VK_ATTACHMENT_UNUSED);
+    for (RenderPassId id : group.passes)
+    {
+        for (const Access& access : m_Passes[id].accesses)
+        {
+            if (access.type != AccessType::TextureRead && attachmentIndex[access.resource] == VK_ATTACHMENT_UNUSED)
+            {
+                attachmentIndex[access.resource] = static_cast<uint32_t>(group.attachments.size());
+                group.attachments.push_back(access.resource);
+                group.usesImported = group.usesImported || m_Resources[access.resource].imported;
+            }
+        }
+    }
+
+    //同一对子流程之间的依赖合并成一条
+    std::vector<VkSubpassDependency> dependencies;
+    auto addDependency = [&](uint32_t src , uint32_t dst , const AccessInfo& from , const AccessInfo& to)
+    {
+        //组内的依赖只涉及同一像素(附着和输入附着)，可以按区域同步，分块渲染时不必等整个画面
+        VkDependencyFlags flags = src != VK_SUBPASS_EXTERNAL && dst != VK_SUBPASS_EXTERNAL
+                                      ? VK_DEPENDENCY_BY_REGION_BIT
+                                      : 0;
+        for (auto& dependency : dependencies)
+        {
+            if (dependency.srcSubpass == src && dependency.dstSubpass == dst && dependency.dependencyFlags == flags)
+            {
+                dependency.srcStageMask |= from.stages;
+                dependency.srcAccessMask |= from.writes;
+                dependency.dstStageMask |= to.stages;
+                dependency.dstAccessMask |= to.access;
+                return;
+            }
+        }
+        VkSubpassDependency dependency = {};
+        dependency.srcSubpass          = src;
+        dependency.dstSubpass          = dst;
+        dependency.srcStageMask        = from.stages;
+        dependency.srcAccessMask       = from.writes;
+        dependency.dstStageMask        = to.stages;
+        dependency.dstAccessMask       = to.access;
+        dependency.dependencyFlags     = flags;
+        dependencies.push_back(dependency);
+    };
+
+    std::vector<VkAttachmentDescription> descriptions(group.attachments.size());
+    group.clearValues.assign(group.attachments.size(), VkClearValue{});
+    for (uint32_t a = 0; a < group.attachments.size(); a++)
+    {
+        RenderResource  resourceId = group.attachments[a];
+        const Resource& resource   = m_Resources[resourceId];
+        const auto&     uses       = resource.uses;
+        auto            inGroup    = [&](const Use& use) { return m_Passes[use.pass].group == groupIndex; };
+        size_t          begin      = std::find_if(uses.begin(), uses.end(), inGroup) - uses.begin();
+        size_t          end        = begin;
+        while (end < uses.size() && inGroup(uses[end]))
+        {
+            end++;
+        }
+        auto accessOf = [&](const Use& use) -> const Access& { return m_Passes[use.pass].accesses[use.access]; };
+
+        const Access& first     = accessOf(uses[begin]);
+        AccessInfo    firstInfo = Describe(first);
+        AccessInfo    lastInfo  = Describe(accessOf(uses[end - 1]));
+        const Use*    previous  = begin > 0 ? &uses[begin - 1] : nullptr;
+        const Use*    next      = end < uses.size() ? &uses[end] : nullptr;
+
+        //清除或内容无效时不读取原有内容，initialLayout为UNDEFINED，省掉一次有意义的布局转换
+        VkAttachmentLoadOp loadOp = first.clear
+                                        ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                                        : currentLayouts[resourceId] == VK_IMAGE_LAYOUT_UNDEFINED
+                                        ? VK_ATTACHMENT_LOAD_OP_DONT_CARE
+                                        : VK_ATTACHMENT_LOAD_OP_LOAD;
+        //之后没有过程再使用的临时附着不写回内存
+        VkAttachmentStoreOp storeOp = next != nullptr || resource.imported
+                                          ? VK_ATTACHMENT_STORE_OP_STORE
+                                          : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+        //结束时直接转换到下一次使用要求的布局：之后被采样时转换为只读布局，之后还作为附着时保持不变
+        VkImageLayout finalLayout = lastInfo.layout;
+        if (next != nullptr && accessOf(*next).type == AccessType::TextureRead)
+        {
+            finalLayout = Describe(accessOf(*next)).layout;
+        }
+        else if (next == nullptr && resource.imported)
+        {
+            finalLayout = resource.finalLayout;
+        }
+
+        VkImageLayout initialLayout = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD
+                                          ? currentLayouts[resourceId]
+                                          : VK_IMAGE_LAYOUT_UNDEFINED;
+        currentLayouts[resourceId] = finalLayout;
+        //不读取原有内容时，第一次写入颜色附着不需要读访问
+        if (loadOp == VK_ATTACHMENT_LOAD_OP_DONT_CARE && first.type == AccessType::ColorWrite)
+        {
+            firstInfo.access &= ~VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+        }
+
+        VkAttachmentDescription& description = descriptions[a];
+        description.format                   = resource.format;
+        description.samples                  = VK_SAMPLE_COUNT_1_BIT;
+        description.loadOp                   = loadOp;
+        description.storeOp                  = storeOp;
+        description.stencilLoadOp            = HasStencil(resource.format) ? loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        description.stencilStoreOp           = HasStencil(resource.format) ? storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description.initialLayout            = initialLayout;
+        description.finalLayout              = finalLayout;
+        if (first.clear)
+        {
+            group.clearValues[a] = first.clearValue;
+        }
+
+        //进入：等待前一个VkRenderPass中的访问。本帧第一次使用时等待上一帧对这个附着，
+        //以及与它共用内存的其它附着的全部访问，同一队列上之前提交的命令都在依赖的第一个同步范围内
+        uint32_t firstSubpass = m_Passes[uses[begin].pass].subpass;
+        if (previous != nullptr)
+        {
+            AccessInfo previousInfo = Describe(accessOf(*previous));
+            if (previousInfo.writes != 0 || firstInfo.writes != 0 || description.initialLayout != firstInfo.layout)
+            {
+                addDependency(VK_SUBPASS_EXTERNAL, firstSubpass, previousInfo, firstInfo);
+            }
+        }
+        else
+        {
+            AccessInfo previousFrame = {};
+            auto       accumulate    = [&](RenderResource other)
+            {
+                for (const Use& use : m_Resources[other].uses)
+                {
+                    AccessInfo info = Describe(accessOf(use));
+                    previousFrame.stages |= info.stages;
+                    previousFrame.writes |= info.writes;
+                }
+            };
+            if (resource.slot != NoSlot)
+            {
+                for (RenderResource other : m_Slots[resource.slot].resources)
+                {
+                    accumulate(other);
+                }
+            }
+            else
+            {
+                accumulate(resourceId);
+            }
+            addDependency(VK_SUBPASS_EXTERNAL, firstSubpass, previousFrame, firstInfo);
+        }
+
+        //组内：相邻两次使用之间有写入或布局变化时才需要依赖，两次都是读取且布局相同时不同步
+        for (size_t i = begin + 1; i < end; i++)
+        {
+            AccessInfo from = Describe(accessOf(uses[i - 1]));
+            AccessInfo to   = Describe(accessOf(uses[i]));
+            if (from.writes != 0 || to.writes != 0 || from.layout != to.layout)
+            {
+                addDependency(m_Passes[uses[i - 1].pass].subpass, m_Passes[uses[i].pass].subpass, from, to);
+            }
+        }
+
+        //离开：之后以纹理方式采样时，让之后的片段着色器等待这里的写入；之后作为附着使用时由那个VkRenderPass的进入依赖负责
+        if (next != nullptr && accessOf(*next).type == AccessType::TextureRead)
+        {
+            addDependency(m_Passes[uses[end - 1].pass].subpass, VK_SUBPASS_EXTERNAL, lastInfo,
+                          Describe(accessOf(*next)));
+        }
+    }
+
+    //每个子流程的附着引用，输入附着的序号就是ReadAttachment的调用顺序
+    struct SubpassReferences
+    {
+        std::vector<VkAttachmentReference> colors;
+        std::vector<VkAttachmentReference> inputs;
+        VkAttachmentReference              depth    = {};
+        bool                               hasDepth = false;
+        std::vector<uint32_t>              preserve;
+    };
+    std::vector<SubpassReferences> references(group.passes.size());
+    for (uint32_t s = 0; s < group.passes.size(); s++)
+    {
+        for (const Access& access : m_Passes[group.passes[s]].accesses)
+        {
+            if (access.type == AccessType::TextureRead) continue;
+            VkAttachmentReference reference = {attachmentIndex[access.resource], Describe(access).layout};
+            if (access.type == AccessType::ColorWrite)
+            {
+                references[s].colors.push_back(reference);
+            }
+            else if (access.type == AccessType::DepthWrite)
+            {
+                references[s].depth    = reference;
+                references[s].hasDepth = true;
+            }
+            else
+            {
+                references[s].inputs.push_back(reference);
+            }
+        }
+    }
+
+    //夹在两次使用之间、自己不使用的子流程必须声明保留这个附着，否则它的内容可能被丢弃
+    for (uint32_t a = 0; a < group.attachments.size(); a++)
+    {
+        std::vector<uint32_t> users;
+        for (const Use& use : m_Resources[group.attachments[a]].uses)
+        {
+            if (m_Passes[use.pass].group == groupIndex)
+            {
+                users.push_back(m_Passes[use.pass].subpass);
+            }
+        }
+        for (uint32_t s = users.front() + 1; s < users.back(); s++)
+        {
+            if (std::find(users.begin(), users.end(), s) == users.end())
+            {
+                references[s].preserve.push_back(a);
+            }
+        }
+    }
+
+    std::vector<VkSubpassDescription> subpasses(group.passes.size());
+    for (uint32_t s = 0; s < subpasses.size(); s++)
+    {
+        subpasses[s].pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpasses[s].colorAttachmentCount    = static_cast<uint32_t>(references[s].colors.size());
+        subpasses[s].pColorAttachments       = references[s].colors.data();
+        subpasses[s].inputAttachmentCount    = static_cast<uint32_t>(references[s].inputs.size());
+        subpasses[s].pInputAttachments       = references[s].inputs.data();
+        subpasses[s].pDepthStencilAttachment = references[s].hasDepth ? &references[s].depth : nullptr;
+        subpasses[s].preserveAttachmentCount = static_cast<uint32_t>(references[s].preserve.size());
+        subpasses[s].pPreserveAttachments    = references[s].preserve.data();
+    }
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType                  = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount        = static_cast<uint32_t>(descriptions.size());
+    renderPassInfo.pAttachments           = descriptions.data();
+    renderPassInfo.subpassCount           = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses             = subpasses.data();
+    renderPassInfo.dependencyCount        = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies          = dependencies.data();
+
+    if (group.renderPass.Create(m_Device, vkCreateRenderPass, renderPassInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("RenderGraph: 创建渲染流程失败");
+    }
+    m_DependencyCount += static_cast<uint32_t>(dependencies.size());
+}
+
+void RenderGraph::SetImportedViews(RenderResource resource , std::vector<VkImageView> views)
+{
+    m_Resources[resource].importedViews = std::move(views);
+}
+
+void RenderGraph::CreateTargets(DeviceMemoryAllocator& allocator , VkExtent2D extent)
+{
+    m_Allocator      = &allocator;
+    m_Extent         = extent;
+    m_RequiredBytes  = 0;
+    m_AllocatedBytes = 0;
+
+    for (MemorySlot& slot : m_Slots)
+    {
+        std::vector<VkMemoryRequirements> requirements;
+        for (RenderResource id : slot.resources)
+        {
+            Resource& resource = m_Resources[id];
+
+            VkImageCreateInfo imageInfo = {};
+            imageInfo.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType         = VK_IMAGE_TYPE_2D;
+            imageInfo.format            = resource.format;
+            imageInfo.extent            = {extent.width, extent.height, 1};
+            imageInfo.mipLevels         = 1;
+            imageInfo.arrayLayers       = 1;
+            imageInfo.samples           = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling            = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage             = resource.usage | ( resource.lazy ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0 );
+            imageInfo.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            if (resource.image.Create(m_Device, vkCreateImage, imageInfo) != VK_SUCCESS)
+            {
+                throw std::runtime_error("RenderGraph: 创建附着" + resource.name + "失败");
+            }
+            VkMemoryRequirements requirement = {};
+            vkGetImageMemoryRequirements(m_Device, resource.image, &requirement);
+            requirements.push_back(requirement);
+            m_RequiredBytes += requirement.size;
+        }
+
+        //延迟分配的内存在分块渲染的GPU上不占用实际的显存，单独分配，不与其它附着共用
+        AllocationCreateInfo createInfo = {};
+        createInfo.preferredFlags       = slot.lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0;
+        createInfo.kind                 = ResourceKind::Optimal;
+        createInfo.dedicated            = slot.lazy;
+
+        //共用内存要求所有附着都能放进同一种内存类型，取需求的交集；没有交集时退回各自分配
+        VkMemoryRequirements combined = requirements.front();
+        for (const auto& requirement : requirements)
+        {
+            combined.size      = std::max(combined.size, requirement.size);
+            combined.alignment = std::max(combined.alignment, requirement.alignment);
+            combined.memoryTypeBits &= requirement.memoryTypeBits;
+        }
+        if (combined.memoryTypeBits != 0)
+        {
+            slot.allocations.push_back(allocator.Allocate(combined, createInfo));
+            m_AllocatedBytes += combined.size;
+        }
+        else
+        {
+            for (const auto& requirement : requirements)
+            {
+                slot.allocations.push_back(allocator.Allocate(requirement, createInfo));
+                m_AllocatedBytes += requirement.size;
+            }
+        }
+
+        for (size_t i = 0; i < slot.resources.size(); i++)
+        {
+            const Allocation& allocation = slot.allocations[slot.allocations.size() == 1 ? 0 : i];
+            vkBindImageMemory(m_Device, m_Resources[slot.resources[i]].image, allocation.memory, allocation.offset);
+        }
+    }
+
+    for (Resource& resource : m_Resources)
+    {
+        if (resource.image == VK_NULL_HANDLE) continue;
+
+        //作为输入附着或纹理读取的深度视图只能包含深度一个方面
+        VkImageAspectFlags aspect = resource.depth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        if (HasStencil(resource.format) &&
+            ( resource.usage & ( VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT ) ) == 0)
+        {
+            aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType                 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image                 = resource.image;
+        viewInfo.viewType              = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format                = resource.format;
+        viewInfo.subresourceRange      = {aspect, 0, 1, 0, 1};
+
+        if (resource.view.Create(m_Device, vkCreateImageView, viewInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("RenderGraph: 创建附着" + resource.name + "的视图失败");
+        }
+    }
+
+    //用到导入图像的VkRenderPass，每个导入视图一个帧缓冲
+    for (Group& group : m_Groups)
+    {
+        size_t framebufferCount = 1;
+        for (RenderResource id : group.attachments)
+        {
+            if (m_Resources[id].imported)
+            {
+                if (m_Resources[id].importedViews.empty())
+                {
+                    throw std::runtime_error("RenderGraph: 导入的图像" + m_Resources[id].name + "没有设置视图");
+                }
+                framebufferCount = m_Resources[id].importedViews.size();
+            }
+        }
+
+        group.framebuffers.resize(framebufferCount);
+        for (size_t i = 0; i < framebufferCount; i++)
+        {
+            std::vector<VkImageView> views;
+            for (RenderResource id : group.attachments)
+            {
+                const Resource& resource = m_Resources[id];
+                views.push_back(resource.imported ? resource.importedViews.at(i) : resource.view.Get());
+            }
+
+            VkFramebufferCreateInfo framebufferInfo = {};
+            framebufferInfo.sType                   = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass              = group.renderPass;
+            framebufferInfo.attachmentCount         = static_cast<uint32_t>(views.size());
+            framebufferInfo.pAttachments            = views.data();
+            framebufferInfo.width                   = extent.width;
+            framebufferInfo.height                  = extent.height;
+            framebufferInfo.layers                  = 1;
+
+            if (group.framebuffers[i].Create(m_Device, vkCreateFramebuffer, framebufferInfo) != VK_SUCCESS)
+            {
+                throw std::runtime_error("RenderGraph: 创建帧缓冲失败");
+            }
+        }
+    }
+}
+
+void RenderGraph::RetireTargets(DeletionQueue& deletionQueue , uint64_t serial)
+{
+    //帧缓冲引用视图，视图引用图像，图像绑定在内存上，按这个顺序登记
+    for (Group& group : m_Groups)
+    {
+        deletionQueue.Retire(serial, std::move(group.framebuffers));
+    }
+
+    std::vector<UniqueImageView> views;
+    std::vector<UniqueImage>     images;
+    for (Resource& resource : m_Resources)
+    {
+        if (resource.image == VK_NULL_HANDLE) continue;
+        views.push_back(std::move(resource.view));
+        images.push_back(std::move(resource.image));
+    }
+    deletionQueue.Retire(serial, std::move(views));
+    deletionQueue.Retire(serial, std::move(images));
+
+    std::vector<Allocation> allocations;
+    for (MemorySlot& slot : m_Slots)
+    {
+        allocations.insert(allocations.end(), slot.allocations.begin(), slot.allocations.end());
+        slot.allocations.clear();
+    }
+    if (!allocations.empty())
+    {
+        deletionQueue.Push(serial, [allocator = m_Allocator, allocations]() mutable
+        {
+            for (auto& allocation : allocations)
+            {
+                allocator->Free(allocation);
+            }
+        });
+    }
+}
+
+void RenderGraph::Destroy()
+{
+    for (Group& group : m_Groups)
+    {
+        group.framebuffers.clear();
+        group.renderPass.Reset();
+    }
+    for (Resource& resource : m_Resources)
+    {
+        resource.view.Reset();
+        resource.image.Reset();
+    }
+    for (MemorySlot& slot : m_Slots)
+    {
+        for (auto& allocation : slot.allocations)
+        {
+            m_Allocator->Free(allocation);
+        }
+        slot.allocations.clear();
+    }
+}
+
+void RenderGraph::SetSecondaryContents(RenderPassId pass , bool secondary)
+{
+    m_Passes[pass].secondary = secondary;
+}
+
+void RenderGraph::Execute(VkCommandBuffer commandBuffer , uint32_t importedIndex)
+{
+    for (const Group& group : m_Groups)
+    {
+        VkFramebuffer framebuffer = group.framebuffers[group.usesImported ? importedIndex : 0];
+
+        VkRenderPassBeginInfo beginInfo = {};
+        beginInfo.sType                 = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        beginInfo.renderPass            = group.renderPass;
+        beginInfo.framebuffer           = framebuffer;
+        beginInfo.renderArea.offset     = {0, 0};
+        beginInfo.renderArea.extent     = m_Extent;
+        beginInfo.clearValueCount       = static_cast<uint32_t>(group.clearValues.size());
+        beginInfo.pClearValues          = group.clearValues.data();
+
+        RenderPassContext context = {};
+        context.commandBuffer     = commandBuffer;
+        context.renderPass        = group.renderPass;
+        context.framebuffer       = framebuffer;
+        context.extent            = m_Extent;
+
+        for (const RenderPassId id : group.passes)
+        {
+            const Pass&       pass     = m_Passes[id];
+            VkSubpassContents contents = pass.secondary
+                                             ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                             : VK_SUBPASS_CONTENTS_INLINE;
+            if (pass.subpass == 0)
+            {
+                vkCmdBeginRenderPass(commandBuffer, &beginInfo, contents);
+            }
+            else
+            {
+                vkCmdNextSubpass(commandBuffer, contents);
+            }
+            context.subpass = pass.subpass;
+            pass.execute(context);
+        }
+        vkCmdEndRenderPass(commandBuffer);
+    }
+}
+
+VkRenderPass RenderGraph::RenderPass(RenderPassId pass) const
+{
+    if (m_Passes[pass].culled)
+    {
+        throw std::runtime_error("RenderGraph: 过程" + m_Passes[pass].name + "已被剔除，没有渲染流程");
+    }
+    return m_Groups[m_Passes[pass].group].renderPass;
+}
+
+std::string RenderGraph::Report() const
+{
+    char        line[256];
+    std::string report;
+    std::snprintf(line, sizeof(line), "render graph: %zu passes (%u culled) -> %zu render passes, %zu subpasses, "
+                  "%u dependencies\n", m_Passes.size(), m_CulledCount, m_Groups.size(),
+                  m_Passes.size() - m_CulledCount, m_DependencyCount);
+    report += line;
+
+    for (size_t g = 0; g < m_Groups.size(); g++)
+    {
+        report += "  render pass " + std::to_string(g) + ":";
+        for (RenderPassId id : m_Groups[g].passes)
+        {
+            report += ( id == m_Groups[g].passes.front() ? " " : " + " ) + m_Passes[id].name;
+        }
+        report += '\n';
+    }
+
+    uint32_t lazyCount    = 0;
+    uint32_t aliasedCount = 0;
+    for (const MemorySlot& slot : m_Slots)
+    {
+        lazyCount += slot.lazy ? 1 : 0;
+        aliasedCount += !slot.lazy && slot.resources.size() > 1 ? static_cast<uint32_t>(slot.resources.size()) : 0;
+    }
+    std::snprintf(line, sizeof(line), "  transient memory: %.2f MB (%.2f MB without aliasing), %u attachments "
+                  "aliased, %u lazily allocated\n", m_AllocatedBytes / 1048576.0, m_RequiredBytes / 1048576.0,
+                  aliasedCount, lazyCount);
+    report += line;
+    return report;
+}
@@ -0,0 +1,188 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "DeviceMemoryAllocator.h"
+#include "VulkanHandle.h"
+
+class DeletionQueue;
+
+using RenderResource = uint32_t;
+using RenderPassId   = uint32_t;
+
+//传给每个渲染过程的录制回调。并行录制secondary命令缓冲时，继承信息取自这里
+struct RenderPassContext
+{
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkRenderPass    renderPass    = VK_NULL_HANDLE;
+    uint32_t        subpass       = 0;
+    VkFramebuffer   framebuffer   = VK_NULL_HANDLE;
+    VkExtent2D      extent        = {};
+};
+
+/*
+ * 渲染图：各个渲染过程只声明读写哪些附着，屏障、布局转换和附着的内存由图推导。
+ *
+ * 编译(Compile，只依赖格式)：
+ *     剔除：从导入的图像(交换链图像)倒推，结果没有被任何需要的过程读取的过程不录制；
+ *     合并：相邻的过程只要不以纹理方式采样同组写入的附着，就合并为同一个VkRenderPass的子流程，
+ *           以输入附着读取的数据留在片上，不必写回内存；
+ *     同步：只在真正有冲突(写后读、读后写、写后写、布局转换)的两次访问之间生成子流程依赖，
+ *           组内依赖都是BY_REGION，布局转换折叠进附着的initialLayout/finalLayout，不录制单独的屏障。
+ * 创建附着(CreateTargets，依赖尺寸，窗口尺寸变化时重建)：
+ *     只在一个VkRenderPass内使用、不需要写回的附着使用TRANSIENT_ATTACHMENT并优先放进延迟分配的内存；
+ *     其余临时附着按生命周期(第一次和最后一次使用所在的VkRenderPass)分组，生命周期不重叠的附着共用同一块内存。
+ *
+ * 过程按声明顺序执行，读取的资源必须已经由前面的过程写入。一个过程不能同时读写同一个附着。
+ */
+class RenderGraph
+{
+public:
+    using ExecuteFunction = std::function<void(const RenderPassContext&)>;
+
+    //外部图像(例如交换链图像)：每帧开始时内容无效，所有过程结束后转换到finalLayout，视图由SetImportedViews提供
+    RenderResource ImportImage(std::string name , VkFormat format , VkImageLayout finalLayout);
+    //图内部的临时附着，尺寸与CreateTargets的extent相同
+    RenderResource CreateAttachment(std::string name , VkFormat format);
+    RenderPassId   AddPass(std::string name , ExecuteFunction execute);
+
+    //clear为空时保留附着原有的内容
+    void WriteColor(RenderPassId pass , RenderResource resource , const VkClearColorValue* clear = nullptr);
+    void WriteDepth(RenderPassId pass , RenderResource resource , const VkClearDepthStencilValue* clear = nullptr);
+    //以输入附着读取同一像素，可以与写入它的过程合并为子流程
+    void ReadAttachment(RenderPassId pass , RenderResource resource);
+    //以纹理方式采样任意位置，必须在写入它的VkRenderPass结束之后
+    void ReadTexture(RenderPassId pass , RenderResource resource);
+
+    void Compile(VkDevice device);
+
+    //导入图像的每个视图对应一组帧缓冲，Execute的importedIndex选择其中之一
+    void SetImportedViews(RenderResource resource , std::vector<VkImageView> views);
+    void CreateTargets(DeviceMemoryAllocator& allocator , VkExtent2D extent);
+    //把附着、帧缓冲和内存交给删除队列，已提交的帧完成后再销毁，之后可以用新的尺寸重新CreateTargets
+    void RetireTargets(DeletionQueue& deletionQueue , uint64_t serial);
+    void Destroy();
+
+    //是否以secondary命令缓冲录制这个过程，可以每帧改变
+    void SetSecondaryContents(RenderPassId pass , bool secondary);
+    void Execute(VkCommandBuffer commandBuffer , uint32_t importedIndex);
+
+    bool         IsCulled(RenderPassId pass) const { return m_Passes[pass].culled; }
+    VkRenderPass RenderPass(RenderPassId pass) const;
+    uint32_t     Subpass(RenderPassId pass) const { return m_Passes[pass].subpass; }
+    VkImageView  ImageView(RenderResource resource) const { return m_Resources[resource].view; }
+
+    //例如"render graph: 6 passes (1 culled) -> 4 render passes, 5 subpasses, 7 dependencies; ..."
+    std::string Report() const;
+
+private:
+    static constexpr uint32_t NoSlot = UINT32_MAX;
+
+    enum class AccessType
+    {
+        ColorWrite,
+        DepthWrite,
+        AttachmentRead,
+        TextureRead,
+    };
+
+    struct Access
+    {
+        RenderResource resource   = 0;
+        AccessType     type       = AccessType::ColorWrite;
+        bool           clear      = false;
+        VkClearValue   clearValue = {};
+    };
+
+    //一次访问在管线中的阶段、访问类型和要求的布局
+    struct AccessInfo
+    {
+        VkPipelineStageFlags stages = 0;
+        VkAccessFlags        access = 0;
+        VkAccessFlags        writes = 0; //access中的写入部分，作为依赖的srcAccessMask
+        VkImageLayout        layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    struct Pass
+    {
+        std::string         name;
+        ExecuteFunction     execute;
+        std::vector<Access> accesses;
+        bool                secondary = false;
+
+        bool     culled  = false;
+        uint32_t group   = 0; //所在的VkRenderPass
+        uint32_t subpass = 0;
+    };
+
+    //资源在存活的过程中的一次使用，按执行顺序排列
+    struct Use
+    {
+        RenderPassId pass;
+        uint32_t     access;
+    };
+
+    struct Resource
+    {
+        std::string   name;
+        VkFormat      format      = VK_FORMAT_UNDEFINED;
+        bool          imported    = false;
+        bool          depth       = false;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        std::vector<Use>  uses;
+        VkImageUsageFlags usage      = 0;
+        uint32_t          firstGroup = 0;
+        uint32_t          lastGroup  = 0;
+        bool              lazy       = false; //只在一个VkRenderPass内使用，不需要写回
+        uint32_t          slot       = NoSlot;
+
+        std::vector<VkImageView> importedViews;
+        UniqueImage              image;
+        UniqueImageView          view;
+    };
+
+    //共用一块内存的临时附着
+    struct MemorySlot
+    {
+        std::vector<RenderResource> resources;
+        bool                        lazy = false;
+        std::vector<Allocation>     allocations; //类型不兼容无法共用时每个附着一块
+    };
+
+    struct Group
+    {
+        std::vector<RenderPassId>      passes;
+        std::vector<RenderResource>    attachments;
+        std::vector<VkClearValue>      clearValues;
+        bool                           usesImported = false;
+        UniqueRenderPass               renderPass;
+        std::vector<UniqueFramebuffer> framebuffers;
+    };
+
+    AccessInfo Describe(const Access& access) const;
+    void       CullPasses();
+    void       AssignGroups();
+    void       AssignMemorySlots();
+    void       CreateRenderPass(uint32_t groupIndex , std::vector<VkImageLayout>& currentLayouts);
+    void       AddAccess(RenderPassId pass , RenderResource resource , AccessType type , const VkClearValue* clear);
+
+    VkDevice               m_Device    = VK_NULL_HANDLE;
+    DeviceMemoryAllocator* m_Allocator = nullptr;
+    VkExtent2D             m_Extent    = {};
+    bool                   m_Compiled  = false;
+
+    std::vector<Resource>   m_Resources;
+    std::vector<Pass>       m_Passes;
+    std::vector<Group>      m_Groups;
+    std::vector<MemorySlot> m_Slots;
+
+    uint32_t     m_CulledCount     = 0;
+    uint32_t     m_DependencyCount = 0;
+    VkDeviceSize m_RequiredBytes   = 0; //每个临时附着单独分配时需要的内存
+    VkDeviceSize m_AllocatedBytes  = 0; //别名共用之后实际分配的内存
+};
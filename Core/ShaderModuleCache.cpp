@@ -0,0 +1,77 @@
+﻿#include "ShaderModuleCache.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "../Tool/Hash.h"
+#include "../Tool/Loader.h"
+
+void ShaderModuleCache::Create(VkDevice device)
+{
+    m_Device = device;
+}
+
+void ShaderModuleCache::Destroy()
+{
+    std::lock_guard lock(m_Mutex);
+    for (auto& [hash, entry] : m_Modules)
+    {
+        vkDestroyShaderModule(m_Device, entry.shaderModule, nullptr);
+    }
+    m_Modules.clear();
+}
+
+VkShaderModule ShaderModuleCache::Load(const std::string& filename)
+{
+    //vkCreateShaderModule会自己拷贝代码，返回后映射就可以解除
+    MappedFile file = Loader::MapFile(filename);
+    return Get(file.Words());
+}
+
+VkShaderModule ShaderModuleCache::Get(std::span<const uint32_t> code)
+{
+    if (code.empty() || code[0] != SpirvMagic)
+    {
+        throw std::runtime_error("invalid SPIR-V: missing magic number");
+    }
+
+    //长度作为种子参与哈希，长度不同的代码不会落到同一个键上
+    size_t   size = code.size_bytes();
+    uint64_t hash = Hash::Fnv1a(code.data(), size, Hash::Fnv1a(&size, sizeof(size)));
+
+    std::lock_guard lock(m_Mutex);
+    auto [first, last] = m_Modules.equal_range(hash);
+    for (auto it = first; it != last; ++it)
+    {
+        if (std::equal(code.begin(), code.end(), it->second.code.begin(), it->second.code.end()))
+        {
+            m_Hits++;
+            return it->second.shaderModule;
+        }
+    }
+
+    VkShaderModuleCreateInfo createInfo = {};
+    createInfo.sType                    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize                 = size;
+    createInfo.pCode                    = code.data();
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(m_Device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create shader module!");
+    }
+    m_Modules.emplace(hash, Entry{std::vector<uint32_t>(code.begin(), code.end()), shaderModule});
+    return shaderModule;
+}
+
+size_t ShaderModuleCache::ModuleCount() const
+{
+    std::lock_guard lock(m_Mutex);
+    return m_Modules.size();
+}
+
+uint32_t ShaderModuleCache::HitCount() const
+{
+    std::lock_guard lock(m_Mutex);
+    return m_Hits;
+}
@@ -0,0 +1,43 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+//按SPIR-V内容哈希缓存VkShaderModule。
+//同一份SPIR-V无论被多少条管线、从哪个路径加载，都只创建一次着色器模块。
+//哈希只用来找候选，命中时还要逐字比较代码，哈希碰撞的两份代码各自创建模块。
+//模块归缓存所有，Destroy时统一销毁，调用者不要自己销毁取得的模块。
+class ShaderModuleCache
+{
+public:
+    void Create(VkDevice device);
+    void Destroy();
+
+    //通过内存映射读取SPIR-V文件，内容不会被拷贝
+    VkShaderModule Load(const std::string& filename);
+    //code必须是完整的SPIR-V，且按4字节对齐
+    VkShaderModule Get(std::span<const uint32_t> code);
+
+    size_t   ModuleCount() const;
+    uint32_t HitCount() const;
+
+private:
+    static constexpr uint32_t SpirvMagic = 0x07230203;
+
+    struct Entry
+    {
+        std::vector<uint32_t> code; //SPIR-V的副本，命中时和请求的代码比较
+        VkShaderModule        shaderModule;
+    };
+
+    VkDevice                                 m_Device = VK_NULL_HANDLE;
+    std::unordered_multimap<uint64_t, Entry> m_Modules;
+    uint32_t                                 m_Hits = 0;
+    //管线可能在编译线程上请求着色器模块
+    mutable std::mutex m_Mutex;
+};
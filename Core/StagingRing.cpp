@@ -0,0 +1,320 @@
+﻿#include "StagingRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "QueueTopology.h"
+
+void StagingRing::Create(VkDevice device , DeviceMemoryAllocator& allocator , VkDeviceSize capacity ,
+                         uint32_t framesInFlight)
+{
+    m_Device    = device;
+    m_Allocator = &allocator;
+    m_FrameMarkers.assign(framesInFlight, std::nullopt);
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size               = capacity;
+    bufferInfo.usage              = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(m_Device, &bufferInfo, nullptr, &m_Buffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建暂存缓冲失败");
+    }
+
+    //整个缓冲绑定在一块独立的主机可见内存上，优先选择一致性内存，省去刷新
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(m_Device, m_Buffer, &requirements);
+    m_Pool.Create(allocator, requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    vkBindBufferMemory(m_Device, m_Buffer, m_Pool.Memory(), 0);
+
+    VkMemoryPropertyFlags flags = allocator.MemoryProperties().memoryTypes[m_Pool.MemoryType()].propertyFlags;
+    m_Coherent                  = flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+void StagingRing::Destroy()
+{
+    if (m_Buffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(m_Device, m_Buffer, nullptr);
+        m_Buffer = VK_NULL_HANDLE;
+    }
+    m_Pool.Destroy();
+}
+
+void StagingRing::BeginFrame(uint32_t frameIndex)
+{
+    //环形缓冲按先进先出回收：这一帧之前提交的帧已经在更早的BeginFrame中等待过
+    if (m_FrameMarkers[frameIndex])
+    {
+        m_Pool.ReleaseUpTo(*m_FrameMarkers[frameIndex]);
+        m_FrameMarkers[frameIndex].reset();
+    }
+    m_CurrentFrame = frameIndex;
+}
+
+bool StagingRing::Upload(VkBuffer dst , VkDeviceSize dstOffset , const void* data , VkDeviceSize size)
+{
+    if (size == 0) return true;
+
+    auto allocation = m_Pool.Allocate(size, m_Alignment);
+    if (!allocation)
+    {
+        m_RejectedCount++;
+        return false;
+    }
+    std::memcpy(allocation->mapped, data, size);
+
+    PendingCopy copy      = {};
+    copy.dst              = dst;
+    copy.region.srcOffset = allocation->offset;
+    copy.region.dstOffset = dstOffset;
+    copy.region.size      = size;
+    m_Pending.push_back(copy);
+
+    m_UploadedBytes += size;
+    m_UploadCount++;
+    return true;
+}
+
+bool StagingRing::UploadImage(VkImage dst , const VkBufferImageCopy& region , const void* data , VkDeviceSize size ,
+                              bool    firstChunk , bool lastChunk)
+{
+    //bufferOffset必须是纹素块大小(BC格式为8或16字节)和4的倍数
+    constexpr VkDeviceSize ImageAlignment = 16;
+
+    auto allocation = m_Pool.Allocate(size, std::max(m_Alignment, ImageAlignment));
+    if (!allocation)
+    {
+        m_RejectedCount++;
+        return false;
+    }
+    std::memcpy(allocation->mapped, data, size);
+
+    PendingImageCopy copy    = {};
+    copy.dst                 = dst;
+    copy.region              = region;
+    copy.region.bufferOffset = allocation->offset;
+    copy.firstChunk          = firstChunk;
+    copy.lastChunk           = lastChunk;
+    m_PendingImages.push_back(copy);
+
+    m_UploadedBytes += size;
+    m_UploadCount++;
+    return true;
+}
+
+void StagingRing::FlushWrites()
+{
+    //非一致性内存需要手动刷新本帧写入的范围，范围要按nonCoherentAtomSize对齐
+    if (m_Coherent || m_Pool.Head() == m_FrameStart) return;
+
+    VkDeviceSize atom     = m_Allocator->NonCoherentAtomSize();
+    VkDeviceSize capacity = m_Pool.Size();
+    VkDeviceSize begin    = m_FrameStart % capacity;
+    VkDeviceSize length   = m_Pool.Head() - m_FrameStart;
+
+    VkMappedMemoryRange ranges[2]  = {};
+    uint32_t            rangeCount = 0;
+    auto addRange = [&](VkDeviceSize offset , VkDeviceSize size)
+    {
+        VkDeviceSize start = offset / atom * atom;
+        VkDeviceSize end   = std::min(( offset + size + atom - 1 ) / atom * atom, capacity);
+        ranges[rangeCount].sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        ranges[rangeCount].memory = m_Pool.Memory();
+        ranges[rangeCount].offset = start;
+        ranges[rangeCount].size   = end == capacity ? VK_WHOLE_SIZE : end - start;
+        rangeCount++;
+    };
+    if (length >= capacity)
+    {
+        addRange(0, capacity);
+    }
+    else if (begin + length <= capacity)
+    {
+        addRange(begin, length);
+    }
+    else
+    {
+        addRange(begin, capacity - begin);
+        addRange(0, begin + length - capacity);
+    }
+    vkFlushMappedMemoryRanges(m_Device, rangeCount, ranges);
+    m_FrameStart = m_Pool.Head();
+}
+
+template <typename F>
+void StagingRing::RecordCopies(VkCommandBuffer commandBuffer , F&& onCopy)
+{
+    //目标相同的连续复制合并成一次vkCmdCopyBuffer。同一次调用中的目标区域不能重叠，遇到重叠时拆开
+    size_t i = 0;
+    while (i < m_Pending.size())
+    {
+        VkBuffer     dst      = m_Pending[i].dst;
+        VkDeviceSize runBegin = m_Pending[i].region.dstOffset;
+        VkDeviceSize runEnd   = runBegin + m_Pending[i].region.size;
+        m_Regions.clear();
+        m_Regions.push_back(m_Pending[i].region);
+        for (i++; i < m_Pending.size() && m_Pending[i].dst == dst; i++)
+        {
+            const VkBufferCopy& region = m_Pending[i].region;
+            if (region.dstOffset < runEnd && region.dstOffset + region.size > runBegin) break;
+
+            runBegin = std::min(runBegin, region.dstOffset);
+            runEnd   = std::max(runEnd, region.dstOffset + region.size);
+            m_Regions.push_back(region);
+        }
+        vkCmdCopyBuffer(commandBuffer, m_Buffer, dst, static_cast<uint32_t>(m_Regions.size()), m_Regions.data());
+        onCopy(dst, runBegin, runEnd - runBegin);
+    }
+    m_Pending.clear();
+}
+
+void StagingRing::RecordImageCopies(VkCommandBuffer commandBuffer , uint32_t releaseToFamily)
+{
+    if (m_PendingImages.empty()) return;
+
+    auto levelBarrier = [](VkImage image , uint32_t level)
+    {
+        VkImageMemoryBarrier barrier            = {};
+        barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image                           = image;
+        barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel   = level;
+        barrier.subresourceRange.levelCount     = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount     = 1;
+        return barrier;
+    };
+
+    //第一块之前丢弃这一级原有的内容，转换到复制目标布局。同一级后面的块在之后的帧上传，布局保持不变
+    m_ImageBarriers.clear();
+    for (const auto& copy : m_PendingImages)
+    {
+        if (!copy.firstChunk) continue;
+        VkImageMemoryBarrier barrier = levelBarrier(copy.dst, copy.region.imageSubresource.mipLevel);
+        barrier.dstAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout            = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        m_ImageBarriers.push_back(barrier);
+    }
+    if (!m_ImageBarriers.empty())
+    {
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                             nullptr, 0, nullptr, static_cast<uint32_t>(m_ImageBarriers.size()),
+                             m_ImageBarriers.data());
+    }
+
+    //目标图像相同的连续复制合并成一次vkCmdCopyBufferToImage，各块的区域互不重叠
+    size_t i = 0;
+    while (i < m_PendingImages.size())
+    {
+        VkImage dst = m_PendingImages[i].dst;
+        m_ImageRegions.clear();
+        for (; i < m_PendingImages.size() && m_PendingImages[i].dst == dst; i++)
+        {
+            m_ImageRegions.push_back(m_PendingImages[i].region);
+        }
+        vkCmdCopyBufferToImage(commandBuffer, m_Buffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(m_ImageRegions.size()), m_ImageRegions.data());
+    }
+
+    //最后一块复制完，这一级转换到着色器只读布局；由传输队列上传时同时释放给图形队列族
+    m_ImageBarriers.clear();
+    for (const auto& copy : m_PendingImages)
+    {
+        if (!copy.lastChunk) continue;
+        VkImageMemoryBarrier barrier = levelBarrier(copy.dst, copy.region.imageSubresource.mipLevel);
+        if (releaseToFamily != VK_QUEUE_FAMILY_IGNORED)
+        {
+            QueueOwnership::ReleaseImage(commandBuffer, copy.dst, barrier.subresourceRange,
+                                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                         m_TransferFamily, releaseToFamily, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                         VK_ACCESS_TRANSFER_WRITE_BIT);
+            m_ImageTransfers.push_back({copy.dst, barrier.subresourceRange});
+            continue;
+        }
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        m_ImageBarriers.push_back(barrier);
+    }
+    if (!m_ImageBarriers.empty())
+    {
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+                             nullptr, 0, nullptr, static_cast<uint32_t>(m_ImageBarriers.size()),
+                             m_ImageBarriers.data());
+    }
+    m_PendingImages.clear();
+}
+
+void StagingRing::RecordTransfer(VkCommandBuffer transferCommands , uint32_t transferFamily ,
+                                 uint32_t        graphicsFamily)
+{
+    FlushWrites();
+    m_TransferFamily = transferFamily;
+    m_GraphicsFamily = graphicsFamily;
+
+    //目标缓冲只被同一套帧资源的图形提交读取，而那次提交已经在BeginFrame之前等待过，传输队列上不需要读后写屏障
+    RecordCopies(transferCommands, [&](VkBuffer dst , VkDeviceSize offset , VkDeviceSize size)
+    {
+        QueueOwnership::ReleaseBuffer(transferCommands, dst, offset, size, transferFamily, graphicsFamily,
+                                      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        m_Transfers.push_back({dst, offset, size});
+    });
+    RecordImageCopies(transferCommands, graphicsFamily);
+}
+
+void StagingRing::Record(VkCommandBuffer commandBuffer)
+{
+    constexpr VkPipelineStageFlags consumerStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+    constexpr VkAccessFlags consumerAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+            VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+    //获取传输队列释放的缓冲，参数要和释放屏障一致
+    for (const auto& transfer : m_Transfers)
+    {
+        QueueOwnership::AcquireBuffer(commandBuffer, transfer.buffer, transfer.offset, transfer.size,
+                                      m_TransferFamily, m_GraphicsFamily, consumerStages, consumerAccess);
+    }
+    m_Transfers.clear();
+    for (const auto& transfer : m_ImageTransfers)
+    {
+        QueueOwnership::AcquireImage(commandBuffer, transfer.image, transfer.range,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                     m_TransferFamily, m_GraphicsFamily, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                     VK_ACCESS_SHADER_READ_BIT);
+    }
+    m_ImageTransfers.clear();
+
+    if (HasPending())
+    {
+        FlushWrites();
+    }
+    if (!m_Pending.empty())
+    {
+
+        //上一帧可能还在读这些缓冲(同一队列上按提交顺序排列)，复制要等之前的顶点输入阶段结束。只有读后写，执行依赖就够了
+        vkCmdPipelineBarrier(commandBuffer, consumerStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                             0, nullptr);
+
+        RecordCopies(commandBuffer, [](VkBuffer , VkDeviceSize , VkDeviceSize) {});
+
+        VkMemoryBarrier barrier = {};
+        barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask   = consumerAccess;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, consumerStages, 0, 1, &barrier, 0,
+                             nullptr, 0, nullptr);
+    }
+    RecordImageCopies(commandBuffer, VK_QUEUE_FAMILY_IGNORED);
+
+    //这一帧的栅栏被等待之后，头部之前的空间都可以回收
+    m_FrameMarkers[m_CurrentFrame] = m_Pool.Head();
+    m_FrameStart                   = m_Pool.Head();
+}
@@ -0,0 +1,121 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "DeviceMemoryAllocator.h"
+
+/*
+ * 持久映射的暂存环形缓冲，用来把CPU数据上传到设备本地的缓冲。
+ * Upload只做一次memcpy并登记复制命令，不分配内存也不等待GPU；
+ * 每帧调用一次Record，把登记的复制合并录制进这一帧的命令缓冲。
+ * 每一帧结束录制时记下环形缓冲的头部位置，等这一帧的栅栏被等待过(同一套帧资源再次使用)时，才回收这之前的空间。
+ */
+class StagingRing
+{
+public:
+    static constexpr VkDeviceSize DefaultCapacity = 16ull << 20;
+
+    void Create(VkDevice device , DeviceMemoryAllocator& allocator , VkDeviceSize capacity , uint32_t framesInFlight);
+    void Destroy();
+
+    //在等待过frameIndex这套帧资源的栅栏之后调用，回收它上一次使用的区域
+    void BeginFrame(uint32_t frameIndex);
+
+    //把数据拷进暂存区并登记一次到dst的复制。空间不足时返回false，调用者可以下一帧再试
+    bool Upload(VkBuffer dst , VkDeviceSize dstOffset , const void* data , VkDeviceSize size);
+
+    /*
+     * 把数据拷进暂存区并登记一次到图像某一级的复制。一级可以分成多块在不同的帧上传，region描述这一块的位置；
+     * firstChunk时先把这一级从UNDEFINED转换到TRANSFER_DST，lastChunk时复制完转换到SHADER_READ_ONLY，供片段着色器读取。
+     * 图像在这一级上传完之前不能被读取。region要满足录制复制的队列族的minImageTransferGranularity。空间不足时返回false
+     */
+    bool UploadImage(VkImage dst , const VkBufferImageCopy& region , const void* data , VkDeviceSize size ,
+                     bool    firstChunk , bool lastChunk);
+
+    bool         HasPending() const { return !m_Pending.empty() || !m_PendingImages.empty(); }
+    VkDeviceSize Capacity() const { return m_Pool.Size(); }
+
+    //有专用传输队列时调用：在传输命令缓冲中录制复制，并把目标缓冲的所有权释放给图形队列族。
+    //传输提交要发出信号量，图形提交在顶点输入阶段等待它。
+    //传输队列上的复制不会等待图形队列，目标缓冲不能正被其它帧读取：例如每套帧资源各用一个动态缓冲，或者只在第一次使用前上传
+    void RecordTransfer(VkCommandBuffer transferCommands , uint32_t transferFamily , uint32_t graphicsFamily);
+
+    //每帧在图形命令缓冲的渲染流程之外调用一次：
+    //获取RecordTransfer释放的缓冲，并录制剩余的复制，用屏障保证之后的顶点输入能看到新数据
+    void Record(VkCommandBuffer commandBuffer);
+
+    uint64_t UploadedBytes() const { return m_UploadedBytes; }
+    uint64_t UploadCount() const { return m_UploadCount; }
+    uint64_t RejectedCount() const { return m_RejectedCount; }
+
+private:
+    struct PendingCopy
+    {
+        VkBuffer     dst;
+        VkBufferCopy region;
+    };
+
+    struct PendingImageCopy
+    {
+        VkImage           dst;
+        VkBufferImageCopy region;
+        bool              firstChunk;
+        bool              lastChunk;
+    };
+
+    //所有权转移的一个缓冲区间
+    struct Transfer
+    {
+        VkBuffer     buffer;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    //所有权转移的一个图像级别
+    struct ImageTransfer
+    {
+        VkImage                 image;
+        VkImageSubresourceRange range;
+    };
+
+    void FlushWrites();
+    //把m_Pending录制成复制命令，每次vkCmdCopyBuffer调用onCopy(dst, regions)
+    template <typename F>
+    void RecordCopies(VkCommandBuffer commandBuffer , F&& onCopy);
+    //把m_PendingImages录制成复制命令，前后加上布局转换。releaseToFamily不为VK_QUEUE_FAMILY_IGNORED时，
+    //上传完的级别在转换布局的同时释放给这个队列族
+    void RecordImageCopies(VkCommandBuffer commandBuffer , uint32_t releaseToFamily);
+
+    VkDevice               m_Device    = VK_NULL_HANDLE;
+    DeviceMemoryAllocator* m_Allocator = nullptr;
+    VkBuffer               m_Buffer    = VK_NULL_HANDLE;
+    LinearMemoryPool       m_Pool;
+    bool                   m_Coherent  = true;
+    VkDeviceSize           m_Alignment = 4;
+
+    //每套帧资源最后一次录制时的头部位置
+    std::vector<std::optional<uint64_t>> m_FrameMarkers;
+    uint32_t                             m_CurrentFrame = 0;
+    //本帧第一笔上传开始的位置，用于刷新非一致性内存
+    uint64_t m_FrameStart = 0;
+
+    //本帧登记的复制，容量在帧之间保留，稳定运行后不再分配
+    std::vector<PendingCopy>  m_Pending;
+    std::vector<VkBufferCopy> m_Regions;
+    //本帧登记的图像复制和录制时用到的屏障
+    std::vector<PendingImageCopy>     m_PendingImages;
+    std::vector<VkBufferImageCopy>    m_ImageRegions;
+    std::vector<VkImageMemoryBarrier> m_ImageBarriers;
+    //RecordTransfer释放、等待Record获取的缓冲区间和图像级别
+    std::vector<Transfer>      m_Transfers;
+    std::vector<ImageTransfer> m_ImageTransfers;
+    uint32_t              m_TransferFamily = 0;
+    uint32_t              m_GraphicsFamily = 0;
+
+    uint64_t m_UploadedBytes = 0;
+    uint64_t m_UploadCount   = 0;
+    uint64_t m_RejectedCount = 0;
+};
@@ -0,0 +1,282 @@
+﻿#include "TextureFile.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    template <typename T>
+    T Read(const std::byte* data , size_t offset)
+    {
+        T value;
+        std::memcpy(&value, data + offset, sizeof(T));
+        return value;
+    }
+
+    constexpr uint32_t FourCC(char a , char b , char c , char d)
+    {
+        return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 | static_cast<uint32_t>(c) << 16 |
+               static_cast<uint32_t>(d) << 24;
+    }
+
+    //DDS文件头：4字节的"DDS "，124字节的DDS_HEADER，像素格式是其中偏移76处的32字节；
+    //像素格式的FourCC为"DX10"时后面还有20字节的DDS_HEADER_DXT10
+    constexpr size_t   DdsHeaderBytes     = 128;
+    constexpr size_t   DdsDx10HeaderBytes = 20;
+    constexpr uint32_t DdsCaps2Cubemap    = 0x200;
+    constexpr uint32_t DdsCaps2Volume     = 0x200000;
+    constexpr uint32_t DxgiDimension2D    = 3;
+    constexpr uint32_t DxgiMiscCubemap    = 0x4;
+
+    //DXGI_FORMAT中的BC格式
+    VkFormat FromDxgiFormat(uint32_t format)
+    {
+        switch (format)
+        {
+        case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+        case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+        case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+        case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+        case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+        case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+        case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+        case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+        case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+        case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+        case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+        case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+        default: return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    //旧式DDS用FourCC表示压缩格式
+    VkFormat FromFourCC(uint32_t fourCC)
+    {
+        switch (fourCC)
+        {
+        case FourCC('D', 'X', 'T', '1'): return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case FourCC('D', 'X', 'T', '2'):
+        case FourCC('D', 'X', 'T', '3'): return VK_FORMAT_BC2_UNORM_BLOCK;
+        case FourCC('D', 'X', 'T', '4'):
+        case FourCC('D', 'X', 'T', '5'): return VK_FORMAT_BC3_UNORM_BLOCK;
+        case FourCC('A', 'T', 'I', '1'):
+        case FourCC('B', 'C', '4', 'U'): return VK_FORMAT_BC4_UNORM_BLOCK;
+        case FourCC('B', 'C', '4', 'S'): return VK_FORMAT_BC4_SNORM_BLOCK;
+        case FourCC('A', 'T', 'I', '2'):
+        case FourCC('B', 'C', '5', 'U'): return VK_FORMAT_BC5_UNORM_BLOCK;
+        case FourCC('B', 'C', '5', 'S'): return VK_FORMAT_BC5_SNORM_BLOCK;
+        default: return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    //KTX2文件头：12字节的标识，9个uint32_t的描述，4个数据块的位置(共32字节)，之后是每级24字节的级别表
+    constexpr uint8_t Ktx2Identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+    constexpr size_t  Ktx2LevelIndexOffset = 80;
+    constexpr size_t  Ktx2LevelEntryBytes  = 24;
+}
+
+TextureFile::TextureFile(const std::string& path)
+    : m_Path(path), m_File(path)
+{
+    if (m_File.Size() >= 12 && std::memcmp(m_File.Data(), Ktx2Identifier, sizeof(Ktx2Identifier)) == 0)
+    {
+        ParseKtx2();
+    }
+    else if (m_File.Size() >= 4 && Read<uint32_t>(m_File.Data(), 0) == FourCC('D', 'D', 'S', ' '))
+    {
+        ParseDds();
+    }
+    else
+    {
+        throw std::runtime_error("不是KTX2或DDS文件: " + path);
+    }
+    ValidateLevels();
+}
+
+void TextureFile::ParseDds()
+{
+    m_Container = "dds";
+    if (m_File.Size() < DdsHeaderBytes || Read<uint32_t>(m_File.Data(), 4) != 124)
+    {
+        throw std::runtime_error("DDS文件头损坏: " + m_Path);
+    }
+
+    const std::byte* data   = m_File.Data();
+    uint32_t         height = Read<uint32_t>(data, 12);
+    uint32_t         width  = Read<uint32_t>(data, 16);
+    uint32_t         levels = Read<uint32_t>(data, 28);
+    uint32_t         fourCC = Read<uint32_t>(data, 84);
+    uint32_t         caps2  = Read<uint32_t>(data, 112);
+    if (caps2 & ( DdsCaps2Cubemap | DdsCaps2Volume ))
+    {
+        throw std::runtime_error("只支持二维DDS纹理: " + m_Path);
+    }
+
+    size_t dataOffset = DdsHeaderBytes;
+    if (fourCC == FourCC('D', 'X', '1', '0'))
+    {
+        if (m_File.Size() < DdsHeaderBytes + DdsDx10HeaderBytes)
+        {
+            throw std::runtime_error("DDS文件头损坏: " + m_Path);
+        }
+        m_Format = FromDxgiFormat(Read<uint32_t>(data, 128));
+        if (Read<uint32_t>(data, 132) != DxgiDimension2D || ( Read<uint32_t>(data, 136) & DxgiMiscCubemap ) ||
+            Read<uint32_t>(data, 140) > 1)
+        {
+            throw std::runtime_error("只支持单层的二维DDS纹理: " + m_Path);
+        }
+        dataOffset += DdsDx10HeaderBytes;
+    }
+    else
+    {
+        m_Format = FromFourCC(fourCC);
+    }
+    if (m_Format == VK_FORMAT_UNDEFINED)
+    {
+        throw std::runtime_error("DDS纹理不是BC压缩格式: " + m_Path);
+    }
+
+    //DDS的各级紧接着依次存放，从级别0开始
+    m_BlockBytes = FormatBlockBytes(m_Format);
+    m_LevelCount = std::max(levels, 1u);
+    if (m_LevelCount > MaxLevels || width == 0 || height == 0)
+    {
+        throw std::runtime_error("DDS纹理的尺寸或级别数无效: " + m_Path);
+    }
+    uint64_t offset = dataOffset;
+    for (uint32_t level = 0; level < m_LevelCount; level++)
+    {
+        TextureLevel& info = m_Levels[level];
+        info.width         = std::max(width >> level, 1u);
+        info.height        = std::max(height >> level, 1u);
+        info.offset        = offset;
+        info.size          = LevelBytes(info.width, info.height, m_BlockBytes);
+        offset            += info.size;
+    }
+}
+
+void TextureFile::ParseKtx2()
+{
+    m_Container = "ktx2";
+    if (m_File.Size() < Ktx2LevelIndexOffset)
+    {
+        throw std::runtime_error("KTX2文件头损坏: " + m_Path);
+    }
+
+    const std::byte* data             = m_File.Data();
+    uint32_t         format           = Read<uint32_t>(data, 12);
+    uint32_t         width            = Read<uint32_t>(data, 20);
+    uint32_t         height           = Read<uint32_t>(data, 24);
+    uint32_t         depth            = Read<uint32_t>(data, 28);
+    uint32_t         layers           = Read<uint32_t>(data, 32);
+    uint32_t         faces            = Read<uint32_t>(data, 36);
+    uint32_t         levels           = Read<uint32_t>(data, 40);
+    uint32_t         supercompression = Read<uint32_t>(data, 44);
+    if (depth != 0 || layers > 1 || faces != 1)
+    {
+        throw std::runtime_error("只支持单层的二维KTX2纹理: " + m_Path);
+    }
+    if (supercompression != 0)
+    {
+        throw std::runtime_error("不支持超压缩的KTX2纹理: " + m_Path);
+    }
+
+    m_Format     = static_cast<VkFormat>(format);
+    m_BlockBytes = FormatBlockBytes(m_Format);
+    if (m_BlockBytes == 0)
+    {
+        throw std::runtime_error("KTX2纹理不是BC压缩格式: " + m_Path);
+    }
+
+    //levelCount为0表示要求加载方自己生成mip，这里只使用级别0
+    m_LevelCount = std::max(levels, 1u);
+    if (m_LevelCount > MaxLevels || width == 0 || height == 0 ||
+        m_File.Size() < Ktx2LevelIndexOffset + m_LevelCount * Ktx2LevelEntryBytes)
+    {
+        throw std::runtime_error("KTX2纹理的尺寸或级别表无效: " + m_Path);
+    }
+    for (uint32_t level = 0; level < m_LevelCount; level++)
+    {
+        size_t        entry = Ktx2LevelIndexOffset + level * Ktx2LevelEntryBytes;
+        TextureLevel& info  = m_Levels[level];
+        info.width          = std::max(width >> level, 1u);
+        info.height         = std::max(height >> level, 1u);
+        info.offset         = Read<uint64_t>(data, entry);
+        info.size           = Read<uint64_t>(data, entry + 8);
+    }
+}
+
+void TextureFile::ValidateLevels()
+{
+    if (Width() > MaxDimension || Height() > MaxDimension)
+    {
+        throw std::runtime_error("纹理尺寸过大: " + m_Path);
+    }
+    //完整的mip链有floor(log2(max(w, h))) + 1级，声称更多级别的文件会让vkCreateImage的参数无效
+    if (m_LevelCount > static_cast<uint32_t>(std::bit_width(std::max(Width(), Height()))))
+    {
+        throw std::runtime_error("纹理的级别数超过完整的mip链: " + m_Path);
+    }
+    for (uint32_t level = 0; level < m_LevelCount; level++)
+    {
+        const TextureLevel& info = m_Levels[level];
+        if (info.size != LevelBytes(info.width, info.height, m_BlockBytes) || info.offset > m_File.Size() ||
+            info.size > m_File.Size() - info.offset)
+        {
+            throw std::runtime_error("纹理第" + std::to_string(level) + "级的数据不完整: " + m_Path);
+        }
+    }
+}
+
+std::span<const std::byte> TextureFile::LevelData(uint32_t level) const
+{
+    const TextureLevel& info = m_Levels[level];
+    return {m_File.Data() + info.offset, static_cast<size_t>(info.size)};
+}
+
+uint64_t TextureFile::ChainBytes(uint32_t firstLevel) const
+{
+    uint64_t bytes = 0;
+    for (uint32_t level = firstLevel; level < m_LevelCount; level++)
+    {
+        bytes += m_Levels[level].size;
+    }
+    return bytes;
+}
+
+uint32_t TextureFile::FormatBlockBytes(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+        return 8;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+uint64_t TextureFile::LevelBytes(uint32_t width , uint32_t height , uint32_t blockBytes)
+{
+    //全部按64位计算，文件头中很大的尺寸不会在加3或相乘时回绕
+    return ( uint64_t(width) + 3 ) / 4 * ( ( uint64_t(height) + 3 ) / 4 ) * blockBytes;
+}
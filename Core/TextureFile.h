@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vulkan/vulkan.h>
+
+#include "../Tool/MappedFile.h"
+
+//一个mip级别在文件中的位置和尺寸，级别0是最大的一级
+struct TextureLevel
+{
+    uint64_t offset = 0;
+    uint64_t size   = 0;
+    uint32_t width  = 0;
+    uint32_t height = 0;
+};
+
+/*
+ * BC压缩纹理文件(KTX2或DDS)，只支持单层的二维纹理，不支持超压缩(Basis、Zstd)。
+ * 文件以只读方式映射，构造时只解析文件头和级别表，像素数据在第一次读取时才由操作系统调入，
+ * 所以读取级别数据应当放在I/O线程上。格式不受支持或文件损坏时构造函数抛出std::runtime_error
+ */
+class TextureFile
+{
+public:
+    static constexpr uint32_t MaxLevels = 16;
+    //现有设备的maxImageDimension2D都不超过它，限制在这里也保证各级的字节数在64位内不会溢出
+    static constexpr uint32_t MaxDimension = 1u << 16;
+
+    explicit TextureFile(const std::string& path);
+
+    const std::string&  Path() const { return m_Path; }
+    const char*         Container() const { return m_Container; }
+    VkFormat            Format() const { return m_Format; }
+    uint32_t            BlockBytes() const { return m_BlockBytes; }
+    uint32_t            Width() const { return m_Levels[0].width; }
+    uint32_t            Height() const { return m_Levels[0].height; }
+    uint32_t            LevelCount() const { return m_LevelCount; }
+    const TextureLevel& Level(uint32_t level) const { return m_Levels[level]; }
+    std::span<const std::byte> LevelData(uint32_t level) const;
+    //从firstLevel到最小一级的字节数之和
+    uint64_t ChainBytes(uint32_t firstLevel) const;
+
+    //BC格式每个4x4块的字节数，不是BC格式时返回0
+    static uint32_t FormatBlockBytes(VkFormat format);
+    //width x height的一级按4x4块压缩后的字节数
+    static uint64_t LevelBytes(uint32_t width , uint32_t height , uint32_t blockBytes);
+
+private:
+    void ParseDds();
+    void ParseKtx2();
+    //按级别0的尺寸推算各级的尺寸，检查级别数据是否都在文件范围内
+    void ValidateLevels();
+
+    std::string  m_Path;
+    MappedFile   m_File;
+    const char*  m_Container  = "";
+    VkFormat     m_Format     = VK_FORMAT_UNDEFINED;
+    uint32_t     m_BlockBytes = 0;
+    uint32_t     m_LevelCount = 0;
+    TextureLevel m_Levels[MaxLevels];
+};
@@ -0,0 +1,565 @@
+﻿#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    constexpr uint32_t TailRead = UINT32_MAX;
+    //每个I/O线程最多排队的升级读取，读出的数据在上传完之前都占着内存
+    constexpr uint32_t ReadsPerThread = 4;
+
+    //宽和高都不超过tailSize的第一级；没有这样的级别时只把最小的一级当作尾部
+    uint32_t FindTail(const TextureFile& file , uint32_t tailSize)
+    {
+        for (uint32_t level = 0; level < file.LevelCount(); level++)
+        {
+            const TextureLevel& info = file.Level(level);
+            if (info.width <= tailSize && info.height <= tailSize) return level;
+        }
+        return file.LevelCount() - 1;
+    }
+
+    uint32_t MaxDimension(const TextureFile& file , uint32_t level)
+    {
+        return std::max(file.Level(level).width, file.Level(level).height);
+    }
+}
+
+void TextureStreamer::Create(VkPhysicalDevice       physicalDevice , VkDevice device , DeviceMemoryAllocator& allocator ,
+                             StagingRing&           stagingRing , uint32_t uploadFamily , DescriptorHeap* heap ,
+                             const TextureStreamerConfig& config)
+{
+    m_PhysicalDevice = physicalDevice;
+    m_Device         = device;
+    m_Allocator      = &allocator;
+    m_StagingRing    = &stagingRing;
+    m_Heap           = heap;
+    m_Config         = config;
+    //一块必须能放进暂存环形缓冲，还要给顶点和实例数据的上传留出空间
+    m_Config.uploadBudget = std::clamp<VkDeviceSize>(m_Config.uploadBudget, 64 << 10, stagingRing.Capacity() / 2);
+    m_Config.tailSize     = std::max(m_Config.tailSize, 4u);
+    m_Io                  = std::make_unique<ThreadPool>(std::max(m_Config.ioThreads, 1u));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    m_MaxImageDimension = properties.limits.maxImageDimension2D;
+
+    //压缩格式的传输粒度以块为单位。块从x = 0开始、覆盖整行，宽度总是合法的，只有起始行受高度粒度限制
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    const VkExtent3D& granularity = families.at(uploadFamily).minImageTransferGranularity;
+    m_RowGranularity              = granularity.width == 0 || granularity.height == 0 ? 0 : granularity.height;
+}
+
+void TextureStreamer::Destroy()
+{
+    if (!Enabled()) return;
+
+    //先等I/O线程结束，它们不再往m_Reads里追加结果
+    m_Io.reset();
+    for (Texture& texture : m_Textures)
+    {
+        for (Residency* residency : {&texture.current, &texture.pending})
+        {
+            if (residency->descriptor != DescriptorHeap::InvalidIndex && m_Heap != nullptr)
+            {
+                m_Heap->Release(DescriptorKind::SampledImage, residency->descriptor);
+            }
+            residency->view.Reset();
+            residency->image.Reset();
+            if (residency->memory.memory != VK_NULL_HANDLE)
+            {
+                m_Allocator->Free(residency->memory);
+            }
+        }
+    }
+    m_Textures.clear();
+    m_Reads.clear();
+    m_Processing.clear();
+    m_ReadsInFlight  = 0;
+    m_ReservedBytes  = 0;
+    m_CommittedBytes = 0;
+    m_ResidentBytes  = 0;
+    m_Device         = VK_NULL_HANDLE;
+}
+
+TextureHandle TextureStreamer::Load(const std::string& path)
+{
+    TextureHandle handle = static_cast<TextureHandle>(m_Textures.size());
+    m_Textures.emplace_back().path = path;
+    //打开文件和读mip尾部排在升级读取之前，新纹理尽快有东西可画
+    SubmitRead(handle, TailRead, 2);
+    return handle;
+}
+
+void TextureStreamer::ReportScreenSize(TextureHandle texture , float pixels)
+{
+    Texture& entry   = m_Textures[texture];
+    entry.screenSize = std::max(entry.screenSize, pixels);
+}
+
+uint32_t TextureStreamer::ResidentLevel(TextureHandle texture) const
+{
+    const Texture& entry = m_Textures[texture];
+    if (entry.current.image != VK_NULL_HANDLE) return entry.current.top;
+    return entry.file ? entry.file->LevelCount() : 0;
+}
+
+void TextureStreamer::Update(DeletionQueue& deletionQueue , uint64_t serial)
+{
+    if (!Enabled()) return;
+
+    ProcessReads();
+    ChooseTargets();
+    StartBuilds();
+    UploadChunks(deletionQueue, serial);
+    UpdateCounts();
+}
+
+void TextureStreamer::SubmitRead(TextureHandle texture , uint32_t top , int priority)
+{
+    Texture& entry = m_Textures[texture];
+    entry.reading  = true;
+    m_ReadsInFlight++;
+
+    //任务只按值捕获路径和共享的文件，m_Textures在读取期间扩容也没有关系
+    std::shared_ptr<const TextureFile> file     = entry.file;
+    std::string                        path     = entry.path;
+    uint32_t                           tailSize = m_Config.tailSize;
+    m_Io->Submit(priority, [this, texture, top, file, path, tailSize]()
+    {
+        ReadResult result;
+        result.texture = texture;
+        try
+        {
+            std::shared_ptr<const TextureFile> source = file;
+            if (!source)
+            {
+                source      = std::make_shared<const TextureFile>(path);
+                result.file = source;
+            }
+            result.top = top == TailRead ? FindTail(*source, tailSize) : top;
+
+            //在这里逐级拷贝，映射文件的缺页都发生在I/O线程上，主线程上传时只读内存
+            result.data.resize(static_cast<size_t>(source->ChainBytes(result.top)));
+            size_t offset = 0;
+            for (uint32_t level = result.top; level < source->LevelCount(); level++)
+            {
+                std::span<const std::byte> bytes = source->LevelData(level);
+                std::memcpy(result.data.data() + offset, bytes.data(), bytes.size());
+                offset += bytes.size();
+            }
+        }
+        catch (const std::exception& e)
+        {
+            result.error = e.what();
+            result.data.clear();
+        }
+
+        std::lock_guard lock(m_ReadMutex);
+        m_Reads.push_back(std::move(result));
+    });
+}
+
+void TextureStreamer::ProcessReads()
+{
+    {
+        std::lock_guard lock(m_ReadMutex);
+        std::swap(m_Reads, m_Processing);
+    }
+
+    for (ReadResult& result : m_Processing)
+    {
+        Texture& texture  = m_Textures[result.texture];
+        texture.reading   = false;
+        m_ReservedBytes  -= texture.reserved;
+        texture.reserved  = 0;
+        m_ReadsInFlight--;
+
+        if (result.error.empty() && result.file)
+        {
+            //压缩格式要由设备支持，否则(例如没有启用textureCompressionBC)不能创建图像
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(m_PhysicalDevice, result.file->Format(), &properties);
+            if (( properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT ) == 0)
+            {
+                result.error = "设备不支持纹理的压缩格式: " + result.file->Path();
+            }
+            else if (std::max(result.file->Width(), result.file->Height()) > m_MaxImageDimension)
+            {
+                result.error = "纹理尺寸超过设备的maxImageDimension2D: " + result.file->Path();
+            }
+        }
+        if (!result.error.empty())
+        {
+            texture.failed = true;
+            std::cerr << "texture streaming: " << result.error << '\n';
+            continue;
+        }
+
+        if (result.file)
+        {
+            texture.file   = std::move(result.file);
+            texture.tail   = result.top;
+            texture.target = result.top;
+        }
+        texture.pending.top = result.top;
+        texture.data        = std::move(result.data);
+        try
+        {
+            BeginBuild(texture);
+        }
+        catch (const std::exception& e)
+        {
+            //创建图像或分配内存失败只影响这一张纹理，不让一个异常的资源中断整个程序
+            DiscardPending(texture);
+            texture.failed = true;
+            std::cerr << "texture streaming: " << e.what() << '\n';
+        }
+    }
+    m_Processing.clear();
+}
+
+void TextureStreamer::ChooseTargets()
+{
+    m_Frame++;
+
+    //先按屏幕尺寸选目标：最小的、边长不小于屏幕尺寸的级别，纹素和像素大致一一对应
+    VkDeviceSize planned = 0;
+    for (Texture& texture : m_Textures)
+    {
+        if (texture.screenSize > 0.0f)
+        {
+            texture.lastSize      = texture.screenSize;
+            texture.lastUsedFrame = m_Frame;
+        }
+        texture.screenSize = 0.0f;
+        if (!texture.file || texture.failed) continue;
+
+        texture.target = texture.tail;
+        bool idle      = texture.lastUsedFrame == 0 || m_Frame - texture.lastUsedFrame > m_Config.idleFrames;
+        if (!idle)
+        {
+            while (texture.target > 0 && MaxDimension(*texture.file, texture.target) < texture.lastSize)
+            {
+                texture.target--;
+            }
+            //只差一级的降级先不做，避免屏幕尺寸在两级之间来回时反复重建；超出预算时下面仍会降级
+            if (texture.current.image != VK_NULL_HANDLE && texture.target == texture.current.top + 1)
+            {
+                texture.target = texture.current.top;
+            }
+        }
+        planned += texture.file->ChainBytes(texture.target);
+    }
+
+    //超出预算时反复把纹素密度最高的纹理降一级，降一级内存约减为四分之一，密度减半。mip尾部不再降级
+    if (planned <= m_Config.memoryBudget) return;
+
+    std::priority_queue<std::pair<float, TextureHandle>> candidates;
+    for (TextureHandle handle = 0; handle < m_Textures.size(); handle++)
+    {
+        const Texture& texture = m_Textures[handle];
+        if (texture.file && !texture.failed && texture.target < texture.tail)
+        {
+            float density = MaxDimension(*texture.file, texture.target) / std::max(texture.lastSize, 1.0f);
+            candidates.push({density, handle});
+        }
+    }
+    while (planned > m_Config.memoryBudget && !candidates.empty())
+    {
+        auto [density, handle] = candidates.top();
+        candidates.pop();
+        Texture& texture  = m_Textures[handle];
+        planned          -= texture.file->ChainBytes(texture.target) - texture.file->ChainBytes(texture.target + 1);
+        texture.target++;
+        if (texture.target < texture.tail)
+        {
+            candidates.push({density * 0.5f, handle});
+        }
+    }
+}
+
+void TextureStreamer::StartBuilds()
+{
+    //屏幕上最大的纹理先升级
+    m_Order.clear();
+    for (TextureHandle handle = 0; handle < m_Textures.size(); handle++)
+    {
+        const Texture& texture = m_Textures[handle];
+        if (texture.failed || texture.reading || texture.pending.image != VK_NULL_HANDLE) continue;
+        if (texture.current.image == VK_NULL_HANDLE || texture.target == texture.current.top) continue;
+        m_Order.push_back(handle);
+    }
+    std::sort(m_Order.begin(), m_Order.end(), [this](TextureHandle a , TextureHandle b)
+    {
+        return m_Textures[a].lastSize > m_Textures[b].lastSize;
+    });
+
+    uint32_t maxReads = m_Io->ThreadCount() * ReadsPerThread;
+    for (TextureHandle handle : m_Order)
+    {
+        Texture& texture = m_Textures[handle];
+        if (texture.target > texture.current.top)
+        {
+            //降级总是允许，它释放内存
+            SubmitRead(handle, texture.target, 2);
+            continue;
+        }
+
+        //升级：不计这张纹理正在替换的旧图像，否则预算接近用满时最后几张纹理永远升不上去。
+        //新旧图像短暂共存，超出的部分不超过旧图像的大小
+        VkDeviceSize bytes     = texture.file->ChainBytes(texture.target);
+        VkDeviceSize committed = m_CommittedBytes - texture.current.bytes + m_ReservedBytes;
+        if (m_ReadsInFlight >= maxReads || committed + bytes > m_Config.memoryBudget) continue;
+        texture.reserved  = bytes;
+        m_ReservedBytes  += bytes;
+        SubmitRead(handle, texture.target, 1);
+    }
+}
+
+void TextureStreamer::UploadChunks(DeletionQueue& deletionQueue , uint64_t serial)
+{
+    //还没有任何驻留级别的纹理先传，其余按屏幕尺寸从大到小
+    m_Order.clear();
+    for (TextureHandle handle = 0; handle < m_Textures.size(); handle++)
+    {
+        if (m_Textures[handle].pending.image != VK_NULL_HANDLE) m_Order.push_back(handle);
+    }
+    std::sort(m_Order.begin(), m_Order.end(), [this](TextureHandle a , TextureHandle b)
+    {
+        const Texture& left  = m_Textures[a];
+        const Texture& right = m_Textures[b];
+        bool           leftEmpty  = left.current.image == VK_NULL_HANDLE;
+        bool           rightEmpty = right.current.image == VK_NULL_HANDLE;
+        if (leftEmpty != rightEmpty) return leftEmpty;
+        return left.lastSize > right.lastSize;
+    });
+
+    m_FrameUploadBytes = 0;
+    for (TextureHandle handle : m_Order)
+    {
+        Texture& texture = m_Textures[handle];
+        while (texture.nextChunk < texture.chunks.size())
+        {
+            const Chunk& chunk = texture.chunks[texture.nextChunk];
+            //每块都不超过预算，这一帧的第一块总能放下，保证有进展
+            if (m_FrameUploadBytes > 0 && m_FrameUploadBytes + chunk.size > m_Config.uploadBudget) break;
+
+            VkBufferImageCopy region               = {};
+            region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel       = chunk.mipLevel;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount     = 1;
+            region.imageOffset                     = {0, static_cast<int32_t>(chunk.y), 0};
+            region.imageExtent                     = {chunk.width, chunk.height, 1};
+            if (!m_StagingRing->UploadImage(texture.pending.image, region, texture.data.data() + chunk.offset, chunk.size,
+                                            chunk.firstChunk, chunk.lastChunk))
+            {
+                break;
+            }
+            m_FrameUploadBytes += chunk.size;
+            m_UploadedBytes    += chunk.size;
+            texture.nextChunk++;
+        }
+
+        //复制和布局转换录制在这一帧的绘制之前，同一帧就可以换用新图像
+        if (texture.nextChunk == texture.chunks.size())
+        {
+            Activate(texture, deletionQueue, serial);
+        }
+        if (m_FrameUploadBytes >= m_Config.uploadBudget) break;
+    }
+    m_PeakFrameUploadBytes = std::max(m_PeakFrameUploadBytes, m_FrameUploadBytes);
+}
+
+void TextureStreamer::BeginBuild(Texture& texture)
+{
+    const TextureFile& file   = *texture.file;
+    uint32_t           top    = texture.pending.top;
+    uint32_t           levels = file.LevelCount() - top;
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType         = VK_IMAGE_TYPE_2D;
+    imageInfo.format            = file.Format();
+    imageInfo.extent            = {file.Level(top).width, file.Level(top).height, 1};
+    imageInfo.mipLevels         = levels;
+    imageInfo.arrayLayers       = 1;
+    imageInfo.samples           = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling            = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage             = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (texture.pending.image.Create(m_Device, vkCreateImage, imageInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建流送纹理的图像失败: " + file.Path());
+    }
+
+    AllocationCreateInfo allocationInfo = {};
+    allocationInfo.requiredFlags        = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    allocationInfo.kind                 = ResourceKind::Optimal;
+
+    texture.pending.memory  = m_Allocator->AllocateForImage(texture.pending.image, allocationInfo);
+    texture.pending.bytes   = file.ChainBytes(top);
+    m_CommittedBytes       += texture.pending.bytes;
+    m_ResidentBytes        += texture.pending.memory.size;
+    m_PeakResidentBytes     = std::max(m_PeakResidentBytes, m_ResidentBytes);
+
+    VkImageViewCreateInfo viewInfo       = {};
+    viewInfo.sType                       = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image                       = texture.pending.image;
+    viewInfo.viewType                    = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format                      = file.Format();
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = levels;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (texture.pending.view.Create(m_Device, vkCreateImageView, viewInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("创建流送纹理的图像视图失败: " + file.Path());
+    }
+
+    //从最小的一级开始切块，超过上传预算的级别按块行切开。块的起始行必须是传输粒度的整数倍，
+    //粒度为0时只能整级复制
+    texture.chunks.clear();
+    texture.nextChunk = 0;
+    for (uint32_t level = file.LevelCount(); level-- > top;)
+    {
+        //读出的数据从top开始依次存放各级
+        const TextureLevel& info         = file.Level(level);
+        VkDeviceSize        levelOffset  = file.ChainBytes(top) - file.ChainBytes(level);
+        VkDeviceSize        rowBytes     = VkDeviceSize(( info.width + 3 ) / 4) * file.BlockBytes();
+        uint32_t            blockRows    = ( info.height + 3 ) / 4;
+        uint32_t            rowsPerChunk = blockRows;
+        if (m_RowGranularity != 0)
+        {
+            VkDeviceSize rows = std::max<VkDeviceSize>(m_Config.uploadBudget / rowBytes, 1);
+            rowsPerChunk      = static_cast<uint32_t>(std::min<VkDeviceSize>(rows, blockRows));
+            rowsPerChunk      = std::max(rowsPerChunk / m_RowGranularity, 1u) * m_RowGranularity;
+        }
+        //每块都要能放进暂存环形缓冲，否则这一级永远传不上去
+        if (std::min(rowsPerChunk, blockRows) * rowBytes > m_StagingRing->Capacity() / 2)
+        {
+            throw std::runtime_error("纹理的一级超过暂存环形缓冲，无法按传输粒度切块: " + file.Path());
+        }
+        for (uint32_t row = 0; row < blockRows; row += rowsPerChunk)
+        {
+            uint32_t rows = std::min(rowsPerChunk, blockRows - row);
+            Chunk    chunk;
+            chunk.mipLevel   = level - top;
+            chunk.y          = row * 4;
+            chunk.width      = info.width;
+            chunk.height     = std::min(rows * 4, info.height - row * 4);
+            chunk.offset     = levelOffset + row * rowBytes;
+            chunk.size       = rows * rowBytes;
+            chunk.firstChunk = row == 0;
+            chunk.lastChunk  = row + rows == blockRows;
+            texture.chunks.push_back(chunk);
+        }
+    }
+}
+
+void TextureStreamer::DiscardPending(Texture& texture)
+{
+    //pending还没有被任何命令引用，可以立即销毁
+    Residency& pending  = texture.pending;
+    m_CommittedBytes   -= pending.bytes;
+    m_ResidentBytes    -= pending.memory.size;
+    pending.view.Reset();
+    pending.image.Reset();
+    if (pending.memory.memory != VK_NULL_HANDLE)
+    {
+        m_Allocator->Free(pending.memory);
+    }
+    pending.memory = {};
+    pending.bytes  = 0;
+
+    texture.data.clear();
+    texture.data.shrink_to_fit();
+    texture.chunks.clear();
+    texture.nextChunk = 0;
+}
+
+void TextureStreamer::Activate(Texture& texture , DeletionQueue& deletionQueue , uint64_t serial)
+{
+    Retire(texture.current, deletionQueue, serial);
+
+    texture.current.image  = std::move(texture.pending.image);
+    texture.current.view   = std::move(texture.pending.view);
+    texture.current.memory = std::exchange(texture.pending.memory, Allocation{});
+    texture.current.bytes  = texture.pending.bytes;
+    texture.current.top    = texture.pending.top;
+    if (m_Heap != nullptr && m_Heap->Enabled())
+    {
+        texture.current.descriptor = m_Heap->AddImage(texture.current.view);
+    }
+
+    texture.data.clear();
+    texture.data.shrink_to_fit();
+    texture.chunks.clear();
+    texture.nextChunk = 0;
+}
+
+void TextureStreamer::Retire(Residency& residency , DeletionQueue& deletionQueue , uint64_t serial)
+{
+    if (residency.image == VK_NULL_HANDLE) return;
+
+    //已提交的帧可能还在采样旧图像，视图、图像、内存和描述符槽位都等这些帧完成后再释放
+    m_CommittedBytes -= residency.bytes;
+    m_ResidentBytes  -= residency.memory.size;
+    deletionQueue.Retire(serial, std::move(residency.view));
+    deletionQueue.Retire(serial, std::move(residency.image));
+    DeviceMemoryAllocator* allocator  = m_Allocator;
+    DescriptorHeap*        heap       = m_Heap;
+    uint32_t               descriptor = residency.descriptor;
+    deletionQueue.Push(serial, [allocator, heap, descriptor, memory = residency.memory]() mutable
+    {
+        if (descriptor != DescriptorHeap::InvalidIndex) heap->Release(DescriptorKind::SampledImage, descriptor);
+        allocator->Free(memory);
+    });
+    residency.memory     = {};
+    residency.bytes      = 0;
+    residency.descriptor = DescriptorHeap::InvalidIndex;
+}
+
+void TextureStreamer::UpdateCounts()
+{
+    m_ResidentCount = 0;
+    m_SettledCount  = 0;
+    m_BusyCount     = 0;
+    m_FailedCount   = 0;
+    for (const Texture& texture : m_Textures)
+    {
+        if (texture.failed)
+        {
+            m_FailedCount++;
+            continue;
+        }
+        bool resident = texture.current.image != VK_NULL_HANDLE;
+        bool busy     = texture.reading || texture.pending.image != VK_NULL_HANDLE;
+        m_ResidentCount += resident ? 1 : 0;
+        m_BusyCount     += busy ? 1 : 0;
+        m_SettledCount  += resident && !busy && texture.current.top == texture.target ? 1 : 0;
+    }
+}
+
+std::string TextureStreamer::Report() const
+{
+    std::ostringstream report;
+    report << "texture streaming: " << TextureCount() << " textures (" << m_FailedCount << " failed), "
+            << m_ResidentCount << " resident, " << m_SettledCount << " at target, "
+            << ( m_ResidentBytes >> 20 ) << " MB resident (peak " << ( m_PeakResidentBytes >> 20 ) << " MB, budget "
+            << ( m_Config.memoryBudget >> 20 ) << " MB), " << ( m_UploadedBytes >> 20 ) << " MB uploaded, peak "
+            << ( m_PeakFrameUploadBytes >> 10 ) << " KB per frame (budget " << ( m_Config.uploadBudget >> 10 )
+            << " KB)\n";
+    return report.str();
+}
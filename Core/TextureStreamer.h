@@ -0,0 +1,196 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "DeletionQueue.h"
+#include "DescriptorHeap.h"
+#include "DeviceMemoryAllocator.h"
+#include "StagingRing.h"
+#include "TextureFile.h"
+#include "VulkanHandle.h"
+#include "../Tool/ThreadPool.h"
+
+using TextureHandle = uint32_t;
+
+struct TextureStreamerConfig
+{
+    uint32_t     ioThreads    = 2;
+    VkDeviceSize uploadBudget = 4ull << 20;   //每帧最多交给暂存环形缓冲的字节数
+    VkDeviceSize memoryBudget = 256ull << 20; //全部纹理占用的设备内存上限，只有mip尾部时可能超出
+    //宽和高都不超过这个尺寸的级别组成mip尾部，加载时最先上传，之后一直驻留
+    uint32_t tailSize = 128;
+    //连续这么多帧没有报告屏幕尺寸的纹理退回mip尾部
+    uint32_t idleFrames = 120;
+};
+
+/*
+ * 纹理流送：KTX2/DDS的BC压缩纹理在后台I/O线程上读取，先上传最小的几级(mip尾部)，之后按屏幕尺寸逐步加载更大的级别。
+ *
+ * 每张纹理的图像只包含驻留的级别[top, levelCount)。驻留级别改变时创建一张新图像，I/O线程读出这些级别的数据，
+ * 经暂存环形缓冲分几帧上传(每帧不超过uploadBudget字节，大的级别按块行切开)，全部上传完才替换旧图像，
+ * 旧图像和它的描述符交给删除队列，整个过程不等待GPU，也不会读到上传了一半的图像。
+ * 重新上传较小的级别多花不到三分之一的带宽，换来不需要稀疏绑定或图像间复制。
+ *
+ * 驻留级别由屏幕尺寸决定：每帧用ReportScreenSize报告纹理在屏幕上的最大边长(像素)，
+ * 级别的尺寸不超过它时就足够清晰。全部纹理需要的内存超过memoryBudget时，从纹素密度最高(最不缺清晰度)的纹理开始降级。
+ *
+ * 接口都只在主线程调用，文件在I/O线程上打开、解析和读取
+ */
+class TextureStreamer
+{
+public:
+    static constexpr TextureHandle InvalidHandle = UINT32_MAX;
+
+    //uploadFamily是录制暂存复制的队列族(有专用传输队列时是传输队列族)，分块要满足它的minImageTransferGranularity。
+    //heap为空或未启用时不注册描述符，只能通过View取得图像视图
+    void Create(VkPhysicalDevice       physicalDevice , VkDevice device , DeviceMemoryAllocator& allocator ,
+                StagingRing&           stagingRing , uint32_t uploadFamily , DescriptorHeap* heap ,
+                const TextureStreamerConfig& config);
+    //设备空闲后调用，等待I/O线程结束并销毁全部纹理
+    void Destroy();
+    bool Enabled() const { return m_Device != VK_NULL_HANDLE; }
+
+    //立即返回句柄，文件在后台打开。文件无效或格式不受支持时这张纹理一直没有驻留的级别
+    TextureHandle Load(const std::string& path);
+
+    //这一帧纹理在屏幕上的最大边长，同一帧报告多次时取最大值
+    void ReportScreenSize(TextureHandle texture , float pixels);
+
+    //每帧在StagingRing::BeginFrame之后、提交上传和录制命令之前调用一次。
+    //替换下来的图像登记到deletionQueue，serial是已提交的最大帧序号
+    void Update(DeletionQueue& deletionQueue , uint64_t serial);
+
+    uint32_t    TextureCount() const { return static_cast<uint32_t>(m_Textures.size()); }
+    bool        IsResident(TextureHandle texture) const { return m_Textures[texture].current.image != VK_NULL_HANDLE; }
+    VkImageView View(TextureHandle texture) const { return m_Textures[texture].current.view; }
+    //描述符堆中的索引，还没有驻留的级别时是DescriptorHeap::InvalidIndex
+    uint32_t DescriptorIndex(TextureHandle texture) const { return m_Textures[texture].current.descriptor; }
+    //驻留的最大级别，还没有驻留时返回级别数
+    uint32_t ResidentLevel(TextureHandle texture) const;
+
+    //已有mip尾部驻留的纹理数、驻留级别达到目标的纹理数、还在读取或上传的纹理数
+    uint32_t     ResidentCount() const { return m_ResidentCount; }
+    uint32_t     SettledCount() const { return m_SettledCount; }
+    uint32_t     BusyCount() const { return m_BusyCount; }
+    uint32_t     FailedCount() const { return m_FailedCount; }
+    VkDeviceSize ResidentBytes() const { return m_ResidentBytes; }
+    VkDeviceSize PeakResidentBytes() const { return m_PeakResidentBytes; }
+    VkDeviceSize LastFrameUploadBytes() const { return m_FrameUploadBytes; }
+    VkDeviceSize PeakFrameUploadBytes() const { return m_PeakFrameUploadBytes; }
+    uint64_t     UploadedBytes() const { return m_UploadedBytes; }
+    const TextureStreamerConfig& Config() const { return m_Config; }
+    std::string                  Report() const;
+
+private:
+    //一张图像和它包含的级别[top, levelCount)
+    struct Residency
+    {
+        UniqueImage     image;
+        UniqueImageView view;
+        Allocation      memory;
+        VkDeviceSize    bytes      = 0; //这些级别的数据量，预算按它计算，和实际分配的大小相差对齐的部分
+        uint32_t        top        = 0;
+        uint32_t        descriptor = DescriptorHeap::InvalidIndex;
+    };
+
+    //上传的一块：图像第mipLevel级中从第y行开始的height行(行数是4的倍数，最后一块到这一级的底边为止)
+    struct Chunk
+    {
+        uint32_t     mipLevel;
+        uint32_t     y;
+        uint32_t     width;
+        uint32_t     height;
+        VkDeviceSize offset; //在读出的数据中的偏移
+        VkDeviceSize size;
+        bool         firstChunk;
+        bool         lastChunk;
+    };
+
+    struct Texture
+    {
+        std::string                        path;
+        std::shared_ptr<const TextureFile> file;
+        bool                               failed = false;
+        uint32_t                           tail   = 0; //mip尾部的第一级
+
+        Residency current;
+
+        //正在替换的图像：先等I/O线程读出数据，再分块上传
+        Residency              pending;
+        bool                   reading  = false;
+        VkDeviceSize           reserved = 0; //读取期间为新图像预留的内存预算
+        std::vector<std::byte> data;         //级别[pending.top, levelCount)依次存放
+        std::vector<Chunk>     chunks;
+        size_t                 nextChunk = 0;
+
+        float    screenSize    = 0.0f; //这一帧报告的最大值
+        float    lastSize      = 0.0f; //最近一次报告的尺寸
+        uint64_t lastUsedFrame = 0;
+        uint32_t target        = 0;
+    };
+
+    //I/O线程的结果，交回主线程处理
+    struct ReadResult
+    {
+        TextureHandle                      texture;
+        std::shared_ptr<const TextureFile> file; //第一次打开时才有
+        uint32_t                           top = 0;
+        std::vector<std::byte>             data;
+        std::string                        error;
+    };
+
+    //top为UINT32_MAX时读取mip尾部
+    void SubmitRead(TextureHandle texture , uint32_t top , int priority);
+    void ProcessReads();
+    void ChooseTargets();
+    void StartBuilds();
+    void UploadChunks(DeletionQueue& deletionQueue , uint64_t serial);
+    //为pending创建图像并切分上传的块，失败时抛出std::runtime_error
+    void BeginBuild(Texture& texture);
+    //BeginBuild失败时销毁pending已经创建的部分并退回记账
+    void DiscardPending(Texture& texture);
+    //pending上传完，替换current
+    void Activate(Texture& texture , DeletionQueue& deletionQueue , uint64_t serial);
+    void Retire(Residency& residency , DeletionQueue& deletionQueue , uint64_t serial);
+    void UpdateCounts();
+
+    VkPhysicalDevice       m_PhysicalDevice    = VK_NULL_HANDLE;
+    VkDevice               m_Device            = VK_NULL_HANDLE;
+    DeviceMemoryAllocator* m_Allocator         = nullptr;
+    StagingRing*           m_StagingRing       = nullptr;
+    DescriptorHeap*        m_Heap              = nullptr;
+    uint32_t               m_MaxImageDimension = 0; //超过它的纹理在打开时就被跳过
+    uint32_t               m_RowGranularity    = 1; //分块起始块行的粒度，0表示只能整级上传
+    TextureStreamerConfig  m_Config;
+
+    std::vector<Texture>       m_Textures;
+    std::vector<TextureHandle> m_Order; //每帧排序用，跨帧复用
+
+    //I/O线程完成的读取，由m_ReadMutex保护
+    std::mutex              m_ReadMutex;
+    std::vector<ReadResult> m_Reads;
+    std::vector<ReadResult> m_Processing;
+    uint32_t                m_ReadsInFlight = 0;
+
+    uint64_t     m_Frame                = 0;
+    VkDeviceSize m_ReservedBytes        = 0;
+    VkDeviceSize m_CommittedBytes       = 0; //current和pending的bytes之和
+    uint32_t     m_ResidentCount        = 0;
+    uint32_t     m_SettledCount         = 0;
+    uint32_t     m_BusyCount            = 0;
+    uint32_t     m_FailedCount          = 0;
+    VkDeviceSize m_ResidentBytes        = 0; //current和pending两部分图像之和
+    VkDeviceSize m_PeakResidentBytes    = 0;
+    VkDeviceSize m_FrameUploadBytes     = 0;
+    VkDeviceSize m_PeakFrameUploadBytes = 0;
+    uint64_t     m_UploadedBytes        = 0;
+
+    //最后声明，最先销毁：先等I/O线程执行完剩余任务
+    std::unique_ptr<ThreadPool> m_Io;
+};
@@ -0,0 +1,342 @@
+﻿#include "ValidationLogger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "../Tool/Hash.h"
+
+struct ValidationLogger::Message
+{
+    VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+    VkDebugUtilsMessageTypeFlagsEXT        types;
+    uint64_t                               key; //计数表中的键，见MessageKey
+    int32_t                                id;
+    uint32_t                               occurrence;
+    char                                   idName[MaxIdNameLength];
+    char                                   text[MaxMessageLength];
+};
+
+/*
+ * 有界多生产者队列(Dmitry Vyukov的有界MPMC队列)。
+ * 每个槽位带一个序号：序号等于写入位置时槽位空闲，等于写入位置+1时槽位已写好、可以读取。
+ * 生产者用CAS抢占写入位置，抢到后独占这个槽位写入，再用release发布序号；没有锁，也不会互相等待对方写完。
+ */
+struct ValidationLogger::Queue
+{
+    struct Cell
+    {
+        std::atomic<uint64_t> sequence;
+        Message               message;
+    };
+
+    Cell                  cells[QueueCapacity];
+    std::atomic<uint64_t> enqueuePosition = 0;
+    std::atomic<uint64_t> dequeuePosition = 0;
+
+    Queue()
+    {
+        for (uint32_t i = 0; i < QueueCapacity; i++)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    //抢到一个空闲槽位，返回nullptr表示队列已满；写完后必须调用Publish
+    Cell* Reserve(uint64_t& position)
+    {
+        position = enqueuePosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell&    cell     = cells[position % QueueCapacity];
+            uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto     diff     = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+            if (diff == 0)
+            {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    return &cell;
+                }
+            }
+            else if (diff < 0)
+            {
+                return nullptr;
+            }
+            else
+            {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    static void Publish(Cell* cell , uint64_t position)
+    {
+        cell->sequence.store(position + 1, std::memory_order_release);
+    }
+
+    //只有后台线程读取，不需要CAS
+    bool Pop(Message& message)
+    {
+        uint64_t position = dequeuePosition.load(std::memory_order_relaxed);
+        Cell&    cell     = cells[position % QueueCapacity];
+        if (cell.sequence.load(std::memory_order_acquire) != position + 1) return false;
+
+        message = cell.message;
+        dequeuePosition.store(position + 1, std::memory_order_relaxed);
+        cell.sequence.store(position + QueueCapacity, std::memory_order_release);
+        return true;
+    }
+};
+
+//按消息种类计数的开放寻址表项。key为0表示空，否则是MessageKey的结果
+struct ValidationLogger::Counter
+{
+    std::atomic<uint64_t> key      = 0;
+    std::atomic<uint64_t> count    = 0;
+    std::atomic<uint32_t> severity = 0;
+    std::atomic<int32_t>  id       = 0; //汇总时显示，抢占到空位的线程写入
+};
+
+namespace
+{
+    //消息种类的键：messageIdNumber加上pMessageIdName的哈希。很多层把id报告为0，只按id区分时
+    //不相关的消息会共用一个重复次数的上限，先出现的几种把后面的全部挤掉。结果不会是0，0表示空位
+    uint64_t MessageKey(int32_t id , const char* idName)
+    {
+        uint64_t hash = Hash::Fnv1a(&id, sizeof(id));
+        if (idName != nullptr)
+        {
+            hash = Hash::Fnv1a(idName, std::strlen(idName), hash);
+        }
+        return hash != 0 ? hash : 1;
+    }
+
+    const char* SeverityName(VkDebugUtilsMessageSeverityFlagsEXT severity)
+    {
+        if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) return "error";
+        if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) return "warning";
+        if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) return "info";
+        return "verbose";
+    }
+
+    void CopyTruncated(char* dst , size_t capacity , const char* src)
+    {
+        if (src == nullptr)
+        {
+            dst[0] = '\0';
+            return;
+        }
+        size_t length = std::min(std::strlen(src), capacity - 1);
+        std::memcpy(dst, src, length);
+        dst[length] = '\0';
+    }
+}
+
+ValidationLogger::ValidationLogger()
+    : m_Queue(std::make_unique<Queue>()) ,
+      m_Counters(std::make_unique<Counter[]>(MaxMessageIds)) ,
+      m_Severities(ParseSeverity("warning")) ,
+      m_Types(VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+              VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT)
+{
+}
+
+ValidationLogger::~ValidationLogger()
+{
+    Stop();
+}
+
+void ValidationLogger::Start()
+{
+    if (m_Worker.joinable()) return;
+    m_Stopping.store(false);
+    m_Worker = std::thread(&ValidationLogger::WorkerLoop, this);
+}
+
+void ValidationLogger::Stop()
+{
+    if (!m_Worker.joinable()) return;
+    m_Stopping.store(true);
+    m_Worker.join();
+    PrintSummary();
+}
+
+void ValidationLogger::SetFilter(VkDebugUtilsMessageSeverityFlagsEXT severities ,
+                                 VkDebugUtilsMessageTypeFlagsEXT     types)
+{
+    m_Severities.store(severities, std::memory_order_relaxed);
+    m_Types.store(types, std::memory_order_relaxed);
+}
+
+void ValidationLogger::Push(VkDebugUtilsMessageSeverityFlagBitsEXT      severity ,
+                            VkDebugUtilsMessageTypeFlagsEXT             types ,
+                            const VkDebugUtilsMessengerCallbackDataEXT* data)
+{
+    if (( severity & Severities() ) == 0 || ( types & Types() ) == 0) return;
+    m_Received.fetch_add(1, std::memory_order_relaxed);
+
+    //重复的消息只计数：不复制字符串，也不占队列
+    uint64_t key        = MessageKey(data->messageIdNumber, data->pMessageIdName);
+    uint32_t occurrence = CountOccurrence(key, data->messageIdNumber, severity);
+    uint32_t limit      = m_RepeatLimit.load(std::memory_order_relaxed);
+    if (limit != 0 && occurrence > limit)
+    {
+        m_Suppressed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    //队列满时丢弃而不是等待，调用线程是驱动正在执行的Vulkan调用
+    uint64_t     position;
+    Queue::Cell* cell = m_Queue->Reserve(position);
+    if (cell == nullptr)
+    {
+        m_Dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Message& message   = cell->message;
+    message.severity   = severity;
+    message.types      = types;
+    message.key        = key;
+    message.id         = data->messageIdNumber;
+    message.occurrence = occurrence;
+    CopyTruncated(message.idName, sizeof(message.idName), data->pMessageIdName);
+    CopyTruncated(message.text, sizeof(message.text), data->pMessage);
+    Queue::Publish(cell, position);
+}
+
+uint32_t ValidationLogger::CountOccurrence(uint64_t key , int32_t id ,
+                                           VkDebugUtilsMessageSeverityFlagBitsEXT severity)
+{
+    uint32_t index = static_cast<uint32_t>(key ^ key >> 32) % MaxMessageIds;
+    for (uint32_t probe = 0; probe < MaxMessageIds; probe++)
+    {
+        Counter& counter = m_Counters[( index + probe ) % MaxMessageIds];
+
+        uint64_t current = counter.key.load(std::memory_order_acquire);
+        if (current == 0)
+        {
+            //空位：抢占失败说明别的线程刚写入了某个key，重新检查是不是同一个
+            if (counter.key.compare_exchange_strong(current, key, std::memory_order_acq_rel))
+            {
+                counter.id.store(id, std::memory_order_relaxed);
+                current = key;
+            }
+        }
+        if (current == key)
+        {
+            counter.severity.fetch_or(severity, std::memory_order_relaxed);
+            return static_cast<uint32_t>(std::min<uint64_t>(counter.count.fetch_add(1, std::memory_order_relaxed) + 1,
+                                                            UINT32_MAX));
+        }
+    }
+    return 0;
+}
+
+void ValidationLogger::WorkerLoop()
+{
+    //轮询而不是让生产者唤醒：唤醒需要系统调用，会把开销放回调用Vulkan的线程上
+    while (!m_Stopping.load())
+    {
+        Drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    Drain();
+}
+
+void ValidationLogger::Drain()
+{
+    Message message;
+    while (m_Queue->Pop(message))
+    {
+        m_IdNames.try_emplace(message.key, message.idName);
+        std::cerr << "validation " << SeverityName(message.severity) << " [" << message.idName << "]";
+        if (message.occurrence == m_RepeatLimit.load(std::memory_order_relaxed))
+        {
+            std::cerr << " (repeated " << message.occurrence << " times, further occurrences only counted)";
+        }
+        std::cerr << ": " << message.text << '\n';
+    }
+}
+
+void ValidationLogger::PrintSummary()
+{
+    struct Entry
+    {
+        uint64_t key;
+        int32_t  id;
+        uint64_t count;
+        uint32_t severity;
+    };
+    std::vector<Entry> entries;
+    for (uint32_t i = 0; i < MaxMessageIds; i++)
+    {
+        uint64_t key = m_Counters[i].key.load();
+        if (key != 0)
+        {
+            entries.push_back({
+                key, m_Counters[i].id.load(), m_Counters[i].count.load(), m_Counters[i].severity.load()
+            });
+        }
+    }
+    if (entries.empty()) return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a , const Entry& b) { return a.count > b.count; });
+
+    std::cerr << "validation summary: " << m_Received.load() << " messages, " << entries.size() << " distinct, "
+            << m_Suppressed.load() << " suppressed as repeats, " << m_Dropped.load() << " dropped (queue full)\n";
+    char line[64];
+    for (const Entry& entry : entries)
+    {
+        std::snprintf(line, sizeof(line), "%10llu  %-8s  0x%08x  ", static_cast<unsigned long long>(entry.count),
+                      SeverityName(entry.severity), static_cast<uint32_t>(entry.id));
+        auto name = m_IdNames.find(entry.key);
+        std::cerr << line << ( name != m_IdNames.end() ? name->second : "" ) << '\n';
+    }
+}
+
+VkDebugUtilsMessageSeverityFlagsEXT ValidationLogger::ParseSeverity(const std::string& name)
+{
+    VkDebugUtilsMessageSeverityFlagsEXT severities = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    if (name == "error") return severities;
+    severities |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+    if (name == "warning") return severities;
+    severities |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    if (name == "info") return severities;
+    severities |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+    if (name == "verbose") return severities;
+    throw std::runtime_error("未知的校验消息级别: " + name);
+}
+
+VkDebugUtilsMessageTypeFlagsEXT ValidationLogger::ParseTypes(const std::string& names)
+{
+    VkDebugUtilsMessageTypeFlagsEXT types = 0;
+    size_t                          begin = 0;
+    while (begin <= names.size())
+    {
+        size_t      end  = std::min(names.find(',', begin), names.size());
+        std::string name = names.substr(begin, end - begin);
+        if (name == "general")
+        {
+            types |= VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT;
+        }
+        else if (name == "validation")
+        {
+            types |= VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
+        }
+        else if (name == "performance")
+        {
+            types |= VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+        }
+        else
+        {
+            throw std::runtime_error("未知的校验消息类型: " + name);
+        }
+        begin = end + 1;
+    }
+    return types;
+}
@@ -0,0 +1,82 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+
+/*
+ * 校验层消息的异步日志。
+ * 校验层在调用Vulkan函数的线程上同步调用回调，回调里直接写std::cerr会让每个出错的Vulkan调用都卡在控制台输出上。
+ * 这里回调只做几件便宜的事：按级别和类型过滤，按messageIdNumber和pMessageIdName计数，
+ * 同一种消息只有前repeatLimit次复制进无锁队列，之后只增加计数；写控制台由后台线程完成。
+ * 退出时输出每种消息的出现次数。
+ */
+class ValidationLogger
+{
+public:
+    //队列容量和单条消息的最大长度，超出的部分截断
+    static constexpr uint32_t QueueCapacity    = 256;
+    static constexpr uint32_t MaxMessageLength = 2048;
+    static constexpr uint32_t MaxIdNameLength  = 96;
+    //按消息种类计数的表的大小，不同消息种类超过这个数时不再去重
+    static constexpr uint32_t MaxMessageIds = 1024;
+
+    ValidationLogger();
+    ~ValidationLogger();
+
+    ValidationLogger(const ValidationLogger&)            = delete;
+    ValidationLogger& operator=(const ValidationLogger&) = delete;
+
+    void Start();
+    //输出队列中剩余的消息和汇总后结束后台线程
+    void Stop();
+
+    //运行时过滤：只记录级别在severities中、且类型与types有交集的消息
+    void SetFilter(VkDebugUtilsMessageSeverityFlagsEXT severities , VkDebugUtilsMessageTypeFlagsEXT types);
+    //同一种消息最多输出的次数，0表示不限制
+    void SetRepeatLimit(uint32_t limit) { m_RepeatLimit.store(limit, std::memory_order_relaxed); }
+
+    VkDebugUtilsMessageSeverityFlagsEXT Severities() const { return m_Severities.load(std::memory_order_relaxed); }
+    VkDebugUtilsMessageTypeFlagsEXT     Types() const { return m_Types.load(std::memory_order_relaxed); }
+
+    //在校验层的回调中调用，可以被多个线程同时调用，不加锁、不分配内存
+    void Push(VkDebugUtilsMessageSeverityFlagBitsEXT      severity , VkDebugUtilsMessageTypeFlagsEXT types ,
+              const VkDebugUtilsMessengerCallbackDataEXT* data);
+
+    //解析"verbose"/"info"/"warning"/"error"，返回该级别及以上的全部级别
+    static VkDebugUtilsMessageSeverityFlagsEXT ParseSeverity(const std::string& name);
+    //解析逗号分隔的"general"/"validation"/"performance"
+    static VkDebugUtilsMessageTypeFlagsEXT ParseTypes(const std::string& names);
+
+private:
+    struct Message;
+    struct Queue;
+    struct Counter;
+
+    //返回这条消息是第几次出现(从1开始)，计数表满时返回0
+    uint32_t CountOccurrence(uint64_t key , int32_t id , VkDebugUtilsMessageSeverityFlagBitsEXT severity);
+    void     Drain();
+    void     WorkerLoop();
+    void     PrintSummary();
+
+    std::unique_ptr<Queue>     m_Queue;
+    std::unique_ptr<Counter[]> m_Counters;
+
+    std::atomic<VkDebugUtilsMessageSeverityFlagsEXT> m_Severities;
+    std::atomic<VkDebugUtilsMessageTypeFlagsEXT>     m_Types;
+    std::atomic<uint32_t>                            m_RepeatLimit = 3;
+
+    std::atomic<uint64_t> m_Received   = 0; //通过过滤的消息数
+    std::atomic<uint64_t> m_Suppressed = 0; //超过重复次数、只计数不输出的消息数
+    std::atomic<uint64_t> m_Dropped    = 0; //队列满而丢弃的消息数
+
+    //后台线程见过的消息名称，汇总时显示；只在后台线程和它结束之后访问
+    std::unordered_map<uint64_t, std::string> m_IdNames;
+
+    std::thread       m_Worker;
+    std::atomic<bool> m_Stopping = false;
+};
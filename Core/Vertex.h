@@ -0,0 +1,33 @@
+﻿#pragma once
+
+#include <cstddef>
+#include "PipelineFactory.h"
+
+//顶点格式，和Triangle.vert.glsl中的输入变量一一对应
+struct Vertex
+{
+    float position[2];
+    float color[3];
+
+    static VertexInputDesc InputDesc()
+    {
+        VertexInputDesc desc = {};
+        desc.bindingCount    = 1;
+        //binding：缓冲绑定的序号；stride：相邻两个顶点之间的字节数；inputRate：逐顶点读取
+        desc.bindings[0].binding   = 0;
+        desc.bindings[0].stride    = sizeof(Vertex);
+        desc.bindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        //location对应着色器中的layout(location = N)
+        desc.attributeCount           = 2;
+        desc.attributes[0].binding    = 0;
+        desc.attributes[0].location   = 0;
+        desc.attributes[0].format     = VK_FORMAT_R32G32_SFLOAT;
+        desc.attributes[0].offset     = offsetof(Vertex, position);
+        desc.attributes[1].binding    = 0;
+        desc.attributes[1].location   = 1;
+        desc.attributes[1].format     = VK_FORMAT_R32G32B32_SFLOAT;
+        desc.attributes[1].offset     = offsetof(Vertex, color);
+        return desc;
+    }
+};
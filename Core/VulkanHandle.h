@@ -0,0 +1,161 @@
+﻿#pragma once
+
+#include <utility>
+#include <vulkan/vulkan.h>
+
+/*
+ * 只能移动的Vulkan句柄包装。析构或Reset时调用DestroyFunction销毁对象，移动后源对象变为空句柄。
+ * 可以隐式转换为原始句柄，直接传给vkXxx函数；需要句柄地址的地方(pSwapchains、pSignalSemaphores等)用Address()。
+ *
+ * RootHandle：没有父对象的句柄(VkInstance、VkDevice)，销毁函数形如vkDestroyInstance(instance, pAllocator)
+ * ChildHandle：由父对象销毁的句柄，销毁函数形如vkDestroyFence(device, fence, pAllocator)
+ *
+ * 成员按声明的逆序析构，持有它们的类应当先声明父对象(实例、设备)，再声明子对象。
+ * 创建失败时输出参数的内容是未定义的，所以Create只在VK_SUCCESS时接管句柄。
+ */
+template <typename T , auto DestroyFunction>
+class RootHandle
+{
+public:
+    RootHandle() = default;
+    explicit RootHandle(T handle) : m_Handle(handle) {}
+    ~RootHandle() { Reset(); }
+
+    RootHandle(const RootHandle&)            = delete;
+    RootHandle& operator=(const RootHandle&) = delete;
+
+    RootHandle(RootHandle&& other) noexcept : m_Handle(other.Release()) {}
+
+    RootHandle& operator=(RootHandle&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset(other.Release());
+        }
+        return *this;
+    }
+
+    //调用create(&createInfo, nullptr, &handle)，成功后销毁旧对象并接管新句柄
+    template <typename CreateFunction , typename CreateInfo>
+    VkResult Create(CreateFunction create , const CreateInfo& createInfo)
+    {
+        T        handle = VK_NULL_HANDLE;
+        VkResult result = create(&createInfo, nullptr, &handle);
+        if (result == VK_SUCCESS)
+        {
+            Reset(handle);
+        }
+        return result;
+    }
+
+    void Reset(T handle = VK_NULL_HANDLE)
+    {
+        if (m_Handle != VK_NULL_HANDLE)
+        {
+            DestroyFunction(m_Handle, nullptr);
+        }
+        m_Handle = handle;
+    }
+
+    //放弃所有权，返回原始句柄，调用者负责销毁
+    T Release() { return std::exchange(m_Handle, VK_NULL_HANDLE); }
+
+    T        Get() const { return m_Handle; }
+    const T* Address() const { return &m_Handle; }
+    operator T() const { return m_Handle; }
+
+private:
+    T m_Handle = VK_NULL_HANDLE;
+};
+
+template <typename Parent , typename T , auto DestroyFunction>
+class ChildHandle
+{
+public:
+    using ParentType = Parent;
+    using HandleType = T;
+
+    ChildHandle() = default;
+    ChildHandle(Parent parent , T handle) : m_Parent(parent), m_Handle(handle) {}
+    ~ChildHandle() { Reset(); }
+
+    ChildHandle(const ChildHandle&)            = delete;
+    ChildHandle& operator=(const ChildHandle&) = delete;
+
+    ChildHandle(ChildHandle&& other) noexcept : m_Parent(other.m_Parent), m_Handle(other.Release()) {}
+
+    ChildHandle& operator=(ChildHandle&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Parent parent = other.m_Parent;
+            Reset(parent, other.Release());
+        }
+        return *this;
+    }
+
+    //调用create(parent, &createInfo, nullptr, &handle)，成功后销毁旧对象并接管新句柄
+    template <typename CreateFunction , typename CreateInfo>
+    VkResult Create(Parent parent , CreateFunction create , const CreateInfo& createInfo)
+    {
+        T        handle = VK_NULL_HANDLE;
+        VkResult result = create(parent, &createInfo, nullptr, &handle);
+        if (result == VK_SUCCESS)
+        {
+            Reset(parent, handle);
+        }
+        return result;
+    }
+
+    void Reset()
+    {
+        if (m_Handle != VK_NULL_HANDLE)
+        {
+            Destroy(m_Parent, m_Handle);
+            m_Handle = VK_NULL_HANDLE;
+        }
+    }
+
+    void Reset(Parent parent , T handle)
+    {
+        Reset();
+        m_Parent = parent;
+        m_Handle = handle;
+    }
+
+    //放弃所有权，返回原始句柄，调用者负责用Destroy(Parent(), handle)销毁
+    T Release() { return std::exchange(m_Handle, VK_NULL_HANDLE); }
+
+    static void Destroy(Parent parent , T handle) { DestroyFunction(parent, handle, nullptr); }
+
+    Parent   GetParent() const { return m_Parent; }
+    T        Get() const { return m_Handle; }
+    const T* Address() const { return &m_Handle; }
+    operator T() const { return m_Handle; }
+
+private:
+    Parent m_Parent = VK_NULL_HANDLE;
+    T      m_Handle = VK_NULL_HANDLE;
+};
+
+template <typename T , auto DestroyFunction>
+using DeviceHandle = ChildHandle<VkDevice, T, DestroyFunction>;
+
+using UniqueInstance       = RootHandle<VkInstance, vkDestroyInstance>;
+using UniqueDevice         = RootHandle<VkDevice, vkDestroyDevice>;
+using UniqueSurface        = ChildHandle<VkInstance, VkSurfaceKHR, vkDestroySurfaceKHR>;
+using UniqueSwapchain      = DeviceHandle<VkSwapchainKHR, vkDestroySwapchainKHR>;
+using UniqueImage          = DeviceHandle<VkImage, vkDestroyImage>;
+using UniqueImageView      = DeviceHandle<VkImageView, vkDestroyImageView>;
+using UniqueFramebuffer    = DeviceHandle<VkFramebuffer, vkDestroyFramebuffer>;
+using UniqueRenderPass     = DeviceHandle<VkRenderPass, vkDestroyRenderPass>;
+using UniquePipelineLayout = DeviceHandle<VkPipelineLayout, vkDestroyPipelineLayout>;
+using UniquePipeline       = DeviceHandle<VkPipeline, vkDestroyPipeline>;
+using UniqueCommandPool    = DeviceHandle<VkCommandPool, vkDestroyCommandPool>;
+using UniqueSemaphore      = DeviceHandle<VkSemaphore, vkDestroySemaphore>;
+using UniqueFence          = DeviceHandle<VkFence, vkDestroyFence>;
+using UniqueSampler        = DeviceHandle<VkSampler, vkDestroySampler>;
+using UniqueQueryPool      = DeviceHandle<VkQueryPool, vkDestroyQueryPool>;
+
+using UniqueDescriptorSetLayout = DeviceHandle<VkDescriptorSetLayout, vkDestroyDescriptorSetLayout>;
+using UniqueDescriptorPool      = DeviceHandle<VkDescriptorPool, vkDestroyDescriptorPool>;
@@ -0,0 +1,269 @@
+﻿#include "Batch.h"
+
+#include <bit>
+
+#if MATH_SIMD_SSE && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Math
+{
+    namespace
+    {
+        //----------------------------------------标量参考----------------------------------------
+        //SIMD实现必须和这里的运算顺序完全一致：先按x、y、z的顺序累加乘积，最后加常数项
+
+        void ScalarTransformPoints(const Mat4& matrix , PointStreams points , PointOutputStreams result , size_t count)
+        {
+            const float* m = matrix.Data();
+            for (size_t i = 0; i < count; i++)
+            {
+                float x     = points.x[i];
+                float y     = points.y[i];
+                float z     = points.z[i];
+                result.x[i] = x * m[0] + y * m[4] + z * m[8] + m[12];
+                result.y[i] = x * m[1] + y * m[5] + z * m[9] + m[13];
+                result.z[i] = x * m[2] + y * m[6] + z * m[10] + m[14];
+            }
+        }
+
+        void ScalarMultiplyMatrices(const Mat4* a , const Mat4* b , Mat4* result , size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                const float* left  = a[i].Data();
+                const float* right = b[i].Data();
+                float        product[16];
+                for (int c = 0; c < 4; c++)
+                {
+                    for (int r = 0; r < 4; r++)
+                    {
+                        product[c * 4 + r] = left[r] * right[c * 4] + left[4 + r] * right[c * 4 + 1] +
+                                             left[8 + r] * right[c * 4 + 2] + left[12 + r] * right[c * 4 + 3];
+                    }
+                }
+                //result可能就是a或b
+                float* out = result[i].Data();
+                for (int j = 0; j < 16; j++)
+                {
+                    out[j] = product[j];
+                }
+            }
+        }
+
+        size_t ScalarCullSpheres(const FrustumPlanes& planes , SphereStreams spheres , uint8_t* visible , size_t count)
+        {
+            size_t visibleCount = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                bool outside = false;
+                for (const auto& plane : planes)
+                {
+                    float distance = spheres.x[i] * plane[0] + spheres.y[i] * plane[1] + spheres.z[i] * plane[2] +
+                                     plane[3];
+                    outside = outside || distance < -spheres.radius[i];
+                }
+                visible[i]    = outside ? 0 : 1;
+                visibleCount += outside ? 0 : 1;
+            }
+            return visibleCount;
+        }
+
+        //盒子在法线方向上的投影半径是|a|*ex + |b|*ey + |c|*ez，中心到平面的距离小于它的相反数时整个盒子在外侧
+        size_t ScalarCullAabbs(const FrustumPlanes& planes , AabbStreams boxes , uint8_t* visible , size_t count)
+        {
+            size_t visibleCount = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                bool outside = false;
+                for (const auto& plane : planes)
+                {
+                    float distance = boxes.centerX[i] * plane[0] + boxes.centerY[i] * plane[1] +
+                                     boxes.centerZ[i] * plane[2] + plane[3];
+                    float radius = boxes.extentX[i] * std::abs(plane[0]) + boxes.extentY[i] * std::abs(plane[1]) +
+                                   boxes.extentZ[i] * std::abs(plane[2]);
+                    outside = outside || distance < -radius;
+                }
+                visible[i]    = outside ? 0 : 1;
+                visibleCount += outside ? 0 : 1;
+            }
+            return visibleCount;
+        }
+
+#if MATH_SIMD_SSE || MATH_SIMD_NEON
+        //----------------------------------------4路实现----------------------------------------
+
+        void Simd4TransformPoints(const Mat4& matrix , PointStreams points , PointOutputStreams result , size_t count)
+        {
+            const float* m = matrix.Data();
+            Simd::Float4 element[16];
+            for (int j = 0; j < 16; j++)
+            {
+                element[j] = Simd::Splat(m[j]);
+            }
+
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                Simd::Float4 x = Simd::Load(points.x + i);
+                Simd::Float4 y = Simd::Load(points.y + i);
+                Simd::Float4 z = Simd::Load(points.z + i);
+                for (int row = 0; row < 3; row++)
+                {
+                    Simd::Float4 sum = Simd::Mul(x, element[row]);
+                    sum              = Simd::Add(sum, Simd::Mul(y, element[4 + row]));
+                    sum              = Simd::Add(sum, Simd::Mul(z, element[8 + row]));
+                    sum              = Simd::Add(sum, element[12 + row]);
+                    float* out       = row == 0 ? result.x : ( row == 1 ? result.y : result.z );
+                    Simd::Store(out + i, sum);
+                }
+            }
+            ScalarTransformPoints(matrix, Detail::Offset(points, i), Detail::Offset(result, i), count - i);
+        }
+
+        //一个矩阵正好是4个Float4，Mat4的乘法运算符已经是4路实现
+        void Simd4MultiplyMatrices(const Mat4* a , const Mat4* b , Mat4* result , size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                result[i] = a[i] * b[i];
+            }
+        }
+
+        size_t Simd4CullSpheres(const FrustumPlanes& planes , SphereStreams spheres , uint8_t* visible , size_t count)
+        {
+            Simd::Float4 zero         = Simd::Splat(0.0f);
+            size_t       visibleCount = 0;
+            size_t       i            = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                Simd::Float4 x         = Simd::Load(spheres.x + i);
+                Simd::Float4 y         = Simd::Load(spheres.y + i);
+                Simd::Float4 z         = Simd::Load(spheres.z + i);
+                Simd::Float4 negRadius = Simd::Sub(zero, Simd::Load(spheres.radius + i));
+                Simd::Mask4  outside   = Simd::NoneMask();
+                for (const auto& plane : planes)
+                {
+                    Simd::Float4 distance = Simd::Mul(x, Simd::Splat(plane[0]));
+                    distance              = Simd::Add(distance, Simd::Mul(y, Simd::Splat(plane[1])));
+                    distance              = Simd::Add(distance, Simd::Mul(z, Simd::Splat(plane[2])));
+                    distance              = Simd::Add(distance, Simd::Splat(plane[3]));
+                    outside               = Simd::Or(outside, Simd::Less(distance, negRadius));
+                }
+                uint32_t bits = ~Simd::MoveMask(outside) & 0xF;
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    visible[i + lane] = static_cast<uint8_t>(( bits >> lane ) & 1);
+                }
+                visibleCount += std::popcount(bits);
+            }
+            return visibleCount + ScalarCullSpheres(planes, Detail::Offset(spheres, i), visible + i, count - i);
+        }
+
+        size_t Simd4CullAabbs(const FrustumPlanes& planes , AabbStreams boxes , uint8_t* visible , size_t count)
+        {
+            Simd::Float4 zero         = Simd::Splat(0.0f);
+            size_t       visibleCount = 0;
+            size_t       i            = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                Simd::Float4 cx      = Simd::Load(boxes.centerX + i);
+                Simd::Float4 cy      = Simd::Load(boxes.centerY + i);
+                Simd::Float4 cz      = Simd::Load(boxes.centerZ + i);
+                Simd::Float4 ex      = Simd::Load(boxes.extentX + i);
+                Simd::Float4 ey      = Simd::Load(boxes.extentY + i);
+                Simd::Float4 ez      = Simd::Load(boxes.extentZ + i);
+                Simd::Mask4  outside = Simd::NoneMask();
+                for (const auto& plane : planes)
+                {
+                    Simd::Float4 distance = Simd::Mul(cx, Simd::Splat(plane[0]));
+                    distance              = Simd::Add(distance, Simd::Mul(cy, Simd::Splat(plane[1])));
+                    distance              = Simd::Add(distance, Simd::Mul(cz, Simd::Splat(plane[2])));
+                    distance              = Simd::Add(distance, Simd::Splat(plane[3]));
+                    Simd::Float4 radius   = Simd::Mul(ex, Simd::Splat(std::abs(plane[0])));
+                    radius                = Simd::Add(radius, Simd::Mul(ey, Simd::Splat(std::abs(plane[1]))));
+                    radius                = Simd::Add(radius, Simd::Mul(ez, Simd::Splat(std::abs(plane[2]))));
+                    outside               = Simd::Or(outside, Simd::Less(distance, Simd::Sub(zero, radius)));
+                }
+                uint32_t bits = ~Simd::MoveMask(outside) & 0xF;
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    visible[i + lane] = static_cast<uint8_t>(( bits >> lane ) & 1);
+                }
+                visibleCount += std::popcount(bits);
+            }
+            return visibleCount + ScalarCullAabbs(planes, Detail::Offset(boxes, i), visible + i, count - i);
+        }
+#endif
+
+#if MATH_SIMD_SSE
+        //AVX2需要CPU支持，并且操作系统在上下文切换时保存YMM寄存器(XCR0的第1、2位)
+        bool CpuSupportsAvx2()
+        {
+#if defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) return false;
+
+            __cpuid(info, 1);
+            bool osxsave = ( info[2] & ( 1 << 27 ) ) != 0;
+            bool avx     = ( info[2] & ( 1 << 28 ) ) != 0;
+            if (!osxsave || !avx || ( _xgetbv(0) & 0x6 ) != 0x6) return false;
+
+            __cpuidex(info, 7, 0);
+            return ( info[1] & ( 1 << 5 ) ) != 0;
+#else
+            //GCC和Clang的实现同样检查了XCR0
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+    }
+
+    namespace Detail
+    {
+        const BatchKernels ScalarKernels = {"scalar", ScalarTransformPoints, ScalarMultiplyMatrices, ScalarCullSpheres,
+                                            ScalarCullAabbs};
+#if MATH_SIMD_SSE || MATH_SIMD_NEON
+        const BatchKernels Simd4Kernels = {Simd::Name, Simd4TransformPoints, Simd4MultiplyMatrices, Simd4CullSpheres,
+                                           Simd4CullAabbs};
+#endif
+    }
+
+    SimdLevel DetectSimdLevel()
+    {
+#if MATH_SIMD_SSE
+        return CpuSupportsAvx2() ? SimdLevel::Avx2 : SimdLevel::Simd4;
+#elif MATH_SIMD_NEON
+        return SimdLevel::Simd4;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    const BatchKernels* GetBatchKernels(SimdLevel level)
+    {
+        switch (level)
+        {
+        case SimdLevel::Scalar:
+            return &Detail::ScalarKernels;
+#if MATH_SIMD_SSE || MATH_SIMD_NEON
+        case SimdLevel::Simd4:
+            return &Detail::Simd4Kernels;
+#endif
+#if MATH_SIMD_SSE
+        case SimdLevel::Avx2:
+            return &Detail::Avx2Kernels;
+#endif
+        default:
+            return nullptr;
+        }
+    }
+
+    const BatchKernels& ActiveBatchKernels()
+    {
+        //局部静态变量的初始化是线程安全的
+        static const BatchKernels* kernels = GetBatchKernels(DetectSimdLevel());
+        return *kernels;
+    }
+}
@@ -0,0 +1,124 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Matrix.h"
+
+/*
+ * 批量数学函数：点的变换、矩阵相乘、包围球/包围盒的视锥体测试。
+ * 点、球和盒按结构数组(SoA)传入，每个分量一个连续的数组，SIMD一次读取相邻几个元素的同一个分量，不需要转置。
+ * 数组不要求对齐，数量不要求是4或8的倍数，尾部交给标量实现。
+ *
+ * 每个函数有三个实现：标量参考、4路(Simd.h，SSE或NEON)、8路AVX2(只在x86上编译)。
+ * 三者的运算顺序相同，也都不使用融合乘加，所以结果逐位相同；--check math会验证这一点。
+ * 不使用融合乘加靠的是Batch.cpp和BatchAvx2.cpp的编译选项：MSVC为/fp:precise(见LearnVulkan.vcxproj中这两个文件的设置)，
+ * GCC和Clang要给这两个文件加上-ffp-contract=off，否则编译器会把乘法和加法合并成FMA(AArch64上默认如此)。
+ * 第一次调用时检测CPU，之后的调用都使用支持的最快的实现。
+ */
+namespace Math
+{
+    struct PointStreams
+    {
+        const float* x;
+        const float* y;
+        const float* z;
+    };
+
+    struct PointOutputStreams
+    {
+        float* x;
+        float* y;
+        float* z;
+    };
+
+    struct SphereStreams
+    {
+        const float* x;
+        const float* y;
+        const float* z;
+        const float* radius;
+    };
+
+    //中心和半边长
+    struct AabbStreams
+    {
+        const float* centerX;
+        const float* centerY;
+        const float* centerZ;
+        const float* extentX;
+        const float* extentY;
+        const float* extentZ;
+    };
+
+    //6个平面(a, b, c, d)，法线朝内，点p在内侧当且仅当dot(abc, p) + d >= 0。和GpuCuller.h中Frustum::planes的布局相同
+    using FrustumPlanes = float[6][4];
+
+    enum class SimdLevel
+    {
+        Scalar,
+        Simd4, //SSE或NEON，见Simd::Name
+        Avx2,
+    };
+
+    struct BatchKernels
+    {
+        const char* name;
+        //result = matrix * (x, y, z, 1)的xyz，不做透视除法。输出可以和输入是同一组数组
+        void (*transformPoints)(const Mat4& matrix , PointStreams points , PointOutputStreams result , size_t count);
+        //result[i] = a[i] * b[i]
+        void (*multiplyMatrices)(const Mat4* a , const Mat4* b , Mat4* result , size_t count);
+        //visible[i]写入0或1，返回可见的数量
+        size_t (*cullSpheres)(const FrustumPlanes& planes , SphereStreams spheres , uint8_t* visible , size_t count);
+        size_t (*cullAabbs)(const FrustumPlanes& planes , AabbStreams boxes , uint8_t* visible , size_t count);
+    };
+
+    //编译进来的实现中当前CPU支持的最高一级
+    SimdLevel DetectSimdLevel();
+    //没有编译进来的级别返回nullptr，不检查CPU是否支持
+    const BatchKernels* GetBatchKernels(SimdLevel level);
+    //DetectSimdLevel对应的实现，只检测一次
+    const BatchKernels& ActiveBatchKernels();
+    //用count个随机元素逐位比较CPU支持的每一级实现和标量参考，任何一位不同都抛出std::runtime_error
+    void CheckBatchKernels(size_t count);
+
+    inline void TransformPoints(const Mat4& matrix , PointStreams points , PointOutputStreams result , size_t count)
+    {
+        ActiveBatchKernels().transformPoints(matrix, points, result, count);
+    }
+
+    inline void MultiplyMatrices(const Mat4* a , const Mat4* b , Mat4* result , size_t count)
+    {
+        ActiveBatchKernels().multiplyMatrices(a, b, result, count);
+    }
+
+    inline size_t CullSpheres(const FrustumPlanes& planes , SphereStreams spheres , uint8_t* visible , size_t count)
+    {
+        return ActiveBatchKernels().cullSpheres(planes, spheres, visible, count);
+    }
+
+    inline size_t CullAabbs(const FrustumPlanes& planes , AabbStreams boxes , uint8_t* visible , size_t count)
+    {
+        return ActiveBatchKernels().cullAabbs(planes, boxes, visible, count);
+    }
+
+    //各个实现之间共用，处理SIMD循环剩下的尾部
+    namespace Detail
+    {
+        extern const BatchKernels ScalarKernels;
+#if MATH_SIMD_SSE || MATH_SIMD_NEON
+        extern const BatchKernels Simd4Kernels;
+#endif
+#if MATH_SIMD_SSE
+        extern const BatchKernels Avx2Kernels;
+#endif
+
+        inline PointStreams Offset(PointStreams s , size_t i) { return {s.x + i, s.y + i, s.z + i}; }
+        inline PointOutputStreams Offset(PointOutputStreams s , size_t i) { return {s.x + i, s.y + i, s.z + i}; }
+        inline SphereStreams Offset(SphereStreams s , size_t i) { return {s.x + i, s.y + i, s.z + i, s.radius + i}; }
+        inline AabbStreams Offset(AabbStreams s , size_t i)
+        {
+            return {s.centerX + i, s.centerY + i, s.centerZ + i, s.extentX + i, s.extentY + i, s.extentZ + i};
+        }
+    }
+}
@@ -0,0 +1,162 @@
+﻿#include "Batch.h"
+
+//8路AVX2实现。只在这个文件中使用AVX指令，由DetectSimdLevel确认CPU支持之后才会调用，
+//所以整个程序不需要/arch:AVX2，在不支持AVX2的CPU上也能运行
+#if MATH_SIMD_SSE
+
+#include <bit>
+#include <immintrin.h>
+
+//MSVC不需要额外的编译选项就能使用AVX内建函数；GCC和Clang要在函数上标注目标指令集
+#if defined(__GNUC__) || defined(__clang__)
+#define MATH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MATH_TARGET_AVX2
+#endif
+
+namespace Math
+{
+    namespace
+    {
+        //把8位掩码展开成8个字节写入visible，返回可见的数量
+        MATH_TARGET_AVX2 size_t StoreVisible(__m256 outside , uint8_t* visible)
+        {
+            uint32_t bits = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFF;
+            for (int lane = 0; lane < 8; lane++)
+            {
+                visible[lane] = static_cast<uint8_t>(( bits >> lane ) & 1);
+            }
+            return std::popcount(bits);
+        }
+
+        MATH_TARGET_AVX2 void Avx2TransformPoints(const Mat4& matrix , PointStreams points , PointOutputStreams result ,
+                                                  size_t count)
+        {
+            const float* m = matrix.Data();
+            __m256       element[16];
+            for (int j = 0; j < 16; j++)
+            {
+                element[j] = _mm256_set1_ps(m[j]);
+            }
+
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256 x = _mm256_loadu_ps(points.x + i);
+                __m256 y = _mm256_loadu_ps(points.y + i);
+                __m256 z = _mm256_loadu_ps(points.z + i);
+                for (int row = 0; row < 3; row++)
+                {
+                    __m256 sum = _mm256_mul_ps(x, element[row]);
+                    sum        = _mm256_add_ps(sum, _mm256_mul_ps(y, element[4 + row]));
+                    sum        = _mm256_add_ps(sum, _mm256_mul_ps(z, element[8 + row]));
+                    sum        = _mm256_add_ps(sum, element[12 + row]);
+                    float* out = row == 0 ? result.x : ( row == 1 ? result.y : result.z );
+                    _mm256_storeu_ps(out + i, sum);
+                }
+            }
+            _mm256_zeroupper();
+            Detail::ScalarKernels.transformPoints(matrix, Detail::Offset(points, i), Detail::Offset(result, i),
+                                                  count - i);
+        }
+
+        //一次计算结果的两列：a的每一列复制到高低两半，b的相邻两列一次读入，在各自的128位内广播分量
+        MATH_TARGET_AVX2 void Avx2MultiplyMatrices(const Mat4* a , const Mat4* b , Mat4* result , size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                const float* left = a[i].Data();
+                __m256       a0   = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(left));
+                __m256       a1   = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(left + 4));
+                __m256       a2   = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(left + 8));
+                __m256       a3   = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(left + 12));
+                __m256       b01  = _mm256_loadu_ps(b[i].Data());
+                __m256       b23  = _mm256_loadu_ps(b[i].Data() + 8);
+
+                __m256 c01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00));
+                c01        = _mm256_add_ps(c01, _mm256_mul_ps(a1, _mm256_permute_ps(b01, 0x55)));
+                c01        = _mm256_add_ps(c01, _mm256_mul_ps(a2, _mm256_permute_ps(b01, 0xAA)));
+                c01        = _mm256_add_ps(c01, _mm256_mul_ps(a3, _mm256_permute_ps(b01, 0xFF)));
+                __m256 c23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, 0x00));
+                c23        = _mm256_add_ps(c23, _mm256_mul_ps(a1, _mm256_permute_ps(b23, 0x55)));
+                c23        = _mm256_add_ps(c23, _mm256_mul_ps(a2, _mm256_permute_ps(b23, 0xAA)));
+                c23        = _mm256_add_ps(c23, _mm256_mul_ps(a3, _mm256_permute_ps(b23, 0xFF)));
+
+                //两个输入都已经读进寄存器，result和a、b是同一个矩阵也没有问题
+                _mm256_storeu_ps(result[i].Data(), c01);
+                _mm256_storeu_ps(result[i].Data() + 8, c23);
+            }
+            _mm256_zeroupper();
+        }
+
+        MATH_TARGET_AVX2 size_t Avx2CullSpheres(const FrustumPlanes& planes , SphereStreams spheres , uint8_t* visible ,
+                                                size_t count)
+        {
+            __m256 zero         = _mm256_setzero_ps();
+            size_t visibleCount = 0;
+            size_t i            = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256 x         = _mm256_loadu_ps(spheres.x + i);
+                __m256 y         = _mm256_loadu_ps(spheres.y + i);
+                __m256 z         = _mm256_loadu_ps(spheres.z + i);
+                __m256 negRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(spheres.radius + i));
+                __m256 outside   = zero;
+                for (const auto& plane : planes)
+                {
+                    __m256 distance = _mm256_mul_ps(x, _mm256_set1_ps(plane[0]));
+                    distance        = _mm256_add_ps(distance, _mm256_mul_ps(y, _mm256_set1_ps(plane[1])));
+                    distance        = _mm256_add_ps(distance, _mm256_mul_ps(z, _mm256_set1_ps(plane[2])));
+                    distance        = _mm256_add_ps(distance, _mm256_set1_ps(plane[3]));
+                    outside         = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negRadius, _CMP_LT_OQ));
+                }
+                visibleCount += StoreVisible(outside, visible + i);
+            }
+            _mm256_zeroupper();
+            return visibleCount + Detail::ScalarKernels.cullSpheres(planes, Detail::Offset(spheres, i), visible + i,
+                                                                    count - i);
+        }
+
+        MATH_TARGET_AVX2 size_t Avx2CullAabbs(const FrustumPlanes& planes , AabbStreams boxes , uint8_t* visible ,
+                                              size_t count)
+        {
+            __m256 zero         = _mm256_setzero_ps();
+            size_t visibleCount = 0;
+            size_t i            = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256 cx      = _mm256_loadu_ps(boxes.centerX + i);
+                __m256 cy      = _mm256_loadu_ps(boxes.centerY + i);
+                __m256 cz      = _mm256_loadu_ps(boxes.centerZ + i);
+                __m256 ex      = _mm256_loadu_ps(boxes.extentX + i);
+                __m256 ey      = _mm256_loadu_ps(boxes.extentY + i);
+                __m256 ez      = _mm256_loadu_ps(boxes.extentZ + i);
+                __m256 outside = zero;
+                for (const auto& plane : planes)
+                {
+                    __m256 distance = _mm256_mul_ps(cx, _mm256_set1_ps(plane[0]));
+                    distance        = _mm256_add_ps(distance, _mm256_mul_ps(cy, _mm256_set1_ps(plane[1])));
+                    distance        = _mm256_add_ps(distance, _mm256_mul_ps(cz, _mm256_set1_ps(plane[2])));
+                    distance        = _mm256_add_ps(distance, _mm256_set1_ps(plane[3]));
+                    __m256 radius   = _mm256_mul_ps(ex, _mm256_set1_ps(std::abs(plane[0])));
+                    radius          = _mm256_add_ps(radius, _mm256_mul_ps(ey, _mm256_set1_ps(std::abs(plane[1]))));
+                    radius          = _mm256_add_ps(radius, _mm256_mul_ps(ez, _mm256_set1_ps(std::abs(plane[2]))));
+                    outside         = _mm256_or_ps(outside,
+                                                   _mm256_cmp_ps(distance, _mm256_sub_ps(zero, radius), _CMP_LT_OQ));
+                }
+                visibleCount += StoreVisible(outside, visible + i);
+            }
+            _mm256_zeroupper();
+            return visibleCount + Detail::ScalarKernels.cullAabbs(planes, Detail::Offset(boxes, i), visible + i,
+                                                                  count - i);
+        }
+    }
+
+    namespace Detail
+    {
+        const BatchKernels Avx2Kernels = {"avx2", Avx2TransformPoints, Avx2MultiplyMatrices, Avx2CullSpheres,
+                                          Avx2CullAabbs};
+    }
+}
+
+#endif
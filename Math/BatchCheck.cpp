@@ -0,0 +1,176 @@
+﻿#include "Batch.h"
+
+#include <bit>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Math
+{
+    namespace
+    {
+        //随机数据和输出缓冲，每一级实现共用同一组输入
+        struct CheckData
+        {
+            size_t             count;
+            size_t             matrixCount;
+            std::vector<float> x, y, z, radius, extentX, extentY, extentZ;
+            std::vector<Mat4>  left, right;
+            FrustumPlanes      planes;
+            Mat4               matrix;
+
+            CheckData(size_t elementCount , uint32_t seed)
+                : count(elementCount), matrixCount(elementCount / 4 + 1), x(count), y(count), z(count), radius(count),
+                  extentX(count), extentY(count), extentZ(count), left(matrixCount), right(matrixCount)
+            {
+                std::mt19937                          random(seed);
+                std::uniform_real_distribution<float> coordinate(-20.0f, 20.0f);
+                std::uniform_real_distribution<float> size(0.1f, 2.0f);
+                std::uniform_real_distribution<float> element(-1.0f, 1.0f);
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    x[i]       = coordinate(random);
+                    y[i]       = coordinate(random);
+                    z[i]       = coordinate(random);
+                    radius[i]  = size(random);
+                    extentX[i] = size(random);
+                    extentY[i] = size(random);
+                    extentZ[i] = size(random);
+                }
+                for (size_t i = 0; i < matrixCount; i++)
+                {
+                    for (int j = 0; j < 16; j++)
+                    {
+                        left[i].Data()[j]  = element(random);
+                        right[i].Data()[j] = element(random);
+                    }
+                }
+                for (int j = 0; j < 16; j++)
+                {
+                    matrix.Data()[j] = element(random);
+                }
+                //平面不需要构成真正的视锥体，只要让一部分元素落在内侧、一部分落在外侧，两种分支都被比较到
+                for (auto& plane : planes)
+                {
+                    plane[0] = element(random);
+                    plane[1] = element(random);
+                    plane[2] = element(random);
+                    plane[3] = coordinate(random) * 0.5f;
+                }
+            }
+        };
+
+        //逐个元素按位比较，浮点数不允许任何ULP差：+0和-0、不同的NaN也算不一致
+        size_t BitMismatches(const float* reference , const float* result , size_t count)
+        {
+            size_t mismatches = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                mismatches += std::bit_cast<uint32_t>(reference[i]) != std::bit_cast<uint32_t>(result[i]) ? 1 : 0;
+            }
+            return mismatches;
+        }
+
+        size_t ByteMismatches(const std::vector<uint8_t>& reference , const std::vector<uint8_t>& result)
+        {
+            size_t mismatches = 0;
+            for (size_t i = 0; i < reference.size(); i++)
+            {
+                mismatches += reference[i] != result[i] ? 1 : 0;
+            }
+            return mismatches;
+        }
+
+        //输出全部写进一个结构，标量参考和被测实现各一份
+        struct CheckOutput
+        {
+            std::vector<float>   x, y, z;
+            std::vector<Mat4>    matrices;
+            std::vector<uint8_t> spheres, boxes;
+            size_t               visibleSpheres = 0;
+            size_t               visibleBoxes   = 0;
+
+            CheckOutput(const CheckData& data)
+                : x(data.count), y(data.count), z(data.count), matrices(data.matrixCount), spheres(data.count),
+                  boxes(data.count)
+            {
+            }
+        };
+
+        void Run(const BatchKernels& kernels , const CheckData& data , CheckOutput& output)
+        {
+            size_t count = data.count;
+            kernels.transformPoints(data.matrix, {data.x.data(), data.y.data(), data.z.data()},
+                                    {output.x.data(), output.y.data(), output.z.data()}, count);
+            kernels.multiplyMatrices(data.left.data(), data.right.data(), output.matrices.data(), data.matrixCount);
+            output.visibleSpheres = kernels.cullSpheres(data.planes,
+                                                        {data.x.data(), data.y.data(), data.z.data(),
+                                                         data.radius.data()}, output.spheres.data(), count);
+            output.visibleBoxes = kernels.cullAabbs(data.planes,
+                                                    {data.x.data(), data.y.data(), data.z.data(), data.extentX.data(),
+                                                     data.extentY.data(), data.extentZ.data()}, output.boxes.data(),
+                                                    count);
+        }
+
+        void Expect(size_t mismatches , const BatchKernels& kernels , const char* kernel , size_t count)
+        {
+            if (mismatches != 0)
+            {
+                throw std::runtime_error(std::string("数学库的") + kernels.name + "实现与标量参考不一致: " + kernel +
+                                         ", " + std::to_string(mismatches) + "/" + std::to_string(count) +
+                                         "个元素不同，检查Batch.cpp和BatchAvx2.cpp是否以禁止融合乘加的选项编译");
+            }
+        }
+    }
+
+    /*
+     * 各级实现和标量参考必须逐位一致，这依赖于Batch.cpp和BatchAvx2.cpp的编译选项禁止合并融合乘加
+     * (MSVC的/fp:precise，GCC和Clang的-ffp-contract=off)，选项漏掉时计算结果只差几个ULP，
+     * 不会有别的症状，所以单独检查，任何一位不同都抛出异常。
+     * 除了count个元素，还检查0到17个元素：覆盖4路和8路循环之后每一种长度的尾部
+     */
+    void CheckBatchKernels(size_t count)
+    {
+        std::vector<const BatchKernels*> implementations;
+        for (SimdLevel level : {SimdLevel::Simd4, SimdLevel::Avx2})
+        {
+            const BatchKernels* kernels = GetBatchKernels(level);
+            if (level <= DetectSimdLevel() && kernels != nullptr)
+            {
+                implementations.push_back(kernels);
+            }
+        }
+
+        std::vector<size_t> counts = {count};
+        for (size_t tail = 0; tail <= 17; tail++)
+        {
+            counts.push_back(tail);
+        }
+
+        for (size_t elements : counts)
+        {
+            CheckData   data(elements, static_cast<uint32_t>(2024 + elements));
+            CheckOutput reference(data);
+            Run(*GetBatchKernels(SimdLevel::Scalar), data, reference);
+
+            for (const BatchKernels* kernels : implementations)
+            {
+                CheckOutput result(data);
+                Run(*kernels, data, result);
+                Expect(BitMismatches(reference.x.data(), result.x.data(), elements) +
+                       BitMismatches(reference.y.data(), result.y.data(), elements) +
+                       BitMismatches(reference.z.data(), result.z.data(), elements), *kernels, "transform points",
+                       elements);
+                Expect(BitMismatches(reference.matrices[0].Data(), result.matrices[0].Data(), data.matrixCount * 16),
+                       *kernels, "multiply matrices", data.matrixCount);
+                Expect(ByteMismatches(reference.spheres, result.spheres) +
+                       ( reference.visibleSpheres != result.visibleSpheres ? 1 : 0 ), *kernels, "cull spheres",
+                       elements);
+                Expect(ByteMismatches(reference.boxes, result.boxes) +
+                       ( reference.visibleBoxes != result.visibleBoxes ? 1 : 0 ), *kernels, "cull aabbs", elements);
+            }
+        }
+    }
+}
@@ -1,5 +1,10 @@
 ﻿#pragma once
 
+//数学库的总入口：Vector.h(Vec3、Vec4、Quat)、Matrix.h(Mat4)和Batch.h(按结构数组批量处理)
+#include "Batch.h"
+#include "Matrix.h"
+#include "Vector.h"
+
 namespace Math
 {
     template <typename T>
@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include <cmath>
+
+#include "Vector.h"
+
+namespace Math
+{
+    //列主序的4x4矩阵，和GLSL、Vulkan的约定一致：columns[c]是第c列，Data()可以直接作为uniform或push constant上传
+    struct alignas(16) Mat4
+    {
+        Vec4 columns[4];
+
+        const float* Data() const { return &columns[0].x; }
+        float*       Data() { return &columns[0].x; }
+
+        static Mat4 Identity()
+        {
+            return {{{1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f},
+                     {0.0f, 0.0f, 0.0f, 1.0f}}};
+        }
+
+        static Mat4 Translation(const Vec3& offset)
+        {
+            Mat4 result       = Identity();
+            result.columns[3] = {offset.x, offset.y, offset.z, 1.0f};
+            return result;
+        }
+
+        static Mat4 Scale(const Vec3& scale)
+        {
+            return {{{scale.x, 0.0f, 0.0f, 0.0f}, {0.0f, scale.y, 0.0f, 0.0f}, {0.0f, 0.0f, scale.z, 0.0f},
+                     {0.0f, 0.0f, 0.0f, 1.0f}}};
+        }
+
+        //q必须是单位四元数
+        static Mat4 Rotation(const Quat& q)
+        {
+            float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+            float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+            float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+            return {{{1.0f - 2.0f * ( yy + zz ), 2.0f * ( xy + wz ), 2.0f * ( xz - wy ), 0.0f},
+                     {2.0f * ( xy - wz ), 1.0f - 2.0f * ( xx + zz ), 2.0f * ( yz + wx ), 0.0f},
+                     {2.0f * ( xz + wy ), 2.0f * ( yz - wx ), 1.0f - 2.0f * ( xx + yy ), 0.0f},
+                     {0.0f, 0.0f, 0.0f, 1.0f}}};
+        }
+
+        //右手坐标系，看向-z，深度映射到Vulkan的[0, 1]。y轴不翻转，需要时由视口或调用者处理
+        static Mat4 Perspective(float fovY , float aspect , float nearZ , float farZ)
+        {
+            float f = 1.0f / std::tan(fovY * 0.5f);
+            return {{{f / aspect, 0.0f, 0.0f, 0.0f}, {0.0f, f, 0.0f, 0.0f},
+                     {0.0f, 0.0f, farZ / ( nearZ - farZ ), -1.0f},
+                     {0.0f, 0.0f, nearZ * farZ / ( nearZ - farZ ), 0.0f}}};
+        }
+    };
+
+    //结果的每一列是a的四列按b对应列的分量加权求和，加法按0、1、2、3的顺序进行，
+    //和Batch.h的标量参考实现逐位相同
+    inline Mat4 operator*(const Mat4& a , const Mat4& b)
+    {
+        Simd::Float4 a0 = a.columns[0].Load();
+        Simd::Float4 a1 = a.columns[1].Load();
+        Simd::Float4 a2 = a.columns[2].Load();
+        Simd::Float4 a3 = a.columns[3].Load();
+
+        Mat4 result;
+        for (int c = 0; c < 4; c++)
+        {
+            Simd::Float4 column = b.columns[c].Load();
+            Simd::Float4 sum    = Simd::Mul(a0, Simd::Broadcast<0>(column));
+            sum                 = Simd::Add(sum, Simd::Mul(a1, Simd::Broadcast<1>(column)));
+            sum                 = Simd::Add(sum, Simd::Mul(a2, Simd::Broadcast<2>(column)));
+            sum                 = Simd::Add(sum, Simd::Mul(a3, Simd::Broadcast<3>(column)));
+            result.columns[c]   = Vec4::From(sum);
+        }
+        return result;
+    }
+
+    inline Vec4 operator*(const Mat4& m , const Vec4& v)
+    {
+        Simd::Float4 sum = Simd::Mul(m.columns[0].Load(), Simd::Splat(v.x));
+        sum              = Simd::Add(sum, Simd::Mul(m.columns[1].Load(), Simd::Splat(v.y)));
+        sum              = Simd::Add(sum, Simd::Mul(m.columns[2].Load(), Simd::Splat(v.z)));
+        sum              = Simd::Add(sum, Simd::Mul(m.columns[3].Load(), Simd::Splat(v.w)));
+        return Vec4::From(sum);
+    }
+
+    //w为1的点，不做透视除法
+    inline Vec3 TransformPoint(const Mat4& m , const Vec3& p)
+    {
+        Vec4 result = m * Vec4{p.x, p.y, p.z, 1.0f};
+        return {result.x, result.y, result.z};
+    }
+
+    inline Mat4 Transpose(const Mat4& m)
+    {
+        const Vec4* c = m.columns;
+        return {{{c[0].x, c[1].x, c[2].x, c[3].x}, {c[0].y, c[1].y, c[2].y, c[3].y}, {c[0].z, c[1].z, c[2].z, c[3].z},
+                 {c[0].w, c[1].w, c[2].w, c[3].w}}};
+    }
+}
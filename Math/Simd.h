@@ -0,0 +1,117 @@
+﻿#pragma once
+
+#include <cstdint>
+
+/*
+ * 4路单精度SIMD的薄封装，编译时选择实现：x86上是SSE(x64必定支持SSE2)，ARM上是NEON，其他平台是逐分量的标量代码。
+ * 定义MATH_FORCE_SCALAR可以强制使用标量实现，用于对比和排查问题。
+ * 8路的AVX2不在这里：是否可用要在运行时检测CPU，只在Batch的批量函数中按检测结果分派。
+ */
+#if defined(MATH_FORCE_SCALAR)
+#define MATH_SIMD_SSE 0
+#define MATH_SIMD_NEON 0
+#elif defined(_M_X64) || defined(__x86_64__) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 ) || defined(__SSE2__)
+#define MATH_SIMD_SSE 1
+#define MATH_SIMD_NEON 0
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+#define MATH_SIMD_SSE 0
+#define MATH_SIMD_NEON 1
+#else
+#define MATH_SIMD_SSE 0
+#define MATH_SIMD_NEON 0
+#endif
+
+#if MATH_SIMD_SSE
+#include <emmintrin.h>
+#elif MATH_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace Math::Simd
+{
+#if MATH_SIMD_SSE
+    constexpr const char* Name = "sse";
+
+    using Float4 = __m128;
+    using Mask4  = __m128;
+
+    inline Float4 Load(const float* p) { return _mm_loadu_ps(p); }
+    inline void   Store(float* p , Float4 v) { _mm_storeu_ps(p, v); }
+    inline Float4 Splat(float value) { return _mm_set1_ps(value); }
+    inline Float4 Add(Float4 a , Float4 b) { return _mm_add_ps(a, b); }
+    inline Float4 Sub(Float4 a , Float4 b) { return _mm_sub_ps(a, b); }
+    inline Float4 Mul(Float4 a , Float4 b) { return _mm_mul_ps(a, b); }
+    inline Float4 Abs(Float4 v) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), v); }
+    inline Mask4  Less(Float4 a , Float4 b) { return _mm_cmplt_ps(a, b); }
+    inline Mask4  Or(Mask4 a , Mask4 b) { return _mm_or_ps(a, b); }
+    inline Mask4  NoneMask() { return _mm_setzero_ps(); }
+    //第i位是第i个分量的掩码
+    inline uint32_t MoveMask(Mask4 mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask)); }
+
+    //把第Lane个分量复制到全部4个分量
+    template <int Lane>
+    Float4 Broadcast(Float4 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(Lane, Lane, Lane, Lane)); }
+#elif MATH_SIMD_NEON
+    constexpr const char* Name = "neon";
+
+    using Float4 = float32x4_t;
+    using Mask4  = uint32x4_t;
+
+    inline Float4 Load(const float* p) { return vld1q_f32(p); }
+    inline void   Store(float* p , Float4 v) { vst1q_f32(p, v); }
+    inline Float4 Splat(float value) { return vdupq_n_f32(value); }
+    inline Float4 Add(Float4 a , Float4 b) { return vaddq_f32(a, b); }
+    inline Float4 Sub(Float4 a , Float4 b) { return vsubq_f32(a, b); }
+    //不用vmlaq_f32：部分编译器把它生成为融合乘加，舍入和标量代码不同
+    inline Float4 Mul(Float4 a , Float4 b) { return vmulq_f32(a, b); }
+    inline Float4 Abs(Float4 v) { return vabsq_f32(v); }
+    inline Mask4  Less(Float4 a , Float4 b) { return vcltq_f32(a, b); }
+    inline Mask4  Or(Mask4 a , Mask4 b) { return vorrq_u32(a, b); }
+    inline Mask4  NoneMask() { return vdupq_n_u32(0); }
+    inline uint32_t MoveMask(Mask4 mask)
+    {
+        const uint32_t bits[4] = {1, 2, 4, 8};
+        return vaddvq_u32(vandq_u32(mask, vld1q_u32(bits)));
+    }
+
+    template <int Lane>
+    Float4 Broadcast(Float4 v) { return vdupq_laneq_f32(v, Lane); }
+#else
+    constexpr const char* Name = "scalar";
+
+    struct Float4
+    {
+        float v[4];
+    };
+
+    struct Mask4
+    {
+        bool v[4];
+    };
+
+    inline Float4 Load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+    inline void   Store(float* p , Float4 v) { for (int i = 0; i < 4; i++) p[i] = v.v[i]; }
+    inline Float4 Splat(float value) { return {{value, value, value, value}}; }
+    inline Float4 Add(Float4 a , Float4 b) { return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}}; }
+    inline Float4 Sub(Float4 a , Float4 b) { return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}}; }
+    inline Float4 Mul(Float4 a , Float4 b) { return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}}; }
+    inline Float4 Abs(Float4 v)
+    {
+        return {{v.v[0] < 0.0f ? -v.v[0] : v.v[0], v.v[1] < 0.0f ? -v.v[1] : v.v[1],
+                 v.v[2] < 0.0f ? -v.v[2] : v.v[2], v.v[3] < 0.0f ? -v.v[3] : v.v[3]}};
+    }
+    inline Mask4 Less(Float4 a , Float4 b) { return {{a.v[0] < b.v[0], a.v[1] < b.v[1], a.v[2] < b.v[2], a.v[3] < b.v[3]}}; }
+    inline Mask4 Or(Mask4 a , Mask4 b) { return {{a.v[0] || b.v[0], a.v[1] || b.v[1], a.v[2] || b.v[2], a.v[3] || b.v[3]}}; }
+    inline Mask4 NoneMask() { return {{false, false, false, false}}; }
+    inline uint32_t MoveMask(Mask4 mask)
+    {
+        return ( mask.v[0] ? 1u : 0u ) | ( mask.v[1] ? 2u : 0u ) | ( mask.v[2] ? 4u : 0u ) | ( mask.v[3] ? 8u : 0u );
+    }
+
+    template <int Lane>
+    Float4 Broadcast(Float4 v) { return Splat(v.v[Lane]); }
+#endif
+
+    //编译进来的4路实现是否真的是SIMD
+    constexpr bool Enabled = MATH_SIMD_SSE || MATH_SIMD_NEON;
+}
@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include <cmath>
+
+#include "Simd.h"
+
+namespace Math
+{
+    //三维向量只有12字节，放进SIMD寄存器要补一个分量，收益抵不过装载的开销，所以保持标量。
+    //批量处理大量的点时使用Batch.h中按结构数组(SoA)存储的版本
+    struct Vec3
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+    };
+
+    inline Vec3 operator+(const Vec3& a , const Vec3& b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+    inline Vec3 operator-(const Vec3& a , const Vec3& b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+    inline Vec3 operator*(const Vec3& v , float s) { return {v.x * s, v.y * s, v.z * s}; }
+    inline Vec3 operator*(float s , const Vec3& v) { return v * s; }
+
+    inline float Dot(const Vec3& a , const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline Vec3  Cross(const Vec3& a , const Vec3& b)
+    {
+        return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+    }
+    inline float Length(const Vec3& v) { return std::sqrt(Dot(v, v)); }
+    //零向量原样返回
+    inline Vec3 Normalize(const Vec3& v)
+    {
+        float length = Length(v);
+        return length > 0.0f ? v * ( 1.0f / length ) : v;
+    }
+
+    //16字节对齐，四个分量正好是一个Simd::Float4
+    struct alignas(16) Vec4
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        float w = 0.0f;
+
+        Simd::Float4 Load() const { return Simd::Load(&x); }
+        static Vec4  From(Simd::Float4 value)
+        {
+            Vec4 result;
+            Simd::Store(&result.x, value);
+            return result;
+        }
+    };
+
+    inline Vec4 operator+(const Vec4& a , const Vec4& b) { return Vec4::From(Simd::Add(a.Load(), b.Load())); }
+    inline Vec4 operator-(const Vec4& a , const Vec4& b) { return Vec4::From(Simd::Sub(a.Load(), b.Load())); }
+    inline Vec4 operator*(const Vec4& a , const Vec4& b) { return Vec4::From(Simd::Mul(a.Load(), b.Load())); }
+    inline Vec4 operator*(const Vec4& v , float s) { return Vec4::From(Simd::Mul(v.Load(), Simd::Splat(s))); }
+
+    //水平求和在SSE2上并不比标量快，直接按分量相加
+    inline float Dot(const Vec4& a , const Vec4& b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+
+    //单位四元数表示旋转，w是实部
+    struct Quat
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        float w = 1.0f;
+
+        //axis必须是单位向量
+        static Quat FromAxisAngle(const Vec3& axis , float radians)
+        {
+            float s = std::sin(radians * 0.5f);
+            return {axis.x * s, axis.y * s, axis.z * s, std::cos(radians * 0.5f)};
+        }
+    };
+
+    //先应用b的旋转，再应用a的旋转
+    inline Quat operator*(const Quat& a , const Quat& b)
+    {
+        return {a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+                a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+    }
+
+    inline Quat Conjugate(const Quat& q) { return {-q.x, -q.y, -q.z, q.w}; }
+
+    inline Quat Normalize(const Quat& q)
+    {
+        float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+        float scale  = length > 0.0f ? 1.0f / length : 0.0f;
+        return {q.x * scale, q.y * scale, q.z * scale, q.w * scale};
+    }
+
+    //v' = v + w*t + u×t，其中u是虚部，t = 2u×v，比展开成q*v*q⁻¹少一半乘法
+    inline Vec3 Rotate(const Quat& q , const Vec3& v)
+    {
+        Vec3 u = {q.x, q.y, q.z};
+        Vec3 t = Cross(u, v) * 2.0f;
+        return v + t * q.w + Cross(u, t);
+    }
+}
@@ -0,0 +1,25 @@
+﻿#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//设备校准的计算测试：每个调用做固定次数的乘加，结果写回缓冲，防止被编译器当作死代码消除
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 0) writeonly buffer Output {
+    vec4 values[];
+};
+
+layout(push_constant) uniform Params {
+    float seed;
+};
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    vec4 a = vec4(float(index & 255u)) * seed;
+    vec4 b = vec4(seed, 0.5, -seed, 0.25);
+    //每次迭代两个vec4乘加，即8次FMA；迭代次数和Core/DeviceCalibration.cpp中的ComputeIterations一致
+    for (int i = 0; i < 256; i++) {
+        a = a * b + seed;
+        b = b * a - seed;
+    }
+    values[index] = a + b;
+}
\ No newline at end of file
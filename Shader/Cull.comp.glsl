@@ -0,0 +1,68 @@
+﻿#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//GPU视锥剔除：每个调用测试一个物体的包围球，可见物体的编号紧凑地写入可见列表，并把网格唯一一条间接绘制命令的
+//instanceCount加一。命令格式和VkDrawIndexedIndirectCommand相同，见Core/GpuCuller.h
+layout(local_size_x = 64) in;
+
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int  vertexOffset;
+    uint firstInstance;
+};
+
+//整个实例缓冲，各个流的起始位置由push constant给出(以vec2为单位)
+layout(std430, binding = 0) readonly buffer Instances {
+    vec2 instanceData[];
+};
+
+//开头16字节是绘制数量(有可见物体时为1)，vkCmdDrawIndexedIndirectCount从这里读取；
+//计数和命令由CPU每帧重置，instanceCount从0开始。可见列表从第48字节开始，Culled.vert按gl_InstanceIndex读取
+layout(std430, binding = 1) buffer Draws {
+    uint        drawCount;
+    uint        padding0;
+    uint        padding1;
+    uint        padding2;
+    DrawCommand command;
+    uint        padding3;
+    uint        padding4;
+    uint        padding5;
+    uint        visibleIds[];
+};
+
+layout(push_constant) uniform Params {
+    vec4  planes[6];     //(法线, d)，法线已归一化，内侧为正
+    uint  objectCount;
+    uint  offsetBase;    //InstanceData::Offset流的起始位置
+    uint  transformBase; //InstanceData::Transform流的起始位置
+    float meshRadius;    //网格在未缩放时的包围球半径
+};
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= objectCount) {
+        return;
+    }
+
+    //二维实例位于z=0平面，缩放是Transform流的长度
+    vec3  center = vec3(instanceData[offsetBase + index], 0.0);
+    float radius = meshRadius * length(instanceData[transformBase + index]);
+    bool visible = true;
+    for (int i = 0; i < 6; i++) {
+        visible = visible && dot(planes[i].xyz, center) + planes[i].w >= -radius;
+    }
+
+    if (!visible) {
+        return;
+    }
+
+    //原子加法返回的旧值就是这个物体在可见列表中的位置。列表的顺序取决于原子操作的先后，每帧可能不同；
+    //这里的实例互不重叠，绘制顺序不影响结果
+    uint slot = atomicAdd(command.instanceCount, 1u);
+    visibleIds[slot] = index;
+    if (slot == 0u) {
+        drawCount = 1u;
+    }
+}
\ No newline at end of file
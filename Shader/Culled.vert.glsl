@@ -0,0 +1,62 @@
+﻿#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+//GPU剔除路径的顶点着色器：计算和Instanced.vert相同，逐实例数据不经过顶点绑定，
+//而是用gl_InstanceIndex在Cull.comp写出的可见列表中取得物体编号，再从实例缓冲读取这个物体的数据
+
+//逐顶点数据，和Triangle.vert.glsl相同
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+//描述符集0是描述符堆(Textured.frag.glsl使用)，剔除的缓冲在描述符集1。
+//整个实例缓冲，按32位字读取，各个流的起始位置由push constant给出(以字为单位)，格式见Core/InstanceData.h
+layout(std430, set = 1, binding = 0) readonly buffer Instances {
+    uint instanceWords[];
+};
+
+//和Cull.comp的Draws块是同一个缓冲，前48字节是绘制数量和间接绘制命令
+layout(std430, set = 1, binding = 1) readonly buffer Draws {
+    uint header[12];
+    uint visibleIds[];
+};
+
+//push constant的前24字节是片段着色器读取的DrawIndices(Core/DescriptorHeap.h)，流的起始位置在它之后
+layout(push_constant) uniform Params {
+    layout(offset = 24) uint offsetBase;
+    uint transformBase;
+    uint colorBase;
+};
+
+layout(location = 0) out vec3 color;
+layout(location = 1) out vec2 uv; //和Triangle.vert.glsl相同
+layout(location = 2) flat out uint instance; //可见列表中取出的物体编号，不是gl_InstanceIndex
+
+//特化常量和Instanced.vert.glsl相同，取值由管线变体决定(Core/PipelineVariants.h)
+layout(constant_id = 0) const bool ApplyTint = true;
+layout(constant_id = 1) const bool ApplyRotation = true;
+
+vec2 LoadVec2(uint base, uint index) {
+    return uintBitsToFloat(uvec2(instanceWords[base + 2u * index], instanceWords[base + 2u * index + 1u]));
+}
+
+void main() {
+    //间接绘制命令的firstInstance是0，gl_InstanceIndex就是可见列表中的位置
+    uint id = visibleIds[gl_InstanceIndex];
+    vec2 offset = LoadVec2(offsetBase, id);
+    vec2 transform = LoadVec2(transformBase, id); //(cos*scale, sin*scale)
+    //RGBA8，最低字节是R，和VK_FORMAT_R8G8B8A8_UNORM的读取结果相同
+    vec4 tint = unpackUnorm4x8(instanceWords[colorBase + id]);
+
+    vec2 rotated = ApplyRotation
+        ? vec2(inPosition.x * transform.x - inPosition.y * transform.y,
+               inPosition.x * transform.y + inPosition.y * transform.x)
+        : inPosition * length(transform);
+    gl_Position = vec4(rotated + offset, 0.0, 1.0);
+    color = ApplyTint ? inColor * tint.rgb : inColor;
+    uv = inPosition + 0.5;
+    instance = id;
+}
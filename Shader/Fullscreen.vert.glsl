@@ -0,0 +1,15 @@
+﻿#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout(location = 0) out vec3 color;
+
+//不需要顶点缓冲的全屏三角形：顶点(-1,-1)、(3,-1)、(-1,3)覆盖整个视口，用于设备校准的填充率测试
+void main() {
+    vec2 uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+    color = vec3(uv * 0.5, float(gl_InstanceIndex & 1));
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+﻿#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+//逐顶点数据，和Triangle.vert.glsl相同
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+//逐实例数据，格式见Core/InstanceData.h，每个属性来自一个单独的绑定
+layout(location = 2) in vec2 inOffset;
+layout(location = 3) in vec2 inTransform; //(cos*scale, sin*scale)
+layout(location = 4) in vec4 inTint;
+
+layout(location = 0) out vec3 color;
+layout(location = 1) out vec2 uv; //和Triangle.vert.glsl相同，纹理跟随三角形旋转
+layout(location = 2) flat out uint instance; //gl_InstanceIndex包括firstInstance，逐个绘制实例时也是实例编号
+
+//特化常量，取值由管线变体决定(Core/PipelineVariants.h)，驱动编译时按常量折叠掉不用的分支
+layout(constant_id = 0) const bool ApplyTint = true;
+layout(constant_id = 1) const bool ApplyRotation = true;
+
+void main() {
+    //二维旋转加缩放：把inTransform看作复数与顶点位置相乘；关闭旋转时只按它的长度缩放
+    vec2 rotated = ApplyRotation
+        ? vec2(inPosition.x * inTransform.x - inPosition.y * inTransform.y,
+               inPosition.x * inTransform.y + inPosition.y * inTransform.x)
+        : inPosition * length(inTransform);
+    gl_Position = vec4(rotated + inOffset, 0.0, 1.0);
+    color = ApplyTint ? inColor * inTint.rgb : inColor;
+    uv = inPosition + 0.5;
+    instance = gl_InstanceIndex;
+}
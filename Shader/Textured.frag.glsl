@@ -0,0 +1,59 @@
+﻿#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+//描述符堆可用时场景使用的片段着色器：在Triangle.frag.glsl的基础上乘以一张纹理的颜色，
+//纹理和采样器都不绑定到固定的位置，而是用push constant中的索引在描述符堆(Core/DescriptorHeap.h)中查找。
+//有纹理索引表时实例i使用表中第i % textureCount项(流送纹理当前的描述符索引)，否则使用推送的textureIndex
+
+layout(location = 0) in vec3 color;
+layout(location = 1) in vec2 uv;
+layout(location = 2) flat in uint instance;
+
+layout(location = 0) out vec4 outColor;
+
+//描述符堆的三个绑定，数组长度是创建堆时的容量，只有注册过的槽位有有效的描述符。
+//绑定0的存储缓冲在这里只用作纹理索引表
+layout(std430, set = 0, binding = 0) readonly buffer TextureTable {
+    uint textureIds[];
+} tables[];
+layout(set = 0, binding = 1) uniform texture2D textures[];
+layout(set = 0, binding = 2) uniform sampler samplers[];
+
+//和Core/DescriptorHeap.h中的DrawIndices一致，没有使用的索引是0xFFFFFFFF
+layout(push_constant) uniform DrawIndices {
+    uint vertexBuffer;
+    uint instanceBuffer;
+    uint textureIndex;
+    uint samplerIndex;
+    uint textureTable;
+    uint textureCount;
+} indices;
+
+//特化常量和Triangle.frag.glsl相同，取值由管线变体决定(Core/PipelineVariants.h)
+layout(constant_id = 2) const int ColorMode = 0; //0：原色，1：灰度，2：色调分离
+layout(constant_id = 3) const int PosterizeLevels = 4;
+
+const uint InvalidIndex = 0xFFFFFFFFu;
+
+void main() {
+    vec3 result = color;
+    //表的下标来自push constant，一次绘制内相同；查出的纹理索引随实例变化
+    uint textureIndex = indices.textureIndex;
+    if (indices.textureCount != 0u) {
+        textureIndex = tables[indices.textureTable].textureIds[instance % indices.textureCount];
+    }
+    if (textureIndex != InvalidIndex) {
+        //一次实例化绘制中不同实例的像素取到不同的纹理，数组下标要标记为nonuniformEXT，
+        //驱动按不同的值分别访问描述符，否则结果未定义
+        result *= texture(sampler2D(textures[nonuniformEXT(textureIndex)],
+                                    samplers[nonuniformEXT(indices.samplerIndex)]), uv).rgb;
+    }
+    if (ColorMode == 1) {
+        result = vec3(dot(result, vec3(0.2126, 0.7152, 0.0722)));
+    } else if (ColorMode == 2) {
+        float steps = float(PosterizeLevels - 1);
+        result = floor(result * steps + 0.5) / steps;
+    }
+    outColor = vec4(result, 1.0);
+}
\ No newline at end of file
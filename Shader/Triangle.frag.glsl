@@ -5,6 +5,17 @@ layout(location = 0) in vec3 color;
 
 layout(location = 0) out vec4 outColor;
 
+//特化常量，取值由管线变体决定(Core/PipelineVariants.h)
+layout(constant_id = 2) const int ColorMode = 0; //0：原色，1：灰度，2：色调分离
+layout(constant_id = 3) const int PosterizeLevels = 4;
+
 void main() {
-    outColor = vec4(color, 1.0);
+    vec3 result = color;
+    if (ColorMode == 1) {
+        result = vec3(dot(color, vec3(0.2126, 0.7152, 0.0722)));
+    } else if (ColorMode == 2) {
+        float steps = float(PosterizeLevels - 1);
+        result = floor(color * steps + 0.5) / steps;
+    }
+    outColor = vec4(result, 1.0);
 }
\ No newline at end of file
@@ -5,20 +5,19 @@ out gl_PerVertex {
     vec4 gl_Position;
 };
 
-vec2 positions[3] = vec2[](
-                vec2(0.0, -0.5),
-                vec2(0.5, 0.5),
-                vec2(-0.5, 0.5)
-);
-vec3 colors[3] = vec3[](
-                vec3(1.0, 0.0, 0.0),
-                vec3(0.0, 1.0, 0.0),
-                vec3(0.0, 0.0, 1.0)
-);
+//顶点数据由CPU通过顶点缓冲上传，格式见Core/Vertex.h
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
 
 layout(location = 0) out vec3 color;
+//纹理坐标，三角形的包围盒[-0.5, 0.5]映射到[0, 1]，Textured.frag.glsl用它采样
+layout(location = 1) out vec2 uv;
+//实例编号，Textured.frag.glsl用它在纹理索引表中查找这个实例的纹理
+layout(location = 2) flat out uint instance;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    color = colors[gl_VertexIndex];
+    gl_Position = vec4(inPosition, 0.0, 1.0);
+    color = inColor;
+    uv = inPosition + 0.5;
+    instance = gl_InstanceIndex;
 }
\ No newline at end of file
@@ -1,3 +1,2 @@
-﻿C:/VulkanSDK/1.3.296.0/Bin/glslangValidator.exe -V Triangle.vert.glsl
-C:/VulkanSDK/1.3.296.0/Bin/glslangValidator.exe -V Triangle.frag.glsl
+﻿python embed_spirv.py
 pause
\ No newline at end of file
@@ -0,0 +1,120 @@
+"""把Shader/*.glsl编译成SPIR-V，经过spirv-opt优化后生成可以直接编译进程序的C++头文件。
+
+由LearnVulkan.vcxproj的预生成事件调用，也可以手动运行:
+    python embed_spirv.py [--optimize performance|size|none]
+
+输出:
+    Spv/<名称>.spv                  优化后的SPIR-V，供--shader-dir覆盖内嵌着色器时使用
+    Generated/EmbeddedSpirv.h       constexpr uint32_t数组和按名称查找的表
+
+Spv和Generated目录都是构建产物，不提交。编译需要Vulkan SDK中的glslangValidator(构建本项目本来就需要SDK)。
+"""
+
+import argparse
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+SHADER_DIR = Path(__file__).resolve().parent
+SPIRV_MAGIC = 0x07230203
+
+
+def find_tool(name):
+    sdk = os.environ.get("VULKAN_SDK")
+    if sdk:
+        for folder in ("Bin", "bin"):
+            for candidate in (name, name + ".exe"):
+                path = Path(sdk) / folder / candidate
+                if path.is_file():
+                    return str(path)
+    return shutil.which(name)
+
+
+def compile_shader(compiler, optimizer, optimize, source, output):
+    """编译并优化一个着色器，结果写到output"""
+    # Triangle.vert.glsl -> 阶段为vert
+    stage = source.suffixes[-2].lstrip(".")
+    with tempfile.TemporaryDirectory() as temp:
+        unoptimized = Path(temp) / "unoptimized.spv"
+        subprocess.run([compiler, "-V", "-S", stage, "-o", str(unoptimized), str(source)], check=True)
+        if optimizer is None or optimize == "none":
+            shutil.copyfile(unoptimized, output)
+        else:
+            # -O偏向运行性能，-Os偏向代码体积；两者都会去掉调试信息和死代码
+            flag = "-O" if optimize == "performance" else "-Os"
+            subprocess.run([optimizer, flag, str(unoptimized), "-o", str(output)], check=True)
+
+
+def read_words(path):
+    data = path.read_bytes()
+    if len(data) == 0 or len(data) % 4 != 0:
+        sys.exit(f"{path}: SPIR-V的长度必须是4的非零倍数")
+    words = struct.unpack(f"<{len(data) // 4}I", data)
+    if words[0] != SPIRV_MAGIC:
+        sys.exit(f"{path}: 缺少SPIR-V魔数")
+    return words
+
+
+def generate_header(shaders):
+    lines = [
+        "// 由Shader/embed_spirv.py生成，不要手动修改",
+        "#pragma once",
+        "",
+        "namespace EmbeddedSpirv",
+        "{",
+    ]
+    for name, words in shaders:
+        symbol = name.replace(".", "_")
+        lines.append(f"    alignas(4) inline constexpr uint32_t {symbol}[] = {{")
+        for i in range(0, len(words), 8):
+            lines.append("        " + ", ".join(f"0x{word:08x}" for word in words[i:i + 8]) + ",")
+        lines.append("    };")
+        lines.append("")
+    lines.append("    inline constexpr EmbeddedShader Table[] = {")
+    for name, _ in shaders:
+        lines.append(f'        {{"{name}", {name.replace(".", "_")}}},')
+    lines.append("    };")
+    lines.append("}")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--optimize", choices=("performance", "size", "none"), default="performance")
+    parser.add_argument("--output", type=Path, default=SHADER_DIR / "Generated" / "EmbeddedSpirv.h")
+    args = parser.parse_args()
+
+    compiler = find_tool("glslangValidator")
+    optimizer = find_tool("spirv-opt")
+    if compiler is None:
+        sys.exit("embed_spirv: 找不到glslangValidator，请安装Vulkan SDK并设置VULKAN_SDK环境变量")
+    if optimizer is None and args.optimize != "none":
+        print("embed_spirv: 找不到spirv-opt，跳过优化")
+
+    sources = sorted(SHADER_DIR.glob("*.glsl"))
+    if not sources:
+        sys.exit("embed_spirv: 没有找到着色器")
+
+    spv_dir = SHADER_DIR / "Spv"
+    spv_dir.mkdir(exist_ok=True)
+    shaders = []
+    for source in sources:
+        name = source.name[:-len(".glsl")]
+        spv = spv_dir / (name + ".spv")
+        compile_shader(compiler, optimizer, args.optimize, source, spv)
+        shaders.append((name, read_words(spv)))
+
+    # 内容没有变化时不改写文件，避免触发不必要的重新编译
+    header = generate_header(shaders)
+    args.output.parent.mkdir(parents=True, exist_ok=True)
+    if not args.output.is_file() or args.output.read_text(encoding="utf-8-sig") != header:
+        args.output.write_text(header, encoding="utf-8-sig")
+        print(f"embed_spirv: 生成{args.output}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,70 @@
+﻿#include "FrameTimer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+FrameTimer::FrameTimer(double reportIntervalSeconds)
+    : m_ReportInterval(reportIntervalSeconds)
+{
+}
+
+void FrameTimer::Tick()
+{
+    auto now    = Clock::now();
+    m_HasReport = false;
+
+    if (!m_Started)
+    {
+        m_Started     = true;
+        m_FirstTick   = now;
+        m_LastTick    = now;
+        m_WindowStart = now;
+        return;
+    }
+
+    double frameMs = std::chrono::duration<double, std::milli>(now - m_LastTick).count();
+    m_LastTick     = now;
+    m_TotalFrames++;
+
+    if (m_WindowFrames == 0)
+    {
+        m_WindowMinMs = frameMs;
+        m_WindowMaxMs = frameMs;
+    }
+    m_WindowMinMs = std::min(m_WindowMinMs, frameMs);
+    m_WindowMaxMs = std::max(m_WindowMaxMs, frameMs);
+    m_WindowFrames++;
+
+    double windowSeconds = std::chrono::duration<double>(now - m_WindowStart).count();
+    if (windowSeconds >= m_ReportInterval)
+    {
+        m_Fps       = m_WindowFrames / windowSeconds;
+        m_AverageMs = windowSeconds * 1000.0 / m_WindowFrames;
+        m_MinMs     = m_WindowMinMs;
+        m_MaxMs     = m_WindowMaxMs;
+        m_HasReport = true;
+
+        m_WindowFrames = 0;
+        m_WindowStart  = now;
+    }
+}
+
+std::string FrameTimer::Report() const
+{
+    char buffer[128];
+    std::snprintf(buffer, sizeof(buffer), "%.1f fps | %.3f ms (min %.3f / max %.3f)",
+                  m_Fps, m_AverageMs, m_MinMs, m_MaxMs);
+    return buffer;
+}
+
+std::string FrameTimer::Summary() const
+{
+    double seconds = std::chrono::duration<double>(m_LastTick - m_FirstTick).count();
+    double fps     = seconds > 0.0 ? m_TotalFrames / seconds : 0.0;
+    double frameMs = m_TotalFrames > 0 ? seconds * 1000.0 / m_TotalFrames : 0.0;
+
+    char buffer[128];
+    std::snprintf(buffer, sizeof(buffer), "%llu frames in %.3f s | %.1f fps | %.3f ms",
+                  static_cast<unsigned long long>(m_TotalFrames), seconds, fps, frameMs);
+    return buffer;
+}
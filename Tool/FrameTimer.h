@@ -0,0 +1,46 @@
+﻿#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+//统计帧率与帧时间。每帧调用一次Tick，累计满一个报告周期后HasReport返回true
+class FrameTimer
+{
+public:
+    explicit FrameTimer(double reportIntervalSeconds = 1.0);
+
+    void Tick();
+
+    bool        HasReport() const { return m_HasReport; }
+    std::string Report() const;
+    //从第一帧到现在的总体统计
+    std::string Summary() const;
+
+    double   Fps() const { return m_Fps; }
+    double   AverageFrameMs() const { return m_AverageMs; }
+    double   MinFrameMs() const { return m_MinMs; }
+    double   MaxFrameMs() const { return m_MaxMs; }
+    uint64_t TotalFrames() const { return m_TotalFrames; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    double            m_ReportInterval;
+    Clock::time_point m_FirstTick;
+    Clock::time_point m_LastTick;
+    Clock::time_point m_WindowStart;
+    bool              m_Started   = false;
+    bool              m_HasReport = false;
+
+    //当前统计窗口内的累计值
+    uint32_t m_WindowFrames = 0;
+    double   m_WindowMinMs  = 0.0;
+    double   m_WindowMaxMs  = 0.0;
+    uint64_t m_TotalFrames  = 0;
+
+    //上一个统计窗口的结果
+    double m_Fps       = 0.0;
+    double m_AverageMs = 0.0;
+    double m_MinMs     = 0.0;
+    double m_MaxMs     = 0.0;
+};
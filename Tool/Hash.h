@@ -0,0 +1,22 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace Hash
+{
+    constexpr uint64_t Fnv1aOffsetBasis = 14695981039346656037ull;
+    constexpr uint64_t Fnv1aPrime       = 1099511628211ull;
+
+    //FNV-1a 64位哈希，用于校验磁盘缓存和按内容区分数据块，不用于安全场景
+    inline uint64_t Fnv1a(const void* data , size_t size , uint64_t seed = Fnv1aOffsetBasis)
+    {
+        auto     bytes = static_cast<const uint8_t*>(data);
+        uint64_t hash  = seed;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= Fnv1aPrime;
+        }
+        return hash;
+    }
+}
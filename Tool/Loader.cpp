@@ -20,3 +20,8 @@ std::vector<char> Loader::ReadFile(const std::string& filename)
 
     return buffer;
 }
+
+MappedFile Loader::MapFile(const std::string& filename)
+{
+    return MappedFile(filename);
+}
@@ -5,8 +5,12 @@
 #include <string>
 #include <vector>
 
+#include "MappedFile.h"
+
 class Loader
 {
 public:
     static std::vector<char> ReadFile(const std::string& filename);
+    //不拷贝文件内容，返回只读的内存映射，适合大量读取SPIR-V这样的只读数据
+    static MappedFile MapFile(const std::string& filename);
 };
@@ -0,0 +1,144 @@
+﻿#include "MappedFile.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& filename)
+{
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        throw std::runtime_error("Failed to get file size: " + filename);
+    }
+    m_Size = static_cast<size_t>(size.QuadPart);
+
+    //长度为0的文件无法创建映射，当作空文件返回
+    if (m_Size != 0)
+    {
+        m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_Mapping != nullptr)
+        {
+            m_Data = static_cast<const std::byte*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+    }
+    //映射对象持有文件的引用，文件句柄可以立即关闭
+    CloseHandle(file);
+
+    if (m_Size != 0 && m_Data == nullptr)
+    {
+        Close();
+        throw std::runtime_error("Failed to map file: " + filename);
+    }
+}
+
+void MappedFile::Close()
+{
+    if (m_Data != nullptr)
+    {
+        UnmapViewOfFile(m_Data);
+    }
+    if (m_Mapping != nullptr)
+    {
+        CloseHandle(m_Mapping);
+    }
+    m_Data    = nullptr;
+    m_Mapping = nullptr;
+    m_Size    = 0;
+}
+#else
+MappedFile::MappedFile(const std::string& filename)
+{
+    //只做open和fstat两次系统调用，不再先exists再file_size
+    int file = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+    {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+
+    struct stat status = {};
+    if (fstat(file, &status) != 0)
+    {
+        close(file);
+        throw std::runtime_error("Failed to get file size: " + filename);
+    }
+    m_Size = static_cast<size_t>(status.st_size);
+
+    if (m_Size != 0)
+    {
+        void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED)
+        {
+            close(file);
+            m_Size = 0;
+            throw std::runtime_error("Failed to map file: " + filename);
+        }
+        m_Data = static_cast<const std::byte*>(data);
+    }
+    //映射建立后文件描述符就不再需要了
+    close(file);
+}
+
+void MappedFile::Close()
+{
+    if (m_Data != nullptr)
+    {
+        munmap(const_cast<std::byte*>(m_Data), m_Size);
+    }
+    m_Data = nullptr;
+    m_Size = 0;
+}
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        m_Data = std::exchange(other.m_Data, nullptr);
+        m_Size = std::exchange(other.m_Size, 0);
+#ifdef _WIN32
+        m_Mapping = std::exchange(other.m_Mapping, nullptr);
+#endif
+    }
+    return *this;
+}
+
+std::span<const uint32_t> MappedFile::Words() const
+{
+    if (m_Size % sizeof(uint32_t) != 0)
+    {
+        throw std::runtime_error("File size is not a multiple of 4 bytes");
+    }
+    //映射地址按页对齐，满足uint32_t的对齐要求
+    return {reinterpret_cast<const uint32_t*>(m_Data), m_Size / sizeof(uint32_t)};
+}
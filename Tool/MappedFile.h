@@ -0,0 +1,39 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+//只读的内存映射文件。
+//文件内容直接映射进进程地址空间，不经过read拷贝，页面在第一次访问时才由操作系统调入。
+//映射的起始地址按页对齐，所以可以安全地当作uint32_t数组读取(SPIR-V要求4字节对齐)。
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    //打开失败时抛出std::runtime_error
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    const std::byte* Data() const { return m_Data; }
+    size_t           Size() const { return m_Size; }
+    bool             Empty() const { return m_Size == 0; }
+
+    std::span<const std::byte> Bytes() const { return {m_Data, m_Size}; }
+    //按32位字访问，文件长度不是4的倍数时抛出异常
+    std::span<const uint32_t> Words() const;
+
+private:
+    void Close();
+
+    const std::byte* m_Data = nullptr;
+    size_t           m_Size = 0;
+#ifdef _WIN32
+    void* m_Mapping = nullptr;
+#endif
+};
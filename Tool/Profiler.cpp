@@ -0,0 +1,189 @@
+﻿#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::time_point Epoch = Clock::now();
+
+    //导出时写入方可能正在覆盖同一个槽位，字段用relaxed原子变量读写，避免数据竞争；
+    //在x86和ARM上relaxed的读写就是普通的mov/ldr，不比普通字段慢
+    struct Slot
+    {
+        std::atomic<const char*> name;
+        std::atomic<uint64_t>    startNs;
+        std::atomic<uint64_t>    durationNs;
+    };
+
+    //一个线程独占的环形缓冲，只有所属线程写入
+    struct ThreadBuffer
+    {
+        std::unique_ptr<Slot[]> slots = std::make_unique<Slot[]>(Profiler::Capacity);
+        std::atomic<uint64_t>   head  = 0;
+        uint32_t                threadId;
+        std::string             name;
+    };
+
+    //登记表只在线程第一次记录和导出时加锁。线程退出后缓冲仍然保留，导出时还能看到它的区间
+    std::mutex                                 g_RegistryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> g_Buffers;
+
+    thread_local ThreadBuffer* t_Buffer = nullptr;
+
+    ThreadBuffer& LocalBuffer()
+    {
+        if (t_Buffer == nullptr)
+        {
+            std::lock_guard lock(g_RegistryMutex);
+            auto            buffer = std::make_unique<ThreadBuffer>();
+            buffer->threadId       = static_cast<uint32_t>(g_Buffers.size()) + 1;
+            buffer->name           = "Thread " + std::to_string(buffer->threadId);
+            t_Buffer               = buffer.get();
+            g_Buffers.push_back(std::move(buffer));
+        }
+        return *t_Buffer;
+    }
+
+    void WriteEscaped(std::ostream& out , const char* text)
+    {
+        for (; *text != '\0'; text++)
+        {
+            char c = *text;
+            if (c == '"' || c == '\\')
+            {
+                out << '\\' << c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out << escaped;
+            }
+            else
+            {
+                out << c;
+            }
+        }
+    }
+
+    void WriteEvents(std::ostream& out , const std::vector<TraceEvent>& events , uint32_t processId , bool& first)
+    {
+        //Chrome trace的时间单位是微秒，保留小数以显示纳秒精度
+        char numbers[96];
+        for (const TraceEvent& event : events)
+        {
+            out << ( first ? "\n" : ",\n" ) << R"({"ph":"X","name":")";
+            WriteEscaped(out, event.name);
+            std::snprintf(numbers, sizeof(numbers), R"(","pid":%u,"tid":%u,"ts":%.3f,"dur":%.3f})", processId,
+                          event.threadId, event.startNs / 1000.0, event.durationNs / 1000.0);
+            out << numbers;
+            first = false;
+        }
+    }
+
+    void WriteMetadata(std::ostream& out , const char* kind , uint32_t processId , uint32_t threadId ,
+                       const std::string& name , bool& first)
+    {
+        out << ( first ? "\n" : ",\n" ) << R"({"ph":"M","name":")" << kind << R"(","pid":)" << processId
+                << R"(,"tid":)" << threadId << R"(,"args":{"name":")";
+        WriteEscaped(out, name.c_str());
+        out << "\"}}";
+        first = false;
+    }
+}
+
+namespace Profiler
+{
+    void SetEnabled(bool enabled)
+    {
+        Detail::Enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    uint64_t NowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - Epoch).count();
+    }
+
+    void SetThreadName(const std::string& name)
+    {
+        ThreadBuffer&   buffer = LocalBuffer();
+        std::lock_guard lock(g_RegistryMutex);
+        buffer.name = name;
+    }
+
+    void Record(const char* name , uint64_t startNs , uint64_t endNs)
+    {
+        ThreadBuffer& buffer = LocalBuffer();
+        //只有本线程写head，普通读即可；先写槽位再发布新的head
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        Slot&    slot = buffer.slots[head & ( Capacity - 1 )];
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.startNs.store(startNs, std::memory_order_relaxed);
+        slot.durationNs.store(endNs - startNs, std::memory_order_relaxed);
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    std::vector<TraceEvent> CollectCpuEvents()
+    {
+        std::vector<TraceEvent> events;
+        std::lock_guard         lock(g_RegistryMutex);
+        for (const auto& buffer : g_Buffers)
+        {
+            uint64_t head  = buffer->head.load(std::memory_order_acquire);
+            uint64_t first = head > Capacity ? head - Capacity : 0;
+
+            size_t begin = events.size();
+            for (uint64_t i = first; i < head; i++)
+            {
+                const Slot& slot = buffer->slots[i & ( Capacity - 1 )];
+                events.push_back({
+                    slot.name.load(std::memory_order_relaxed), slot.startNs.load(std::memory_order_relaxed),
+                    slot.durationNs.load(std::memory_order_relaxed), buffer->threadId
+                });
+            }
+
+            //复制期间写入方可能已经绕回来覆盖了最旧的槽位(包括正在写、还没发布的那一个)，这些区间丢弃
+            uint64_t newHead    = buffer->head.load(std::memory_order_acquire);
+            uint64_t validFirst = newHead + 1 > Capacity ? newHead + 1 - Capacity : 0;
+            if (validFirst > first)
+            {
+                size_t overwritten = static_cast<size_t>(std::min(validFirst, head) - first);
+                events.erase(events.begin() + begin, events.begin() + begin + overwritten);
+            }
+        }
+        return events;
+    }
+
+    bool WriteChromeTrace(const std::string& path , const std::vector<TraceEvent>& gpuEvents)
+    {
+        constexpr uint32_t CpuProcess = 1;
+        constexpr uint32_t GpuProcess = 2;
+
+        std::vector<TraceEvent> cpuEvents = CollectCpuEvents();
+
+        std::ofstream out(path, std::ios::trunc);
+        bool          first = true;
+        out << R"({"displayTimeUnit":"ms","traceEvents":[)";
+        WriteMetadata(out, "process_name", CpuProcess, 0, "CPU", first);
+        WriteMetadata(out, "process_name", GpuProcess, 0, "GPU", first);
+        WriteMetadata(out, "thread_name", GpuProcess, 0, "Graphics queue", first);
+        {
+            std::lock_guard lock(g_RegistryMutex);
+            for (const auto& buffer : g_Buffers)
+            {
+                WriteMetadata(out, "thread_name", CpuProcess, buffer->threadId, buffer->name, first);
+            }
+        }
+        WriteEvents(out, cpuEvents, CpuProcess, first);
+        WriteEvents(out, gpuEvents, GpuProcess, first);
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+}
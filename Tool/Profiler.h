@@ -0,0 +1,86 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//编译期开关：定义ENABLE_PROFILER=0时PROFILE_SCOPE展开为空语句，计时代码完全不会编译进程序。
+//默认打开：不指定--profile时每个区间只多一次原子读，可以留在发布版本中
+#ifndef ENABLE_PROFILER
+#define ENABLE_PROFILER 1
+#endif
+
+//时间线上的一段区间，时间以纳秒计，起点是程序启动
+struct TraceEvent
+{
+    const char* name;       //只保存指针，必须是字符串字面量之类生命周期足够长的字符串
+    uint64_t    startNs;
+    uint64_t    durationNs;
+    uint32_t    threadId;
+};
+
+/*
+ * CPU区间性能分析。
+ * 每个线程第一次记录时登记一个自己独占的环形缓冲，之后记录只写本线程的缓冲，不加锁也没有原子读改写：
+ * 写入槽位后用release语义更新头部位置，读取方用acquire读头部，再丢弃复制期间可能被覆盖的旧槽位。
+ * 缓冲写满后覆盖最旧的区间，导出的总是每个线程最近的Capacity个区间。
+ */
+namespace Profiler
+{
+    //每个线程保留的区间数
+    static constexpr uint32_t Capacity = 1u << 16;
+
+    namespace Detail
+    {
+        inline std::atomic<bool> Enabled = false;
+    }
+
+    //运行时开关，默认关闭
+    inline bool Enabled() { return Detail::Enabled.load(std::memory_order_relaxed); }
+    void        SetEnabled(bool enabled);
+
+    uint64_t NowNs();
+    //给当前线程命名，显示在导出的时间线上
+    void SetThreadName(const std::string& name);
+    void Record(const char* name , uint64_t startNs , uint64_t endNs);
+
+    //复制所有线程当前缓冲中的区间，可以在其它线程仍在记录时调用
+    std::vector<TraceEvent> CollectCpuEvents();
+
+    //把CPU区间和gpuEvents导出为Chrome trace JSON，可以用chrome://tracing或ui.perfetto.dev打开
+    bool WriteChromeTrace(const std::string& path , const std::vector<TraceEvent>& gpuEvents);
+
+    //作用域计时：构造时记下开始时间，析构时记录整个区间
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name)
+            : m_Name(Enabled() ? name : nullptr) , m_StartNs(m_Name != nullptr ? NowNs() : 0)
+        {
+        }
+
+        ~Scope()
+        {
+            if (m_Name != nullptr)
+            {
+                Record(m_Name, m_StartNs, NowNs());
+            }
+        }
+
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* m_Name;
+        uint64_t    m_StartNs;
+    };
+}
+
+#define PROFILER_CONCAT_INNER(a , b) a##b
+#define PROFILER_CONCAT(a , b) PROFILER_CONCAT_INNER(a, b)
+
+#if ENABLE_PROFILER
+#define PROFILE_SCOPE(name) ::Profiler::Scope PROFILER_CONCAT(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
@@ -0,0 +1,42 @@
+﻿#include "RingAllocator.h"
+
+#include <stdexcept>
+
+std::optional<uint64_t> RingAllocator::Allocate(uint64_t size , uint64_t alignment)
+{
+    if (alignment == 0) alignment = 1;
+    if (m_Capacity == 0 || size > m_Capacity) return std::nullopt;
+
+    uint64_t offset  = m_Head % m_Capacity;
+    uint64_t aligned = ( offset + alignment - 1 ) / alignment * alignment;
+    uint64_t newHead;
+    if (aligned + size <= m_Capacity)
+    {
+        newHead = m_Head + ( aligned - offset ) + size;
+    }
+    else
+    {
+        //回绕到开头，尾部剩下的空间作为填充一起占用
+        aligned = 0;
+        newHead = m_Head + ( m_Capacity - offset ) + size;
+    }
+
+    if (newHead - m_Tail > m_Capacity) return std::nullopt;
+    m_Head = newHead;
+    return aligned;
+}
+
+void RingAllocator::ReleaseUpTo(uint64_t marker)
+{
+    if (marker < m_Tail || marker > m_Head)
+    {
+        throw std::runtime_error("RingAllocator: release marker out of range");
+    }
+    m_Tail = marker;
+}
+
+void RingAllocator::Reset()
+{
+    m_Head = 0;
+    m_Tail = 0;
+}
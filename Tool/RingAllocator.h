@@ -0,0 +1,33 @@
+﻿#pragma once
+#include <cstdint>
+#include <optional>
+
+/*
+ * 线性/环形偏移量分配器。
+ * 分配只是移动头指针；位置用单调递增的64位计数表示，对容量取模得到偏移量。
+ * 线性用法：一直分配，用完后Reset一次性释放全部。
+ * 环形用法：记录每一帧结束时的Head()，等这一帧的GPU工作完成后ReleaseUpTo(该位置)，按先进先出的顺序回收。
+ */
+class RingAllocator
+{
+public:
+    explicit RingAllocator(uint64_t capacity = 0)
+        : m_Capacity(capacity) {}
+
+    //空间不足时返回空。尾部放不下时跳到开头，跳过的部分同样要等释放
+    std::optional<uint64_t> Allocate(uint64_t size , uint64_t alignment = 1);
+
+    //当前头部位置，作为ReleaseUpTo的标记
+    uint64_t Head() const { return m_Head; }
+    //释放标记之前的全部分配
+    void ReleaseUpTo(uint64_t marker);
+    void Reset();
+
+    uint64_t Capacity() const { return m_Capacity; }
+    uint64_t UsedBytes() const { return m_Head - m_Tail; }
+
+private:
+    uint64_t m_Capacity;
+    uint64_t m_Head = 0;
+    uint64_t m_Tail = 0;
+};
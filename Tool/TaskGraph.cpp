@@ -0,0 +1,189 @@
+﻿#include "TaskGraph.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+
+#include "Profiler.h"
+
+TaskGraph::TaskId TaskGraph::Add(std::string name , std::function<void()> work , std::vector<TaskId> dependencies ,
+                                 bool        mainThread)
+{
+    TaskId id = static_cast<TaskId>(m_Tasks.size());
+    for (TaskId dependency : dependencies)
+    {
+        if (dependency >= id)
+        {
+            throw std::runtime_error("TaskGraph: 任务只能依赖先添加的任务: " + name);
+        }
+        m_Tasks[dependency].dependents.push_back(id);
+    }
+
+    Task task         = {};
+    task.name         = std::move(name);
+    task.work         = std::move(work);
+    task.dependencies = std::move(dependencies);
+    task.mainThread   = mainThread;
+    m_Tasks.push_back(std::move(task));
+    return id;
+}
+
+void TaskGraph::Execute(Task& task , std::chrono::steady_clock::time_point start)
+{
+    using Clock  = std::chrono::steady_clock;
+    task.startMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    try
+    {
+        task.work();
+    }
+    catch (...)
+    {
+        task.error = std::current_exception();
+    }
+    task.endMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void TaskGraph::Run(ThreadPool& pool)
+{
+    PROFILE_SCOPE("TaskGraph::Run");
+    auto start = std::chrono::steady_clock::now();
+
+    //以下状态都由mutex保护。任务完成后由执行它的线程释放后继任务，
+    //主线程正在执行一个主线程任务时，工作线程上的依赖链不必等它
+    std::mutex              mutex;
+    std::condition_variable wakeMain;
+    std::vector<size_t>     remaining(m_Tasks.size());
+    std::deque<TaskId>      readyOnMain;
+    size_t                  done    = 0;
+    size_t                  running = 0; //已交给线程池、还没完成的任务数
+    std::exception_ptr      error;
+
+    std::function<void(TaskId)> launch;
+    //任务完成后调用，调用者持有锁：记录异常，出错后不再释放后继任务
+    auto complete = [&](TaskId id)
+    {
+        done++;
+        if (m_Tasks[id].error && !error)
+        {
+            error = m_Tasks[id].error;
+        }
+        if (!error)
+        {
+            for (TaskId dependent : m_Tasks[id].dependents)
+            {
+                if (--remaining[dependent] == 0)
+                {
+                    launch(dependent);
+                }
+            }
+        }
+        wakeMain.notify_one();
+    };
+    launch = [&](TaskId id)
+    {
+        if (m_Tasks[id].mainThread)
+        {
+            readyOnMain.push_back(id);
+            return;
+        }
+        running++;
+        pool.Submit(0, [&, id]()
+        {
+            Execute(m_Tasks[id], start);
+            std::lock_guard lock(mutex);
+            running--;
+            complete(id);
+        });
+    };
+
+    std::unique_lock lock(mutex);
+    for (TaskId id = 0; id < m_Tasks.size(); id++)
+    {
+        remaining[id] = m_Tasks[id].dependencies.size();
+        if (remaining[id] == 0)
+        {
+            launch(id);
+        }
+    }
+
+    //图无环，没出错时未完成的任务要么正在执行，要么在readyOnMain中，等待一定能结束。
+    //出错后也要等已提交的任务结束，它们引用着这里的局部变量
+    while (true)
+    {
+        wakeMain.wait(lock, [&]()
+        {
+            return error ? running == 0 : ( done == m_Tasks.size() || !readyOnMain.empty() );
+        });
+        if (error || done == m_Tasks.size()) break;
+
+        TaskId id = readyOnMain.front();
+        readyOnMain.pop_front();
+        lock.unlock();
+        Execute(m_Tasks[id], start);
+        lock.lock();
+        complete(id);
+    }
+    lock.unlock();
+
+    m_WallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+std::string TaskGraph::Report() const
+{
+    std::vector<TaskId> order(m_Tasks.size());
+    double              totalMs = 0.0;
+    for (TaskId id = 0; id < m_Tasks.size(); id++)
+    {
+        order[id] = id;
+        totalMs += DurationMs(id);
+    }
+    std::sort(order.begin(), order.end(), [&](TaskId a , TaskId b) { return m_Tasks[a].startMs < m_Tasks[b].startMs; });
+
+    char        line[160];
+    std::string report;
+    std::snprintf(line, sizeof(line), "task graph: %zu tasks, wall %.2f ms, task sum %.2f ms (%.2fx overlap)\n",
+                  m_Tasks.size(), m_WallMs, totalMs, m_WallMs > 0.0 ? totalMs / m_WallMs : 0.0);
+    report += line;
+    report += "  task                        |  start ms |     ms | thread\n";
+    for (TaskId id : order)
+    {
+        const Task& task = m_Tasks[id];
+        std::snprintf(line, sizeof(line), "  %-27s | %9.2f | %6.2f | %s\n", task.name.c_str(), task.startMs,
+                      DurationMs(id), task.mainThread ? "main" : "worker");
+        report += line;
+    }
+
+    //关键路径：从最后结束的任务出发，每次回到结束得最晚的依赖，缩短这条路径上的任务才能缩短启动时间
+    if (!m_Tasks.empty())
+    {
+        TaskId current = *std::max_element(order.begin(), order.end(), [&](TaskId a , TaskId b)
+        {
+            return m_Tasks[a].endMs < m_Tasks[b].endMs;
+        });
+        std::vector<TaskId> path = {current};
+        while (!m_Tasks[current].dependencies.empty())
+        {
+            const auto& dependencies = m_Tasks[current].dependencies;
+            current = *std::max_element(dependencies.begin(), dependencies.end(), [&](TaskId a , TaskId b)
+            {
+                return m_Tasks[a].endMs < m_Tasks[b].endMs;
+            });
+            path.push_back(current);
+        }
+
+        report += "  critical path:";
+        for (auto it = path.rbegin(); it != path.rend(); ++it)
+        {
+            report += ( it == path.rbegin() ? " " : " -> " ) + m_Tasks[*it].name;
+        }
+        report += '\n';
+    }
+    return report;
+}
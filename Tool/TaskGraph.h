@@ -0,0 +1,52 @@
+﻿#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+
+/*
+ * 一次性执行的小型依赖任务图，用于并行化启动流程。
+ * 任务只能依赖先添加的任务，所以图一定无环。没有依赖关系的任务在线程池上并发执行；
+ * 标记为mainThread的任务只在调用Run的线程上执行，用于只能在主线程调用的API(例如GLFW的窗口函数)。
+ * 任务完成后由执行它的线程释放后继任务：工作线程任务直接提交给线程池，主线程任务排队等主线程取走。
+ * 任何任务抛出异常后不再启动新任务，等正在执行的任务结束后，在主线程重新抛出第一个异常。
+ */
+class TaskGraph
+{
+public:
+    using TaskId = uint32_t;
+
+    TaskId Add(std::string name , std::function<void()> work , std::vector<TaskId> dependencies = {} ,
+               bool        mainThread = false);
+
+    //阻塞直到全部任务完成
+    void Run(ThreadPool& pool);
+
+    double DurationMs(TaskId task) const { return m_Tasks[task].endMs - m_Tasks[task].startMs; }
+    double WallMs() const { return m_WallMs; }
+    //按开始时间列出每个任务的开始时刻、耗时和执行线程，最后给出关键路径
+    std::string Report() const;
+
+private:
+    struct Task
+    {
+        std::string           name;
+        std::function<void()> work;
+        std::vector<TaskId>   dependencies;
+        std::vector<TaskId>   dependents;
+        bool                  mainThread = false;
+
+        //相对Run开始的时刻，由执行任务的线程写入，完成时随互斥量对其它线程可见
+        double             startMs = 0.0;
+        double             endMs   = 0.0;
+        std::exception_ptr error;
+    };
+
+    void Execute(Task& task , std::chrono::steady_clock::time_point start);
+
+    std::vector<Task> m_Tasks;
+    double            m_WallMs = 0.0;
+};
@@ -0,0 +1,72 @@
+﻿#include "ThreadPool.h"
+
+#include <algorithm>
+#include <string>
+
+#include "Profiler.h"
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    threadCount = std::max(threadCount, 1u);
+    m_Workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    //析构前先把已提交的任务执行完，任务返回的future不会因为线程池销毁而失效
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_TaskAvailable.notify_all();
+    for (auto& worker : m_Workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::WaitIdle()
+{
+    std::unique_lock lock(m_Mutex);
+    m_Idle.wait(lock, [this]() { return m_Tasks.empty() && m_Running == 0; });
+}
+
+uint32_t ThreadPool::DefaultThreadCount()
+{
+    uint32_t cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 1;
+}
+
+void ThreadPool::WorkerLoop(uint32_t index)
+{
+    Profiler::SetThreadName("Worker " + std::to_string(index));
+    while (true)
+    {
+        Task task;
+        {
+            std::unique_lock lock(m_Mutex);
+            m_TaskAvailable.wait(lock, [this]() { return m_Stopping || !m_Tasks.empty(); });
+            if (m_Tasks.empty()) return;
+
+            task = m_Tasks.top();
+            m_Tasks.pop();
+            m_Running++;
+        }
+
+        //异常由packaged_task保存到future中，不会逃出工作线程
+        task.run();
+
+        {
+            std::lock_guard lock(m_Mutex);
+            m_Running--;
+            if (m_Running == 0 && m_Tasks.empty())
+            {
+                m_Idle.notify_all();
+            }
+        }
+    }
+}
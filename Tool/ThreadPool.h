@@ -0,0 +1,74 @@
+﻿#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//固定数量工作线程的线程池。任务按优先级出队，优先级相同时先提交的先执行
+class ThreadPool
+{
+public:
+    explicit ThreadPool(uint32_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //提交任务，返回的future可以取得任务的返回值或抛出的异常
+    template <typename F>
+    auto Submit(int priority , F&& function) -> std::future<std::invoke_result_t<F>>
+    {
+        using Result = std::invoke_result_t<F>;
+        //packaged_task只能移动，而std::function要求可复制，所以放进shared_ptr里
+        auto task   = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+        auto future = task->get_future();
+        {
+            std::lock_guard lock(m_Mutex);
+            m_Tasks.push({priority, m_NextSequence++, [task]() { ( *task )(); }});
+        }
+        m_TaskAvailable.notify_one();
+        return future;
+    }
+
+    //阻塞直到队列为空且没有正在执行的任务
+    void WaitIdle();
+
+    uint32_t ThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+    //默认线程数：留一个核心给主线程
+    static uint32_t DefaultThreadCount();
+
+private:
+    struct Task
+    {
+        int                   priority;
+        uint64_t              sequence;
+        std::function<void()> run;
+    };
+
+    struct TaskOrder
+    {
+        bool operator()(const Task& a , const Task& b) const
+        {
+            if (a.priority != b.priority) return a.priority < b.priority;
+            return a.sequence > b.sequence;
+        }
+    };
+
+    void WorkerLoop(uint32_t index);
+
+    std::vector<std::thread>                                m_Workers;
+    std::priority_queue<Task, std::vector<Task>, TaskOrder> m_Tasks;
+    std::mutex                                              m_Mutex;
+    std::condition_variable                                 m_TaskAvailable;
+    std::condition_variable                                 m_Idle;
+    uint64_t                                                m_NextSequence = 0;
+    uint32_t                                                m_Running      = 0;
+    bool                                                    m_Stopping     = false;
+};
@@ -0,0 +1,224 @@
+﻿#include "TlsfAllocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+TlsfAllocator::TlsfAllocator(uint64_t capacity)
+    : m_Capacity(capacity)
+{
+    std::fill(&m_Heads[0][0], &m_Heads[0][0] + FlCount * SlCount, None);
+    if (capacity != 0)
+    {
+        InsertFree(NewNode(0, capacity));
+    }
+}
+
+void TlsfAllocator::MappingInsert(uint64_t size , uint32_t& fl , uint32_t& sl)
+{
+    //小于SlCount的大小全部放进第0级，按字节精确区分
+    if (size < SlCount)
+    {
+        fl = 0;
+        sl = static_cast<uint32_t>(size);
+        return;
+    }
+    uint32_t msb = static_cast<uint32_t>(std::bit_width(size)) - 1;
+    sl           = static_cast<uint32_t>(size >> ( msb - SlLog2 )) ^ SlCount;
+    fl           = msb - SlLog2 + 1;
+}
+
+void TlsfAllocator::MappingSearch(uint64_t size , uint32_t& fl , uint32_t& sl)
+{
+    //向上取整到下一个链表的下界，这样链表中的任何一块都一定放得下，不需要遍历链表
+    if (size >= SlCount)
+    {
+        uint32_t msb = static_cast<uint32_t>(std::bit_width(size)) - 1;
+        size += ( 1ull << ( msb - SlLog2 ) ) - 1;
+    }
+    MappingInsert(size, fl, sl);
+}
+
+uint32_t TlsfAllocator::NewNode(uint64_t offset , uint64_t size)
+{
+    Node node   = {};
+    node.offset = offset;
+    node.size   = size;
+    if (!m_UnusedNodes.empty())
+    {
+        uint32_t index = m_UnusedNodes.back();
+        m_UnusedNodes.pop_back();
+        m_Nodes[index] = node;
+        return index;
+    }
+    m_Nodes.push_back(node);
+    return static_cast<uint32_t>(m_Nodes.size() - 1);
+}
+
+void TlsfAllocator::InsertFree(uint32_t index)
+{
+    Node&    node = m_Nodes[index];
+    uint32_t fl , sl;
+    MappingInsert(node.size, fl, sl);
+
+    node.free     = true;
+    node.prevFree = None;
+    node.nextFree = m_Heads[fl][sl];
+    if (node.nextFree != None)
+    {
+        m_Nodes[node.nextFree].prevFree = index;
+    }
+    m_Heads[fl][sl] = index;
+    m_FlBitmap |= 1ull << fl;
+    m_SlBitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::RemoveFree(uint32_t index)
+{
+    Node&    node = m_Nodes[index];
+    uint32_t fl , sl;
+    MappingInsert(node.size, fl, sl);
+
+    if (node.prevFree != None) m_Nodes[node.prevFree].nextFree = node.nextFree;
+    else m_Heads[fl][sl] = node.nextFree;
+    if (node.nextFree != None) m_Nodes[node.nextFree].prevFree = node.prevFree;
+
+    if (m_Heads[fl][sl] == None)
+    {
+        m_SlBitmap[fl] &= ~( 1u << sl );
+        if (m_SlBitmap[fl] == 0)
+        {
+            m_FlBitmap &= ~( 1ull << fl );
+        }
+    }
+    node.free     = false;
+    node.prevFree = None;
+    node.nextFree = None;
+}
+
+uint32_t TlsfAllocator::FindFree(uint32_t fl , uint32_t sl) const
+{
+    if (fl >= FlCount) return None;
+
+    //先在同一级中找不小于sl的链表，找不到再去更高的一级
+    uint32_t slMap = m_SlBitmap[fl] & ( ~0u << sl );
+    if (slMap == 0)
+    {
+        uint64_t flMap = fl + 1 < 64 ? m_FlBitmap & ( ~0ull << ( fl + 1 ) ) : 0;
+        if (flMap == 0) return None;
+        fl    = static_cast<uint32_t>(std::countr_zero(flMap));
+        slMap = m_SlBitmap[fl];
+    }
+    sl = static_cast<uint32_t>(std::countr_zero(slMap));
+    return m_Heads[fl][sl];
+}
+
+std::optional<TlsfAllocator::Allocation> TlsfAllocator::Allocate(uint64_t size , uint64_t alignment)
+{
+    if (size == 0) size = 1;
+    if (alignment == 0) alignment = 1;
+    if (size > m_Capacity) return std::nullopt;
+
+    //多找alignment - 1字节，保证对齐后仍然放得下
+    uint32_t fl , sl;
+    MappingSearch(size + alignment - 1, fl, sl);
+    uint32_t index = FindFree(fl, sl);
+    if (index == None) return std::nullopt;
+    RemoveFree(index);
+
+    uint64_t alignedOffset = ( m_Nodes[index].offset + alignment - 1 ) / alignment * alignment;
+    uint64_t padding       = alignedOffset - m_Nodes[index].offset;
+
+    //对齐产生的前部空隙拆成单独的空闲块
+    if (padding != 0)
+    {
+        uint32_t front = NewNode(m_Nodes[index].offset, padding);
+        m_Nodes[front].prevPhysical = m_Nodes[index].prevPhysical;
+        m_Nodes[front].nextPhysical = index;
+        if (m_Nodes[index].prevPhysical != None)
+        {
+            m_Nodes[m_Nodes[index].prevPhysical].nextPhysical = front;
+        }
+        m_Nodes[index].prevPhysical = front;
+        m_Nodes[index].offset       = alignedOffset;
+        m_Nodes[index].size -= padding;
+        MergeAndInsert(front);
+    }
+
+    //剩余的尾部拆成新的空闲块
+    if (m_Nodes[index].size > size)
+    {
+        uint32_t back = NewNode(alignedOffset + size, m_Nodes[index].size - size);
+        m_Nodes[back].prevPhysical = index;
+        m_Nodes[back].nextPhysical = m_Nodes[index].nextPhysical;
+        if (m_Nodes[index].nextPhysical != None)
+        {
+            m_Nodes[m_Nodes[index].nextPhysical].prevPhysical = back;
+        }
+        m_Nodes[index].nextPhysical = back;
+        m_Nodes[index].size         = size;
+        MergeAndInsert(back);
+    }
+
+    m_UsedBytes += size;
+    m_AllocationCount++;
+    return Allocation{alignedOffset, size, index};
+}
+
+void TlsfAllocator::Free(uint32_t index)
+{
+    if (index >= m_Nodes.size() || m_Nodes[index].free)
+    {
+        throw std::runtime_error("TlsfAllocator: invalid or double free");
+    }
+    m_UsedBytes -= m_Nodes[index].size;
+    m_AllocationCount--;
+    MergeAndInsert(index);
+}
+
+void TlsfAllocator::MergeAndInsert(uint32_t index)
+{
+    uint32_t prev = m_Nodes[index].prevPhysical;
+    if (prev != None && m_Nodes[prev].free)
+    {
+        RemoveFree(prev);
+        m_Nodes[prev].size += m_Nodes[index].size;
+        m_Nodes[prev].nextPhysical = m_Nodes[index].nextPhysical;
+        if (m_Nodes[index].nextPhysical != None)
+        {
+            m_Nodes[m_Nodes[index].nextPhysical].prevPhysical = prev;
+        }
+        m_UnusedNodes.push_back(index);
+        index = prev;
+    }
+
+    uint32_t next = m_Nodes[index].nextPhysical;
+    if (next != None && m_Nodes[next].free)
+    {
+        RemoveFree(next);
+        m_Nodes[index].size += m_Nodes[next].size;
+        m_Nodes[index].nextPhysical = m_Nodes[next].nextPhysical;
+        if (m_Nodes[next].nextPhysical != None)
+        {
+            m_Nodes[m_Nodes[next].nextPhysical].prevPhysical = index;
+        }
+        m_UnusedNodes.push_back(next);
+    }
+
+    InsertFree(index);
+}
+
+uint64_t TlsfAllocator::LargestFreeRange() const
+{
+    if (m_FlBitmap == 0) return 0;
+
+    //最大的空闲块一定在最高的非空链表里，但同一链表内的大小并不相同，需要遍历这一条链表
+    uint32_t fl      = 63 - static_cast<uint32_t>(std::countl_zero(m_FlBitmap));
+    uint32_t sl      = 31 - static_cast<uint32_t>(std::countl_zero(m_SlBitmap[fl]));
+    uint64_t largest = 0;
+    for (uint32_t index = m_Heads[fl][sl]; index != None; index = m_Nodes[index].nextFree)
+    {
+        largest = std::max(largest, m_Nodes[index].size);
+    }
+    return largest;
+}
@@ -0,0 +1,73 @@
+﻿#pragma once
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/*
+ * TLSF(Two-Level Segregated Fit)偏移量分配器。
+ * 只管理[0, capacity)范围内的偏移量，不接触真正的内存，所以可以用来划分VkDeviceMemory这类无法直接访问的资源。
+ * 空闲块按大小放进两级链表：第一级按2的幂划分，第二级把每个2的幂区间再等分成SlCount份。
+ * 两级都用位图记录哪些链表非空，分配和释放都是O(1)，相邻空闲块在释放时立即合并。
+ */
+class TlsfAllocator
+{
+public:
+    struct Allocation
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t node; //释放时使用
+    };
+
+    explicit TlsfAllocator(uint64_t capacity = 0);
+
+    //空间不足时返回空
+    std::optional<Allocation> Allocate(uint64_t size , uint64_t alignment = 1);
+    void                      Free(uint32_t node);
+
+    uint64_t Capacity() const { return m_Capacity; }
+    uint64_t UsedBytes() const { return m_UsedBytes; }
+    uint64_t FreeBytes() const { return m_Capacity - m_UsedBytes; }
+    uint32_t AllocationCount() const { return m_AllocationCount; }
+    bool     Empty() const { return m_AllocationCount == 0; }
+    //最大的连续空闲区间，和FreeBytes一起可以衡量碎片程度
+    uint64_t LargestFreeRange() const;
+
+private:
+    static constexpr uint32_t SlLog2  = 5;
+    static constexpr uint32_t SlCount = 1u << SlLog2;
+    static constexpr uint32_t FlCount = 64 - SlLog2 + 1;
+    static constexpr uint32_t None    = UINT32_MAX;
+
+    struct Node
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t prevPhysical = None; //地址上相邻的块
+        uint32_t nextPhysical = None;
+        uint32_t prevFree     = None; //同一空闲链表中的块
+        uint32_t nextFree     = None;
+        bool     free         = false;
+    };
+
+    static void MappingInsert(uint64_t size , uint32_t& fl , uint32_t& sl);
+    static void MappingSearch(uint64_t size , uint32_t& fl , uint32_t& sl);
+
+    uint32_t NewNode(uint64_t offset , uint64_t size);
+    void     InsertFree(uint32_t node);
+    void     RemoveFree(uint32_t node);
+    uint32_t FindFree(uint32_t fl , uint32_t sl) const;
+    //把空闲块和地址上相邻的空闲块合并后放回空闲链表
+    void MergeAndInsert(uint32_t node);
+
+    uint64_t m_Capacity        = 0;
+    uint64_t m_UsedBytes       = 0;
+    uint32_t m_AllocationCount = 0;
+
+    std::vector<Node>     m_Nodes;
+    std::vector<uint32_t> m_UnusedNodes;
+
+    uint64_t m_FlBitmap = 0;
+    uint32_t m_SlBitmap[FlCount] = {};
+    uint32_t m_Heads[FlCount][SlCount];
+};